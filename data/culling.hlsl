@@ -14,7 +14,7 @@ struct IndirectCommand {
     uint ibuffer_index;
     uint transform_index;
     uint texture_index;
-    uint aabb_index;
+    uint mesh_constants_index;
     uint vertex_count_per_instance;
     uint instance_count;
     uint start_vertex_location;
@@ -56,7 +56,7 @@ void cs_main(uint3 thread_id : SV_DispatchThreadID, uint group_index : SV_GroupI
 
         ConstantBuffer<Frustum> frustum = ResourceDescriptorHeap[di_frustum];
         ConstantBuffer<MatrixStruct> transform = ResourceDescriptorHeap[instance.transform_index];
-        ConstantBuffer<AABB> aabb = ResourceDescriptorHeap[instance.aabb_index];
+        ConstantBuffer<AABB> aabb = ResourceDescriptorHeap[instance.mesh_constants_index];
 
         float3 min = aabb.min;
         float3 max = aabb.max;
@@ -6,6 +6,22 @@ struct Vertex {
     float2 uv;
 };
 
+#define VERTEX_FORMAT_COMPACT 1
+#define INDEX_FORMAT_U16 1
+
+struct MeshConstants {
+    float3 aabb_min;
+    float pad0;
+    float3 aabb_max;
+    float pad1;
+    float3 position_offset;
+    float pad2;
+    float3 position_scale;
+    float pad3;
+    uint vertex_format;
+    uint index_format;
+};
+
 struct VSOut {
     float4 sv_pos : SV_Position;
     float3 normal : Normal;
@@ -19,17 +35,55 @@ cbuffer DescriptorIndices : register(b0, space0)
     uint di_ibuffer;
     uint di_transform;
     uint di_texture;
+    uint di_mesh_constants;
 };
 
+float3 decode_octahedral(float2 e) {
+    float3 n = float3(e, 1.0f - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0f);
+    n.x += n.x >= 0.0f ? -t : t;
+    n.y += n.y >= 0.0f ? -t : t;
+    return normalize(n);
+}
+
+uint fetch_index(ConstantBuffer<MeshConstants> mesh, uint vertex_id) {
+    ByteAddressBuffer ibuffer = ResourceDescriptorHeap[di_ibuffer];
+
+    if (mesh.index_format == INDEX_FORMAT_U16) {
+        uint pair = ibuffer.Load((vertex_id * 2) & ~3u);
+        return (vertex_id & 1) ? pair >> 16 : pair & 0xFFFF;
+    }
+
+    return ibuffer.Load(vertex_id * 4);
+}
+
+Vertex fetch_vertex(ConstantBuffer<MeshConstants> mesh, uint index) {
+    if (mesh.vertex_format == VERTEX_FORMAT_COMPACT) {
+        StructuredBuffer<uint4> vbuffer = ResourceDescriptorHeap[di_vbuffer];
+        uint4 packed = vbuffer[index];
+
+        float3 q = float3(packed.x & 0xFFFF, packed.x >> 16, packed.y & 0xFFFF);
+        int2 octahedral = int2(packed.z << 16, packed.z) >> 16;
+
+        Vertex vertex;
+        vertex.pos = mesh.position_offset + q * mesh.position_scale;
+        vertex.norm = decode_octahedral(max(float2(octahedral) / 32767.0f, -1.0f));
+        vertex.uv = float2(f16tof32(packed.w), f16tof32(packed.w >> 16));
+        return vertex;
+    }
+
+    StructuredBuffer<Vertex> vbuffer = ResourceDescriptorHeap[di_vbuffer];
+    return vbuffer[index];
+}
+
 VSOut vs_main(uint vertex_id : SV_VertexID) {
     ConstantBuffer<MatrixStruct> camera = ResourceDescriptorHeap[di_camera];
 
-    StructuredBuffer<Vertex> vbuffer = ResourceDescriptorHeap[di_vbuffer];
-    StructuredBuffer<uint> ibuffer = ResourceDescriptorHeap[di_ibuffer];
+    ConstantBuffer<MeshConstants> mesh = ResourceDescriptorHeap[di_mesh_constants];
 
     ConstantBuffer<MatrixStruct> transform = ResourceDescriptorHeap[di_transform];
 
-    Vertex vertex = vbuffer[ibuffer[vertex_id]];
+    Vertex vertex = fetch_vertex(mesh, fetch_index(mesh, vertex_id));
     
     VSOut vso;
     vso.sv_pos = mul(camera.m, mul(transform.m, float4(vertex.pos, 1.0f)));
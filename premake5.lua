@@ -1,3 +1,14 @@
+newoption {
+    trigger = "renderer",
+    value = "BACKEND",
+    description = "Renderer backend to build",
+    allowed = {
+        { "d3d12", "Direct3D 12" },
+        { "null", "No GPU; uploads are staged and counted on the CPU" },
+    },
+    default = "d3d12",
+}
+
 workspace "sugar"
     configurations { "Debug", "Release" }
     architecture "x86_64"
@@ -43,10 +54,57 @@ project "sugar"
         "{COPY} extern/DirectXShaderCompiler/bin/dxcompiler.dll target/bin"
     }
 
+    filter "options:renderer=null"
+        defines { "RENDERER_NULL=1" }
+
+    filter "configurations:Debug"
+        defines { "_DEBUG" }
+        symbols "On"
+
+    filter "configurations:Release"
+        defines { "NDEBUG" }
+        optimize "On"
+
+    filter {}
+
+-- Runs the checks and benchmarks in tests/ against the null backend, so it needs no GPU.
+project "tests"
+    kind "ConsoleApp"
+    language "C++"
+
+    targetdir "target/bin/"
+    objdir "target/obj/tests/"
+    debugdir "data"
+
+    warnings "Extra"
+    flags { "FatalWarnings" }
+
+    disablewarnings { "4505", "4201" }
+
+    files {
+        "src/**.h",
+        "src/**.c",
+        "src/**.cpp",
+        "tests/**.h",
+        "tests/**.cpp",
+    }
+
+    removefiles {
+        "src/core/entry_win32.cpp",
+    }
+
+    includedirs {
+        "src",
+        "tests",
+        "extern/stb"
+    }
+
+    defines { "RENDERER_NULL=1" }
+
     filter "configurations:Debug"
         defines { "_DEBUG" }
         symbols "On"
 
     filter "configurations:Release"
         defines { "NDEBUG" }
-        optimize "On"
\ No newline at end of file
+        optimize "On"
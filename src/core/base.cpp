@@ -17,12 +17,17 @@ void arena_clear(Arena* arena) {
     arena->cursor = (u8*)arena->base;
 }
 
+u64 arena_push_size(u64 size) {
+    // 16 byte granularity keeps arrays of XMVECTOR and XMMATRIX members aligned.
+    return (size + 15) & ~15;
+}
+
 void* arena_push(Arena* arena, u64 size) {
     if (size == 0) {
         return NULL;
     }
 
-    size = (size + 7) & ~7;
+    size = arena_push_size(size);
 
     assert((i64)size <= (arena->end - arena->cursor));
     void* ptr = arena->cursor;
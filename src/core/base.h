@@ -37,10 +37,13 @@ void arena_clear(Arena* arena);
 void* arena_push(Arena* arena, u64 size);
 void* arena_push_zero(Arena* arena, u64 size);
 
-#define arena_push_array(arena, type, len) (type*)arena_push(arena, len * sizeof(type))
-#define arena_push_array_zero(arena, type, len) (type*)arena_push_zero(arena, len * sizeof(type))
+// What pushing size bytes takes from an arena, for sizing one up front.
+u64 arena_push_size(u64 size);
+
+#define arena_push_array(arena, type, len) (type*)arena_push(arena, (len) * sizeof(type))
+#define arena_push_array_zero(arena, type, len) (type*)arena_push_zero(arena, (len) * sizeof(type))
 
 #define arena_push_struct(arena, type) arena_push_array(arena, type, 1)
 #define arena_push_struct_zero(arena, type) arena_push_array_zero(arena, type, 1)
 
-#define arena_mark(arena, type) ( assert(sizeof(type)%8==0), (type*)(arena->cursor) )
+#define arena_array_size(type, len) arena_push_size((len) * sizeof(type))
@@ -1,117 +1,20 @@
 #include <Windows.h> 
-#include <stdarg.h>
-#include <stdio.h>
+#include <math.h>
+#include <string.h>
 
 #include "common.h"
 #include "renderer/renderer.h"
 #include "renderer/gltf.h"
+#include "renderer/gltf_lazy.h"
+#include "renderer/texture_streaming.h"
+#include "renderer/asset_registry.h"
+#include "renderer/scene_graph.h"
+#include "renderer/animation.h"
+#include "renderer/skinning.h"
+#include "utility/work_queue.h"
+#include "utility/pak.h"
 
-void system_message_box(char* fmt, ...) {
-    va_list args;
-    va_start(args, fmt);
-
-    char buf[1024];
-    vsnprintf(buf, sizeof(buf), fmt, args);
-    MessageBoxA(0, buf, "Sugar", 0);
-
-    va_end(args);
-}
-
-void debug_message(char* fmt, ...) {
-    va_list args;
-    va_start(args, fmt);
-
-    char buf[1024];
-    vsnprintf(buf, sizeof(buf), fmt, args);
-    OutputDebugStringA(buf);
-
-    va_end(args);
-}
-
-global_var LARGE_INTEGER counter_start;
-global_var LARGE_INTEGER counter_freq;
-
-f32 engine_time() {
-    LARGE_INTEGER counter_now;
-    QueryPerformanceCounter(&counter_now);
-    i64 elapsed = counter_now.QuadPart - counter_start.QuadPart;
-    f64 elapsed_seconds = (f64)elapsed / (f64)counter_freq.QuadPart;
-    return (f32)elapsed_seconds;
-}
-
-#define SCRATCH_ARENA_SIZE (1024 * 1024 * 1024)
-#define NUM_SCRATCH_ARENAS 2
-Arena scratch_arenas[NUM_SCRATCH_ARENAS];
-
-Scratch get_scratch(Arena** conflicts, u32 conflict_count) {
-    for (int i = 0; i < NUM_SCRATCH_ARENAS; ++i)
-    {
-        bool conflicting = false;
-        for (u32 j = 0; j < conflict_count; ++j) {
-            if (conflicts[j] == &scratch_arenas[i]) {
-                conflicting = true;
-                break;
-            }
-        }
-        
-        if (!conflicting) {
-            Scratch scratch;
-            scratch.arena = &scratch_arenas[i];
-            scratch.ptr = scratch.arena->cursor;
-            return scratch;
-        }
-    }
-
-    assert(false && "Unable to retrieve a scratch arena that isn't in conflict");
-    return {};
-}
-
-void release_scratch(Scratch scratch) {
-    if (scratch.ptr < scratch.arena->cursor) {
-        scratch.arena->cursor = scratch.ptr;
-    }
-}
-
-ReadFileResult read_file(Arena* arena, char* path) {
-    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
-
-    if (file == INVALID_HANDLE_VALUE) {
-        system_message_box("Missing file: '%s'", path);
-    }
-
-    LARGE_INTEGER file_size;
-    GetFileSizeEx(file, &file_size);
-
-    char* memory = (char*)arena_push(arena, file_size.QuadPart + 1);
-    DWORD bytes_read = 0;
-    ReadFile(file, memory,(DWORD)file_size.QuadPart, &bytes_read, 0);
-
-    assert((LONGLONG)bytes_read == file_size.QuadPart);
-    memory[bytes_read] = '\0';
-
-    CloseHandle(file);
-
-    ReadFileResult result;
-    result.memory = (char*)memory;
-    result.size = file_size.QuadPart;
-
-    return result;
-}
-
-void write_file(char* path, void* data, u64 size) {
-    HANDLE file = CreateFileA(path, GENERIC_WRITE, FILE_SHARE_WRITE, 0, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, 0);
-
-    if (file == INVALID_HANDLE_VALUE) {
-        system_message_box("Couldn't create file: '%s'", path);
-    }
-
-    DWORD bytes_written;
-    WriteFile(file, data, (DWORD)size, &bytes_written, 0);
-
-    assert(bytes_written == size);
-
-    CloseHandle(file);
-}
+#define WORK_QUEUE_SCRATCH_SIZE (64 * 1024 * 1024)
 
 struct WindowEvents {
     b32 closed;
@@ -192,10 +95,6 @@ internal LRESULT CALLBACK window_callback(HWND window, UINT msg, WPARAM w_param,
     return result;
 }
 
-internal void* page_alloc(u64 size) {
-    return VirtualAlloc(0, size, MEM_COMMIT, PAGE_READWRITE);
-}
-
 internal bool key_down(int key) {
     return GetKeyState(key) & (1 << 15);
 }
@@ -231,13 +130,8 @@ internal void extract_frustum_planes(XMMATRIX view_projection, XMVECTOR* frustum
 }
 
 
-int CALLBACK WinMain(HINSTANCE instance, HINSTANCE, LPSTR, int) {
-    QueryPerformanceCounter(&counter_start);
-    QueryPerformanceFrequency(&counter_freq);
-
-    for (int i = 0; i < NUM_SCRATCH_ARENAS; ++i) {
-        scratch_arenas[i] = arena_init(page_alloc(SCRATCH_ARENA_SIZE), SCRATCH_ARENA_SIZE);
-    }
+int CALLBACK WinMain(HINSTANCE instance, HINSTANCE, LPSTR command_line, int) {
+    platform_init();
 
     WNDCLASSA window_class = {};
     window_class.hInstance = instance;
@@ -276,20 +170,61 @@ int CALLBACK WinMain(HINSTANCE instance, HINSTANCE, LPSTR, int) {
     RegisterRawInputDevices(&raw_input_mouse, 1, sizeof(RAWINPUTDEVICE));
 
     u64 perm_arena_size = 64 * 1024u * 1024u;
-    u64 frame_arena_size = 3 * 1024 * 1024;
+    u64 frame_arena_size = 32 * 1024 * 1024; // Holds the skinned vertices posed each frame
     Arena perm_arena = arena_init(page_alloc(perm_arena_size), perm_arena_size);
     Arena frame_arena = arena_init(page_alloc(frame_arena_size), frame_arena_size);
 
-    Renderer* renderer = renderer_init(&perm_arena, window);
+    // Files are read from data.pak when there is one, falling back to loose files for anything it doesn't hold.
+    // Running with -build_pak reads only loose files and packs the ones read into data.pak on exit, in the order
+    // they were first read, which is the order the pak reads ahead in.
+    bool build_pak = strstr(command_line, "-build_pak") != 0;
+
+    Pak* pak = 0;
+    if (build_pak) {
+        vfs_begin_recording(64 * 1024);
+    }
+    else {
+        pak = pak_open(&perm_arena, "data.pak", processor_count() - 1);
+        if (pak) {
+            vfs_mount(pak);
+        }
+    }
 
-    RendererUploadContext* upload_context = renderer_open_upload_context(&perm_arena, renderer);
-    LoadGLTFResult gltf = load_gltf(&perm_arena, renderer, upload_context, "models/bistro/bistro.gltf");
-    RendererUploadTicket* upload_ticket = renderer_submit_upload_context(&perm_arena, renderer, upload_context);
+    Renderer* renderer = renderer_init(&perm_arena, window);
 
-    for (u32 i = 0; i < gltf.num_instances; ++i) {
-        gltf.instances[i].transform *= XMMatrixScaling(0.4f, 0.4f, 0.4f);
+    AssetRegistry* assets = asset_registry_new(&perm_arena, renderer, 16 * 1024);
+
+    GLTFLoadOptions load_options = gltf_default_load_options();
+    load_options.weld_vertices = true;
+    load_options.optimize_vertex_cache = true;
+    load_options.optimize_overdraw = true;
+    load_options.optimize_vertex_fetch = true;
+    load_options.build_meshlets = true;
+    load_options.compact_vertices = true;
+    load_options.generate_lods = true;
+    load_options.generate_mips = true;
+    load_options.mip_filter = MIP_FILTER_KAISER;
+    load_options.texture_format = TEXTURE_FORMAT_BC7;
+    load_options.texture_quality = BC_QUALITY_FAST;
+    load_options.lazy_materials = true;
+
+    // Running with -stream_textures streams the scene's texture mips by how large they appear to the culling camera,
+    // uploading at most the budget each frame, instead of uploading whole chains.
+    TextureStreamer* texture_streamer = 0;
+    if (strstr(command_line, "-stream_textures")) {
+        texture_streamer = texture_streamer_new(&perm_arena, renderer, 16 * 1024, 8 * 1024 * 1024);
+        load_options.texture_streamer = texture_streamer;
     }
 
+    // The scene streams in while the main loop runs; each frame spends at most about this long recording uploads.
+    f32 load_time_slice = 0.002f;
+
+    SceneAsset scene = asset_registry_acquire_scene(assets, &load_options, "models/bistro/bistro.gltf");
+    LoadGLTFResult* gltf = asset_registry_scene(assets, scene);
+    bool scene_placed = false;
+
+    WorkQueue* work_queue = work_queue_new(&perm_arena, processor_count() - 1, WORK_QUEUE_SCRATCH_SIZE);
+
     f32 last_time = engine_time();
 
     bool in_camera = false;
@@ -437,19 +372,41 @@ int CALLBACK WinMain(HINSTANCE instance, HINSTANCE, LPSTR, int) {
         renderer_camera.far_plane = camera->far_plane;
         renderer_camera.fov = camera->fov;
 
-        MeshInstance* queue = 0;
-        int queue_len = 0;
+        asset_registry_update(assets, load_time_slice);
+
+        if (gltf->scene_graph && !scene_placed) {
+            scene_graph_set_local_transform(gltf->scene_graph, SCENE_GRAPH_ROOT, XMVectorZero(), XMQuaternionIdentity(), XMVectorReplicate(0.4f));
+            scene_placed = true;
+        }
+
+        if (gltf->num_animations > 0 && gltf->animations[0]->duration > 0.0f) {
+            AnimationClip* clip = gltf->animations[0];
+            animation_sample(clip, fmodf(time, clip->duration), gltf->scene_graph, true);
+        }
 
-        if (renderer_upload_finished(renderer, upload_ticket)) {
-            queue = arena_push_array(&frame_arena, MeshInstance, gltf.num_instances);
-            memcpy(queue, gltf.instances, gltf.num_instances * sizeof(MeshInstance));
-            queue_len = gltf.num_instances;
+        if (gltf->scene_graph) {
+            scene_graph_update(gltf->scene_graph, work_queue, gltf->num_instances, gltf->instances, gltf->instance_nodes, gltf->num_instance_batches, gltf->instance_batches, gltf->instance_batch_nodes);
         }
 
+        MeshVertexUpdate* skinned_updates = 0;
+        if (gltf->num_skinned_meshes > 0) {
+            skinned_updates = skin_meshes(&frame_arena, work_queue, gltf->scene_graph, gltf->num_skinned_meshes, gltf->skinned_meshes);
+        }
+
+        // The renderer writes each instance's selected LOD back into the queue, so the instances are passed
+        // directly to keep that state (and the LOD hysteresis) across frames.
+        MeshInstance* queue = gltf->instances;
+        int queue_len = gltf->num_instances;
+
         RendererFrameData frame = {};
         frame.camera = &renderer_camera;
         frame.queue = queue;
         frame.queue_len = queue_len;
+        frame.instance_batches = gltf->instance_batches;
+        frame.num_instance_batches = gltf->num_instance_batches;
+        frame.mesh_updates = skinned_updates;
+        frame.num_mesh_updates = gltf->num_skinned_meshes;
+        frame.lod_error_pixels = 1.0f;
 
         f32 aspect_ratio = (f32)window_width / (f32)window_height;
         XMMATRIX camera0_transform = XMMatrixRotationRollPitchYaw(cameras[0].pitch, cameras[0].yaw, 0.0f) * XMMatrixTranslationFromVector(cameras[0].position);
@@ -478,6 +435,19 @@ int CALLBACK WinMain(HINSTANCE instance, HINSTANCE, LPSTR, int) {
 
         extract_frustum_planes(view_proj_matrix, frame.frustum);
 
+        if (texture_streamer) {
+            f32 projection_scale = (f32)window_height / (2.0f * tanf(cameras[0].fov / aspect_ratio * 0.5f));
+            texture_streamer_begin_frame(texture_streamer, cameras[0].position, projection_scale);
+        }
+
+        // Textures are decoded as the culling camera first sees them, within the same slice as the scene's uploads.
+        // Streamed ones are updated in between, so instances switch to levels that finished uploading this frame.
+        gltf_request_visible_materials(renderer, gltf, frame.frustum);
+        if (texture_streamer) {
+            texture_streamer_update(texture_streamer);
+        }
+        gltf_update_lazy_materials(renderer, asset_registry_texture_cache(assets), gltf, load_time_slice);
+
         LineMesh line_meshes[1] = {};
         u32 num_line_meshes = 0;
 
@@ -500,21 +470,37 @@ int CALLBACK WinMain(HINSTANCE instance, HINSTANCE, LPSTR, int) {
         frame.num_line_meshes = num_line_meshes;
 
         renderer_render_frame(renderer, &frame);
+
+        asset_registry_collect(assets);
     }
 
     #if _DEBUG
-    for (u32 i = 0; i < gltf.num_instances; ++i) {
-        if (renderer_mesh_alive(renderer, gltf.instances[i].mesh)) {
-            renderer_free_mesh(renderer, gltf.instances[i].mesh);
-        }
+    // A scene that's still loading is only freed once its load finishes.
+    asset_registry_release_scene(assets, scene);
+    while (asset_registry_num_scenes(assets) > 0) {
+        asset_registry_update(assets, load_time_slice);
+        asset_registry_collect(assets);
     }
+    #endif
 
-    for (u32 i = 0; i < gltf.num_materials; ++i) {
-        renderer_free_material(renderer, gltf.materials[i]);
+    if (texture_streamer) {
+        texture_streamer_destroy(texture_streamer);
     }
-    #endif
+
+    work_queue_destroy(work_queue);
 
     renderer_release_backend(renderer);
 
+    if (pak) {
+        vfs_unmount(pak);
+        pak_close(pak);
+    }
+
+    if (build_pak) {
+        char** pak_paths = 0;
+        u32 num_pak_paths = vfs_end_recording(&perm_arena, &pak_paths);
+        pak_build("data.pak", num_pak_paths, pak_paths);
+    }
+
     return 0;
 }
\ No newline at end of file
@@ -2,6 +2,9 @@
 
 #include "base.h"
 
+// Starts the clock and gives the calling thread its scratch arenas. Call once, before anything else.
+void platform_init();
+
 void system_message_box(char* fmt, ...);
 void debug_message(char* fmt, ...);
 
@@ -20,5 +23,54 @@ struct ReadFileResult {
     u64 size;
 };
 
+// Looks in the mounted paks before falling back to loose files.
 ReadFileResult read_file(Arena* arena, char* path);
 void write_file(char* path, void* data, u64 size);
+
+// Files read at explicit offsets, so one can be read from several threads at once.
+
+struct File {
+    void* handle; // Null if the file couldn't be opened
+};
+
+File file_open(char* path);
+void file_close(File file);
+u64 file_size(File file);
+bool file_read(File file, u64 offset, void* memory, u64 size);
+
+// Writes the file's cached pages back and drops them from the OS's file cache, so the next read goes to the disk.
+// For measuring cold reads.
+void file_drop_cached(char* path);
+
+void* page_alloc(u64 size);
+void page_free(void* memory);
+
+// Threads get their own scratch arenas of scratch_size bytes each, so get_scratch is safe to call from any thread.
+
+typedef void ThreadProc(void* data);
+
+struct Thread {
+    void* handle;
+};
+
+Thread thread_start(Arena* arena, ThreadProc* proc, void* data, u64 scratch_size);
+void thread_join(Thread thread);
+
+// Whether the thread has exited, so joining it won't wait.
+bool thread_finished(Thread thread);
+
+u32 processor_count();
+
+struct Semaphore {
+    void* handle;
+};
+
+Semaphore semaphore_create(u32 initial_count);
+void semaphore_destroy(Semaphore semaphore);
+void semaphore_signal(Semaphore semaphore, u32 count);
+void semaphore_wait(Semaphore semaphore);
+
+// Interlocked operations; each one is a full memory barrier.
+u32 atomic_increment(volatile u32* value);
+u32 atomic_load(volatile u32* value);
+void atomic_store(volatile u32* value, u32 new_value);
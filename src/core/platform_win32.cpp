@@ -0,0 +1,269 @@
+#include <Windows.h>
+#include <stdarg.h>
+#include <stdio.h>
+
+#include "common.h"
+#include "utility/pak.h"
+
+void system_message_box(char* fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+
+    char buf[1024];
+    vsnprintf(buf, sizeof(buf), fmt, args);
+    MessageBoxA(0, buf, "Sugar", 0);
+
+    va_end(args);
+}
+
+void debug_message(char* fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+
+    char buf[1024];
+    vsnprintf(buf, sizeof(buf), fmt, args);
+    OutputDebugStringA(buf);
+
+    va_end(args);
+}
+
+global_var LARGE_INTEGER counter_start;
+global_var LARGE_INTEGER counter_freq;
+
+f32 engine_time() {
+    LARGE_INTEGER counter_now;
+    QueryPerformanceCounter(&counter_now);
+    i64 elapsed = counter_now.QuadPart - counter_start.QuadPart;
+    f64 elapsed_seconds = (f64)elapsed / (f64)counter_freq.QuadPart;
+    return (f32)elapsed_seconds;
+}
+
+#define SCRATCH_ARENA_SIZE (1024 * 1024 * 1024)
+#define NUM_SCRATCH_ARENAS 2
+thread_local Arena scratch_arenas[NUM_SCRATCH_ARENAS];
+
+void platform_init() {
+    QueryPerformanceCounter(&counter_start);
+    QueryPerformanceFrequency(&counter_freq);
+
+    for (int i = 0; i < NUM_SCRATCH_ARENAS; ++i) {
+        scratch_arenas[i] = arena_init(page_alloc(SCRATCH_ARENA_SIZE), SCRATCH_ARENA_SIZE);
+    }
+}
+
+Scratch get_scratch(Arena** conflicts, u32 conflict_count) {
+    for (int i = 0; i < NUM_SCRATCH_ARENAS; ++i)
+    {
+        bool conflicting = false;
+        for (u32 j = 0; j < conflict_count; ++j) {
+            if (conflicts[j] == &scratch_arenas[i]) {
+                conflicting = true;
+                break;
+            }
+        }
+        
+        if (!conflicting) {
+            Scratch scratch;
+            scratch.arena = &scratch_arenas[i];
+            scratch.ptr = scratch.arena->cursor;
+            return scratch;
+        }
+    }
+
+    assert(false && "Unable to retrieve a scratch arena that isn't in conflict");
+    return {};
+}
+
+void release_scratch(Scratch scratch) {
+    if (scratch.ptr < scratch.arena->cursor) {
+        scratch.arena->cursor = scratch.ptr;
+    }
+}
+
+ReadFileResult read_file(Arena* arena, char* path) {
+    ReadFileResult pak_file;
+    if (vfs_read(arena, path, &pak_file)) {
+        return pak_file;
+    }
+
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+
+    if (file == INVALID_HANDLE_VALUE) {
+        system_message_box("Missing file: '%s'", path);
+    }
+
+    LARGE_INTEGER file_size;
+    GetFileSizeEx(file, &file_size);
+
+    char* memory = (char*)arena_push(arena, file_size.QuadPart + 1);
+    DWORD bytes_read = 0;
+    ReadFile(file, memory,(DWORD)file_size.QuadPart, &bytes_read, 0);
+
+    assert((LONGLONG)bytes_read == file_size.QuadPart);
+    memory[bytes_read] = '\0';
+
+    CloseHandle(file);
+
+    ReadFileResult result;
+    result.memory = (char*)memory;
+    result.size = file_size.QuadPart;
+
+    return result;
+}
+
+void write_file(char* path, void* data, u64 size) {
+    HANDLE file = CreateFileA(path, GENERIC_WRITE, FILE_SHARE_WRITE, 0, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, 0);
+
+    if (file == INVALID_HANDLE_VALUE) {
+        system_message_box("Couldn't create file: '%s'", path);
+    }
+
+    DWORD bytes_written;
+    WriteFile(file, data, (DWORD)size, &bytes_written, 0);
+
+    assert(bytes_written == size);
+
+    CloseHandle(file);
+}
+
+File file_open(char* path) {
+    File file = {};
+
+    HANDLE handle = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+    if (handle != INVALID_HANDLE_VALUE) {
+        file.handle = handle;
+    }
+
+    return file;
+}
+
+void file_close(File file) {
+    CloseHandle(file.handle);
+}
+
+u64 file_size(File file) {
+    LARGE_INTEGER size;
+    GetFileSizeEx(file.handle, &size);
+    return size.QuadPart;
+}
+
+bool file_read(File file, u64 offset, void* memory, u64 size) {
+    u8* cursor = (u8*)memory;
+
+    while (size > 0) {
+        DWORD read_size = size < (1u << 30) ? (DWORD)size : (1u << 30);
+
+        // An offset in the OVERLAPPED reads there without moving a shared file pointer.
+        OVERLAPPED overlapped = {};
+        overlapped.Offset = (DWORD)offset;
+        overlapped.OffsetHigh = (DWORD)(offset >> 32);
+
+        DWORD bytes_read = 0;
+        if (!ReadFile(file.handle, cursor, read_size, &bytes_read, &overlapped) || bytes_read != read_size) {
+            return false;
+        }
+
+        cursor += read_size;
+        offset += read_size;
+        size -= read_size;
+    }
+
+    return true;
+}
+
+void file_drop_cached(char* path) {
+    // The cache manager flushes and purges a file's pages when it's opened without buffering.
+    HANDLE handle = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, 0, OPEN_EXISTING, FILE_FLAG_NO_BUFFERING, 0);
+    if (handle != INVALID_HANDLE_VALUE) {
+        CloseHandle(handle);
+    }
+}
+
+void* page_alloc(u64 size) {
+    return VirtualAlloc(0, size, MEM_COMMIT, PAGE_READWRITE);
+}
+
+void page_free(void* memory) {
+    VirtualFree(memory, 0, MEM_RELEASE);
+}
+
+struct ThreadStartInfo {
+    ThreadProc* proc;
+    void* data;
+    u64 scratch_size;
+};
+
+internal DWORD WINAPI thread_entry(LPVOID param) {
+    ThreadStartInfo* info = (ThreadStartInfo*)param;
+
+    for (int i = 0; i < NUM_SCRATCH_ARENAS; ++i) {
+        scratch_arenas[i] = arena_init(page_alloc(info->scratch_size), info->scratch_size);
+    }
+
+    info->proc(info->data);
+
+    for (int i = 0; i < NUM_SCRATCH_ARENAS; ++i) {
+        page_free(scratch_arenas[i].base);
+    }
+
+    return 0;
+}
+
+Thread thread_start(Arena* arena, ThreadProc* proc, void* data, u64 scratch_size) {
+    ThreadStartInfo* info = arena_push_struct(arena, ThreadStartInfo);
+    info->proc = proc;
+    info->data = data;
+    info->scratch_size = scratch_size;
+
+    Thread thread;
+    thread.handle = CreateThread(0, 0, thread_entry, info, 0, 0);
+    assert(thread.handle);
+
+    return thread;
+}
+
+void thread_join(Thread thread) {
+    WaitForSingleObject(thread.handle, INFINITE);
+    CloseHandle(thread.handle);
+}
+
+bool thread_finished(Thread thread) {
+    return WaitForSingleObject(thread.handle, 0) == WAIT_OBJECT_0;
+}
+
+u32 processor_count() {
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors;
+}
+
+Semaphore semaphore_create(u32 initial_count) {
+    Semaphore semaphore;
+    semaphore.handle = CreateSemaphoreA(0, initial_count, MAXLONG, 0);
+    assert(semaphore.handle);
+    return semaphore;
+}
+
+void semaphore_destroy(Semaphore semaphore) {
+    CloseHandle(semaphore.handle);
+}
+
+void semaphore_signal(Semaphore semaphore, u32 count) {
+    ReleaseSemaphore(semaphore.handle, count, 0);
+}
+
+void semaphore_wait(Semaphore semaphore) {
+    WaitForSingleObject(semaphore.handle, INFINITE);
+}
+
+u32 atomic_increment(volatile u32* value) {
+    return (u32)InterlockedIncrement((volatile LONG*)value);
+}
+
+u32 atomic_load(volatile u32* value) {
+    return (u32)InterlockedCompareExchange((volatile LONG*)value, 0, 0);
+}
+
+void atomic_store(volatile u32* value, u32 new_value) {
+    InterlockedExchange((volatile LONG*)value, (LONG)new_value);
+}
@@ -0,0 +1,229 @@
+#include <string.h>
+
+#include "animation.h"
+#include "scene_graph.h"
+
+internal AnimationTrackKind animation_track_kind(AnimationTrackDesc* track) {
+    bool rotation = track->path == ANIMATION_PATH_ROTATION;
+
+    switch (track->interpolation) {
+        case ANIMATION_INTERPOLATION_STEP:
+            return ANIMATION_TRACK_STEP;
+        case ANIMATION_INTERPOLATION_LINEAR:
+            return rotation ? ANIMATION_TRACK_LINEAR_ROTATION : ANIMATION_TRACK_LINEAR;
+        case ANIMATION_INTERPOLATION_CUBIC_SPLINE:
+            return rotation ? ANIMATION_TRACK_CUBIC_ROTATION : ANIMATION_TRACK_CUBIC;
+    }
+
+    assert(false);
+    return ANIMATION_TRACK_STEP;
+}
+
+AnimationClip* animation_clip_new(Arena* arena, u32 num_tracks, AnimationTrackDesc* tracks) {
+    AnimationClip* clip = arena_push_struct_zero(arena, AnimationClip);
+
+    u32 total_keys = 0;
+    u32 total_values = 0;
+
+    for (u32 i = 0; i < num_tracks; ++i) {
+        AnimationTrackDesc* track = &tracks[i];
+        assert(track->key_count > 0);
+
+        ++clip->kind_starts[animation_track_kind(track) + 1];
+
+        total_keys += track->key_count;
+        total_values += track->key_count * (track->interpolation == ANIMATION_INTERPOLATION_CUBIC_SPLINE ? 3 : 1);
+
+        f32 end_time = track->times[track->key_count - 1];
+        if (end_time > clip->duration) {
+            clip->duration = end_time;
+        }
+    }
+
+    for (u32 kind = 0; kind < ANIMATION_TRACK_KIND_COUNT; ++kind) {
+        clip->kind_starts[kind + 1] += clip->kind_starts[kind];
+    }
+
+    clip->num_tracks = num_tracks;
+    clip->track_nodes = arena_push_array(arena, u32, num_tracks);
+    clip->track_paths = arena_push_array(arena, AnimationPath, num_tracks);
+    clip->track_first_keys = arena_push_array(arena, u32, num_tracks);
+    clip->track_first_values = arena_push_array(arena, u32, num_tracks);
+    clip->track_key_counts = arena_push_array(arena, u32, num_tracks);
+    clip->track_cursors = arena_push_array_zero(arena, u32, num_tracks);
+    clip->key_times = arena_push_array(arena, f32, total_keys);
+    clip->key_values = arena_push_array(arena, XMVECTOR, total_values);
+
+    u32 kind_cursors[ANIMATION_TRACK_KIND_COUNT];
+    memcpy(kind_cursors, clip->kind_starts, sizeof(kind_cursors));
+
+    u32 key_cursor = 0;
+    u32 value_cursor = 0;
+
+    for (u32 i = 0; i < num_tracks; ++i) {
+        AnimationTrackDesc* src = &tracks[i];
+        u32 dst = kind_cursors[animation_track_kind(src)]++;
+        u32 value_count = src->key_count * (src->interpolation == ANIMATION_INTERPOLATION_CUBIC_SPLINE ? 3 : 1);
+
+        clip->track_nodes[dst] = src->node;
+        clip->track_paths[dst] = src->path;
+        clip->track_first_keys[dst] = key_cursor;
+        clip->track_first_values[dst] = value_cursor;
+        clip->track_key_counts[dst] = src->key_count;
+
+        memcpy(clip->key_times + key_cursor, src->times, src->key_count * sizeof(f32));
+        memcpy(clip->key_values + value_cursor, src->values, value_count * sizeof(XMVECTOR));
+
+        key_cursor += src->key_count;
+        value_cursor += value_count;
+    }
+
+    return clip;
+}
+
+u64 animation_clip_size(u32 num_tracks, AnimationTrackDesc* tracks) {
+    u32 total_keys = 0;
+    u32 total_values = 0;
+
+    for (u32 i = 0; i < num_tracks; ++i) {
+        total_keys += tracks[i].key_count;
+        total_values += tracks[i].key_count * (tracks[i].interpolation == ANIMATION_INTERPOLATION_CUBIC_SPLINE ? 3 : 1);
+    }
+
+    u64 size = arena_array_size(AnimationClip, 1);
+    size += 5 * arena_array_size(u32, num_tracks) + arena_array_size(AnimationPath, num_tracks);
+    size += arena_array_size(f32, total_keys) + arena_array_size(XMVECTOR, total_values);
+
+    return size;
+}
+
+// Index of the last key at or before time, 0 before the first key. The cached key and the one after it cover
+// forward playback; anything else falls back to a binary search.
+internal u32 find_animation_key(f32* times, u32 key_count, u32 cursor, f32 time) {
+    if (cursor < key_count && times[cursor] <= time) {
+        if (cursor + 1 == key_count || time < times[cursor + 1]) {
+            return cursor;
+        }
+
+        if (cursor + 2 == key_count || time < times[cursor + 2]) {
+            return cursor + 1;
+        }
+    }
+
+    u32 low = 0;
+    u32 high = key_count;
+
+    while (high - low > 1) {
+        u32 mid = (low + high) / 2;
+        if (times[mid] <= time) {
+            low = mid;
+        }
+        else {
+            high = mid;
+        }
+    }
+
+    return low;
+}
+
+internal XMVECTOR* animation_target(SceneGraph* graph, AnimationPath path, u32 node) {
+    switch (path) {
+        case ANIMATION_PATH_TRANSLATION:
+            return &graph->translations[node];
+        case ANIMATION_PATH_ROTATION:
+            return &graph->rotations[node];
+        case ANIMATION_PATH_SCALE:
+            return &graph->scales[node];
+    }
+
+    assert(false);
+    return 0;
+}
+
+// Cubic keys are [in-tangent, value, out-tangent], with tangents per second, so they're scaled by the key span.
+internal XMVECTOR sample_cubic_track(AnimationClip* clip, u32 track, u32 key, f32 factor, f32 span) {
+    XMVECTOR* values = clip->key_values + clip->track_first_values[track] + key * 3;
+
+    if (factor > 0.0f) {
+        return XMVectorHermite(values[1], values[2] * span, values[4], values[3] * span, factor);
+    }
+
+    return values[1];
+}
+
+void animation_sample(AnimationClip* clip, f32 time, SceneGraph* graph, bool fast_rotations) {
+    Scratch scratch = get_scratch(0, 0);
+
+    // Pass 1: locate each track's key and the blend factor towards the next one. Past either end the factor is 0
+    // and the next key is the key itself.
+    u32* keys = arena_push_array(scratch.arena, u32, clip->num_tracks);
+    f32* factors = arena_push_array(scratch.arena, f32, clip->num_tracks);
+    f32* spans = arena_push_array(scratch.arena, f32, clip->num_tracks);
+
+    for (u32 i = 0; i < clip->num_tracks; ++i) {
+        f32* times = clip->key_times + clip->track_first_keys[i];
+        u32 key_count = clip->track_key_counts[i];
+
+        u32 key = find_animation_key(times, key_count, clip->track_cursors[i], time);
+        clip->track_cursors[i] = key;
+
+        f32 factor = 0.0f;
+        f32 span = 0.0f;
+
+        if (key + 1 < key_count && time > times[key]) {
+            span = times[key + 1] - times[key];
+            factor = span > 0.0f ? (time - times[key]) / span : 0.0f;
+        }
+
+        keys[i] = key;
+        factors[i] = factor;
+        spans[i] = span;
+    }
+
+    // Pass 2: one loop per kind, each a straight run of vector math.
+    for (u32 i = clip->kind_starts[ANIMATION_TRACK_STEP]; i < clip->kind_starts[ANIMATION_TRACK_STEP + 1]; ++i) {
+        XMVECTOR* values = clip->key_values + clip->track_first_values[i];
+        *animation_target(graph, clip->track_paths[i], clip->track_nodes[i]) = values[keys[i]];
+    }
+
+    for (u32 i = clip->kind_starts[ANIMATION_TRACK_LINEAR]; i < clip->kind_starts[ANIMATION_TRACK_LINEAR + 1]; ++i) {
+        XMVECTOR* values = clip->key_values + clip->track_first_values[i];
+        XMVECTOR a = values[keys[i]];
+        XMVECTOR b = factors[i] > 0.0f ? values[keys[i] + 1] : a;
+        *animation_target(graph, clip->track_paths[i], clip->track_nodes[i]) = XMVectorLerp(a, b, factors[i]);
+    }
+
+    for (u32 i = clip->kind_starts[ANIMATION_TRACK_LINEAR_ROTATION]; i < clip->kind_starts[ANIMATION_TRACK_LINEAR_ROTATION + 1]; ++i) {
+        XMVECTOR* values = clip->key_values + clip->track_first_values[i];
+        XMVECTOR a = values[keys[i]];
+        XMVECTOR b = factors[i] > 0.0f ? values[keys[i] + 1] : a;
+
+        XMVECTOR rotation;
+
+        if (fast_rotations) {
+            // Take the short way round, as slerp does.
+            XMVECTOR flip = XMVectorLess(XMVector4Dot(a, b), XMVectorZero());
+            b = XMVectorSelect(b, XMVectorNegate(b), flip);
+            rotation = XMQuaternionNormalize(XMVectorLerp(a, b, factors[i]));
+        }
+        else {
+            rotation = XMQuaternionSlerp(a, b, factors[i]);
+        }
+
+        graph->rotations[clip->track_nodes[i]] = rotation;
+    }
+
+    for (u32 i = clip->kind_starts[ANIMATION_TRACK_CUBIC]; i < clip->kind_starts[ANIMATION_TRACK_CUBIC + 1]; ++i) {
+        *animation_target(graph, clip->track_paths[i], clip->track_nodes[i]) = sample_cubic_track(clip, i, keys[i], factors[i], spans[i]);
+    }
+
+    for (u32 i = clip->kind_starts[ANIMATION_TRACK_CUBIC_ROTATION]; i < clip->kind_starts[ANIMATION_TRACK_CUBIC_ROTATION + 1]; ++i) {
+        graph->rotations[clip->track_nodes[i]] = XMQuaternionNormalize(sample_cubic_track(clip, i, keys[i], factors[i], spans[i]));
+    }
+
+    for (u32 i = 0; i < clip->num_tracks; ++i) {
+        scene_graph_mark_dirty(graph, clip->track_nodes[i]);
+    }
+
+    release_scratch(scratch);
+}
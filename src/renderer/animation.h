@@ -0,0 +1,64 @@
+#pragma once
+
+#include "renderer.h"
+
+struct SceneGraph;
+
+enum AnimationPath {
+    ANIMATION_PATH_TRANSLATION,
+    ANIMATION_PATH_ROTATION,
+    ANIMATION_PATH_SCALE,
+};
+
+enum AnimationInterpolation {
+    ANIMATION_INTERPOLATION_STEP,
+    ANIMATION_INTERPOLATION_LINEAR,
+    ANIMATION_INTERPOLATION_CUBIC_SPLINE,
+};
+
+// One animated property of one node. Cubic spline tracks have three values per key (in-tangent, value,
+// out-tangent) as in glTF; the others have one. Rotations are xyzw quaternions.
+struct AnimationTrackDesc {
+    u32 node;
+    AnimationPath path;
+    AnimationInterpolation interpolation;
+    u32 key_count;
+    f32* times;
+    XMVECTOR* values;
+};
+
+enum AnimationTrackKind {
+    ANIMATION_TRACK_STEP,
+    ANIMATION_TRACK_LINEAR,
+    ANIMATION_TRACK_LINEAR_ROTATION,
+    ANIMATION_TRACK_CUBIC,
+    ANIMATION_TRACK_CUBIC_ROTATION,
+    ANIMATION_TRACK_KIND_COUNT,
+};
+
+// Keyframe tracks packed into parallel arrays and sorted by kind, so the sampler runs one branch-free loop per
+// kind. Each track remembers the key it last sampled, so playing forward rarely has to search.
+struct AnimationClip {
+    f32 duration;
+    u32 num_tracks;
+    u32 kind_starts[ANIMATION_TRACK_KIND_COUNT + 1];
+    u32* track_nodes;
+    AnimationPath* track_paths;
+    u32* track_first_keys; // Into key_times
+    u32* track_first_values; // Into key_values
+    u32* track_key_counts;
+    u32* track_cursors;
+    f32* key_times;
+    XMVECTOR* key_values;
+};
+
+// Copies the tracks' keys into the clip.
+AnimationClip* animation_clip_new(Arena* arena, u32 num_tracks, AnimationTrackDesc* tracks);
+
+// What animation_clip_new pushes to its arena for the tracks.
+u64 animation_clip_size(u32 num_tracks, AnimationTrackDesc* tracks);
+
+// Samples every track at time, clamped to each track's key range, and writes the results straight into the scene
+// graph's local transforms. Linear rotations are slerped, or normalized-lerped when fast_rotations is set, which is
+// cheaper and close for the small angles between neighbouring keys.
+void animation_sample(AnimationClip* clip, f32 time, SceneGraph* graph, bool fast_rotations);
@@ -0,0 +1,366 @@
+#include <math.h>
+#include <string.h>
+
+#include "asset_registry.h"
+#include "texture_cache.h"
+#include "gltf_lazy.h"
+#include "utility/hash.h"
+#include "utility/pak.h"
+#include "utility/resource_pool.h"
+
+// A scene's loader and result header live in a page allocation of their own, freed with the scene. What the result
+// points to is sized from the document by the load, so this only has to fit what doesn't depend on it.
+#define SCENE_ARENA_SIZE (64 * 1024)
+
+struct SceneEntry {
+    u64 path_hash;
+    TextureContentKey content; // Of the document, see gltf_document_key
+    u32 ref_count;
+    Arena arena;
+    GLTFLoader* loader; // Null once loaded
+    LoadGLTFResult* result;
+    char path[PAK_MAX_PATH]; // Normalized
+};
+
+// The normalized path, which two spellings of the same file share, and its hash map key.
+struct ScenePath {
+    u64 hash;
+    char path[PAK_MAX_PATH];
+};
+
+struct AssetRegistry {
+    Renderer* renderer;
+    TextureCache* texture_cache;
+
+    ResourcePool* scenes;
+    HashMap* scenes_by_path;
+    HashMap* mesh_ref_counts; // Keyed by mesh handle
+
+    u32 num_loading_scenes;
+    u64* loading_scenes;
+
+    // References queued for the next collect.
+    u32 capacity;
+    u32 num_released_scenes;
+    u64* released_scenes;
+    u32 num_released_meshes;
+    Mesh* released_meshes;
+    u32 num_released_materials;
+    Material* released_materials;
+};
+
+AssetRegistry* asset_registry_new(Arena* arena, Renderer* renderer, u32 capacity) {
+    AssetRegistry* registry = arena_push_struct_zero(arena, AssetRegistry);
+
+    registry->renderer = renderer;
+    registry->texture_cache = texture_cache_new(arena, capacity);
+
+    registry->scenes = resource_pool_new(arena, capacity, sizeof(SceneEntry));
+    registry->scenes_by_path = hash_map_new(arena, capacity);
+    registry->mesh_ref_counts = hash_map_new(arena, capacity);
+
+    registry->loading_scenes = arena_push_array(arena, u64, capacity);
+
+    registry->capacity = capacity;
+    registry->released_scenes = arena_push_array(arena, u64, capacity);
+    registry->released_meshes = arena_push_array(arena, Mesh, capacity);
+    registry->released_materials = arena_push_array(arena, Material, capacity);
+
+    return registry;
+}
+
+internal SceneEntry* get_scene_entry(AssetRegistry* registry, SceneAsset scene) {
+    assert(resource_pool_handle_valid(registry->scenes, scene.handle) && "Scene is not owned by this registry");
+    return resource_pool_access(registry->scenes, scene.handle, SceneEntry);
+}
+
+internal void normalize_scene_path(char* path, ScenePath* scene_path) {
+    pak_normalize_path(path, scene_path->path);
+
+    // Hash map keys can't be 0.
+    scene_path->hash = hash_string(scene_path->path);
+    scene_path->hash = scene_path->hash ? scene_path->hash : 1;
+}
+
+// Returns true and takes a reference if the scene at path is loaded or loading from a document with the given
+// content. A scene loaded from the path before its document changed is taken out of the path map; its holders
+// keep it, and the caller loads the path again.
+internal bool acquire_existing_scene(AssetRegistry* registry, ScenePath* scene_path, TextureContentKey* content, SceneAsset* scene) {
+    if (!hash_map_get(registry->scenes_by_path, scene_path->hash, &scene->handle)) {
+        return false;
+    }
+
+    SceneEntry* entry = get_scene_entry(registry, *scene);
+
+    // A path whose hash another one took first isn't shared.
+    if (strcmp(entry->path, scene_path->path) != 0) {
+        return false;
+    }
+
+    if (memcmp(&entry->content, content, sizeof(TextureContentKey)) != 0) {
+        hash_map_remove(registry->scenes_by_path, scene_path->hash);
+        return false;
+    }
+
+    ++entry->ref_count;
+    return true;
+}
+
+internal SceneEntry* new_scene_entry(AssetRegistry* registry, ScenePath* scene_path, TextureContentKey* content, SceneAsset* scene) {
+    scene->handle = resource_pool_alloc(registry->scenes);
+
+    u64 existing;
+    if (!hash_map_get(registry->scenes_by_path, scene_path->hash, &existing)) {
+        hash_map_put(registry->scenes_by_path, scene_path->hash, scene->handle);
+    }
+
+    SceneEntry* entry = get_scene_entry(registry, *scene);
+    *entry = {};
+    entry->path_hash = scene_path->hash;
+    entry->content = *content;
+    entry->ref_count = 1;
+    entry->arena = arena_init(page_alloc(SCENE_ARENA_SIZE), SCENE_ARENA_SIZE);
+    strcpy(entry->path, scene_path->path);
+
+    return entry;
+}
+
+// Every mesh of a loaded scene starts with the scene's reference.
+internal void register_scene_meshes(AssetRegistry* registry, SceneEntry* entry) {
+    for (u32 i = 0; i < entry->result->num_meshes; ++i) {
+        u64 ref_count;
+        assert(!hash_map_get(registry->mesh_ref_counts, entry->result->meshes[i].handle, &ref_count));
+        UNUSED(ref_count);
+
+        hash_map_put(registry->mesh_ref_counts, entry->result->meshes[i].handle, 1);
+    }
+}
+
+SceneAsset asset_registry_acquire_scene(AssetRegistry* registry, GLTFLoadOptions* options, char* path) {
+    ScenePath scene_path;
+    normalize_scene_path(path, &scene_path);
+    TextureContentKey content = gltf_document_key(path);
+
+    SceneAsset scene;
+    if (acquire_existing_scene(registry, &scene_path, &content, &scene)) {
+        return scene;
+    }
+
+    SceneEntry* entry = new_scene_entry(registry, &scene_path, &content, &scene);
+    entry->loader = gltf_begin_load(&entry->arena, registry->renderer, registry->texture_cache, options, path);
+    entry->result = gltf_loader_result(entry->loader);
+
+    registry->loading_scenes[registry->num_loading_scenes++] = scene.handle;
+
+    return scene;
+}
+
+internal void finish_scene_load(AssetRegistry* registry, u32 loading_index) {
+    SceneAsset scene = { registry->loading_scenes[loading_index] };
+    SceneEntry* entry = get_scene_entry(registry, scene);
+
+    entry->loader = 0;
+    register_scene_meshes(registry, entry);
+
+    registry->loading_scenes[loading_index] = registry->loading_scenes[--registry->num_loading_scenes];
+}
+
+SceneAsset asset_registry_load_scene(AssetRegistry* registry, RendererUploadContext* upload_context, GLTFLoadOptions* options, char* path) {
+    ScenePath scene_path;
+    normalize_scene_path(path, &scene_path);
+    TextureContentKey content = gltf_document_key(path);
+
+    SceneAsset scene;
+    if (acquire_existing_scene(registry, &scene_path, &content, &scene)) {
+        SceneEntry* entry = get_scene_entry(registry, scene);
+
+        if (entry->loader) {
+            while (!gltf_update_load(entry->loader, INFINITY)) {}
+
+            for (u32 i = 0; i < registry->num_loading_scenes; ++i) {
+                if (registry->loading_scenes[i] == scene.handle) {
+                    finish_scene_load(registry, i);
+                    break;
+                }
+            }
+        }
+
+        return scene;
+    }
+
+    SceneEntry* entry = new_scene_entry(registry, &scene_path, &content, &scene);
+    entry->result = arena_push_struct(&entry->arena, LoadGLTFResult);
+    *entry->result = load_gltf(0, registry->renderer, upload_context, registry->texture_cache, options, path, 0);
+
+    register_scene_meshes(registry, entry);
+
+    return scene;
+}
+
+LoadGLTFResult* asset_registry_scene(AssetRegistry* registry, SceneAsset scene) {
+    return get_scene_entry(registry, scene)->result;
+}
+
+bool asset_registry_scene_loaded(AssetRegistry* registry, SceneAsset scene) {
+    return get_scene_entry(registry, scene)->loader == 0;
+}
+
+void asset_registry_add_scene_ref(AssetRegistry* registry, SceneAsset scene) {
+    ++get_scene_entry(registry, scene)->ref_count;
+}
+
+void asset_registry_release_scene(AssetRegistry* registry, SceneAsset scene) {
+    assert(get_scene_entry(registry, scene)->ref_count > 0);
+    assert(registry->num_released_scenes < registry->capacity && "Too many scene releases queued. Collect more often.");
+    registry->released_scenes[registry->num_released_scenes++] = scene.handle;
+}
+
+void asset_registry_add_mesh_ref(AssetRegistry* registry, Mesh mesh) {
+    u64 ref_count;
+    bool found = hash_map_get(registry->mesh_ref_counts, mesh.handle, &ref_count);
+    assert(found && "Mesh is not owned by this registry");
+    UNUSED(found);
+
+    hash_map_put(registry->mesh_ref_counts, mesh.handle, ref_count + 1);
+}
+
+void asset_registry_release_mesh(AssetRegistry* registry, Mesh mesh) {
+    assert(registry->num_released_meshes < registry->capacity && "Too many mesh releases queued. Collect more often.");
+    registry->released_meshes[registry->num_released_meshes++] = mesh;
+}
+
+void asset_registry_add_material_ref(AssetRegistry* registry, Material material) {
+    texture_cache_add_ref(registry->texture_cache, material);
+}
+
+void asset_registry_release_material(AssetRegistry* registry, Material material) {
+    assert(registry->num_released_materials < registry->capacity && "Too many material releases queued. Collect more often.");
+    registry->released_materials[registry->num_released_materials++] = material;
+}
+
+TextureCache* asset_registry_texture_cache(AssetRegistry* registry) {
+    return registry->texture_cache;
+}
+
+void asset_registry_update(AssetRegistry* registry, f32 time_slice) {
+    f32 start = engine_time();
+
+    // Loads are updated in turn until the slice runs out. Ones it doesn't reach wait for the next update.
+    for (u32 i = 0; i < registry->num_loading_scenes;) {
+        SceneEntry* entry = get_scene_entry(registry, { registry->loading_scenes[i] });
+
+        f32 remaining = time_slice - (engine_time() - start);
+        if (remaining <= 0.0f) {
+            break;
+        }
+
+        if (gltf_update_load(entry->loader, remaining)) {
+            finish_scene_load(registry, i);
+        }
+        else {
+            ++i;
+        }
+    }
+}
+
+u32 asset_registry_collect(AssetRegistry* registry) {
+    Scratch scratch = get_scratch(0, 0);
+
+    // Scenes go first, since freeing one drops its references to its meshes and materials. A scene about to lose
+    // its last reference while it's still loading keeps that reference queued until the load finishes.
+
+    u64* freed_scenes = arena_push_array(scratch.arena, u64, registry->num_released_scenes);
+    u32 num_freed_scenes = 0;
+    u32 num_kept_releases = 0;
+
+    u32 num_mesh_drops = registry->num_released_meshes;
+    u32 num_material_drops = registry->num_released_materials;
+
+    for (u32 i = 0; i < registry->num_released_scenes; ++i) {
+        SceneAsset scene = { registry->released_scenes[i] };
+        SceneEntry* entry = get_scene_entry(registry, scene);
+
+        if (entry->ref_count == 1 && entry->loader) {
+            registry->released_scenes[num_kept_releases++] = scene.handle;
+            continue;
+        }
+
+        if (--entry->ref_count == 0) {
+            // The path may have been loaded again since, or have been taken by another path's hash.
+            u64 mapped;
+            if (hash_map_get(registry->scenes_by_path, entry->path_hash, &mapped) && mapped == scene.handle) {
+                hash_map_remove(registry->scenes_by_path, entry->path_hash);
+            }
+
+            num_mesh_drops += entry->result->num_meshes;
+            num_material_drops += entry->result->num_materials;
+            freed_scenes[num_freed_scenes++] = scene.handle;
+        }
+    }
+
+    registry->num_released_scenes = num_kept_releases;
+
+    Mesh* mesh_drops = arena_push_array(scratch.arena, Mesh, num_mesh_drops);
+    Material* material_drops = arena_push_array(scratch.arena, Material, num_material_drops);
+
+    memcpy(mesh_drops, registry->released_meshes, registry->num_released_meshes * sizeof(Mesh));
+    memcpy(material_drops, registry->released_materials, registry->num_released_materials * sizeof(Material));
+
+    u32 mesh_cursor = registry->num_released_meshes;
+    u32 material_cursor = registry->num_released_materials;
+
+    registry->num_released_meshes = 0;
+    registry->num_released_materials = 0;
+
+    for (u32 i = 0; i < num_freed_scenes; ++i) {
+        SceneAsset scene = { freed_scenes[i] };
+        SceneEntry* entry = get_scene_entry(registry, scene);
+        LoadGLTFResult* result = entry->result;
+
+        memcpy(mesh_drops + mesh_cursor, result->meshes, result->num_meshes * sizeof(Mesh));
+        memcpy(material_drops + material_cursor, result->materials, result->num_materials * sizeof(Material));
+        mesh_cursor += result->num_meshes;
+        material_cursor += result->num_materials;
+
+        gltf_release_streamed_textures(result);
+        gltf_free_result(result);
+        page_free(entry->arena.base);
+        resource_pool_free(registry->scenes, scene.handle);
+    }
+
+    // Meshes dropped to zero references are freed together.
+
+    Mesh* unreferenced_meshes = arena_push_array(scratch.arena, Mesh, num_mesh_drops);
+    u32 num_unreferenced_meshes = 0;
+
+    for (u32 i = 0; i < num_mesh_drops; ++i) {
+        u64 ref_count;
+        bool found = hash_map_get(registry->mesh_ref_counts, mesh_drops[i].handle, &ref_count);
+        assert(found && "Mesh is not owned by this registry");
+        UNUSED(found);
+
+        if (ref_count > 1) {
+            hash_map_put(registry->mesh_ref_counts, mesh_drops[i].handle, ref_count - 1);
+        }
+        else {
+            hash_map_remove(registry->mesh_ref_counts, mesh_drops[i].handle);
+            unreferenced_meshes[num_unreferenced_meshes++] = mesh_drops[i];
+        }
+    }
+
+    renderer_free_meshes(registry->renderer, num_unreferenced_meshes, unreferenced_meshes);
+
+    u32 num_freed_materials = texture_cache_release_batch(registry->texture_cache, registry->renderer, num_material_drops, material_drops);
+
+    release_scratch(scratch);
+
+    return num_freed_scenes + num_unreferenced_meshes + num_freed_materials;
+}
+
+u32 asset_registry_num_scenes(AssetRegistry* registry) {
+    return resource_pool_num_allocations(registry->scenes);
+}
+
+u32 asset_registry_num_meshes(AssetRegistry* registry) {
+    return registry->mesh_ref_counts->count;
+}
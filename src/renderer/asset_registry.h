@@ -0,0 +1,58 @@
+#pragma once
+
+#include "gltf.h"
+
+// Owns what glTF scenes load and shares it between loads. Scenes are keyed by normalized path (see
+// pak_normalize_path), so acquiring one that's loaded or loading is a hash lookup plus a read of the document's JSON
+// to check it hasn't changed; the options it was first acquired with win. A scene whose document changed is loaded
+// again, and the old one stays with whoever holds it. Materials go through the registry's
+// texture cache, keyed by image uri and content hash, so they're shared across scenes too.
+//
+// Scenes, meshes and materials are refcounted. Releasing only queues the reference to be dropped: the next
+// asset_registry_collect drops every queued reference and frees whatever is left unreferenced together, so the
+// renderer waits for the GPU once per collect rather than once per asset. An asset acquired again before the
+// collect survives it.
+
+struct AssetRegistry;
+
+struct SceneAsset {
+    u64 handle;
+};
+
+AssetRegistry* asset_registry_new(Arena* arena, Renderer* renderer, u32 capacity);
+
+// Starts a background load unless the scene is loaded or loading already. Its result grows while it loads, as
+// gltf_loader_result describes, and stays at the same address.
+SceneAsset asset_registry_acquire_scene(AssetRegistry* registry, GLTFLoadOptions* options, char* path);
+
+// Loads the scene on the calling thread, recording its uploads into upload_context, unless it's loaded already. A
+// background load already in flight for it is finished first.
+SceneAsset asset_registry_load_scene(AssetRegistry* registry, RendererUploadContext* upload_context, GLTFLoadOptions* options, char* path);
+
+LoadGLTFResult* asset_registry_scene(AssetRegistry* registry, SceneAsset scene);
+bool asset_registry_scene_loaded(AssetRegistry* registry, SceneAsset scene);
+
+void asset_registry_add_scene_ref(AssetRegistry* registry, SceneAsset scene);
+void asset_registry_release_scene(AssetRegistry* registry, SceneAsset scene);
+
+// Each mesh of a loaded scene holds a reference from the scene. More references keep the mesh alive after its
+// scene is freed, though its GLTFMeshInfo belongs to the scene and goes with it.
+void asset_registry_add_mesh_ref(AssetRegistry* registry, Mesh mesh);
+void asset_registry_release_mesh(AssetRegistry* registry, Mesh mesh);
+
+void asset_registry_add_material_ref(AssetRegistry* registry, Material material);
+void asset_registry_release_material(AssetRegistry* registry, Material material);
+
+// Where materials created for the registry's scenes after loading, such as lazy materials, have to go.
+TextureCache* asset_registry_texture_cache(AssetRegistry* registry);
+
+// Call once per frame from the thread that owns the renderer. Advances background loads for up to time_slice
+// seconds in total.
+void asset_registry_update(AssetRegistry* registry, f32 time_slice);
+
+// Drops every queued reference and frees whatever is left unreferenced. A scene that's still loading is freed by
+// the first collect after its load finishes. Returns how many assets were freed.
+u32 asset_registry_collect(AssetRegistry* registry);
+
+u32 asset_registry_num_scenes(AssetRegistry* registry);
+u32 asset_registry_num_meshes(AssetRegistry* registry);
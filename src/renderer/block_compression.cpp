@@ -0,0 +1,796 @@
+#include <math.h>
+#include <string.h>
+
+#include "block_compression.h"
+#include "utility/work_queue.h"
+
+#define BC_BLOCKS_PER_CHUNK 64
+
+internal u32 bc_block_size(TextureFormat format) {
+    switch (format) {
+        case TEXTURE_FORMAT_BC1:
+            return 8;
+        case TEXTURE_FORMAT_BC3:
+        case TEXTURE_FORMAT_BC5:
+        case TEXTURE_FORMAT_BC7:
+            return 16;
+        default:
+            assert(false && "Not a block format");
+            return 0;
+    }
+}
+
+u64 texture_chain_size(TextureFormat format, u32 width, u32 height, u32 num_levels) {
+    u64 size = 0;
+
+    for (u32 i = 0; i < num_levels; ++i) {
+        if (format == TEXTURE_FORMAT_RGBA8) {
+            size += (u64)width * height * sizeof(u32);
+        }
+        else {
+            size += (u64)((width + 3) / 4) * ((height + 3) / 4) * bc_block_size(format);
+        }
+
+        width = width > 1 ? width / 2 : 1;
+        height = height > 1 ? height / 2 : 1;
+    }
+
+    return size;
+}
+
+// A 4x4 block of RGBA8 texels, row by row.
+struct BCTexels {
+    u8 c[16][4];
+};
+
+internal void load_bc_texels(u32* texels, u32 width, u32 height, u32 block_x, u32 block_y, BCTexels* block) {
+    for (u32 y = 0; y < 4; ++y) {
+        u32 src_y = block_y * 4 + y < height ? block_y * 4 + y : height - 1;
+
+        for (u32 x = 0; x < 4; ++x) {
+            u32 src_x = block_x * 4 + x < width ? block_x * 4 + x : width - 1;
+            memcpy(block->c[y * 4 + x], &texels[(u64)src_y * width + src_x], 4);
+        }
+    }
+}
+
+internal f32 clamp_unorm8(f32 x) {
+    return x < 0.0f ? 0.0f : x > 255.0f ? 255.0f : x;
+}
+
+// Endpoints spanning the block along its principal axis, found by power iteration on the covariance of the first
+// channels. e0 is the end the axis points to.
+internal void fit_bc_endpoints(BCTexels* block, int channels, f32* e0, f32* e1) {
+    f32 mean[4] = {};
+    f32 lo[4] = { 255.0f, 255.0f, 255.0f, 255.0f };
+    f32 hi[4] = {};
+
+    for (int i = 0; i < 16; ++i) {
+        for (int c = 0; c < channels; ++c) {
+            f32 v = block->c[i][c];
+            mean[c] += v;
+            lo[c] = fminf(lo[c], v);
+            hi[c] = fmaxf(hi[c], v);
+        }
+    }
+
+    for (int c = 0; c < channels; ++c) {
+        mean[c] /= 16.0f;
+    }
+
+    f32 cov[4][4] = {};
+    for (int i = 0; i < 16; ++i) {
+        f32 d[4];
+        for (int c = 0; c < channels; ++c) {
+            d[c] = block->c[i][c] - mean[c];
+        }
+        for (int a = 0; a < channels; ++a) {
+            for (int b = 0; b < channels; ++b) {
+                cov[a][b] += d[a] * d[b];
+            }
+        }
+    }
+
+    f32 axis[4];
+    for (int c = 0; c < channels; ++c) {
+        axis[c] = hi[c] - lo[c];
+    }
+
+    for (int iteration = 0; iteration < 8; ++iteration) {
+        f32 next[4] = {};
+        f32 length = 0.0f;
+
+        for (int a = 0; a < channels; ++a) {
+            for (int b = 0; b < channels; ++b) {
+                next[a] += cov[a][b] * axis[b];
+            }
+            length = fmaxf(length, fabsf(next[a]));
+        }
+
+        // A flat block has no axis; both endpoints become the mean.
+        if (length < 1e-6f) {
+            for (int c = 0; c < channels; ++c) {
+                e0[c] = e1[c] = mean[c];
+            }
+            return;
+        }
+
+        for (int c = 0; c < channels; ++c) {
+            axis[c] = next[c] / length;
+        }
+    }
+
+    f32 length_sq = 0.0f;
+    for (int c = 0; c < channels; ++c) {
+        length_sq += axis[c] * axis[c];
+    }
+
+    f32 t_min = FLT_MAX;
+    f32 t_max = -FLT_MAX;
+
+    for (int i = 0; i < 16; ++i) {
+        f32 t = 0.0f;
+        for (int c = 0; c < channels; ++c) {
+            t += (block->c[i][c] - mean[c]) * axis[c];
+        }
+        t_min = fminf(t_min, t);
+        t_max = fmaxf(t_max, t);
+    }
+
+    for (int c = 0; c < channels; ++c) {
+        e0[c] = clamp_unorm8(mean[c] + axis[c] * t_max / length_sq);
+        e1[c] = clamp_unorm8(mean[c] + axis[c] * t_min / length_sq);
+    }
+}
+
+// Least-squares endpoints for the block, given how far each texel is interpolated from e0 toward e1. Returns false
+// when the weights can't determine both endpoints, e.g. when every texel uses the same one.
+internal bool refine_bc_endpoints(BCTexels* block, int channels, f32* weights, f32* e0, f32* e1) {
+    f32 aa = 0.0f;
+    f32 ab = 0.0f;
+    f32 bb = 0.0f;
+    f32 ax[4] = {};
+    f32 bx[4] = {};
+
+    for (int i = 0; i < 16; ++i) {
+        f32 b = weights[i];
+        f32 a = 1.0f - b;
+
+        aa += a * a;
+        ab += a * b;
+        bb += b * b;
+
+        for (int c = 0; c < channels; ++c) {
+            ax[c] += a * block->c[i][c];
+            bx[c] += b * block->c[i][c];
+        }
+    }
+
+    f32 det = aa * bb - ab * ab;
+    if (fabsf(det) < 1e-4f) {
+        return false;
+    }
+
+    for (int c = 0; c < channels; ++c) {
+        e0[c] = clamp_unorm8((ax[c] * bb - bx[c] * ab) / det);
+        e1[c] = clamp_unorm8((bx[c] * aa - ax[c] * ab) / det);
+    }
+
+    return true;
+}
+
+internal int bc_quality_iterations(BCQuality quality) {
+    return quality == BC_QUALITY_FAST ? 0 : quality == BC_QUALITY_NORMAL ? 1 : 3;
+}
+
+// BC1 color blocks
+
+internal u16 pack_565(f32* rgb) {
+    u32 r = (u32)(clamp_unorm8(rgb[0]) * 31.0f / 255.0f + 0.5f);
+    u32 g = (u32)(clamp_unorm8(rgb[1]) * 63.0f / 255.0f + 0.5f);
+    u32 b = (u32)(clamp_unorm8(rgb[2]) * 31.0f / 255.0f + 0.5f);
+    return (u16)((r << 11) | (g << 5) | b);
+}
+
+internal void unpack_565(u16 color, i32* rgb) {
+    i32 r = color >> 11;
+    i32 g = (color >> 5) & 63;
+    i32 b = color & 31;
+
+    rgb[0] = (r << 3) | (r >> 2);
+    rgb[1] = (g << 2) | (g >> 4);
+    rgb[2] = (b << 3) | (b >> 2);
+}
+
+// Four-color blocks interpolate thirds; three-color blocks (BC1 with c0 <= c1) a half and black.
+internal void bc1_palette(u16 c0, u16 c1, bool four_color, i32 palette[4][3]) {
+    unpack_565(c0, palette[0]);
+    unpack_565(c1, palette[1]);
+
+    for (int c = 0; c < 3; ++c) {
+        if (four_color) {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c] + 1) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c] + 1) / 3;
+        }
+        else {
+            palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+            palette[3][c] = 0;
+        }
+    }
+}
+
+internal u32 rgb_distance(u8* texel, i32* color) {
+    i32 dr = texel[0] - color[0];
+    i32 dg = texel[1] - color[1];
+    i32 db = texel[2] - color[2];
+    return (u32)(dr * dr + dg * dg + db * db);
+}
+
+// Always a four-color block, which BC3 requires; equal endpoints fall back to index 0 everywhere.
+internal u64 quantize_bc1_color(BCTexels* block, f32* e0, f32* e1, u32* error) {
+    u16 c0 = pack_565(e0);
+    u16 c1 = pack_565(e1);
+
+    if (c0 < c1) {
+        u16 swap = c0;
+        c0 = c1;
+        c1 = swap;
+    }
+
+    i32 palette[4][3];
+    bc1_palette(c0, c1, true, palette);
+
+    u32 indices = 0;
+    *error = 0;
+
+    for (int i = 0; i < 16; ++i) {
+        u32 best = 0;
+        u32 best_distance = rgb_distance(block->c[i], palette[0]);
+
+        for (u32 k = 1; k < 4 && c0 != c1; ++k) {
+            u32 distance = rgb_distance(block->c[i], palette[k]);
+            if (distance < best_distance) {
+                best = k;
+                best_distance = distance;
+            }
+        }
+
+        indices |= best << (2 * i);
+        *error += best_distance;
+    }
+
+    return (u64)c0 | ((u64)c1 << 16) | ((u64)indices << 32);
+}
+
+internal u64 encode_bc1_color(BCTexels* block, BCQuality quality) {
+    f32 e0[4];
+    f32 e1[4];
+    fit_bc_endpoints(block, 3, e0, e1);
+
+    u32 best_error;
+    u64 best = quantize_bc1_color(block, e0, e1, &best_error);
+
+    // Palette entries 2 and 3 sit a third and two thirds of the way to c1.
+    f32 index_weights[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+
+    for (int iteration = 0; iteration < bc_quality_iterations(quality) && best_error > 0; ++iteration) {
+        f32 weights[16];
+        for (int i = 0; i < 16; ++i) {
+            weights[i] = index_weights[(best >> (32 + 2 * i)) & 3];
+        }
+
+        if (!refine_bc_endpoints(block, 3, weights, e0, e1)) {
+            break;
+        }
+
+        u32 error;
+        u64 encoded = quantize_bc1_color(block, e0, e1, &error);
+        if (error >= best_error) {
+            break;
+        }
+
+        best = encoded;
+        best_error = error;
+    }
+
+    return best;
+}
+
+// BC4 single-channel blocks, which BC3 uses for alpha and BC5 for each of its channels
+
+// a0 > a1 interpolates six values between them; otherwise four, plus 0 and 255.
+internal void bc4_palette(u8 a0, u8 a1, i32 palette[8]) {
+    palette[0] = a0;
+    palette[1] = a1;
+
+    if (a0 > a1) {
+        for (int i = 2; i < 8; ++i) {
+            palette[i] = ((8 - i) * a0 + (i - 1) * a1 + 3) / 7;
+        }
+    }
+    else {
+        for (int i = 2; i < 6; ++i) {
+            palette[i] = ((6 - i) * a0 + (i - 1) * a1 + 2) / 5;
+        }
+        palette[6] = 0;
+        palette[7] = 255;
+    }
+}
+
+internal u64 quantize_bc4(u8* values, u8 a0, u8 a1, u32* error) {
+    i32 palette[8];
+    bc4_palette(a0, a1, palette);
+
+    u64 indices = 0;
+    *error = 0;
+
+    for (int i = 0; i < 16; ++i) {
+        u32 best = 0;
+        u32 best_distance = UINT32_MAX;
+
+        for (u32 k = 0; k < 8; ++k) {
+            i32 d = values[i] - palette[k];
+            if ((u32)(d * d) < best_distance) {
+                best = k;
+                best_distance = (u32)(d * d);
+            }
+        }
+
+        indices |= (u64)best << (3 * i);
+        *error += best_distance;
+    }
+
+    return (u64)a0 | ((u64)a1 << 8) | (indices << 16);
+}
+
+internal u64 encode_bc4(u8* values, BCQuality quality) {
+    u8 lo = 255;
+    u8 hi = 0;
+    u8 inner_lo = 255;
+    u8 inner_hi = 0;
+
+    for (int i = 0; i < 16; ++i) {
+        lo = values[i] < lo ? values[i] : lo;
+        hi = values[i] > hi ? values[i] : hi;
+
+        if (values[i] != 0 && values[i] != 255) {
+            inner_lo = values[i] < inner_lo ? values[i] : inner_lo;
+            inner_hi = values[i] > inner_hi ? values[i] : inner_hi;
+        }
+    }
+
+    u32 best_error;
+    u64 best = quantize_bc4(values, hi, lo, &best_error);
+
+    if (best_error == 0 || quality == BC_QUALITY_FAST) {
+        return best;
+    }
+
+    // Blocks reaching 0 or 255 can spend the six-value mode's interpolants on everything in between.
+    if (inner_lo <= inner_hi && (lo == 0 || hi == 255)) {
+        u32 error;
+        u64 encoded = quantize_bc4(values, inner_lo, inner_hi, &error);
+        if (error < best_error) {
+            best = encoded;
+            best_error = error;
+        }
+    }
+
+    // Pulling the endpoints in often fits the interpolants better.
+    if (quality == BC_QUALITY_HIGH) {
+        for (int d0 = 0; d0 < 4; ++d0) {
+            for (int d1 = 0; d1 < 4; ++d1) {
+                i32 a0 = hi - d0;
+                i32 a1 = lo + d1;
+                if (a0 <= a1) {
+                    continue;
+                }
+
+                u32 error;
+                u64 encoded = quantize_bc4(values, (u8)a0, (u8)a1, &error);
+                if (error < best_error) {
+                    best = encoded;
+                    best_error = error;
+                }
+            }
+        }
+    }
+
+    return best;
+}
+
+internal u64 encode_bc4_channel(BCTexels* block, int channel, BCQuality quality) {
+    u8 values[16];
+    for (int i = 0; i < 16; ++i) {
+        values[i] = block->c[i][channel];
+    }
+    return encode_bc4(values, quality);
+}
+
+// BC7 mode 6: one subset, RGBA endpoints of 7 bits plus a p-bit each, and 4-bit indices.
+
+global_var i32 bc7_index_weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+internal void put_bits(u8* block, u32* offset, u32 value, u32 count) {
+    for (u32 i = 0; i < count; ++i) {
+        if ((value >> i) & 1) {
+            block[(*offset + i) / 8] |= (u8)(1 << ((*offset + i) % 8));
+        }
+    }
+    *offset += count;
+}
+
+internal u32 get_bits(u8* block, u32* offset, u32 count) {
+    u32 value = 0;
+    for (u32 i = 0; i < count; ++i) {
+        value |= (u32)((block[(*offset + i) / 8] >> ((*offset + i) % 8)) & 1) << i;
+    }
+    *offset += count;
+    return value;
+}
+
+struct BC7Mode6 {
+    u8 endpoints[2][4]; // 7 bits per channel
+    u8 pbits[2];
+    u8 indices[16];
+    u32 error;
+};
+
+internal void bc7_mode6_palette(u8 endpoints[2][4], u8* pbits, i32 palette[16][4]) {
+    for (int c = 0; c < 4; ++c) {
+        i32 a = (endpoints[0][c] << 1) | pbits[0];
+        i32 b = (endpoints[1][c] << 1) | pbits[1];
+
+        for (int i = 0; i < 16; ++i) {
+            palette[i][c] = ((64 - bc7_index_weights[i]) * a + bc7_index_weights[i] * b + 32) >> 6;
+        }
+    }
+}
+
+internal void quantize_bc7_mode6(BCTexels* block, f32* e0, f32* e1, u32 pbit0, u32 pbit1, BC7Mode6* mode) {
+    f32* endpoints[2] = { e0, e1 };
+    mode->pbits[0] = (u8)pbit0;
+    mode->pbits[1] = (u8)pbit1;
+
+    for (int e = 0; e < 2; ++e) {
+        for (int c = 0; c < 4; ++c) {
+            i32 q = (i32)((endpoints[e][c] - mode->pbits[e]) * 0.5f + 0.5f);
+            mode->endpoints[e][c] = (u8)(q < 0 ? 0 : q > 127 ? 127 : q);
+        }
+    }
+
+    i32 palette[16][4];
+    bc7_mode6_palette(mode->endpoints, mode->pbits, palette);
+
+    // The palette lies on a line, so projecting onto it finds the nearest entry to within rounding; only the
+    // neighbours of the projected index are measured.
+    i32 axis[4];
+    i32 axis_length_sq = 0;
+    for (int c = 0; c < 4; ++c) {
+        axis[c] = palette[15][c] - palette[0][c];
+        axis_length_sq += axis[c] * axis[c];
+    }
+
+    mode->error = 0;
+
+    for (int i = 0; i < 16; ++i) {
+        i32 projected = 0;
+        if (axis_length_sq > 0) {
+            i32 dot = 0;
+            for (int c = 0; c < 4; ++c) {
+                dot += (block->c[i][c] - palette[0][c]) * axis[c];
+            }
+            projected = (i32)((f32)dot * 15.0f / (f32)axis_length_sq + 0.5f);
+            projected = projected < 0 ? 0 : projected > 15 ? 15 : projected;
+        }
+
+        u32 first = projected > 0 ? projected - 1 : 0;
+        u32 last = projected < 15 ? projected + 1 : 15;
+
+        u32 best = 0;
+        u32 best_distance = UINT32_MAX;
+
+        for (u32 k = first; k <= last; ++k) {
+            u32 distance = 0;
+            for (int c = 0; c < 4; ++c) {
+                i32 d = block->c[i][c] - palette[k][c];
+                distance += (u32)(d * d);
+            }
+
+            if (distance < best_distance) {
+                best = k;
+                best_distance = distance;
+            }
+        }
+
+        mode->indices[i] = (u8)best;
+        mode->error += best_distance;
+    }
+}
+
+// The p-bit that keeps an endpoint closest to its unquantized value.
+internal u32 nearest_bc7_pbit(f32* endpoint) {
+    f32 error[2] = {};
+
+    for (u32 p = 0; p < 2; ++p) {
+        for (int c = 0; c < 4; ++c) {
+            i32 q = (i32)((endpoint[c] - p) * 0.5f + 0.5f);
+            q = q < 0 ? 0 : q > 127 ? 127 : q;
+            f32 d = (f32)((q << 1) | p) - endpoint[c];
+            error[p] += d * d;
+        }
+    }
+
+    return error[1] < error[0] ? 1 : 0;
+}
+
+internal void encode_bc7_mode6(BCTexels* block, BCQuality quality, u8* out) {
+    f32 e0[4];
+    f32 e1[4];
+    fit_bc_endpoints(block, 4, e0, e1);
+
+    BC7Mode6 best = {};
+    best.error = UINT32_MAX;
+
+    for (int iteration = 0; iteration <= bc_quality_iterations(quality); ++iteration) {
+        if (iteration > 0) {
+            f32 weights[16];
+            for (int i = 0; i < 16; ++i) {
+                weights[i] = bc7_index_weights[best.indices[i]] / 64.0f;
+            }
+
+            if (best.error == 0 || !refine_bc_endpoints(block, 4, weights, e0, e1)) {
+                break;
+            }
+        }
+
+        // High quality searches every p-bit pair; the others take each endpoint's nearest.
+        u32 num_pairs = quality == BC_QUALITY_HIGH ? 4 : 1;
+
+        for (u32 pair = 0; pair < num_pairs; ++pair) {
+            BC7Mode6 mode;
+            if (num_pairs == 4) {
+                quantize_bc7_mode6(block, e0, e1, pair & 1, pair >> 1, &mode);
+            }
+            else {
+                quantize_bc7_mode6(block, e0, e1, nearest_bc7_pbit(e0), nearest_bc7_pbit(e1), &mode);
+            }
+
+            if (mode.error < best.error) {
+                best = mode;
+            }
+        }
+    }
+
+    // The first index is stored without its top bit, so it has to be below 8.
+    if (best.indices[0] & 8) {
+        for (int c = 0; c < 4; ++c) {
+            u8 swap = best.endpoints[0][c];
+            best.endpoints[0][c] = best.endpoints[1][c];
+            best.endpoints[1][c] = swap;
+        }
+
+        u8 swap = best.pbits[0];
+        best.pbits[0] = best.pbits[1];
+        best.pbits[1] = swap;
+
+        for (int i = 0; i < 16; ++i) {
+            best.indices[i] = (u8)(15 - best.indices[i]);
+        }
+    }
+
+    memset(out, 0, 16);
+    u32 offset = 0;
+
+    put_bits(out, &offset, 1 << 6, 7);
+
+    for (int c = 0; c < 4; ++c) {
+        put_bits(out, &offset, best.endpoints[0][c], 7);
+        put_bits(out, &offset, best.endpoints[1][c], 7);
+    }
+
+    put_bits(out, &offset, best.pbits[0], 1);
+    put_bits(out, &offset, best.pbits[1], 1);
+
+    for (int i = 0; i < 16; ++i) {
+        put_bits(out, &offset, best.indices[i], i == 0 ? 3 : 4);
+    }
+
+    assert(offset == 128);
+}
+
+struct BCCompressLevel {
+    TextureFormat format;
+    BCQuality quality;
+    u32 width;
+    u32 height;
+    u32 blocks_x;
+    u64 row_pitch; // Bytes between rows of blocks
+    u32* texels;
+    u8* blocks;
+};
+
+internal void compress_bc_blocks(void* data, u32 begin, u32 end) {
+    BCCompressLevel* level = (BCCompressLevel*)data;
+    u32 block_size = bc_block_size(level->format);
+
+    for (u32 i = begin; i < end; ++i) {
+        BCTexels block;
+        load_bc_texels(level->texels, level->width, level->height, i % level->blocks_x, i / level->blocks_x, &block);
+
+        u8* out = level->blocks + (i / level->blocks_x) * level->row_pitch + (u64)(i % level->blocks_x) * block_size;
+        u64 halves[2];
+
+        switch (level->format) {
+            case TEXTURE_FORMAT_BC1:
+                halves[0] = encode_bc1_color(&block, level->quality);
+                memcpy(out, halves, 8);
+                break;
+            case TEXTURE_FORMAT_BC3:
+                halves[0] = encode_bc4_channel(&block, 3, level->quality);
+                halves[1] = encode_bc1_color(&block, level->quality);
+                memcpy(out, halves, 16);
+                break;
+            case TEXTURE_FORMAT_BC5:
+                halves[0] = encode_bc4_channel(&block, 0, level->quality);
+                halves[1] = encode_bc4_channel(&block, 1, level->quality);
+                memcpy(out, halves, 16);
+                break;
+            case TEXTURE_FORMAT_BC7:
+                encode_bc7_mode6(&block, level->quality, out);
+                break;
+            default:
+                assert(false);
+        }
+    }
+}
+
+void bc_compress_chain(WorkQueue* queue, TextureFormat format, BCQuality quality, u32 width, u32 height, u32 num_levels, u32* texels, void* blocks, TextureUploadLayout* layout) {
+    u8* dst = (u8*)blocks;
+
+    for (u32 i = 0; i < num_levels; ++i) {
+        BCCompressLevel level;
+        level.format = format;
+        level.quality = quality;
+        level.width = width;
+        level.height = height;
+        level.blocks_x = (width + 3) / 4;
+        level.row_pitch = layout ? layout->row_pitches[i] : (u64)level.blocks_x * bc_block_size(format);
+        level.texels = texels;
+        level.blocks = layout ? (u8*)blocks + layout->level_offsets[i] : dst;
+
+        u32 num_blocks = level.blocks_x * ((height + 3) / 4);
+        work_queue_parallel_for(queue, compress_bc_blocks, &level, num_blocks, BC_BLOCKS_PER_CHUNK);
+
+        dst += texture_chain_size(format, width, height, 1);
+        texels += (u64)width * height;
+
+        width = width > 1 ? width / 2 : 1;
+        height = height > 1 ? height / 2 : 1;
+    }
+}
+
+// Decoding
+
+internal void decode_bc1_color(u8* src, bool force_four_color, BCTexels* block) {
+    u16 c0 = (u16)(src[0] | (src[1] << 8));
+    u16 c1 = (u16)(src[2] | (src[3] << 8));
+    u32 indices = (u32)src[4] | ((u32)src[5] << 8) | ((u32)src[6] << 16) | ((u32)src[7] << 24);
+
+    bool four_color = force_four_color || c0 > c1;
+
+    i32 palette[4][3];
+    bc1_palette(c0, c1, four_color, palette);
+
+    for (int i = 0; i < 16; ++i) {
+        u32 index = (indices >> (2 * i)) & 3;
+        for (int c = 0; c < 3; ++c) {
+            block->c[i][c] = (u8)palette[index][c];
+        }
+        block->c[i][3] = !four_color && index == 3 ? 0 : 255;
+    }
+}
+
+internal void decode_bc4(u8* src, int channel, BCTexels* block) {
+    i32 palette[8];
+    bc4_palette(src[0], src[1], palette);
+
+    u64 indices = 0;
+    memcpy(&indices, src + 2, 6);
+
+    for (int i = 0; i < 16; ++i) {
+        block->c[i][channel] = (u8)palette[(indices >> (3 * i)) & 7];
+    }
+}
+
+internal void decode_bc7_mode6(u8* src, BCTexels* block) {
+    u32 offset = 0;
+    u32 mode = get_bits(src, &offset, 7);
+    assert(mode == 1 << 6 && "Only BC7 mode 6 is decoded");
+    UNUSED(mode);
+
+    BC7Mode6 decoded;
+    for (int c = 0; c < 4; ++c) {
+        decoded.endpoints[0][c] = (u8)get_bits(src, &offset, 7);
+        decoded.endpoints[1][c] = (u8)get_bits(src, &offset, 7);
+    }
+
+    decoded.pbits[0] = (u8)get_bits(src, &offset, 1);
+    decoded.pbits[1] = (u8)get_bits(src, &offset, 1);
+
+    i32 palette[16][4];
+    bc7_mode6_palette(decoded.endpoints, decoded.pbits, palette);
+
+    for (int i = 0; i < 16; ++i) {
+        u32 index = get_bits(src, &offset, i == 0 ? 3 : 4);
+        for (int c = 0; c < 4; ++c) {
+            block->c[i][c] = (u8)palette[index][c];
+        }
+    }
+}
+
+void bc_decompress(TextureFormat format, u32 width, u32 height, void* blocks, u32* texels) {
+    u32 block_size = bc_block_size(format);
+    u32 blocks_x = (width + 3) / 4;
+    u32 blocks_y = (height + 3) / 4;
+
+    for (u32 by = 0; by < blocks_y; ++by) {
+        for (u32 bx = 0; bx < blocks_x; ++bx) {
+            u8* src = (u8*)blocks + ((u64)by * blocks_x + bx) * block_size;
+
+            BCTexels block = {};
+            switch (format) {
+                case TEXTURE_FORMAT_BC1:
+                    decode_bc1_color(src, false, &block);
+                    break;
+                case TEXTURE_FORMAT_BC3:
+                    decode_bc1_color(src + 8, true, &block);
+                    decode_bc4(src, 3, &block);
+                    break;
+                case TEXTURE_FORMAT_BC5:
+                    decode_bc4(src, 0, &block);
+                    decode_bc4(src + 8, 1, &block);
+                    for (int i = 0; i < 16; ++i) {
+                        block.c[i][3] = 255;
+                    }
+                    break;
+                case TEXTURE_FORMAT_BC7:
+                    decode_bc7_mode6(src, &block);
+                    break;
+                default:
+                    assert(false);
+            }
+
+            for (u32 y = 0; y < 4 && by * 4 + y < height; ++y) {
+                for (u32 x = 0; x < 4 && bx * 4 + x < width; ++x) {
+                    memcpy(&texels[(u64)(by * 4 + y) * width + bx * 4 + x], block.c[y * 4 + x], 4);
+                }
+            }
+        }
+    }
+}
+
+f32 bc_psnr(TextureFormat format, u32 width, u32 height, u32* texels, void* blocks) {
+    Scratch scratch = get_scratch(0, 0);
+
+    u32* decoded = arena_push_array(scratch.arena, u32, (u64)width * height);
+    bc_decompress(format, width, height, blocks, decoded);
+
+    int channels = format == TEXTURE_FORMAT_BC1 ? 3 : format == TEXTURE_FORMAT_BC5 ? 2 : 4;
+
+    f64 squared_error = 0.0;
+    for (u64 i = 0; i < (u64)width * height; ++i) {
+        u8* a = (u8*)&texels[i];
+        u8* b = (u8*)&decoded[i];
+
+        for (int c = 0; c < channels; ++c) {
+            f64 d = (f64)a[c] - (f64)b[c];
+            squared_error += d * d;
+        }
+    }
+
+    release_scratch(scratch);
+
+    f64 mse = squared_error / ((f64)width * height * channels);
+    return mse > 0.0 ? (f32)(10.0 * log10(255.0 * 255.0 / mse)) : INFINITY;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "renderer.h"
+
+struct WorkQueue;
+
+// CPU encoders for the BC formats. BC1 stores RGB, BC3 RGBA, BC5 RG (e.g. normal maps) and BC7 RGBA through
+// mode 6 alone, its single-subset mode, which is the fast one to search. Quality trades encode time for error.
+
+enum BCQuality {
+    BC_QUALITY_FAST,
+    BC_QUALITY_NORMAL,
+    BC_QUALITY_HIGH,
+};
+
+// Bytes in the first num_levels levels of a chain packed largest first. Levels of block formats round up to whole
+// 4x4 blocks.
+u64 texture_chain_size(TextureFormat format, u32 width, u32 height, u32 num_levels);
+
+// Compresses every level of an RGBA8 chain packed largest first into blocks packed the same way, or placed as layout
+// describes if it isn't null, e.g. straight into upload memory. Blocks past the right or bottom edge of a level
+// repeat its last column or row. Blocks are split across the work queue, which may be null.
+void bc_compress_chain(WorkQueue* queue, TextureFormat format, BCQuality quality, u32 width, u32 height, u32 num_levels, u32* texels, void* blocks, TextureUploadLayout* layout);
+
+// Decodes one level back to RGBA8. Channels a format doesn't store come back as 0, or 255 for alpha. BC7 blocks
+// must use mode 6.
+void bc_decompress(TextureFormat format, u32 width, u32 height, void* blocks, u32* texels);
+
+// Peak signal-to-noise ratio in dB of one compressed level against its source, over the channels the format stores.
+// Infinite when they match exactly.
+f32 bc_psnr(TextureFormat format, u32 width, u32 height, u32* texels, void* blocks);
@@ -1,55 +1,30 @@
+#include <math.h>
 #include <string.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
 #include <stddef.h>
 
 #include <stb_image.h>
 
-#include "gltf.h"
+#include "gltf_internal.h"
+#include "texture_cache.h"
+#include "mesh_optimizer.h"
+#include "meshlet.h"
+#include "vertex_quantization.h"
+#include "scene_graph.h"
+#include "animation.h"
+#include "skinning.h"
+#include "meshopt_decoder.h"
 #include "utility/json.h"
+#include "utility/hash.h"
+#include "utility/base64.h"
 
 #define IGNORE_MATERIALS 0
 
-struct GLTFBuffer {
-    u64 len;
-    void* memory;
-};
-
-struct GLTFBufferView {
-    GLTFBuffer* buffer;
-    u64 len;
-    u64 offset;
-};
-
-enum GLTFType {
-    GLTF_UNSIGNED_BYTE = 0x1401,
-    GLTF_SHORT = 0x1402,
-    GLTF_UNSIGNED_SHORT = 0x1403,
-    GLTF_INT = 0x1404,
-    GLTF_UNSIGNED_INT = 0x1405,
-    GLTF_FLOAT = 0x1406,
-};
-
-struct GLTFAccessor {
-    GLTFBufferView* view;
-    u64 offset;
-    GLTFType type;
-    u32 count;
-    int component_count;
-};
-
-struct GLTFImage {
-    u32 width;
-    u32 height;
-    void* memory;
-};
-
-struct GLTFTexture {
-    GLTFImage* image;
-};
-
 struct GLTFPrimitive {
-    Mesh mesh;
-    Material material;
+    u32 geometry;
+    u32 material;
 };
 
 struct GLTFMesh {
@@ -59,9 +34,11 @@ struct GLTFMesh {
 
 struct GLTFNode {
     u32 num_children;
-    GLTFNode** children;
-    XMMATRIX transform;
+    u32* children;
     GLTFMesh* mesh;
+    u32 skin;
+    u32 first_transform; // EXT_mesh_gpu_instancing transforms, a range of the scene's instance_transforms
+    u32 num_transforms;
 };
 
 struct GLBHeader {
@@ -81,77 +58,24 @@ struct GLBChunk {
     char memory[1];
 };
 
-struct DecodeBase64Result {
-    u64 size;
-    void* memory;
-};
+// Load reports are optional: these do nothing without one.
 
-internal DecodeBase64Result decode_base64(Arena* arena, char *in)
-{
-    // Taken from https://nachtimwald.com/2017/11/18/base64-encode-and-decode-in-c/
-
-	u64 in_len = strlen(in);
-
-    u64 out_len = in_len / 4 * 3;
-	for (u64 i=in_len; i-->0; ) {
-		if (in[i] == '=') {
-			out_len--;
-		} else {
-			break;
-		}
-	}
-    
-    int b64invs[] = {
-        62, -1, -1, -1, 63, 52, 53, 54, 55, 56, 57, 58,
-        59, 60, 61, -1, -1, -1, -1, -1, -1, -1, 0, 1, 2, 3, 4, 5,
-        6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20,
-        21, 22, 23, 24, 25, -1, -1, -1, -1, -1, -1, 26, 27, 28,
-        29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40, 41, 42,
-        43, 44, 45, 46, 47, 48, 49, 50, 51
-    };
-
-    char* out = (char*)arena_push(arena, out_len);
-
-	for (u64 i=0, j=0; i<in_len; i+=4, j+=3) {
-		int v = b64invs[in[i]-43];
-		v = (v << 6) | b64invs[in[i+1]-43];
-		v = in[i+2]=='=' ? v << 6 : (v << 6) | b64invs[in[i+2]-43];
-		v = in[i+3]=='=' ? v << 6 : (v << 6) | b64invs[in[i+3]-43];
-
-		out[j] = (v >> 16) & 0xFF;
-		if (in[i+2] != '=')
-			out[j+1] = (v >> 8) & 0xFF;
-		if (in[i+3] != '=')
-			out[j+2] = v & 0xFF;
-	}
-
-    DecodeBase64Result result;
-    result.size = out_len;
-    result.memory = out;
-    
-    return result;
+internal void add_gltf_stage_time(GLTFLoadReport* report, GLTFLoadStage stage, f32 start) {
+    if (report) {
+        report->stage_seconds[stage] += engine_time() - start;
+    }
 }
 
-internal void process_gltf_node(Arena* arena, LoadGLTFResult* result, GLTFNode* node, XMMATRIX parent_transform) {
-    XMMATRIX absolute_transform = node->transform * parent_transform;
-    
-    if (node->mesh) {
-        for (u32 i = 0; i < node->mesh->num_primitives; ++i)
-        {
-            GLTFPrimitive* prim = &node->mesh->primitives[i];
-
-            MeshInstance* instance = arena_push_struct(arena, MeshInstance);
-            ++result->num_instances;
+internal ReadFileResult read_gltf_file(Arena* arena, char* path, GLTFLoadReport* report) {
+    f32 start = engine_time();
+    ReadFileResult file = read_file(arena, path);
+    add_gltf_stage_time(report, GLTF_STAGE_FILE_IO, start);
 
-            instance->mesh = prim->mesh;
-            instance->material = prim->material;
-            instance->transform = absolute_transform;
-        }
+    if (report) {
+        report->bytes_read += file.size;
     }
 
-    for (u32 i = 0; i < node->num_children; ++i) {
-        process_gltf_node(arena, result, node->children[i], absolute_transform);
-    }
+    return file;
 }
 
 internal XMVECTOR extract_json_vector(Json* j) {
@@ -177,482 +101,3343 @@ internal XMVECTOR extract_json_vector(Json* j) {
     return result;
 }
 
-internal LoadGLTFResult process_gltf(Arena* arena, Renderer* renderer, RendererUploadContext* upload_context, char* dir, Json* root, GLTFBuffer* buffers, u32 num_buffers) {
-    UNUSED(num_buffers);
-    UNUSED(dir);
-
-    Scratch scratch = get_scratch(&arena, 1);
-
-    Json* asset_views = json_query(root, "bufferViews");
-    GLTFBufferView* views = arena_push_array(scratch.arena, GLTFBufferView, json_len(asset_views));
-    u32 num_views = 0;
+internal void* accessor_data(GLTFAccessor* accessor) {
+    return (u8*)accessor->view->buffer->memory + accessor->view->offset + accessor->offset;
+}
 
-    JSON_FOREACH(asset_views, asset_view) {
-        GLTFBufferView* view = &views[num_views++];
+internal u64 component_size(GLTFType type) {
+    switch (type) {
+        case GLTF_BYTE:
+        case GLTF_UNSIGNED_BYTE:
+            return 1;
+        case GLTF_SHORT:
+        case GLTF_UNSIGNED_SHORT:
+            return 2;
+        case GLTF_INT:
+        case GLTF_UNSIGNED_INT:
+        case GLTF_FLOAT:
+            return 4;
+        default:
+            assert(false && "Unknown accessor component type");
+            return 0;
+    }
+}
 
-        u32 buffer_index = (u32)json_query(asset_view, "buffer")->integer;
-        assert(buffer_index < num_buffers);
-        view->buffer = &buffers[buffer_index];
+internal u64 accessor_stride(GLTFAccessor* accessor) {
+    return accessor->view->stride ? accessor->view->stride : accessor->component_count * component_size(accessor->type);
+}
 
-        view->len = json_query(asset_view, "byteLength")->integer;
-        Json* j_offset = json_query(asset_view, "byteOffset");
-        if (j_offset) {
-            view->offset = j_offset->integer;
-        }
-        else {
-            view->offset = 0;
-        }
+// Bytes spanned by the elements, including any interleaved data between them.
+internal u64 accessor_size(GLTFAccessor* accessor) {
+    if (accessor->count == 0) {
+        return 0;
     }
 
-    Json* asset_accessors = json_query(root, "accessors");
-    GLTFAccessor* accessors = arena_push_array(scratch.arena, GLTFAccessor, json_len(asset_accessors));
-    u32 num_accessors = 0;
+    return (u64)(accessor->count - 1) * accessor_stride(accessor) + accessor->component_count * component_size(accessor->type);
+}
 
-    JSON_FOREACH(asset_accessors, asset_accessor) {
-        GLTFAccessor* accessor = &accessors[num_accessors++];
+// Converts the first components of every element to floats written dst_stride bytes apart, so quantized data
+// goes straight into its final layout. Normalized integers follow the glTF rules, e.g. max(c / 127, -1) for bytes.
+internal void read_accessor_floats(GLTFAccessor* accessor, int components, void* dst, u64 dst_stride) {
+    assert(accessor->component_count >= components);
 
-        u32 view_index = (u32)json_query(asset_accessor, "bufferView")->integer;
-        assert(view_index < num_views);
-        accessor->view = &views[view_index];
+    u8* src = (u8*)accessor_data(accessor);
+    u64 src_stride = accessor_stride(accessor);
+    bool normalized = accessor->normalized;
 
-        Json* j_offset = json_query(asset_accessor, "byteOffset");
-        if (j_offset) {
-            accessor->offset = j_offset->integer;
-        }
-        else {
-            accessor->offset = 0;
+    for (u32 i = 0; i < accessor->count; ++i) {
+        void* element = src + i * src_stride;
+        f32* out = (f32*)((u8*)dst + i * dst_stride);
+
+        switch (accessor->type) {
+            case GLTF_FLOAT:
+                memcpy(out, element, components * sizeof(f32));
+                break;
+            case GLTF_BYTE:
+                for (int c = 0; c < components; ++c) {
+                    f32 value = (f32)((i8*)element)[c];
+                    out[c] = normalized ? fmaxf(value / 127.0f, -1.0f) : value;
+                }
+                break;
+            case GLTF_UNSIGNED_BYTE:
+                for (int c = 0; c < components; ++c) {
+                    f32 value = (f32)((u8*)element)[c];
+                    out[c] = normalized ? value / 255.0f : value;
+                }
+                break;
+            case GLTF_SHORT:
+                for (int c = 0; c < components; ++c) {
+                    f32 value = (f32)((i16*)element)[c];
+                    out[c] = normalized ? fmaxf(value / 32767.0f, -1.0f) : value;
+                }
+                break;
+            case GLTF_UNSIGNED_SHORT:
+                for (int c = 0; c < components; ++c) {
+                    f32 value = (f32)((u16*)element)[c];
+                    out[c] = normalized ? value / 65535.0f : value;
+                }
+                break;
+            default:
+                assert(false && "Unsupported accessor component type");
         }
+    }
+}
 
-        accessor->type = (GLTFType)json_query(asset_accessor, "componentType")->integer;
-        accessor->count = (u32)json_query(asset_accessor, "count")->integer;
+// Reads unsigned integer scalars or vector components into u32s, count * components of them.
+internal void read_accessor_uints(GLTFAccessor* accessor, int components, u32* dst) {
+    assert(accessor->component_count >= components);
 
-        char* component_count = json_query(asset_accessor, "type")->string;
+    u8* src = (u8*)accessor_data(accessor);
+    u64 src_stride = accessor_stride(accessor);
 
-        if (strcmp(component_count, "SCALAR") == 0) {
-            accessor->component_count = 1;
-        }
-        else if (strcmp(component_count, "VEC2") == 0) {
-            accessor->component_count = 2;
-        }
-        else if (strcmp(component_count, "VEC3") == 0) {
-            accessor->component_count = 3;
-        }
-        else if (strcmp(component_count, "VEC4") == 0) {
-            accessor->component_count = 4;
-        }
-        else {
-            assert(false);
-        }
+    if (accessor->type == GLTF_UNSIGNED_INT && src_stride == sizeof(u32) && components == 1) {
+        memcpy(dst, src, accessor->count * sizeof(u32));
+        return;
     }
 
-    Material* materials = 0;
-    int num_materials = 0;
+    for (u32 i = 0; i < accessor->count; ++i) {
+        void* element = src + i * src_stride;
+        u32* out = dst + (u64)i * components;
 
-#if !IGNORE_MATERIALS
+        switch (accessor->type) {
+            case GLTF_UNSIGNED_BYTE:
+                for (int c = 0; c < components; ++c) {
+                    out[c] = ((u8*)element)[c];
+                }
+                break;
+            case GLTF_UNSIGNED_SHORT:
+                for (int c = 0; c < components; ++c) {
+                    out[c] = ((u16*)element)[c];
+                }
+                break;
+            case GLTF_UNSIGNED_INT:
+                for (int c = 0; c < components; ++c) {
+                    out[c] = ((u32*)element)[c];
+                }
+                break;
+            default:
+                assert(false && "Unsupported accessor component type");
+        }
+    }
+}
 
-    GLTFImage* images = 0;
-    int num_images = 0;
+// Expands VEC3/VEC4 elements to XMVECTORs (w = 0 for VEC3).
+XMVECTOR* read_accessor_vectors(Arena* arena, GLTFAccessor* accessor) {
+    assert(accessor->component_count == 3 || accessor->component_count == 4);
 
-    Json* asset_images = json_query(root, "images");
-    if (asset_images) {
-        images = arena_push_array_zero(scratch.arena, GLTFImage, json_len(asset_images));
+    XMVECTOR* vectors = arena_push_array_zero(arena, XMVECTOR, accessor->count);
+    read_accessor_floats(accessor, accessor->component_count, vectors, sizeof(XMVECTOR));
 
-        JSON_FOREACH(asset_images, asset_image) {
-            Scratch image_scratch = get_scratch(&arena, 1);
+    return vectors;
+}
 
-            GLTFImage* image = &images[num_images++];
+// Copies size bytes of a buffer, from memory or from its file. Returns false if they're out of range or unreadable.
+internal bool read_gltf_buffer_range(GLTFBuffer* buffer, u64 offset, u64 size, void* dst) {
+    if (offset + size > buffer->len) {
+        return false;
+    }
 
-            void* compressed_memory = 0;
-            u64 compressed_memory_size = 0;
+    if (size == 0) {
+        return true;
+    }
 
-            if (Json* uri = json_query(asset_image, "uri")) {
-                char absolute_uri[1024];
-                sprintf_s(absolute_uri, sizeof(absolute_uri), "%s%s", dir, uri->string);
-                ReadFileResult file = read_file(image_scratch.arena, absolute_uri);
-                compressed_memory = file.memory;
-                compressed_memory_size = file.size;
-            }
-            else if(Json* bufferView = json_query(asset_image, "bufferView")) {
-                assert(bufferView->integer < num_views);
-                GLTFBufferView* view = &views[bufferView->integer];
-                compressed_memory = (u8*)view->buffer->memory + view->offset;
-                compressed_memory_size = view->len;
-            }
-            else {
-                assert(false);
-            }
+    if (buffer->memory) {
+        memcpy(dst, (u8*)buffer->memory + offset, size);
+        return true;
+    }
 
-            int width, height;
-            image->memory = stbi_load_from_memory((stbi_uc*)compressed_memory, (int)compressed_memory_size, &width, &height, 0, 4);
+    return buffer->file.handle && file_read(buffer->file, buffer->file_offset + offset, dst, size);
+}
 
-            image->width = width;
-            image->height = width;
+internal bool decode_gltf_compressed_view(GLTFCompressedView* view, u8* src, void* dst) {
+    if (strcmp(view->mode, "ATTRIBUTES") == 0) {
+        return meshopt_decode_vertices(dst, view->count, view->stride, src, view->len) && meshopt_decode_filter(view->filter, dst, view->count, view->stride);
+    }
 
-            release_scratch(image_scratch);
-        }
+    if (strcmp(view->mode, "TRIANGLES") == 0) {
+        return meshopt_decode_triangles(dst, view->count, view->stride, src, view->len);
     }
 
-    GLTFTexture* textures = 0;
-    int num_textures = 0;
+    if (strcmp(view->mode, "INDICES") == 0) {
+        return meshopt_decode_index_sequence(dst, view->count, view->stride, src, view->len);
+    }
 
-    Json* asset_textures = json_query(root, "textures");
-    if (asset_textures) {
-        textures = arena_push_array(scratch.arena, GLTFTexture, json_len(asset_textures));
+    return false;
+}
 
-        JSON_FOREACH(asset_textures, asset_texture) {
-            i64 index = json_query(asset_texture, "source")->integer;
-            assert(index < num_images);
-            textures[num_textures++].image = &images[index];
-        }
+// Returns the accessor itself if its data is in memory. Otherwise returns a copy whose view holds only its
+// elements, read into arena; a compressed view is read and decoded whole, since its elements can't be decoded on
+// their own.
+GLTFAccessor* read_gltf_accessor(Arena* arena, GLTFAccessor* accessor) {
+    GLTFBufferView* view = accessor->view;
+
+    if (!view->compression && view->buffer->memory) {
+        return accessor;
     }
 
-    // Materials will be stored in the output arena because they are returned
+    GLTFBuffer* buffer = arena_push_struct_zero(arena, GLTFBuffer);
+    GLTFBufferView* resident_view = arena_push_struct(arena, GLTFBufferView);
+    GLTFAccessor* resident = arena_push_struct(arena, GLTFAccessor);
 
-    Json* asset_materials = json_query(root, "materials");
-    if (asset_materials) {
-        materials = arena_push_array_zero(arena, Material, json_len(asset_materials));
+    *resident_view = *view;
+    resident_view->buffer = buffer;
+    resident_view->compression = 0;
 
-        JSON_FOREACH(asset_materials, asset_material) {
-            u64 base_color_texture = json_query(json_query(json_query(asset_material, "pbrMetallicRoughness"), "baseColorTexture"), "index")->integer;
-            assert(base_color_texture < num_textures);
-            GLTFTexture* texture = &textures[base_color_texture];
-            GLTFImage* image = texture->image;
-            materials[num_materials++] = renderer_new_material(renderer, upload_context, image->width, image->height, image->memory);
-        }
+    *resident = *accessor;
+    resident->view = resident_view;
+
+    bool valid;
+
+    if (GLTFCompressedView* compression = view->compression) {
+        buffer->len = view->len;
+        buffer->memory = arena_push(arena, buffer->len);
+
+        u8* src = (u8*)arena_push(arena, compression->len);
+        valid = read_gltf_buffer_range(compression->buffer, compression->offset, compression->len, src) && decode_gltf_compressed_view(compression, src, buffer->memory);
     }
+    else {
+        buffer->len = accessor_size(accessor);
+        buffer->memory = arena_push(arena, buffer->len);
+
+        valid = read_gltf_buffer_range(view->buffer, view->offset + accessor->offset, buffer->len, buffer->memory);
 
-    for (int i = 0; i < num_images; ++i) {
-        stbi_image_free(images[i].memory);
+        resident_view->offset = 0;
+        resident_view->len = buffer->len;
+        resident->offset = 0;
     }
 
-#endif // IF NOT IGNORE_MATERIALS
+    if (!valid) {
+        system_message_box("Failed to read GLTF buffer data");
+        assert(false);
+    }
 
-    Json* asset_meshes = json_query(root, "meshes");
-    GLTFMesh* meshes = arena_push_array(scratch.arena, GLTFMesh, json_len(asset_meshes));
-    int num_meshes = 0;
+    return resident;
+}
 
-    JSON_FOREACH(json_query(root, "meshes"), asset_mesh) {
-        GLTFMesh* mesh = &meshes[num_meshes++];
+GLTFGeometry read_gltf_geometry(Arena* arena, GLTFGeometry* geometry) {
+    GLTFGeometry result = *geometry;
+    result.pos = read_gltf_accessor(arena, geometry->pos);
+    result.norm = read_gltf_accessor(arena, geometry->norm);
+    result.uv = read_gltf_accessor(arena, geometry->uv);
 
-        Json* mesh_primitives = json_query(asset_mesh, "primitives");
-        mesh->num_primitives = json_len(mesh_primitives);
-        mesh->primitives = arena_push_array(scratch.arena, GLTFPrimitive, mesh->num_primitives);
+    if (geometry->indices) {
+        result.indices = read_gltf_accessor(arena, geometry->indices);
+    }
 
-        int primitive_index = 0;
-        JSON_FOREACH(mesh_primitives, primitive) {
-            Scratch prim_scratch = get_scratch(&arena, 1);
+    if (geometry->joints) {
+        result.joints = read_gltf_accessor(arena, geometry->joints);
+        result.weights = read_gltf_accessor(arena, geometry->weights);
+    }
 
-            Json* attributes = json_query(primitive, "attributes");
-            u32 pos_index = (u32)json_query(attributes, "POSITION")->integer;
-            u32 norm_index = (u32)json_query(attributes, "NORMAL")->integer;
-            u32 uv_index = (u32)json_query(attributes, "TEXCOORD_0")->integer;
-            u32 indices_index = (u32)json_query(primitive, "indices")->integer;
+    return result;
+}
 
-            assert(pos_index < num_accessors);
-            assert(norm_index < num_accessors);
-            assert(uv_index < num_accessors);
-            assert(indices_index < num_accessors);
+internal Json* instancing_attributes(Json* asset_node) {
+    Json* extensions = json_query(asset_node, "extensions");
+    Json* instancing = extensions ? json_query(extensions, "EXT_mesh_gpu_instancing") : 0;
+    return instancing ? json_query(instancing, "attributes") : 0;
+}
 
-            GLTFAccessor* pos_accessor = &accessors[pos_index];
-            GLTFAccessor* norm_accessor = &accessors[norm_index];
-            GLTFAccessor* uv_accessor = &accessors[uv_index];
-            GLTFAccessor* indices_accessor = &accessors[indices_index];
+// Composes the TRANSLATION, ROTATION and SCALE accessors of EXT_mesh_gpu_instancing into 3x4 transforms. Missing
+// attributes are identity. Returns the number of transforms, and only counts them when transforms is null.
+internal u32 read_instance_transforms(GLTFAccessor* accessors, Json* attributes, XMFLOAT4X3* transforms) {
 
-            assert(pos_accessor->count == norm_accessor->count && pos_accessor->count == uv_accessor->count);
-            assert(pos_accessor->type == GLTF_FLOAT && norm_accessor->type == GLTF_FLOAT && uv_accessor->type == GLTF_FLOAT);
-            assert(indices_accessor->type == GLTF_UNSIGNED_INT || indices_accessor->type == GLTF_UNSIGNED_SHORT);
-            assert(indices_accessor->component_count == 1);
+    GLTFAccessor* translations = 0;
+    GLTFAccessor* rotations = 0;
+    GLTFAccessor* scales = 0;
 
-            u32 vertex_count = pos_accessor->count;
-            u32 index_count = indices_accessor->count;
+    if (Json* translation = json_query(attributes, "TRANSLATION")) {
+        translations = &accessors[translation->integer];
+    }
+    if (Json* rotation = json_query(attributes, "ROTATION")) {
+        rotations = &accessors[rotation->integer];
+    }
+    if (Json* scale = json_query(attributes, "SCALE")) {
+        scales = &accessors[scale->integer];
+    }
 
-            Vertex* vertex_data = arena_push_array(prim_scratch.arena, Vertex, vertex_count);
-            u32* index_data = arena_push_array(prim_scratch.arena, u32, index_count);
+    u32 count = translations ? translations->count : rotations ? rotations->count : scales ? scales->count : 0;
+    assert((!translations || translations->count == count) && (!rotations || rotations->count == count) && (!scales || scales->count == count));
 
-            f32* pos_src = (f32*)((u8*)pos_accessor->view->buffer->memory + pos_accessor->view->offset + pos_accessor->offset);
-            f32* norm_src = (f32*)((u8*)norm_accessor->view->buffer->memory + norm_accessor->view->offset + norm_accessor->offset);
-            f32* uv_src = (f32*)((u8*)uv_accessor->view->buffer->memory + uv_accessor->view->offset + uv_accessor->offset);
-            void* index_src = (u8*)indices_accessor->view->buffer->memory + indices_accessor->view->offset + indices_accessor->offset;
-            
-            XMVECTOR aabb_min =  XMVectorSplatInfinity();
-            XMVECTOR aabb_max = -XMVectorSplatInfinity();
+    if (!transforms) {
+        return count;
+    }
 
-            for (u32 i = 0; i < vertex_count; ++i) {
-                Vertex* v = &vertex_data[i];
+    Scratch scratch = get_scratch(0, 0);
 
-                f32* pos = pos_src + i * pos_accessor->component_count;
-                f32* norm = norm_src + i * norm_accessor->component_count;
-                f32* uv = uv_src + i * uv_accessor->component_count;
+    XMVECTOR* translation_values = translations ? read_accessor_vectors(scratch.arena, read_gltf_accessor(scratch.arena, translations)) : 0;
+    XMVECTOR* rotation_values = rotations ? read_accessor_vectors(scratch.arena, read_gltf_accessor(scratch.arena, rotations)) : 0;
+    XMVECTOR* scale_values = scales ? read_accessor_vectors(scratch.arena, read_gltf_accessor(scratch.arena, scales)) : 0;
 
-                v->pos = { pos[0], pos[1], pos[2] };
-                v->norm = { norm[0], norm[1], norm[2] };
-                v->uv = { uv[0], uv[1] };
+    for (u32 i = 0; i < count; ++i) {
+        XMVECTOR translation = translation_values ? translation_values[i] : XMVectorZero();
+        XMVECTOR rotation = rotation_values ? XMQuaternionNormalize(rotation_values[i]) : XMQuaternionIdentity();
+        XMVECTOR scale = scale_values ? scale_values[i] : XMVectorSplatOne();
 
-                aabb_max = XMVectorMax(aabb_max, XMLoadFloat3(&v->pos));
-                aabb_min = XMVectorMin(aabb_min, XMLoadFloat3(&v->pos));
-            }
+        XMStoreFloat4x3(&transforms[i], XMMatrixAffineTransformation(scale, XMVectorZero(), rotation, translation));
+    }
 
-            switch (indices_accessor->type) {
-                case GLTF_UNSIGNED_INT:
-                    memcpy(index_data, index_src, index_count * sizeof(u32));
-                    break;
-                case GLTF_UNSIGNED_SHORT:
-                    for (u32 i = 0; i < index_count; ++i) {
-                        index_data[i] = ((u16*)index_src)[i];
-                    }
-                    break;
-                default:
-                    assert(false && "Unreachable");
-            }
+    release_scratch(scratch);
+    return count;
+}
 
-            MeshCreateInfo mesh_info = {};
-            mesh_info.vertex_data = vertex_data;
-            mesh_info.index_data = index_data;
-            mesh_info.vertex_count = vertex_count;
-            mesh_info.index_count = index_count;
-            XMStoreFloat3(&mesh_info.aabb.min, aabb_min);
-            XMStoreFloat3(&mesh_info.aabb.max, aabb_max);
+// Weights are renormalized, as quantized ones rarely sum to exactly one.
+internal SkinInfluence* read_skin_influences(Arena* arena, GLTFAccessor* joints, GLTFAccessor* weights, u32* joint_count) {
+    assert(joints->component_count == 4 && weights->component_count == 4 && joints->count == weights->count);
 
-            GLTFPrimitive* prim = &mesh->primitives[primitive_index++];
-            prim->mesh = renderer_new_mesh(renderer, upload_context, &mesh_info);
+    Scratch scratch = get_scratch(&arena, 1);
 
-            #if IGNORE_MATERIALS
-                prim->material = renderer_get_default_material(renderer);
-            #else
-                if (Json* material = json_query(primitive, "material")) {
-                    assert(material->integer < num_materials);
-                    prim->material = materials[material->integer];
-                }
-                else {
-                    prim->material = renderer_get_default_material(renderer);
-                }
-            #endif
+    SkinInfluence* influences = arena_push_array(arena, SkinInfluence, joints->count);
+    read_accessor_floats(weights, 4, influences[0].weights, sizeof(SkinInfluence));
 
-            release_scratch(prim_scratch);
-        }
-    }
+    u32* joint_indices = arena_push_array(scratch.arena, u32, (u64)joints->count * 4);
+    read_accessor_uints(joints, 4, joint_indices);
 
-    Json* asset_nodes = json_query(root, "nodes");
-    int num_nodes = json_len(asset_nodes);
-    GLTFNode* nodes = arena_push_array(scratch.arena, GLTFNode, num_nodes);
+    *joint_count = 0;
 
-    int node_index = 0;
-    JSON_FOREACH(asset_nodes, asset_node) {
-        GLTFNode* node = &nodes[node_index++];
+    for (u32 i = 0; i < joints->count; ++i) {
+        SkinInfluence* influence = &influences[i];
+        f32 weight_sum = 0.0f;
 
-        Json* node_children = json_query(asset_node, "children");
-        if (node_children) {
-            node->num_children = json_len(node_children);
-            node->children = arena_push_array(scratch.arena, GLTFNode*, node->num_children);
+        for (u32 j = 0; j < 4; ++j) {
+            assert(joint_indices[i * 4 + j] <= UINT16_MAX);
+            influence->joints[j] = (u16)joint_indices[i * 4 + j];
+            weight_sum += influence->weights[j];
+        }
 
-            int child_index = 0;
-            JSON_FOREACH(node_children, child) {
-                assert(child->integer < num_nodes);
-                node->children[child_index++] = &nodes[child->integer];
+        if (weight_sum > 0.0f) {
+            for (u32 j = 0; j < 4; ++j) {
+                influence->weights[j] /= weight_sum;
             }
         }
         else {
-            node->num_children = 0;
-            node->children = 0;
+            influence->weights[0] = 1.0f;
         }
-        
-        Json* matrix = json_query(asset_node, "matrix");
-        if (matrix) {
-            assert(json_len(matrix) == 16);
-            f32* matrix_element = (f32*)&node->transform;
-            JSON_FOREACH(matrix, el) {
-                switch (el->type) {
-                    case JSON_REAL:
-                        *(matrix_element++) = (f32)el->real;
-                        break;
-                    case JSON_INTEGER:
-                        *(matrix_element++) = (f32)el->integer;
-                        break;
-                    default:
-                        assert(false);
-                        break;
-                }
-            }
-        }
-        else {
-            node->transform = XMMatrixIdentity();
-
-            Json* scaling = json_query(asset_node, "scale");
-            if (scaling) {
-                node->transform *= XMMatrixScalingFromVector(extract_json_vector(scaling));
-            }
 
-            Json* rotation = json_query(asset_node, "rotation");
-            if (rotation) {
-                node->transform *= XMMatrixRotationQuaternion(extract_json_vector(rotation));
+        // Unused slots may hold any joint index, so they're pointed at joint 0 to keep palette reads in bounds.
+        for (u32 j = 0; j < 4; ++j) {
+            if (influence->weights[j] == 0.0f) {
+                influence->joints[j] = 0;
             }
 
-            Json* translation = json_query(asset_node, "translation");
-            if (translation) {
-                node->transform *= XMMatrixTranslationFromVector(extract_json_vector(translation));
+            if (influence->joints[j] >= *joint_count) {
+                *joint_count = influence->joints[j] + 1u;
             }
         }
+    }
 
-        Json* mesh = json_query(asset_node, "mesh");
-        if (mesh) {
-            assert(mesh->integer < num_meshes);
-            node->mesh = &meshes[mesh->integer];
-        }
-        else {
-            node->mesh = 0;
-        }
+    release_scratch(scratch);
+
+    return influences;
+}
+
+internal u64 accessor_content_hash(GLTFAccessor* accessor, u64 seed) {
+    u64 layout = ((u64)accessor->normalized << 48) | ((u64)accessor->type << 40) | ((u64)accessor->component_count << 32) | accessor->count;
+    return hash_bytes(accessor_data(accessor), accessor_size(accessor), hash_combine(seed, layout));
+}
+
+internal bool accessor_content_equal(GLTFAccessor* a, GLTFAccessor* b) {
+    if (a == b) {
+        return true;
     }
 
-    LoadGLTFResult result;
-    result.num_materials = num_materials;
-    result.materials = materials;
-    result.num_instances = 0;
-    result.instances = arena_mark(arena, MeshInstance);
+    if (!a || !b) {
+        return false;
+    }
 
-    JSON_FOREACH(json_query(root, "scenes"), scene) {
-        JSON_FOREACH(json_query(scene, "nodes"), node) {
-            process_gltf_node(arena, &result, &nodes[node->integer], XMMatrixIdentity());
-        }
+    if (a->type != b->type || a->count != b->count || a->component_count != b->component_count || a->normalized != b->normalized) {
+        return false;
     }
 
-    release_scratch(scratch);
+    if (accessor_stride(a) != accessor_stride(b)) {
+        return false;
+    }
 
-    return result;
+    return memcmp(accessor_data(a), accessor_data(b), accessor_size(a)) == 0;
 }
 
-internal void get_directory(char* path, char* buf, u64 buf_size) {
-    {
-        strcpy_s(buf, buf_size, path);
+internal u64 geometry_content_hash(GLTFGeometry* geometry) {
+    u64 hash = accessor_content_hash(geometry->pos, 0);
+    hash = accessor_content_hash(geometry->norm, hash);
+    hash = accessor_content_hash(geometry->uv, hash);
+    if (geometry->indices) {
+        hash = accessor_content_hash(geometry->indices, hash);
+    }
+    if (geometry->joints) {
+        hash = accessor_content_hash(geometry->joints, hash);
+        hash = accessor_content_hash(geometry->weights, hash);
+    }
+    return hash;
+}
 
-        for (char* c = buf; *c; ++c) {
-            if (*c == '\\') {
-                *c = '/';
-            }
-        }
+internal bool geometry_content_equal(GLTFGeometry* a, GLTFGeometry* b) {
+    return accessor_content_equal(a->pos, b->pos) &&
+           accessor_content_equal(a->norm, b->norm) &&
+           accessor_content_equal(a->uv, b->uv) &&
+           accessor_content_equal(a->indices, b->indices) &&
+           accessor_content_equal(a->joints, b->joints) &&
+           accessor_content_equal(a->weights, b->weights);
+}
 
-        char* last_slash = strrchr(buf, '/');
-        if (last_slash) {
-            last_slash[1] = '\0';
-        }
-        else {
-            buf[0] = '\0';
-        }
+internal void accumulate_vertex_cache_stats(VertexCacheStats* total, VertexCacheStats stats) {
+    total->triangle_count += stats.triangle_count;
+    total->vertex_count += stats.vertex_count;
+    total->vertices_transformed += stats.vertices_transformed;
+
+    if (total->triangle_count > 0) {
+        total->acmr = (f32)total->vertices_transformed / (f32)total->triangle_count;
+        total->atvr = (f32)total->vertices_transformed / (f32)total->vertex_count;
     }
 }
 
-internal LoadGLTFResult load_gltf_glb(Arena* arena, Renderer* renderer, RendererUploadContext* upload_context, char* path) {
-    Scratch scratch = get_scratch(&arena, 1);
+// Where prepared vertex and index data is written, once, as a single block. With an upload context that's upload
+// memory reserved in it, so creating the mesh or material copies nothing more; reservations can only be made on the
+// thread recording uploads. Without one it's a page allocation, freed once the upload has been recorded.
+struct GLTFUploadTarget {
+    Renderer* renderer;
+    RendererUploadContext* upload_context;
+};
 
-    assert(strcmp(strrchr(path, '.'), ".glb") == 0);
-    ReadFileResult file = read_file(scratch.arena, path);
-    u8* file_cursor = (u8*)file.memory;
-    u8* file_end = file_cursor + file.size;
+internal void* push_gltf_upload_data(GLTFUploadTarget* target, u64 size) {
+    if (target->upload_context) {
+        return renderer_reserve_upload(target->renderer, target->upload_context, size);
+    }
+    return page_alloc(size);
+}
 
-    char dir[1024];
-    get_directory(path, dir, sizeof(dir));
+// Does all of the CPU work for a geometry. Only the target's upload memory touches the renderer, so it can run on
+// any thread when the target has no upload context. The mesh info is pushed to arena, and the vertices and indices
+// the returned create info points at are one block written to target, starting at vertex_data.
+internal MeshCreateInfo prepare_geometry_mesh(Arena* arena, GLTFUploadTarget* target, GLTFLoadOptions* options, GLTFGeometry* geometry, GLTFMeshStats* stats, GLTFMeshInfo* info) {
+    Scratch scratch = get_scratch(&arena, 1);
 
-    GLBHeader* header = (GLBHeader*)file_cursor;
-    file_cursor += sizeof(*header);
+    // Skinned vertices are rewritten in the full format every frame and keep their influences by index, so the
+    // passes that merge, reorder or quantize vertices are skipped for them. Index-only passes still run.
+    bool skinned = geometry->joints != 0;
 
-    assert(memcmp(&header->magic, "glTF", 4) == 0);
-    assert(header->version == 2);
-    assert(header->len == file.size);
+    GLTFAccessor* pos_accessor = geometry->pos;
+    GLTFAccessor* norm_accessor = geometry->norm;
+    GLTFAccessor* uv_accessor = geometry->uv;
+    GLTFAccessor* indices_accessor = geometry->indices;
 
-    #define READ_CHUNK(name) GLBChunk* name = (GLBChunk*)file_cursor; file_cursor += offsetof(GLBChunk, memory) + name->len
-    
-    READ_CHUNK(json_chunk);
-    assert(json_chunk->type == GLB_CHUNK_JSON);
+    u32 vertex_count = pos_accessor->count;
+    u32 index_count = indices_accessor ? indices_accessor->count : vertex_count;
 
-    char* json_string = (char*)arena_push(scratch.arena, json_chunk->len + 1);
-    memcpy(json_string, json_chunk->memory, json_chunk->len);
-    json_string[json_chunk->len] = '\0';
+    Vertex* vertex_data = arena_push_array(scratch.arena, Vertex, vertex_count);
+    u32* index_data = arena_push_array(scratch.arena, u32, index_count);
 
-    Arena* conflicts[] = { arena, scratch.arena };
-    Scratch scratch_2 = get_scratch(conflicts, ARRAY_LEN(conflicts));
+    read_accessor_floats(pos_accessor, 3, &vertex_data[0].pos, sizeof(Vertex));
+    read_accessor_floats(norm_accessor, 3, &vertex_data[0].norm, sizeof(Vertex));
+    read_accessor_floats(uv_accessor, 2, &vertex_data[0].uv, sizeof(Vertex));
 
-    int num_buffers = 0;
-    GLTFBuffer* buffers = arena_mark(scratch_2.arena, GLTFBuffer);
+    XMVECTOR aabb_min =  XMVectorSplatInfinity();
+    XMVECTOR aabb_max = -XMVectorSplatInfinity();
 
-    while (file_cursor != file_end) {
-        READ_CHUNK(buf_chunk);
-        assert(buf_chunk->type == GLB_CHUNK_BIN);
+    for (u32 i = 0; i < vertex_count; ++i) {
+        aabb_max = XMVectorMax(aabb_max, XMLoadFloat3(&vertex_data[i].pos));
+        aabb_min = XMVectorMin(aabb_min, XMLoadFloat3(&vertex_data[i].pos));
+    }
 
-        GLTFBuffer* buf = arena_push_struct(scratch_2.arena, GLTFBuffer);
-        ++num_buffers;
+    if (!indices_accessor) {
+        for (u32 i = 0; i < index_count; ++i) {
+            index_data[i] = i;
+        }
+    }
+    else {
+        read_accessor_uints(indices_accessor, 1, index_data);
+    }
 
-        buf->len = buf_chunk->len;
-        buf->memory = buf_chunk->memory;
+    if (options->weld_vertices && !skinned) {
+        stats->vertices_before_weld += vertex_count;
+        vertex_count = weld_vertices(vertex_data, index_data, index_count, vertex_count, options->weld_epsilon);
+        stats->vertices_after_weld += vertex_count;
     }
 
-    #undef READ_CHUNK
+    bool optimize = options->optimize_vertex_cache || options->optimize_overdraw || options->optimize_vertex_fetch;
+
+    if (optimize) {
+        accumulate_vertex_cache_stats(&stats->cache_before, analyze_vertex_cache(index_data, index_count, vertex_count, VERTEX_CACHE_SIZE));
+    }
+
+    if (options->optimize_vertex_cache) {
+        optimize_vertex_cache(index_data, index_count, vertex_count, VERTEX_CACHE_SIZE);
+    }
+
+    if (options->optimize_overdraw) {
+        optimize_overdraw(index_data, index_count, vertex_data, vertex_count, VERTEX_CACHE_SIZE, options->overdraw_threshold);
+    }
+
+    // LODs reuse the vertex buffer and follow LOD 0 in the index buffer; index_count stays the LOD 0 count.
+
+    u32 lod_count = 1;
+    MeshLOD lods[MAX_MESH_LODS] = {};
+    lods[0].index_count = index_count;
+
+    if (options->generate_lods) {
+        u32* lod_indices = arena_push_array(scratch.arena, u32, index_count * options->max_lods);
+        lod_count = build_mesh_lods(lod_indices, lods, options->max_lods, index_data, index_count, vertex_data, vertex_count, options->lod_attribute_weight);
+        index_data = lod_indices;
+
+        for (u32 i = 0; i < lod_count; ++i) {
+            stats->lod_triangles[i] += lods[i].index_count / 3;
+        }
+    }
+
+    u32 total_index_count = lods[lod_count - 1].index_offset + lods[lod_count - 1].index_count;
+
+    if (options->optimize_vertex_fetch && !skinned) {
+        vertex_count = optimize_vertex_fetch(vertex_data, index_data, total_index_count, vertex_count);
+    }
+
+    if (optimize) {
+        accumulate_vertex_cache_stats(&stats->cache_after, analyze_vertex_cache(index_data, index_count, vertex_count, VERTEX_CACHE_SIZE));
+    }
+
+    *info = {};
+
+    if (options->build_meshlets) {
+        MeshletBuildResult build = build_meshlets(scratch.arena, index_data, index_count, vertex_count, options->meshlet_max_vertices, options->meshlet_max_triangles);
+        Meshlet* meshlets = arena_push_array(arena, Meshlet, build.meshlet_count);
+
+        for (u32 i = 0; i < build.meshlet_count; ++i) {
+            MeshletRange* range = &build.meshlets[i];
+            meshlets[i].bounds = compute_meshlet_bounds(&build, range, vertex_data);
+            meshlets[i].index_offset = range->triangle_offset * 3;
+            meshlets[i].index_count = range->triangle_count * 3;
+
+            ++stats->meshlet_count;
+            stats->meshlet_vertices += range->vertex_count;
+            stats->meshlet_triangles += range->triangle_count;
+        }
+
+        // Each meshlet becomes a contiguous index range so it can be drawn on its own.
+        write_meshlet_indices(&build, index_data);
+
+        info->num_meshlets = build.meshlet_count;
+        info->meshlets = meshlets;
+    }
+
+    IndexFormat index_format = vertex_count <= 65536u ? INDEX_FORMAT_U16 : INDEX_FORMAT_U32;
+
+    stats->index_bytes_u32 += total_index_count * sizeof(u32);
+    stats->index_bytes_uploaded += total_index_count * (index_format == INDEX_FORMAT_U16 ? sizeof(u16) : sizeof(u32));
+
+    MeshCreateInfo mesh_info = {};
+    mesh_info.vertex_format = VERTEX_FORMAT_FULL;
+    mesh_info.vertex_data = vertex_data;
+    mesh_info.index_format = index_format;
+    mesh_info.vertex_count = vertex_count;
+    mesh_info.index_count = total_index_count;
+    mesh_info.lod_count = lod_count;
+    memcpy(mesh_info.lods, lods, sizeof(lods));
+    XMStoreFloat3(&mesh_info.aabb.min, aabb_min);
+    XMStoreFloat3(&mesh_info.aabb.max, aabb_max);
+
+    if (skinned) {
+        SkinnedVertices* skin_vertices = arena_push_struct(arena, SkinnedVertices);
+        skin_vertices->vertex_count = vertex_count;
+        skin_vertices->bind_vertices = arena_push_array(arena, Vertex, vertex_count);
+        skin_vertices->influences = read_skin_influences(arena, geometry->joints, geometry->weights, &skin_vertices->joint_count);
+        memcpy(skin_vertices->bind_vertices, vertex_data, vertex_count * sizeof(Vertex));
+
+        info->skin_vertices = skin_vertices;
+    }
+
+    if (options->compact_vertices && !skinned) {
+        VertexDequantization dequantization = vertex_dequantization_from_aabb(&mesh_info.aabb);
+
+        CompactVertex* compact_data = arena_push_array(scratch.arena, CompactVertex, vertex_count);
+        encode_compact_vertices(compact_data, vertex_data, vertex_count, &dequantization);
+
+        stats->vertex_bytes += vertex_count * sizeof(Vertex);
+        stats->compact_vertex_bytes += vertex_count * sizeof(CompactVertex);
+
+        mesh_info.vertex_format = VERTEX_FORMAT_COMPACT;
+        mesh_info.vertex_data = compact_data;
+        mesh_info.dequantization = dequantization;
+    }
+
+    // Vertex sizes are multiples of 16 bytes, so the indices that follow stay aligned.
+    u32 vertex_stride = mesh_info.vertex_format == VERTEX_FORMAT_COMPACT ? sizeof(CompactVertex) : sizeof(Vertex);
+    u32 index_stride = mesh_info.index_format == INDEX_FORMAT_U16 ? sizeof(u16) : sizeof(u32);
+    u64 vertex_size = (u64)mesh_info.vertex_count * vertex_stride;
+
+    u8* upload_data = (u8*)push_gltf_upload_data(target, vertex_size + (u64)mesh_info.index_count * index_stride);
+    memcpy(upload_data, mesh_info.vertex_data, vertex_size);
+
+    // 16-bit indices are narrowed straight into the target.
+    if (index_format == INDEX_FORMAT_U16) {
+        u16* index_data_u16 = (u16*)(upload_data + vertex_size);
+        for (u32 i = 0; i < total_index_count; ++i) {
+            index_data_u16[i] = (u16)index_data[i];
+        }
+    }
+    else {
+        memcpy(upload_data + vertex_size, index_data, (u64)total_index_count * sizeof(u32));
+    }
+
+    mesh_info.vertex_data = upload_data;
+    mesh_info.index_data = upload_data + vertex_size;
 
-    Json* root = parse_json_string(scratch.arena, json_string);
-    LoadGLTFResult result = process_gltf(arena, renderer, upload_context, dir, root, buffers, num_buffers);
-        
-    release_scratch(scratch_2);
     release_scratch(scratch);
 
-    return result;
+    return mesh_info;
 }
 
-internal LoadGLTFResult load_gltf_gltf(Arena* arena, Renderer* renderer, RendererUploadContext* upload_context, char* path) {
-    Scratch scratch = get_scratch(&arena, 1);
+// Keeps the report's largest meshes in order.
+internal void report_gltf_mesh(GLTFLoadReport* report, GLTFGeometry* geometry, MeshCreateInfo* info) {
+    ++report->num_meshes;
 
-    assert(strcmp(strrchr(path, '.'), ".gltf") == 0);
-    ReadFileResult file = read_file(scratch.arena, path);
-    Json* root = parse_json_string(scratch.arena, file.memory);
+    u64 vertex_stride = info->vertex_format == VERTEX_FORMAT_COMPACT ? sizeof(CompactVertex) : sizeof(Vertex);
+    u64 index_stride = info->index_format == INDEX_FORMAT_U16 ? sizeof(u16) : sizeof(u32);
+    u64 bytes = info->vertex_count * vertex_stride + info->index_count * index_stride;
 
-    char dir[1024];
-    get_directory(path, dir, sizeof(dir));
+    u32 slot = report->num_top_meshes;
+    while (slot > 0 && report->top_meshes[slot - 1].bytes < bytes) {
+        --slot;
+    }
 
-    assert(strcmp(json_query(json_query(root, "asset"), "version")->string, "2.0") == 0 && "Unsupported GLTF version");
+    if (slot == GLTF_REPORT_TOP_COUNT) {
+        return;
+    }
 
-    Json* asset_buffers = json_query(root, "buffers");
-    GLTFBuffer* buffers = arena_push_array(scratch.arena, GLTFBuffer, json_len(asset_buffers));
-    u32 num_buffers = 0;
+    if (report->num_top_meshes < GLTF_REPORT_TOP_COUNT) {
+        ++report->num_top_meshes;
+    }
 
-    JSON_FOREACH(json_query(root, "buffers"), src_buf) {
-        GLTFBuffer* buf = &buffers[num_buffers++];
-        buf->len = json_query(src_buf, "byteLength")->integer;
+    memmove(&report->top_meshes[slot + 1], &report->top_meshes[slot], (report->num_top_meshes - 1 - slot) * sizeof(GLTFReportMesh));
 
-        char* base64_header = "data:application/octet-stream;base64,";
-        char* uri = json_query(src_buf, "uri")->string;
+    GLTFReportMesh* entry = &report->top_meshes[slot];
+    memcpy(entry->name, geometry->name, sizeof(entry->name));
+    entry->bytes = bytes;
+    entry->vertex_count = info->vertex_count;
+    entry->index_count = info->index_count;
+}
+
+Mesh create_geometry_mesh(Arena* arena, Renderer* renderer, RendererUploadContext* upload_context, GLTFLoadOptions* options, GLTFGeometry* geometry, GLTFMeshStats* stats, GLTFMeshInfo* info, GLTFLoadReport* report) {
+    GLTFUploadTarget target = { renderer, upload_context };
+
+    f32 prepare_start = engine_time();
+    MeshCreateInfo mesh_info = prepare_geometry_mesh(arena, &target, options, geometry, stats, info);
+    add_gltf_stage_time(report, GLTF_STAGE_VERTEX_PROCESSING, prepare_start);
+
+    f32 upload_start = engine_time();
+    Mesh mesh = renderer_new_mesh(renderer, upload_context, &mesh_info);
+    add_gltf_stage_time(report, GLTF_STAGE_UPLOAD_RECORDING, upload_start);
+
+    if (report) {
+        report_gltf_mesh(report, geometry, &mesh_info);
+    }
+
+    return mesh;
+}
+
+struct GLTFDecodedImage {
+    int width;
+    int height;
+    u32 mip_count;
+    TextureFormat format;
+    void* data; // The whole chain: a page allocation, or upload memory laid out for the texture when staged
+    bool staged;
+    f32 mip_seconds;
+    f32 compress_seconds;
+    f32 psnr; // Of level 0, or 0 unless compressed with report_texture_psnr
+};
+
+internal void free_gltf_image(GLTFDecodedImage* image) {
+    if (!image->staged) {
+        page_free(image->data);
+    }
+    image->data = 0;
+}
+
+internal u64 gltf_image_size(GLTFDecodedImage* image) {
+    return texture_chain_size(image->format, image->width, image->height, image->mip_count);
+}
+
+internal MaterialCreateInfo gltf_image_material_info(GLTFDecodedImage* image) {
+    MaterialCreateInfo info = {};
+    info.texture_w = image->width;
+    info.texture_h = image->height;
+    info.mip_count = image->mip_count;
+    info.format = image->format;
+    info.texture_data = image->data;
+    return info;
+}
+
+// Decodes an image to RGBA8 followed by its mips, if the options ask for them, then block-compresses the chain if
+// the options ask for that. Images that aren't a multiple of 4 texels in both dimensions stay RGBA8, since D3D12
+// can't create block-compressed textures from them. The final chain is written once to the target: as the
+// texture's upload layout when staged in upload memory, otherwise packed in a page allocation.
+// Material images are base colors, which glTF stores as sRGB.
+internal void decode_gltf_image(GLTFLoadOptions* options, GLTFUploadTarget* target, void* encoded_memory, u64 encoded_size, GLTFDecodedImage* image) {
+    *image = {};
+
+    u32* decoded = (u32*)stbi_load_from_memory((stbi_uc*)encoded_memory, (int)encoded_size, &image->width, &image->height, 0, 4);
+    assert(decoded && "Failed to decode GLTF image");
+
+    image->mip_count = options->generate_mips ? mip_level_count(image->width, image->height) : 1;
+
+    bool compress = options->texture_format != TEXTURE_FORMAT_RGBA8 && image->width % 4 == 0 && image->height % 4 == 0;
+    image->format = compress ? options->texture_format : TEXTURE_FORMAT_RGBA8;
+
+    // Without mips, stb's buffer is the whole RGBA8 chain.
+    u32* chain = decoded;
+    u64 chain_size = mip_chain_texels(image->width, image->height, image->mip_count) * sizeof(u32);
 
-        if (strncmp(uri, base64_header, strlen(base64_header)) == 0) {
-            DecodeBase64Result decode = decode_base64(scratch.arena, uri + strlen(base64_header));
-            assert(decode.size == buf->len);
-            buf->memory = decode.memory;
+    if (image->mip_count > 1) {
+        chain = (u32*)page_alloc(chain_size);
+        memcpy(chain, decoded, (u64)image->width * image->height * sizeof(u32));
+
+        f32 mip_start = engine_time();
+        generate_mips(0, options->mip_filter, true, image->width, image->height, image->mip_count, chain);
+        image->mip_seconds = engine_time() - mip_start;
+    }
+
+    // Measuring PSNR reads the blocks back, which upload memory is too slow for.
+    if (target->upload_context && !(compress && options->report_texture_psnr)) {
+        MaterialCreateInfo info = gltf_image_material_info(image);
+
+        TextureUploadLayout layout;
+        renderer_texture_upload_layout(target->renderer, &info, &layout);
+
+        image->data = renderer_reserve_upload(target->renderer, target->upload_context, layout.size);
+        image->staged = true;
+
+        if (compress) {
+            f32 compress_start = engine_time();
+            bc_compress_chain(0, image->format, options->texture_quality, image->width, image->height, image->mip_count, chain, image->data, &layout);
+            image->compress_seconds = engine_time() - compress_start;
         }
         else {
-            char absolute_uri[1024];
-            snprintf(absolute_uri, sizeof(absolute_uri), "%s%s", dir, uri);
-            ReadFileResult buf_file = read_file(scratch.arena, absolute_uri);
+            u32* src = chain;
+            u32 width = image->width;
+            u32 height = image->height;
+
+            for (u32 i = 0; i < image->mip_count; ++i) {
+                for (u32 y = 0; y < height; ++y) {
+                    memcpy((u8*)image->data + layout.level_offsets[i] + (u64)y * layout.row_pitches[i], src, width * sizeof(u32));
+                    src += width;
+                }
 
-            assert(buf_file.size == buf->len);
-            buf->memory = buf_file.memory;
+                width = width > 1 ? width / 2 : 1;
+                height = height > 1 ? height / 2 : 1;
+            }
+        }
+    }
+    else if (compress) {
+        image->data = page_alloc(gltf_image_size(image));
+
+        f32 compress_start = engine_time();
+        bc_compress_chain(0, image->format, options->texture_quality, image->width, image->height, image->mip_count, chain, image->data, 0);
+        image->compress_seconds = engine_time() - compress_start;
+
+        if (options->report_texture_psnr) {
+            image->psnr = bc_psnr(image->format, image->width, image->height, chain, image->data);
+        }
+    }
+    else if (chain == decoded) {
+        image->data = page_alloc(chain_size);
+        memcpy(image->data, decoded, chain_size);
+    }
+    else {
+        image->data = chain;
+    }
+
+    if (chain != decoded && chain != image->data) {
+        page_free(chain);
+    }
+
+    stbi_image_free(decoded);
+}
+
+internal void add_gltf_texture_stats(GLTFTextureStats* stats, GLTFDecodedImage* image) {
+    ++stats->num_decoded;
+    stats->num_mip_levels += image->mip_count - 1;
+    stats->mip_seconds += image->mip_seconds;
+    stats->texture_bytes += gltf_image_size(image);
+
+    if (image->format == TEXTURE_FORMAT_RGBA8) {
+        return;
+    }
+
+    ++stats->num_compressed;
+    stats->compress_seconds += image->compress_seconds;
+
+    if (image->psnr > 0.0f) {
+        if (stats->num_psnr == 0 || image->psnr < stats->min_psnr) {
+            stats->min_psnr = image->psnr;
+        }
+        ++stats->num_psnr;
+
+        if (isinf(image->psnr)) {
+            ++stats->num_lossless;
+        }
+        else {
+            stats->psnr_sum += image->psnr;
         }
     }
+}
+
+// Splits the time spent decoding an image into its stages, and keeps the report's largest textures in order.
+internal void report_gltf_texture(GLTFLoadReport* report, GLTFImage* image, GLTFDecodedImage* decoded, f32 decode_seconds) {
+    ++report->num_textures;
+
+    report->stage_seconds[GLTF_STAGE_IMAGE_DECODE] += decode_seconds - decoded->mip_seconds - decoded->compress_seconds;
+    report->stage_seconds[GLTF_STAGE_MIP_GENERATION] += decoded->mip_seconds;
+    report->stage_seconds[GLTF_STAGE_TEXTURE_COMPRESSION] += decoded->compress_seconds;
+    report->bytes_decoded += (u64)decoded->width * decoded->height * sizeof(u32);
+
+    u64 bytes = gltf_image_size(decoded);
+
+    u32 slot = report->num_top_textures;
+    while (slot > 0 && report->top_textures[slot - 1].bytes < bytes) {
+        --slot;
+    }
+
+    if (slot == GLTF_REPORT_TOP_COUNT) {
+        return;
+    }
+
+    if (report->num_top_textures < GLTF_REPORT_TOP_COUNT) {
+        ++report->num_top_textures;
+    }
+
+    memmove(&report->top_textures[slot + 1], &report->top_textures[slot], (report->num_top_textures - 1 - slot) * sizeof(GLTFReportTexture));
+
+    GLTFReportTexture* entry = &report->top_textures[slot];
+    memcpy(entry->name, image->name, sizeof(entry->name));
+    entry->bytes = bytes;
+    entry->width = decoded->width;
+    entry->height = decoded->height;
+    entry->mip_count = decoded->mip_count;
+    entry->format = decoded->format;
+}
+
+internal char* texture_format_name(TextureFormat format) {
+    switch (format) {
+        case TEXTURE_FORMAT_BC1:
+            return "BC1";
+        case TEXTURE_FORMAT_BC3:
+            return "BC3";
+        case TEXTURE_FORMAT_BC5:
+            return "BC5";
+        case TEXTURE_FORMAT_BC7:
+            return "BC7";
+        default:
+            return "RGBA8";
+    }
+}
+
+void log_gltf_texture_stats(GLTFLoadOptions* options, u32 num_materials, GLTFTextureStats* stats) {
+    debug_message("Loaded %u materials (%u images decoded, %u shared through the texture cache, %.1f MB of textures).\n",
+        num_materials, stats->num_decoded, stats->num_shared, stats->texture_bytes / (1024.0f * 1024.0f));
+
+    if (options->generate_mips && stats->num_decoded > 0) {
+        debug_message("Mips: %u levels generated with the %s filter in %.1f ms.\n",
+            stats->num_mip_levels, options->mip_filter == MIP_FILTER_KAISER ? "Kaiser" : "box", stats->mip_seconds * 1000.0f);
+    }
+
+    if (options->texture_format != TEXTURE_FORMAT_RGBA8 && stats->num_decoded > 0) {
+        debug_message("Compression: %u of %u images encoded as %s in %.1f ms.\n",
+            stats->num_compressed, stats->num_decoded, texture_format_name(options->texture_format), stats->compress_seconds * 1000.0f);
+
+        if (stats->num_psnr > stats->num_lossless) {
+            debug_message("Compression PSNR: %.2f dB mean, %.2f dB worst (%u lossless).\n",
+                stats->psnr_sum / (stats->num_psnr - stats->num_lossless), stats->min_psnr, stats->num_lossless);
+        }
+    }
+}
+
+// Returns the encoded bytes of an image, reading them into arena if the image is an external file or its buffer is
+// deferred.
+internal void* read_image_source(Arena* arena, GLTFImage* image, u64* size, GLTFLoadReport* report) {
+    if (image->uri) {
+        ReadFileResult file = read_gltf_file(arena, image->uri, report);
+        *size = file.size;
+        return file.memory;
+    }
+
+    GLTFBufferView* view = image->view;
+    *size = view->len;
+
+    if (view->buffer->memory) {
+        return (u8*)view->buffer->memory + view->offset;
+    }
+
+    void* memory = arena_push(arena, view->len);
+    if (!read_gltf_buffer_range(view->buffer, view->offset, view->len, memory)) {
+        system_message_box("Failed to read GLTF image '%s'", image->name);
+        assert(false);
+    }
+
+    return memory;
+}
+
+// Returns a referenced material for the image, decoding it only if neither this load nor the cache has seen it.
+Material acquire_image_material(Arena* arena, Renderer* renderer, RendererUploadContext* upload_context, TextureCache* texture_cache, GLTFLoadOptions* options, GLTFImage* image, GLTFTextureStats* stats, GLTFLoadReport* report) {
+    if (image->loaded) {
+        texture_cache_add_ref(texture_cache, image->material);
+        return image->material;
+    }
+
+    Material material;
+
+    if (image->uri && texture_cache_acquire_uri(texture_cache, image->uri, &material)) {
+        ++stats->num_shared;
+    }
+    else {
+        Scratch scratch = get_scratch(&arena, 1);
+
+        u64 encoded_size = 0;
+        void* encoded_memory = read_image_source(scratch.arena, image, &encoded_size, report);
+
+        TextureContentKey content_key = texture_content_key(encoded_memory, encoded_size);
+
+        if (texture_cache_acquire_content(texture_cache, image->uri, &content_key, &material)) {
+            ++stats->num_shared;
+        }
+        else {
+            GLTFUploadTarget target = { renderer, upload_context };
+
+            f32 decode_start = engine_time();
+            GLTFDecodedImage decoded;
+            decode_gltf_image(options, &target, encoded_memory, encoded_size, &decoded);
+            f32 decode_seconds = engine_time() - decode_start;
+
+            f32 upload_start = engine_time();
+            MaterialCreateInfo material_info = gltf_image_material_info(&decoded);
+            material = renderer_new_material(renderer, upload_context, &material_info);
+            add_gltf_stage_time(report, GLTF_STAGE_UPLOAD_RECORDING, upload_start);
+
+            texture_cache_insert(texture_cache, image->uri, &content_key, material);
+
+            add_gltf_texture_stats(stats, &decoded);
+            if (report) {
+                report_gltf_texture(report, image, &decoded, decode_seconds);
+            }
+            free_gltf_image(&decoded);
+        }
+
+        release_scratch(scratch);
+    }
+
+    image->loaded = true;
+    image->material = material;
+
+    return material;
+}
+
+// Decodes the image into a texture of the streamer's, which copies the chain. Streamed textures don't go through
+// the texture cache, as their materials are replaced while they stream.
+StreamedTexture stream_gltf_image(Arena* arena, TextureStreamer* streamer, GLTFLoadOptions* options, GLTFImage* image, GLTFTextureStats* stats) {
+    Scratch scratch = get_scratch(&arena, 1);
+
+    u64 encoded_size = 0;
+    void* encoded_memory = read_image_source(scratch.arena, image, &encoded_size, 0);
+
+    GLTFUploadTarget target = {};
+    GLTFDecodedImage decoded;
+    decode_gltf_image(options, &target, encoded_memory, encoded_size, &decoded);
+
+    MaterialCreateInfo material_info = gltf_image_material_info(&decoded);
+    StreamedTexture texture = texture_streamer_add(streamer, &material_info);
 
-    LoadGLTFResult result = process_gltf(arena, renderer, upload_context, dir, root, buffers, num_buffers);
+    add_gltf_texture_stats(stats, &decoded);
+    free_gltf_image(&decoded);
 
     release_scratch(scratch);
 
-    return result;
-};
+    return texture;
+}
 
-LoadGLTFResult load_gltf(Arena* arena, Renderer* renderer, RendererUploadContext* upload_context, char* path) {
-    char* extension = strrchr(path, '.');
-    assert(extension);
-    
-    if (strcmp(extension, ".gltf") == 0) {
-        return load_gltf_gltf(arena, renderer, upload_context, path);
+internal void collect_gltf_instances(GLTFScene* scene, GLTFNode* nodes, bool* visited, u32 node_index) {
+    if (visited[node_index]) {
+        return;
     }
 
-    if (strcmp(extension, ".glb") == 0) {
-        return load_gltf_glb(arena, renderer, upload_context, path);
+    visited[node_index] = true;
+    GLTFNode* node = &nodes[node_index];
+
+    if (node->mesh) {
+        for (u32 i = 0; i < node->mesh->num_primitives; ++i)
+        {
+            GLTFPrimitive* prim = &node->mesh->primitives[i];
+
+            GLTFSceneInstance* instance = &scene->instances[scene->num_instances++];
+            instance->node = node_index;
+            instance->geometry = prim->geometry;
+            instance->material = prim->material;
+            instance->first_transform = node->first_transform;
+            instance->num_transforms = node->num_transforms;
+
+            if (node->num_transforms > 0) {
+                ++scene->num_batched_instances;
+            }
+
+            if (node->skin != GLTF_NO_SKIN && scene->geometries[prim->geometry].joints && scene->geometry_skins[prim->geometry] == GLTF_NO_SKIN) {
+                scene->geometry_skins[prim->geometry] = node->skin;
+            }
+        }
     }
 
-    system_message_box("Invalid GLTF file:\n'%s'", path);
+    for (u32 i = 0; i < node->num_children; ++i) {
+        collect_gltf_instances(scene, nodes, visited, node->children[i]);
+    }
+}
 
-    return {};
-};
+// The scene is pushed to arena. Geometries keep pointing into the document's buffers.
+void parse_gltf_scene(Arena* arena, GLTFDocument* doc, GLTFScene* scene) {
+    Scratch scratch = get_scratch(&arena, 1);
+
+    Json* root = doc->root;
+    *scene = {};
+
+    Json* asset_views = json_query(root, "bufferViews");
+    GLTFBufferView* views = arena_push_array(arena, GLTFBufferView, json_len(asset_views));
+    u32 num_views = 0;
+
+    JSON_FOREACH(asset_views, asset_view) {
+        GLTFBuffer* decoded = &doc->decoded_views[num_views];
+        GLTFCompressedView* compressed = &doc->compressed_views[num_views];
+        GLTFBufferView* view = &views[num_views++];
+
+        u32 buffer_index = (u32)json_query(asset_view, "buffer")->integer;
+        assert(buffer_index < doc->num_buffers);
+        view->buffer = &doc->buffers[buffer_index];
+
+        view->len = json_query(asset_view, "byteLength")->integer;
+        Json* j_offset = json_query(asset_view, "byteOffset");
+        if (j_offset) {
+            view->offset = j_offset->integer;
+        }
+        else {
+            view->offset = 0;
+        }
+
+        Json* j_stride = json_query(asset_view, "byteStride");
+        view->stride = j_stride ? j_stride->integer : 0;
+        view->compression = 0;
+
+        if (decoded->memory) {
+            view->buffer = decoded;
+            view->len = decoded->len;
+            view->offset = 0;
+        }
+        else if (doc->deferred && compressed->buffer) {
+            view->compression = compressed;
+            view->len = (u64)compressed->count * compressed->stride;
+            view->offset = 0;
+        }
+    }
+
+    Json* asset_accessors = json_query(root, "accessors");
+    GLTFAccessor* accessors = arena_push_array(arena, GLTFAccessor, json_len(asset_accessors));
+    u32 num_accessors = 0;
+
+    JSON_FOREACH(asset_accessors, asset_accessor) {
+        GLTFAccessor* accessor = &accessors[num_accessors++];
+
+        u32 view_index = (u32)json_query(asset_accessor, "bufferView")->integer;
+        assert(view_index < num_views);
+        accessor->view = &views[view_index];
+
+        Json* j_offset = json_query(asset_accessor, "byteOffset");
+        if (j_offset) {
+            accessor->offset = j_offset->integer;
+        }
+        else {
+            accessor->offset = 0;
+        }
+
+        accessor->type = (GLTFType)json_query(asset_accessor, "componentType")->integer;
+        accessor->count = (u32)json_query(asset_accessor, "count")->integer;
+
+        Json* j_normalized = json_query(asset_accessor, "normalized");
+        accessor->normalized = j_normalized && j_normalized->boolean;
+
+        char* component_count = json_query(asset_accessor, "type")->string;
+
+        if (strcmp(component_count, "SCALAR") == 0) {
+            accessor->component_count = 1;
+        }
+        else if (strcmp(component_count, "VEC2") == 0) {
+            accessor->component_count = 2;
+        }
+        else if (strcmp(component_count, "VEC3") == 0) {
+            accessor->component_count = 3;
+        }
+        else if (strcmp(component_count, "VEC4") == 0) {
+            accessor->component_count = 4;
+        }
+        else if (strcmp(component_count, "MAT4") == 0) {
+            accessor->component_count = 16;
+        }
+        else {
+            assert(false);
+        }
+
+        // Worlds bound their geometries with these, instead of reading every position when they're opened.
+        Json* j_min = json_query(asset_accessor, "min");
+        Json* j_max = json_query(asset_accessor, "max");
+        accessor->has_bounds = j_min && j_max && accessor->component_count == 3 && !accessor->normalized;
+
+        if (accessor->has_bounds) {
+            XMStoreFloat3(&accessor->min, extract_json_vector(j_min));
+            XMStoreFloat3(&accessor->max, extract_json_vector(j_max));
+        }
+    }
+
+#if !IGNORE_MATERIALS
+
+    // Images are only resolved to source locations here. Decoding is deferred until a material
+    // references them, and goes through the texture cache so every distinct image is decoded once.
+
+    Json* asset_images = json_query(root, "images");
+    if (asset_images) {
+        scene->images = arena_push_array_zero(arena, GLTFImage, json_len(asset_images));
+
+        JSON_FOREACH(asset_images, asset_image) {
+            GLTFImage* image = &scene->images[scene->num_images++];
+
+            Json* j_name = json_query(asset_image, "name");
+            Json* j_uri = json_query(asset_image, "uri");
+
+            if (j_name || j_uri) {
+                snprintf(image->name, sizeof(image->name), "%s", j_name ? j_name->string : j_uri->string);
+            }
+            else {
+                snprintf(image->name, sizeof(image->name), "image %u", scene->num_images - 1);
+            }
+
+            if (j_uri) {
+                u64 uri_size = strlen(doc->dir) + strlen(j_uri->string) + 1;
+                image->uri = (char*)arena_push(arena, uri_size);
+                sprintf_s(image->uri, uri_size, "%s%s", doc->dir, j_uri->string);
+            }
+            else if(Json* bufferView = json_query(asset_image, "bufferView")) {
+                assert(bufferView->integer < num_views);
+                image->view = &views[bufferView->integer];
+            }
+            else {
+                assert(false);
+            }
+        }
+    }
+
+    u32* texture_images = 0;
+    u32 num_textures = 0;
+
+    Json* asset_textures = json_query(root, "textures");
+    if (asset_textures) {
+        texture_images = arena_push_array(scratch.arena, u32, json_len(asset_textures));
+
+        JSON_FOREACH(asset_textures, asset_texture) {
+            i64 index = json_query(asset_texture, "source")->integer;
+            assert(index < (i64)scene->num_images);
+            texture_images[num_textures++] = (u32)index;
+        }
+    }
+
+    Json* asset_materials = json_query(root, "materials");
+    if (asset_materials) {
+        scene->material_images = arena_push_array(arena, u32, json_len(asset_materials));
+
+        JSON_FOREACH(asset_materials, asset_material) {
+            u64 base_color_texture = json_query(json_query(json_query(asset_material, "pbrMetallicRoughness"), "baseColorTexture"), "index")->integer;
+            assert(base_color_texture < num_textures);
+            scene->material_images[scene->num_materials++] = texture_images[base_color_texture];
+        }
+    }
+
+#endif // IF NOT IGNORE_MATERIALS
+
+    Json* asset_meshes = json_query(root, "meshes");
+    GLTFMesh* meshes = arena_push_array(scratch.arena, GLTFMesh, json_len(asset_meshes));
+    u32 num_meshes = 0;
+
+    u32 max_primitives = 0;
+    JSON_FOREACH(asset_meshes, asset_mesh) {
+        max_primitives += json_len(json_query(asset_mesh, "primitives"));
+    }
+
+    // Primitives are deduplicated first by the accessors they reference, then by the content of
+    // those accessors, so only distinct geometry is processed and uploaded. Deferred documents skip the content
+    // comparison, which would read every geometry.
+
+    scene->geometries = arena_push_array(arena, GLTFGeometry, max_primitives);
+    scene->num_primitives = max_primitives;
+
+    HashMap* geometry_by_accessors = hash_map_new(scratch.arena, max_primitives);
+    HashMap* geometry_by_content = hash_map_new(scratch.arena, max_primitives);
+
+    JSON_FOREACH(asset_meshes, asset_mesh) {
+        GLTFMesh* mesh = &meshes[num_meshes++];
+
+        Json* j_mesh_name = json_query(asset_mesh, "name");
+
+        Json* mesh_primitives = json_query(asset_mesh, "primitives");
+        mesh->num_primitives = json_len(mesh_primitives);
+        mesh->primitives = arena_push_array(scratch.arena, GLTFPrimitive, mesh->num_primitives);
+
+        int primitive_index = 0;
+        JSON_FOREACH(mesh_primitives, primitive) {
+            Json* attributes = json_query(primitive, "attributes");
+            u32 pos_index = (u32)json_query(attributes, "POSITION")->integer;
+            u32 norm_index = (u32)json_query(attributes, "NORMAL")->integer;
+            u32 uv_index = (u32)json_query(attributes, "TEXCOORD_0")->integer;
+            Json* j_indices = json_query(primitive, "indices");
+            u32 indices_index = j_indices ? (u32)j_indices->integer : UINT32_MAX;
+            Json* j_joints = json_query(attributes, "JOINTS_0");
+            Json* j_weights = json_query(attributes, "WEIGHTS_0");
+            u32 joints_index = j_joints && j_weights ? (u32)j_joints->integer : UINT32_MAX;
+            u32 weights_index = j_joints && j_weights ? (u32)j_weights->integer : UINT32_MAX;
+
+            assert(pos_index < num_accessors);
+            assert(norm_index < num_accessors);
+            assert(uv_index < num_accessors);
+            assert(!j_indices || indices_index < num_accessors);
+            assert(joints_index == UINT32_MAX || (joints_index < num_accessors && weights_index < num_accessors));
+
+            GLTFGeometry* geometry = &scene->geometries[scene->num_geometries];
+            if (j_mesh_name) {
+                snprintf(geometry->name, sizeof(geometry->name), "%s[%d]", j_mesh_name->string, primitive_index);
+            }
+            else {
+                snprintf(geometry->name, sizeof(geometry->name), "mesh %u[%d]", num_meshes - 1, primitive_index);
+            }
+            geometry->pos = &accessors[pos_index];
+            geometry->norm = &accessors[norm_index];
+            geometry->uv = &accessors[uv_index];
+            geometry->indices = j_indices ? &accessors[indices_index] : 0;
+            geometry->joints = joints_index != UINT32_MAX ? &accessors[joints_index] : 0;
+            geometry->weights = joints_index != UINT32_MAX ? &accessors[weights_index] : 0;
+
+            assert(geometry->pos->count == geometry->norm->count && geometry->pos->count == geometry->uv->count);
+            assert(geometry->pos->component_count >= 3 && geometry->norm->component_count >= 3 && geometry->uv->component_count >= 2);
+            assert(!geometry->indices || geometry->indices->type == GLTF_UNSIGNED_INT || geometry->indices->type == GLTF_UNSIGNED_SHORT || geometry->indices->type == GLTF_UNSIGNED_BYTE);
+            assert(!geometry->indices || geometry->indices->component_count == 1);
+            assert(!geometry->joints || geometry->joints->count == geometry->pos->count);
+
+            u32 accessor_indices[] = { pos_index, norm_index, uv_index, indices_index, joints_index, weights_index };
+            u64 accessor_key = hash_bytes(accessor_indices, sizeof(accessor_indices), 0);
+
+            u64 existing_index;
+            bool existing = false;
+
+            if (hash_map_get(geometry_by_accessors, accessor_key, &existing_index)) {
+                GLTFGeometry* candidate = &scene->geometries[existing_index];
+                existing = candidate->pos == geometry->pos && candidate->norm == geometry->norm && candidate->uv == geometry->uv && candidate->indices == geometry->indices &&
+                           candidate->joints == geometry->joints && candidate->weights == geometry->weights;
+            }
+
+            u64 content_key = 0;
+
+            if (!existing && !doc->deferred) {
+                content_key = geometry_content_hash(geometry);
+                if (hash_map_get(geometry_by_content, content_key, &existing_index) && geometry_content_equal(&scene->geometries[existing_index], geometry)) {
+                    existing = true;
+                    hash_map_put(geometry_by_accessors, accessor_key, existing_index);
+                }
+            }
+
+            GLTFPrimitive* prim = &mesh->primitives[primitive_index++];
+
+            if (existing) {
+                prim->geometry = (u32)existing_index;
+
+                ++scene->num_deduplicated_primitives;
+                u32 index_count = geometry->indices ? geometry->indices->count : geometry->pos->count;
+                scene->deduplicated_bytes += geometry->pos->count * sizeof(Vertex) + index_count * sizeof(u32);
+            }
+            else {
+                prim->geometry = scene->num_geometries;
+
+                hash_map_put(geometry_by_accessors, accessor_key, scene->num_geometries);
+                if (!doc->deferred) {
+                    hash_map_put(geometry_by_content, content_key, scene->num_geometries);
+                }
+
+                ++scene->num_geometries;
+            }
+
+            prim->material = GLTF_NO_MATERIAL;
+
+            #if !IGNORE_MATERIALS
+                if (Json* material = json_query(primitive, "material")) {
+                    assert(material->integer < scene->num_materials);
+                    prim->material = (u32)material->integer;
+                }
+            #endif
+        }
+    }
+
+    Json* asset_nodes = json_query(root, "nodes");
+    u32 num_nodes = (u32)json_len(asset_nodes);
+    GLTFNode* nodes = arena_push_array(scratch.arena, GLTFNode, num_nodes);
+
+    // Inverse bind matrices are copied out of the document, like animation keys. They default to identity.
+    Json* asset_skins = json_query(root, "skins");
+    scene->num_skins = asset_skins ? json_len(asset_skins) : 0;
+    scene->skins = arena_push_array(arena, Skin, scene->num_skins);
+
+    for (u32 i = 0; i < scene->num_skins; ++i) {
+        Json* asset_skin = json_index(asset_skins, i);
+        Skin* skin = &scene->skins[i];
+
+        Json* joints = json_query(asset_skin, "joints");
+        skin->num_joints = json_len(joints);
+        skin->joint_nodes = arena_push_array(arena, u32, skin->num_joints);
+        skin->inverse_bind_matrices = arena_push_array(arena, XMMATRIX, skin->num_joints);
+
+        u32 joint_index = 0;
+        JSON_FOREACH(joints, joint) {
+            assert(joint->integer < num_nodes);
+            skin->joint_nodes[joint_index++] = (u32)joint->integer;
+        }
+
+        if (Json* inverse_bind_matrices = json_query(asset_skin, "inverseBindMatrices")) {
+            GLTFAccessor* accessor = &accessors[inverse_bind_matrices->integer];
+            assert(accessor->type == GLTF_FLOAT && accessor->component_count == 16 && accessor->count == skin->num_joints);
+            read_accessor_floats(read_gltf_accessor(scratch.arena, accessor), 16, skin->inverse_bind_matrices, sizeof(XMMATRIX));
+        }
+        else {
+            for (u32 j = 0; j < skin->num_joints; ++j) {
+                skin->inverse_bind_matrices[j] = XMMatrixIdentity();
+            }
+        }
+    }
+
+    scene->geometry_skins = arena_push_array(arena, u32, scene->num_geometries);
+    for (u32 i = 0; i < scene->num_geometries; ++i) {
+        scene->geometry_skins[i] = GLTF_NO_SKIN;
+    }
+
+    scene->num_nodes = num_nodes;
+    scene->node_parents = arena_push_array(arena, u32, num_nodes);
+    scene->node_translations = arena_push_array(arena, XMVECTOR, num_nodes);
+    scene->node_rotations = arena_push_array(arena, XMVECTOR, num_nodes);
+    scene->node_scales = arena_push_array(arena, XMVECTOR, num_nodes);
+
+    for (u32 i = 0; i < num_nodes; ++i) {
+        scene->node_parents[i] = SCENE_NO_PARENT;
+    }
+
+    u32 max_instances = 0;
+
+    // Instancing transforms are counted first so they can all share one allocation.
+    JSON_FOREACH(asset_nodes, asset_node) {
+        if (Json* instancing = instancing_attributes(asset_node)) {
+            scene->num_instance_transforms += read_instance_transforms(accessors, instancing, 0);
+        }
+    }
+
+    scene->instance_transforms = arena_push_array(arena, XMFLOAT4X3, scene->num_instance_transforms);
+    u32 instance_transform_cursor = 0;
+
+    u32 node_index = 0;
+    JSON_FOREACH(asset_nodes, asset_node) {
+        GLTFNode* node = &nodes[node_index];
+
+        Json* node_children = json_query(asset_node, "children");
+        if (node_children) {
+            node->num_children = json_len(node_children);
+            node->children = arena_push_array(scratch.arena, u32, node->num_children);
+
+            int child_index = 0;
+            JSON_FOREACH(node_children, child) {
+                assert(child->integer < num_nodes);
+                assert(scene->node_parents[child->integer] == SCENE_NO_PARENT && "GLTF node has several parents");
+                scene->node_parents[child->integer] = node_index;
+                node->children[child_index++] = (u32)child->integer;
+            }
+        }
+        else {
+            node->num_children = 0;
+            node->children = 0;
+        }
+
+        XMVECTOR translation = XMVectorZero();
+        XMVECTOR rotation = XMQuaternionIdentity();
+        XMVECTOR scale = XMVectorSplatOne();
+
+        Json* matrix = json_query(asset_node, "matrix");
+        if (matrix) {
+            assert(json_len(matrix) == 16);
+            XMMATRIX transform;
+            f32* matrix_element = (f32*)&transform;
+            JSON_FOREACH(matrix, el) {
+                switch (el->type) {
+                    case JSON_REAL:
+                        *(matrix_element++) = (f32)el->real;
+                        break;
+                    case JSON_INTEGER:
+                        *(matrix_element++) = (f32)el->integer;
+                        break;
+                    default:
+                        assert(false);
+                        break;
+                }
+            }
+
+            // The hierarchy stores TRS, so matrices with shear lose it.
+            bool decomposed = XMMatrixDecompose(&scale, &rotation, &translation, transform);
+            assert(decomposed && "GLTF node matrix can't be decomposed");
+            UNUSED(decomposed);
+        }
+        else {
+            if (Json* scaling = json_query(asset_node, "scale")) {
+                scale = extract_json_vector(scaling);
+            }
+
+            if (Json* node_rotation = json_query(asset_node, "rotation")) {
+                rotation = extract_json_vector(node_rotation);
+            }
+
+            if (Json* node_translation = json_query(asset_node, "translation")) {
+                translation = extract_json_vector(node_translation);
+            }
+        }
+
+        scene->node_translations[node_index] = translation;
+        scene->node_rotations[node_index] = rotation;
+        scene->node_scales[node_index] = scale;
+
+        Json* mesh = json_query(asset_node, "mesh");
+        if (mesh) {
+            assert(mesh->integer < num_meshes);
+            node->mesh = &meshes[mesh->integer];
+            max_instances += node->mesh->num_primitives;
+        }
+        else {
+            node->mesh = 0;
+        }
+
+        node->skin = GLTF_NO_SKIN;
+        if (Json* skin = json_query(asset_node, "skin")) {
+            assert(skin->integer < scene->num_skins);
+            node->skin = (u32)skin->integer;
+        }
+
+        node->first_transform = instance_transform_cursor;
+        node->num_transforms = 0;
+        if (Json* instancing = instancing_attributes(asset_node)) {
+            node->num_transforms = read_instance_transforms(accessors, instancing, scene->instance_transforms + instance_transform_cursor);
+            instance_transform_cursor += node->num_transforms;
+        }
+
+        ++node_index;
+    }
+
+    // Each node is instanced once, even when several scenes list it.
+    scene->instances = arena_push_array(arena, GLTFSceneInstance, max_instances);
+    bool* visited = arena_push_array_zero(scratch.arena, bool, num_nodes);
+
+    JSON_FOREACH(json_query(root, "scenes"), asset_scene) {
+        JSON_FOREACH(json_query(asset_scene, "nodes"), node) {
+            assert(node->integer < num_nodes);
+            collect_gltf_instances(scene, nodes, visited, (u32)node->integer);
+        }
+    }
+
+    // Keys are copied out of the document, which the background loader frees before the clips are created.
+    // Morph target weights aren't supported, so their channels are skipped.
+    Json* asset_animations = json_query(root, "animations");
+    scene->num_animations = asset_animations ? json_len(asset_animations) : 0;
+    scene->animations = arena_push_array_zero(arena, GLTFAnimation, scene->num_animations);
+
+    for (u32 i = 0; i < scene->num_animations; ++i) {
+        Json* asset_animation = json_index(asset_animations, i);
+        GLTFAnimation* animation = &scene->animations[i];
+
+        Json* channels = json_query(asset_animation, "channels");
+        Json* samplers = json_query(asset_animation, "samplers");
+
+        u32 num_samplers = json_len(samplers);
+        Json** sampler_list = arena_push_array(scratch.arena, Json*, num_samplers);
+
+        u32 sampler_index = 0;
+        JSON_FOREACH(samplers, sampler) {
+            sampler_list[sampler_index++] = sampler;
+        }
+
+        animation->tracks = arena_push_array(arena, AnimationTrackDesc, json_len(channels));
+
+        JSON_FOREACH(channels, channel) {
+            Json* target = json_query(channel, "target");
+            Json* target_node = json_query(target, "node");
+            char* path = json_query(target, "path")->string;
+
+            if (!target_node || strcmp(path, "weights") == 0) {
+                continue;
+            }
+
+            AnimationTrackDesc* track = &animation->tracks[animation->num_tracks++];
+
+            assert(target_node->integer < num_nodes);
+            track->node = (u32)target_node->integer;
+
+            if (strcmp(path, "translation") == 0) {
+                track->path = ANIMATION_PATH_TRANSLATION;
+            }
+            else if (strcmp(path, "rotation") == 0) {
+                track->path = ANIMATION_PATH_ROTATION;
+            }
+            else {
+                assert(strcmp(path, "scale") == 0);
+                track->path = ANIMATION_PATH_SCALE;
+            }
+
+            u32 channel_sampler = (u32)json_query(channel, "sampler")->integer;
+            assert(channel_sampler < num_samplers);
+            Json* sampler = sampler_list[channel_sampler];
+
+            track->interpolation = ANIMATION_INTERPOLATION_LINEAR;
+
+            if (Json* interpolation = json_query(sampler, "interpolation")) {
+                if (strcmp(interpolation->string, "STEP") == 0) {
+                    track->interpolation = ANIMATION_INTERPOLATION_STEP;
+                }
+                else if (strcmp(interpolation->string, "CUBICSPLINE") == 0) {
+                    track->interpolation = ANIMATION_INTERPOLATION_CUBIC_SPLINE;
+                }
+            }
+
+            GLTFAccessor* input = read_gltf_accessor(scratch.arena, &accessors[json_query(sampler, "input")->integer]);
+            GLTFAccessor* output = read_gltf_accessor(scratch.arena, &accessors[json_query(sampler, "output")->integer]);
+            assert(input->type == GLTF_FLOAT && input->component_count == 1);
+
+            track->key_count = input->count;
+            track->times = arena_push_array(arena, f32, input->count);
+            read_accessor_floats(input, 1, track->times, sizeof(f32));
+
+            u32 values_per_key = track->interpolation == ANIMATION_INTERPOLATION_CUBIC_SPLINE ? 3 : 1;
+            assert(output->count == input->count * values_per_key);
+            track->values = read_accessor_vectors(arena, output);
+        }
+    }
+
+    release_scratch(scratch);
+}
+
+// Clips go to arena, with their tracks retargeted from GLTF nodes to scene graph nodes.
+internal AnimationClip** create_gltf_animations(Arena* arena, GLTFScene* scene, u32* node_map) {
+    AnimationClip** animations = arena_push_array(arena, AnimationClip*, scene->num_animations);
+
+    for (u32 i = 0; i < scene->num_animations; ++i) {
+        GLTFAnimation* animation = &scene->animations[i];
+
+        for (u32 j = 0; j < animation->num_tracks; ++j) {
+            animation->tracks[j].node = node_map[animation->tracks[j].node];
+        }
+
+        animations[i] = animation_clip_new(arena, animation->num_tracks, animation->tracks);
+    }
+
+    return animations;
+}
+
+// Skins go to arena, with their joints retargeted from GLTF nodes to scene graph nodes.
+internal Skin* create_gltf_skins(Arena* arena, GLTFScene* scene, u32* node_map) {
+    Skin* skins = arena_push_array(arena, Skin, scene->num_skins);
+
+    for (u32 i = 0; i < scene->num_skins; ++i) {
+        Skin* src = &scene->skins[i];
+        Skin* skin = &skins[i];
+
+        skin->num_joints = src->num_joints;
+        skin->joint_nodes = arena_push_array(arena, u32, src->num_joints);
+        skin->inverse_bind_matrices = arena_push_array(arena, XMMATRIX, src->num_joints);
+        memcpy(skin->inverse_bind_matrices, src->inverse_bind_matrices, src->num_joints * sizeof(XMMATRIX));
+
+        for (u32 j = 0; j < src->num_joints; ++j) {
+            skin->joint_nodes[j] = node_map[src->joint_nodes[j]];
+        }
+    }
+
+    return skins;
+}
+
+// Posed meshes are relative to the graph root (see build_joint_palette), so their instances follow it.
+u32 gltf_instance_graph_node(GLTFScene* scene, GLTFSceneInstance* instance, u32* node_map) {
+    return scene->geometry_skins[instance->geometry] != GLTF_NO_SKIN ? SCENE_GRAPH_ROOT : node_map[instance->node];
+}
+
+// The result keeps its own copy of the instancing transforms, as the scene is freed once loading finishes.
+internal XMFLOAT4X3* copy_instance_transforms(Arena* arena, GLTFScene* scene) {
+    XMFLOAT4X3* transforms = arena_push_array(arena, XMFLOAT4X3, scene->num_instance_transforms);
+    if (transforms) { memcpy(transforms, scene->instance_transforms, scene->num_instance_transforms * sizeof(XMFLOAT4X3)); }
+    return transforms;
+}
+
+internal void append_gltf_instance_batch(Arena* arena, LoadGLTFResult* result, GLTFSceneInstance* src, u32 node, Mesh mesh, Material material) {
+    result->instance_batch_nodes[result->num_instance_batches] = node;
+    result->instance_batch_materials[result->num_instance_batches] = src->material;
+
+    MeshInstanceBatch* batch = &result->instance_batches[result->num_instance_batches++];
+    batch->mesh = mesh;
+    batch->material = material;
+    batch->transform = result->scene_graph->world_transforms[node];
+    batch->num_instances = src->num_transforms;
+    batch->local_transforms = result->instance_transforms + src->first_transform;
+    batch->lods = arena_push_array_zero(arena, u8, src->num_transforms);
+}
+
+internal SkinnedMesh gltf_skinned_mesh(Mesh mesh, Skin* skin, SkinnedVertices* skin_vertices) {
+    assert(skin_vertices->joint_count <= skin->num_joints);
+
+    SkinnedMesh skinned_mesh;
+    skinned_mesh.mesh = mesh;
+    skinned_mesh.skin = skin;
+    skinned_mesh.vertices = skin_vertices;
+
+    return skinned_mesh;
+}
+
+// The most a load pushes to its result arena, worked out from the parsed scene. Meshlets are the only part that
+// depends on the meshes as they're built, and meshlet_count_bound covers them.
+internal u64 gltf_result_size(GLTFScene* scene, GLTFLoadOptions* options) {
+    u32 num_instances = scene->num_instances - scene->num_batched_instances;
+
+    u64 size = arena_array_size(Material, scene->num_materials);
+    size += arena_array_size(Mesh, scene->num_geometries) + arena_array_size(GLTFMeshInfo, scene->num_geometries);
+    size += arena_array_size(MeshInstance, num_instances) + 2 * arena_array_size(u32, num_instances);
+    size += arena_array_size(MeshInstanceBatch, scene->num_batched_instances) + 2 * arena_array_size(u32, scene->num_batched_instances);
+    size += arena_array_size(XMFLOAT4X3, scene->num_instance_transforms);
+    size += arena_array_size(SkinnedMesh, scene->num_geometries);
+
+    for (u32 i = 0; i < scene->num_instances; ++i) {
+        size += arena_array_size(u8, scene->instances[i].num_transforms);
+    }
+
+    if (options->lazy_materials) {
+        size += lazy_gltf_materials_size(scene);
+    }
+
+    size += scene_graph_size(scene->num_nodes);
+
+    size += arena_array_size(AnimationClip*, scene->num_animations);
+    for (u32 i = 0; i < scene->num_animations; ++i) {
+        size += animation_clip_size(scene->animations[i].num_tracks, scene->animations[i].tracks);
+    }
+
+    size += arena_array_size(Skin, scene->num_skins);
+    for (u32 i = 0; i < scene->num_skins; ++i) {
+        size += arena_array_size(u32, scene->skins[i].num_joints) + arena_array_size(XMMATRIX, scene->skins[i].num_joints);
+    }
+
+    for (u32 i = 0; i < scene->num_geometries; ++i) {
+        GLTFGeometry* geometry = &scene->geometries[i];
+
+        if (options->build_meshlets) {
+            u32 index_count = geometry->indices ? geometry->indices->count : geometry->pos->count;
+            size += arena_array_size(Meshlet, meshlet_count_bound(index_count, options->meshlet_max_vertices, options->meshlet_max_triangles));
+        }
+
+        // Skinned vertices are never welded or reordered, so there are as many as the accessors hold.
+        if (geometry->joints) {
+            size += arena_array_size(SkinnedVertices, 1);
+            size += arena_array_size(Vertex, geometry->pos->count) + arena_array_size(SkinInfluence, geometry->joints->count);
+        }
+    }
+
+    return size;
+}
+
+// A page allocation of gltf_result_size for the result, which holds its own arena so the result's lazy materials
+// can keep pointing at it.
+internal Arena* new_gltf_result_arena(GLTFScene* scene, GLTFLoadOptions* options, LoadGLTFResult* result) {
+    u64 size = arena_array_size(Arena, 1) + gltf_result_size(scene, options);
+
+    result->memory = page_alloc(size);
+
+    Arena arena = arena_init(result->memory, size);
+    Arena* result_arena = arena_push_struct(&arena, Arena);
+    *result_arena = arena;
+
+    return result_arena;
+}
+
+void gltf_free_result(LoadGLTFResult* result) {
+    if (result->memory) {
+        page_free(result->memory);
+        result->memory = 0;
+    }
+}
+
+// Upload memory written since start, split into bytes create calls had to copy and bytes the loader wrote in place.
+internal void log_gltf_upload_stats(Renderer* renderer, RendererUploadStats* start) {
+    RendererUploadStats end = renderer_upload_stats(renderer);
+    debug_message("Uploads: %.1f MB copied into upload memory, %.1f MB written there in place.\n",
+        (end.bytes_copied - start->bytes_copied) / (1024.0f * 1024.0f), (end.bytes_in_place - start->bytes_in_place) / (1024.0f * 1024.0f));
+}
+
+internal void log_gltf_mesh_stats(GLTFLoadOptions* options, GLTFScene* scene, GLTFMeshStats* mesh_stats) {
+    if (scene->num_deduplicated_primitives > 0) {
+        debug_message("Deduplicated %u of %u primitives (%llu KB of geometry not uploaded).\n", scene->num_deduplicated_primitives, scene->num_primitives, scene->deduplicated_bytes / 1024);
+    }
+
+    if (options->weld_vertices) {
+        debug_message("Welded %llu vertices down to %llu.\n", mesh_stats->vertices_before_weld, mesh_stats->vertices_after_weld);
+    }
+
+    if (mesh_stats->cache_before.triangle_count > 0) {
+        debug_message("Vertex cache (FIFO %d): ACMR %.3f -> %.3f, ATVR %.3f -> %.3f.\n", VERTEX_CACHE_SIZE,
+            mesh_stats->cache_before.acmr, mesh_stats->cache_after.acmr, mesh_stats->cache_before.atvr, mesh_stats->cache_after.atvr);
+    }
+
+    if (mesh_stats->meshlet_count > 0) {
+        debug_message("Built %llu meshlets (%.1f vertices, %.1f triangles on average).\n", mesh_stats->meshlet_count,
+            (f64)mesh_stats->meshlet_vertices / mesh_stats->meshlet_count, (f64)mesh_stats->meshlet_triangles / mesh_stats->meshlet_count);
+    }
+
+    if (options->generate_lods) {
+        debug_message("LOD triangles: %llu, %llu, %llu, %llu, %llu.\n", mesh_stats->lod_triangles[0], mesh_stats->lod_triangles[1],
+            mesh_stats->lod_triangles[2], mesh_stats->lod_triangles[3], mesh_stats->lod_triangles[4]);
+    }
+
+    debug_message("Indices: %llu KB uploaded (%llu KB saved by 16-bit indices).\n",
+        mesh_stats->index_bytes_uploaded / 1024, (mesh_stats->index_bytes_u32 - mesh_stats->index_bytes_uploaded) / 1024);
+
+    if (options->compact_vertices) {
+        debug_message("Compact vertices: %llu KB -> %llu KB.\n", mesh_stats->vertex_bytes / 1024, mesh_stats->compact_vertex_bytes / 1024);
+    }
+}
+
+internal LoadGLTFResult process_gltf(Arena* arena, Renderer* renderer, RendererUploadContext* upload_context, TextureCache* texture_cache, GLTFLoadOptions* options, GLTFDocument* doc, GLTFLoadReport* report) {
+    Scratch scratch = get_scratch(&arena, 1);
+
+    RendererUploadStats upload_start = renderer_upload_stats(renderer);
+
+    f32 parse_start = engine_time();
+    GLTFScene scene;
+    parse_gltf_scene(scratch.arena, doc, &scene);
+    add_gltf_stage_time(report, GLTF_STAGE_SCENE_PARSE, parse_start);
+
+    LoadGLTFResult result = {};
+
+    if (!arena) {
+        arena = new_gltf_result_arena(&scene, options, &result);
+    }
+
+    // Materials will be stored in the output arena because they are returned.
+    // Each entry holds one texture cache reference, even when several entries share a material.
+    // Lazy materials are added as they're created, so none are here yet.
+
+    Material* materials = arena_push_array(arena, Material, scene.num_materials);
+    GLTFTextureStats texture_stats = {};
+
+    if (!options->lazy_materials) {
+        for (u32 i = 0; i < scene.num_materials; ++i) {
+            materials[i] = acquire_image_material(arena, renderer, upload_context, texture_cache, options, &scene.images[scene.material_images[i]], &texture_stats, report);
+        }
+
+        log_gltf_texture_stats(options, scene.num_materials, &texture_stats);
+    }
+
+    // Unique meshes are returned for freeing.
+
+    Mesh* meshes = arena_push_array(arena, Mesh, scene.num_geometries);
+    GLTFMeshInfo* mesh_infos = arena_push_array(arena, GLTFMeshInfo, scene.num_geometries);
+    GLTFMeshStats mesh_stats = {};
+
+    for (u32 i = 0; i < scene.num_geometries; ++i) {
+        meshes[i] = create_geometry_mesh(arena, renderer, upload_context, options, &scene.geometries[i], &mesh_stats, &mesh_infos[i], report);
+    }
+
+    log_gltf_mesh_stats(options, &scene, &mesh_stats);
+    log_gltf_upload_stats(renderer, &upload_start);
+
+    if (report) {
+        RendererUploadStats upload_end = renderer_upload_stats(renderer);
+        report->bytes_staged = (upload_end.bytes_copied - upload_start.bytes_copied) + (upload_end.bytes_in_place - upload_start.bytes_in_place);
+        report->bytes_staged_in_place = upload_end.bytes_in_place - upload_start.bytes_in_place;
+    }
+
+    result.num_materials = options->lazy_materials ? 0 : scene.num_materials;
+    result.materials = materials;
+    result.num_meshes = scene.num_geometries;
+    result.meshes = meshes;
+    result.mesh_infos = mesh_infos;
+    result.num_instances = 0;
+    result.instances = arena_push_array_zero(arena, MeshInstance, scene.num_instances - scene.num_batched_instances);
+    result.instance_nodes = arena_push_array(arena, u32, scene.num_instances - scene.num_batched_instances);
+    result.instance_materials = arena_push_array(arena, u32, scene.num_instances - scene.num_batched_instances);
+    result.num_instance_batches = 0;
+    result.instance_batches = arena_push_array(arena, MeshInstanceBatch, scene.num_batched_instances);
+    result.instance_batch_nodes = arena_push_array(arena, u32, scene.num_batched_instances);
+    result.instance_batch_materials = arena_push_array(arena, u32, scene.num_batched_instances);
+    result.instance_transforms = copy_instance_transforms(arena, &scene);
+    result.lazy_materials = options->lazy_materials ? build_lazy_gltf_materials(arena, texture_cache, options, &scene, &result) : 0;
+
+    u32* node_map = arena_push_array(scratch.arena, u32, scene.num_nodes);
+    result.scene_graph = scene_graph_new(arena, scene.num_nodes, scene.node_parents, scene.node_translations, scene.node_rotations, scene.node_scales, node_map);
+    result.num_animations = scene.num_animations;
+    result.animations = create_gltf_animations(arena, &scene, node_map);
+    result.num_skins = scene.num_skins;
+    result.skins = create_gltf_skins(arena, &scene, node_map);
+    result.num_skinned_meshes = 0;
+    result.skinned_meshes = arena_push_array(arena, SkinnedMesh, scene.num_geometries);
+
+    for (u32 i = 0; i < scene.num_geometries; ++i) {
+        if (scene.geometry_skins[i] != GLTF_NO_SKIN) {
+            result.skinned_meshes[result.num_skinned_meshes++] = gltf_skinned_mesh(meshes[i], &result.skins[scene.geometry_skins[i]], mesh_infos[i].skin_vertices);
+        }
+    }
+
+    for (u32 i = 0; i < scene.num_instances; ++i) {
+        GLTFSceneInstance* src = &scene.instances[i];
+        u32 node = gltf_instance_graph_node(&scene, src, node_map);
+
+        Mesh mesh = meshes[src->geometry];
+        Material material;
+
+        if (result.lazy_materials) {
+            material = lazy_gltf_material(renderer, result.lazy_materials, src->material);
+        }
+        else {
+            material = src->material == GLTF_NO_MATERIAL ? renderer_get_default_material(renderer) : materials[src->material];
+        }
+
+        if (src->num_transforms > 0) {
+            append_gltf_instance_batch(arena, &result, src, node, mesh, material);
+            continue;
+        }
+
+        MeshInstance* instance = &result.instances[result.num_instances];
+        instance->mesh = mesh;
+        instance->material = material;
+        instance->transform = result.scene_graph->world_transforms[node];
+        result.instance_nodes[result.num_instances] = node;
+        result.instance_materials[result.num_instances++] = src->material;
+    }
+
+    release_scratch(scratch);
+
+    return result;
+}
+
+internal void get_directory(char* path, char* buf, u64 buf_size) {
+    {
+        strcpy_s(buf, buf_size, path);
+
+        for (char* c = buf; *c; ++c) {
+            if (*c == '\\') {
+                *c = '/';
+            }
+        }
+
+        char* last_slash = strrchr(buf, '/');
+        if (last_slash) {
+            last_slash[1] = '\0';
+        }
+        else {
+            buf[0] = '\0';
+        }
+    }
+}
+
+// A buffer's data is embedded base64, a file next to the document, the GLB binary chunk (the first buffer, if it
+// has no uri) or absent, in which case its memory stays null. Deferred documents open files instead of reading them.
+internal GLTFBuffer* read_gltf_buffers(Arena* arena, char* path, GLTFDocument* doc, Json* asset_buffers, GLTFBuffer* glb_chunk, GLTFLoadReport* report) {
+    GLTFBuffer* buffers = arena_push_array_zero(arena, GLTFBuffer, json_len(asset_buffers));
+    u32 num_buffers = 0;
+
+    JSON_FOREACH(asset_buffers, src_buf) {
+        GLTFBuffer* buf = &buffers[num_buffers++];
+        buf->len = json_query(src_buf, "byteLength")->integer;
+
+        char* base64_header = "data:application/octet-stream;base64,";
+        Json* uri_json = json_query(src_buf, "uri");
+        u64 header_len = strlen(base64_header);
+
+        if (!uri_json) {
+            if (num_buffers == 1 && glb_chunk) {
+                assert(glb_chunk->len >= buf->len);
+                buf->memory = glb_chunk->memory;
+                buf->file = glb_chunk->file;
+                buf->file_offset = glb_chunk->file_offset;
+            }
+        }
+        else if (strncmp(uri_json->string, base64_header, header_len) == 0) {
+            buf->memory = arena_push(arena, buf->len);
+
+            f32 decode_start = engine_time();
+            u64 decoded_size = 0;
+            if (!base64_decode(buf->memory, buf->len, uri_json->string + header_len, uri_json->string_len - header_len, &decoded_size) || decoded_size != buf->len) {
+                system_message_box("Malformed base64 buffer in '%s'", path);
+                assert(false);
+            }
+            add_gltf_stage_time(report, GLTF_STAGE_BASE64_DECODE, decode_start);
+
+            if (report) {
+                report->bytes_decoded += decoded_size;
+            }
+        }
+        else {
+            char absolute_uri[1024];
+            snprintf(absolute_uri, sizeof(absolute_uri), "%s%s", doc->dir, uri_json->string);
+
+            if (doc->deferred) {
+                buf->file = file_open(absolute_uri);
+
+                if (buf->file.handle) {
+                    assert(file_size(buf->file) >= buf->len);
+                    continue;
+                }
+            }
+
+            ReadFileResult buf_file = read_gltf_file(arena, absolute_uri, report);
+
+            assert(buf_file.size == buf->len);
+            buf->memory = buf_file.memory;
+        }
+    }
+
+    doc->num_buffers = num_buffers;
+
+    return buffers;
+}
+
+// Reads the file and its buffers into arena.
+internal void read_gltf_glb(Arena* arena, char* path, GLTFDocument* doc, GLTFLoadReport* report) {
+    assert(strcmp(strrchr(path, '.'), ".glb") == 0);
+    ReadFileResult file = read_gltf_file(arena, path, report);
+    u8* file_cursor = (u8*)file.memory;
+    u8* file_end = file_cursor + file.size;
+
+    get_directory(path, doc->dir, sizeof(doc->dir));
+
+    GLBHeader* header = (GLBHeader*)file_cursor;
+    file_cursor += sizeof(*header);
+
+    assert(memcmp(&header->magic, "glTF", 4) == 0);
+    assert(header->version == 2);
+    assert(header->len == file.size);
+
+    #define READ_CHUNK(name) GLBChunk* name = (GLBChunk*)file_cursor; file_cursor += offsetof(GLBChunk, memory) + name->len
+
+    READ_CHUNK(json_chunk);
+    assert(json_chunk->type == GLB_CHUNK_JSON);
+
+    char* json_string = (char*)arena_push(arena, json_chunk->len + 1);
+    memcpy(json_string, json_chunk->memory, json_chunk->len);
+    json_string[json_chunk->len] = '\0';
+
+    GLTFBuffer bin_chunk = {};
+
+    if (file_cursor != file_end) {
+        READ_CHUNK(buf_chunk);
+        assert(buf_chunk->type == GLB_CHUNK_BIN);
+
+        bin_chunk.len = buf_chunk->len;
+        bin_chunk.memory = buf_chunk->memory;
+    }
+
+    #undef READ_CHUNK
+
+    f32 parse_start = engine_time();
+    doc->root = parse_json_string(arena, json_string);
+    add_gltf_stage_time(report, GLTF_STAGE_JSON_PARSE, parse_start);
+
+    Json* asset_buffers = json_query(doc->root, "buffers");
+    if (asset_buffers) {
+        doc->buffers = read_gltf_buffers(arena, path, doc, asset_buffers, bin_chunk.memory ? &bin_chunk : 0, report);
+    }
+    else {
+        doc->num_buffers = 0;
+        doc->buffers = 0;
+    }
+}
+
+// Reads the header and JSON chunk only, leaving the binary chunk in the file.
+internal void read_gltf_glb_deferred(Arena* arena, char* path, GLTFDocument* doc) {
+    assert(strcmp(strrchr(path, '.'), ".glb") == 0);
+    File file = file_open(path);
+
+    if (!file.handle) {
+        read_gltf_glb(arena, path, doc, 0);
+        return;
+    }
+
+    get_directory(path, doc->dir, sizeof(doc->dir));
+
+    GLBHeader header;
+    u32 json_chunk[2];
+    bool read = file_read(file, 0, &header, sizeof(header)) && file_read(file, sizeof(header), json_chunk, sizeof(json_chunk));
+
+    assert(read && memcmp(&header.magic, "glTF", 4) == 0);
+    assert(header.version == 2);
+    assert(header.len == file_size(file));
+    assert(json_chunk[1] == GLB_CHUNK_JSON);
+
+    u64 json_offset = sizeof(header) + sizeof(json_chunk);
+    char* json_string = (char*)arena_push(arena, json_chunk[0] + 1);
+    read = file_read(file, json_offset, json_string, json_chunk[0]);
+    assert(read);
+    UNUSED(read);
+    json_string[json_chunk[0]] = '\0';
+
+    GLTFBuffer bin_chunk = {};
+    bin_chunk.file = file;
+
+    u64 bin_offset = json_offset + json_chunk[0];
+    u32 bin_header[2];
+
+    if (bin_offset < header.len && file_read(file, bin_offset, bin_header, sizeof(bin_header))) {
+        assert(bin_header[1] == GLB_CHUNK_BIN);
+        bin_chunk.len = bin_header[0];
+        bin_chunk.file_offset = bin_offset + sizeof(bin_header);
+    }
+
+    doc->root = parse_json_string(arena, json_string);
+
+    Json* asset_buffers = json_query(doc->root, "buffers");
+    if (asset_buffers) {
+        doc->buffers = read_gltf_buffers(arena, path, doc, asset_buffers, bin_chunk.len ? &bin_chunk : 0, 0);
+    }
+    else {
+        doc->num_buffers = 0;
+        doc->buffers = 0;
+    }
+
+    // The binary chunk's buffer closes the file along with the rest; without one it's closed here.
+    if (!doc->num_buffers || doc->buffers[0].file.handle != file.handle) {
+        file_close(file);
+    }
+}
+
+// Reads the file and its buffers into arena.
+internal void read_gltf_gltf(Arena* arena, char* path, GLTFDocument* doc, GLTFLoadReport* report) {
+    assert(strcmp(strrchr(path, '.'), ".gltf") == 0);
+    ReadFileResult file = read_gltf_file(arena, path, report);
+
+    f32 parse_start = engine_time();
+    Json* root = parse_json_string(arena, file.memory);
+    add_gltf_stage_time(report, GLTF_STAGE_JSON_PARSE, parse_start);
+
+    get_directory(path, doc->dir, sizeof(doc->dir));
+
+    assert(strcmp(json_query(json_query(root, "asset"), "version")->string, "2.0") == 0 && "Unsupported GLTF version");
+
+    doc->root = root;
+    doc->buffers = read_gltf_buffers(arena, path, doc, json_query(root, "buffers"), 0, report);
+}
+
+// EXT_meshopt_compression views are decoded up front, so everything after this reads them like any other view,
+// already in the layout their accessors describe. Deferred documents only describe them, to decode on demand.
+internal void decode_gltf_meshopt_views(Arena* arena, char* path, GLTFDocument* doc, GLTFLoadReport* report) {
+    Json* asset_views = json_query(doc->root, "bufferViews");
+    if (!asset_views) {
+        doc->compressed_views = 0;
+        doc->decoded_views = 0;
+        return;
+    }
+
+    doc->compressed_views = arena_push_array_zero(arena, GLTFCompressedView, json_len(asset_views));
+    doc->decoded_views = arena_push_array_zero(arena, GLTFBuffer, json_len(asset_views));
+    u32 num_views = 0;
+
+    JSON_FOREACH(asset_views, asset_view) {
+        GLTFCompressedView* view = &doc->compressed_views[num_views];
+        GLTFBuffer* decoded = &doc->decoded_views[num_views++];
+
+        Json* extensions = json_query(asset_view, "extensions");
+        Json* compression = extensions ? json_query(extensions, "EXT_meshopt_compression") : 0;
+
+        if (!compression) {
+            continue;
+        }
+
+        u32 buffer_index = (u32)json_query(compression, "buffer")->integer;
+        assert(buffer_index < doc->num_buffers);
+        view->buffer = &doc->buffers[buffer_index];
+
+        Json* j_offset = json_query(compression, "byteOffset");
+        view->offset = j_offset ? j_offset->integer : 0;
+        view->len = json_query(compression, "byteLength")->integer;
+        view->stride = (u32)json_query(compression, "byteStride")->integer;
+        view->count = (u32)json_query(compression, "count")->integer;
+        view->mode = json_query(compression, "mode")->string;
+
+        view->filter = MESHOPT_FILTER_NONE;
+        if (Json* j_filter = json_query(compression, "filter")) {
+            if (strcmp(j_filter->string, "OCTAHEDRAL") == 0) {
+                view->filter = MESHOPT_FILTER_OCTAHEDRAL;
+            }
+            else if (strcmp(j_filter->string, "QUATERNION") == 0) {
+                view->filter = MESHOPT_FILTER_QUATERNION;
+            }
+            else if (strcmp(j_filter->string, "EXPONENTIAL") == 0) {
+                view->filter = MESHOPT_FILTER_EXPONENTIAL;
+            }
+        }
+
+        if (doc->deferred) {
+            continue;
+        }
+
+        decoded->len = (u64)view->count * view->stride;
+        decoded->memory = arena_push(arena, decoded->len);
+
+        f32 decode_start = engine_time();
+
+        bool valid = view->buffer->memory && view->offset + view->len <= view->buffer->len &&
+                     decode_gltf_compressed_view(view, (u8*)view->buffer->memory + view->offset, decoded->memory);
+
+        if (!valid) {
+            system_message_box("Malformed EXT_meshopt_compression buffer view in '%s'", path);
+            assert(false);
+        }
+
+        add_gltf_stage_time(report, GLTF_STAGE_MESHOPT_DECODE, decode_start);
+
+        if (report) {
+            report->bytes_decoded += decoded->len;
+        }
+    }
+}
+
+bool read_gltf_document(Arena* arena, char* path, GLTFDocument* doc, GLTFLoadReport* report) {
+    char* extension = strrchr(path, '.');
+    assert(extension);
+
+    *doc = {};
+
+    if (strcmp(extension, ".gltf") == 0) {
+        read_gltf_gltf(arena, path, doc, report);
+        decode_gltf_meshopt_views(arena, path, doc, report);
+        return true;
+    }
+
+    if (strcmp(extension, ".glb") == 0) {
+        read_gltf_glb(arena, path, doc, report);
+        decode_gltf_meshopt_views(arena, path, doc, report);
+        return true;
+    }
+
+    system_message_box("Invalid GLTF file:\n'%s'", path);
+
+    return false;
+}
+
+bool read_gltf_document_deferred(Arena* arena, char* path, GLTFDocument* doc) {
+    char* extension = strrchr(path, '.');
+    assert(extension);
+
+    *doc = {};
+    doc->deferred = true;
+
+    if (strcmp(extension, ".gltf") == 0) {
+        read_gltf_gltf(arena, path, doc, 0);
+        decode_gltf_meshopt_views(arena, path, doc, 0);
+        return true;
+    }
+
+    if (strcmp(extension, ".glb") == 0) {
+        read_gltf_glb_deferred(arena, path, doc);
+        decode_gltf_meshopt_views(arena, path, doc, 0);
+        return true;
+    }
+
+    system_message_box("Invalid GLTF file:\n'%s'", path);
+
+    return false;
+}
+
+TextureContentKey gltf_document_key(char* path) {
+    Scratch scratch = get_scratch(0, 0);
+
+    char* extension = strrchr(path, '.');
+    bool glb = extension && strcmp(extension, ".glb") == 0;
+    TextureContentKey key = {};
+
+    // A .glb's JSON chunk is read on its own where the file can be read in ranges, like a deferred document.
+    File file = {};
+    if (glb) {
+        file = file_open(path);
+    }
+
+    if (file.handle) {
+        u32 json_chunk[2] = {};
+        bool read = file_read(file, sizeof(GLBHeader), json_chunk, sizeof(json_chunk));
+
+        char* json = (char*)arena_push(scratch.arena, json_chunk[0]);
+        read = read && file_read(file, sizeof(GLBHeader) + sizeof(json_chunk), json, json_chunk[0]);
+        assert(read && json_chunk[1] == GLB_CHUNK_JSON);
+        UNUSED(read);
+
+        key = texture_content_key(json, json_chunk[0]);
+        file_close(file);
+    }
+    else if (glb) {
+        ReadFileResult glb_file = read_file(scratch.arena, path);
+        GLBChunk* json_chunk = (GLBChunk*)((u8*)glb_file.memory + sizeof(GLBHeader));
+        assert(json_chunk->type == GLB_CHUNK_JSON);
+
+        key = texture_content_key(json_chunk->memory, json_chunk->len);
+    }
+    else {
+        ReadFileResult json = read_file(scratch.arena, path);
+        key = texture_content_key(json.memory, json.size);
+    }
+
+    release_scratch(scratch);
+
+    return key;
+}
+
+// Closes the files a deferred document's buffers are read from.
+void close_gltf_document(GLTFDocument* doc) {
+    for (u32 i = 0; i < doc->num_buffers; ++i) {
+        if (doc->buffers[i].file.handle) {
+            file_close(doc->buffers[i].file);
+            doc->buffers[i].file.handle = 0;
+        }
+    }
+}
+
+GLTFLoadOptions gltf_default_load_options() {
+    GLTFLoadOptions options = {};
+    options.overdraw_threshold = 1.05f;
+    options.meshlet_max_vertices = MESHLET_MAX_VERTICES;
+    options.meshlet_max_triangles = MESHLET_MAX_TRIANGLES;
+    options.max_lods = MAX_MESH_LODS;
+    options.lod_attribute_weight = 0.01f;
+    options.texture_quality = BC_QUALITY_NORMAL;
+    options.upload_batch_size = 32 * 1024 * 1024;
+    return options;
+}
+
+LoadGLTFResult load_gltf(Arena* arena, Renderer* renderer, RendererUploadContext* upload_context, TextureCache* texture_cache, GLTFLoadOptions* options, char* path, GLTFLoadReport* report) {
+    Scratch scratch = get_scratch(&arena, 1);
+
+    f32 start = engine_time();
+    if (report) {
+        *report = {};
+    }
+
+    LoadGLTFResult result = {};
+
+    GLTFDocument* doc = arena_push_struct(scratch.arena, GLTFDocument);
+    if (read_gltf_document(scratch.arena, path, doc, report)) {
+        result = process_gltf(arena, renderer, upload_context, texture_cache, options, doc, report);
+    }
+
+    release_scratch(scratch);
+
+    if (report) {
+        report->total_seconds = engine_time() - start;
+    }
+
+    return result;
+}
+
+global_var char* gltf_load_stage_names[GLTF_STAGE_COUNT] = {
+    "file_io",
+    "json_parse",
+    "base64_decode",
+    "meshopt_decode",
+    "scene_parse",
+    "image_decode",
+    "mip_generation",
+    "texture_compression",
+    "vertex_processing",
+    "upload_recording",
+};
+
+char* gltf_load_stage_name(GLTFLoadStage stage) {
+    assert(stage < GLTF_STAGE_COUNT);
+    return gltf_load_stage_names[stage];
+}
+
+void gltf_print_load_report(GLTFLoadReport* report) {
+    debug_message("Load report: %.1f ms in total.\n", report->total_seconds * 1000.0f);
+
+    for (int i = 0; i < GLTF_STAGE_COUNT; ++i) {
+        f32 share = report->total_seconds > 0.0f ? report->stage_seconds[i] / report->total_seconds : 0.0f;
+        debug_message("  %-20s %9.1f ms %5.1f%%\n", gltf_load_stage_names[i], report->stage_seconds[i] * 1000.0f, share * 100.0f);
+    }
+
+    debug_message("Bytes: %.1f MB read, %.1f MB decoded, %.1f MB staged for upload (%.1f MB in place).\n",
+        report->bytes_read / (1024.0f * 1024.0f), report->bytes_decoded / (1024.0f * 1024.0f),
+        report->bytes_staged / (1024.0f * 1024.0f), report->bytes_staged_in_place / (1024.0f * 1024.0f));
+
+    debug_message("Largest meshes (of %u):\n", report->num_meshes);
+    for (u32 i = 0; i < report->num_top_meshes; ++i) {
+        GLTFReportMesh* mesh = &report->top_meshes[i];
+        debug_message("  %-40s %8llu KB, %u vertices, %u indices\n", mesh->name, mesh->bytes / 1024, mesh->vertex_count, mesh->index_count);
+    }
+
+    debug_message("Largest textures (of %u):\n", report->num_textures);
+    for (u32 i = 0; i < report->num_top_textures; ++i) {
+        GLTFReportTexture* texture = &report->top_textures[i];
+        debug_message("  %-40s %8llu KB, %ux%u %s, %u mips\n", texture->name, texture->bytes / 1024, texture->width, texture->height,
+            texture_format_name(texture->format), texture->mip_count);
+    }
+}
+
+// Enough for the largest report, even with every name character escaped as \u00XX.
+#define GLTF_REPORT_JSON_CAPACITY (32 * 1024)
+
+struct GLTFReportWriter {
+    char* buffer;
+    u64 capacity;
+    u64 len;
+};
+
+internal void report_write(GLTFReportWriter* writer, char* fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    int written = vsnprintf(writer->buffer + writer->len, writer->capacity - writer->len, fmt, args);
+    va_end(args);
+
+    assert(written >= 0 && writer->len + written < writer->capacity);
+    writer->len += written;
+}
+
+internal void report_write_string(GLTFReportWriter* writer, char* string) {
+    report_write(writer, "\"");
+
+    for (char* c = string; *c; ++c) {
+        if (*c == '"' || *c == '\\') {
+            report_write(writer, "\\%c", *c);
+        }
+        else if ((u8)*c < 0x20) {
+            report_write(writer, "\\u%04x", *c);
+        }
+        else {
+            report_write(writer, "%c", *c);
+        }
+    }
+
+    report_write(writer, "\"");
+}
+
+char* gltf_load_report_json(Arena* arena, GLTFLoadReport* report) {
+    GLTFReportWriter writer;
+    writer.buffer = (char*)arena_push(arena, GLTF_REPORT_JSON_CAPACITY);
+    writer.capacity = GLTF_REPORT_JSON_CAPACITY;
+    writer.len = 0;
+
+    report_write(&writer, "{\n  \"total_seconds\": %.6f,\n  \"stage_seconds\": {\n", report->total_seconds);
+
+    for (int i = 0; i < GLTF_STAGE_COUNT; ++i) {
+        report_write(&writer, "    \"%s\": %.6f%s\n", gltf_load_stage_names[i], report->stage_seconds[i], i + 1 < GLTF_STAGE_COUNT ? "," : "");
+    }
+
+    report_write(&writer, "  },\n  \"bytes_read\": %llu,\n  \"bytes_decoded\": %llu,\n  \"bytes_staged\": %llu,\n  \"bytes_staged_in_place\": %llu,\n",
+        report->bytes_read, report->bytes_decoded, report->bytes_staged, report->bytes_staged_in_place);
+    report_write(&writer, "  \"num_meshes\": %u,\n  \"num_textures\": %u,\n  \"top_meshes\": [", report->num_meshes, report->num_textures);
+
+    for (u32 i = 0; i < report->num_top_meshes; ++i) {
+        GLTFReportMesh* mesh = &report->top_meshes[i];
+
+        report_write(&writer, "%s\n    { \"name\": ", i > 0 ? "," : "");
+        report_write_string(&writer, mesh->name);
+        report_write(&writer, ", \"bytes\": %llu, \"vertex_count\": %u, \"index_count\": %u }", mesh->bytes, mesh->vertex_count, mesh->index_count);
+    }
+
+    report_write(&writer, "%s],\n  \"top_textures\": [", report->num_top_meshes > 0 ? "\n  " : "");
+
+    for (u32 i = 0; i < report->num_top_textures; ++i) {
+        GLTFReportTexture* texture = &report->top_textures[i];
+
+        report_write(&writer, "%s\n    { \"name\": ", i > 0 ? "," : "");
+        report_write_string(&writer, texture->name);
+        report_write(&writer, ", \"bytes\": %llu, \"width\": %u, \"height\": %u, \"mip_count\": %u, \"format\": \"%s\" }",
+            texture->bytes, texture->width, texture->height, texture->mip_count, texture_format_name(texture->format));
+    }
+
+    report_write(&writer, "%s]\n}\n", report->num_top_textures > 0 ? "\n  " : "");
+
+    return writer.buffer;
+}
+
+// Background loading
+//
+// The loader thread reads and parses the document, then it and the worker threads pull jobs off a shared
+// counter: one per referenced image (read, hash, decode) and one per unique geometry (prepare_geometry_mesh).
+// Finished jobs are published through a completion array that gltf_update_load walks in order on the main
+// thread, which owns the renderer and the texture cache and is the only thread that records uploads.
+//
+// Ownership: until parsed is set, only the loader thread touches the loader arena. After that, only the main
+// thread writes the bookkeeping in it; the threads only write their own job results. Each result is published by
+// a single interlocked store, so its contents are visible to the main thread once the store is.
+//
+// Time slices: gltf_update_load works in steps and only starts one it expects to finish inside the slice. A
+// step's cost is estimated from the bytes it touches plus GLTF_STEP_OVERHEAD, at the slowest rate seen lately.
+// Textures and meshes are copied into upload memory GLTF_COPY_STEP_SIZE bytes at a time, and created out of it in
+// place once every byte is there, so no single step is long. A slice too short for any step makes no progress. The
+// estimate eases by GLTF_STEP_ESTIMATE_DECAY every update, so one step held up by something else can't stall a load.
+
+#define GLTF_LOADER_SCRATCH_SIZE (1024ull * 1024 * 1024)
+#define GLTF_WORKER_SCRATCH_SIZE (256ull * 1024 * 1024)
+
+// Batches in flight at once. Each one's upload context and ticket live in an arena of its own, reused once the
+// batch has completed.
+#define MAX_GLTF_LOAD_BATCHES 8
+#define GLTF_LOAD_BATCH_ARENA_SIZE (16 * 1024)
+
+#define GLTF_COPY_STEP_SIZE (256 * 1024)
+#define GLTF_STEP_OVERHEAD (16 * 1024) // A step's fixed cost, in bytes copied
+#define GLTF_REVEAL_STEP_INSTANCES 1024
+#define GLTF_STEP_ESTIMATE_DECAY 0.9f
+#define GLTF_INITIAL_SECONDS_PER_BYTE (1.0f / (1024.0f * 1024.0f * 1024.0f))
+
+// Batch indices are stored plus one, so 0 means "resident before this load" and is always ready.
+#define GLTF_NOT_UPLOADED UINT32_MAX
+
+#define GLTF_NO_STAGED_UPLOAD UINT32_MAX
+
+enum GLTFJobType {
+    GLTF_JOB_IMAGE,
+    GLTF_JOB_GEOMETRY,
+};
+
+struct GLTFJob {
+    GLTFJobType type;
+    u32 index;
+};
+
+struct GLTFImageResult {
+    TextureContentKey content_key; // Of the encoded bytes, which are gone by the time the texture cache is asked
+    GLTFDecodedImage image; // Freed once its upload has been recorded
+};
+
+// Prepared geometry. The vertices and indices are a page allocation of their own, written once by
+// prepare_geometry_mesh; everything else is copied into memory. Both are freed once the upload has been recorded.
+struct GLTFGeometryResult {
+    void* memory; // Null when there's nothing besides vertices and indices
+    MeshCreateInfo mesh_info;
+    GLTFMeshInfo info;
+    SkinnedVertices skin_vertices; // Pointed to by info when the geometry is skinned
+    GLTFMeshStats stats;
+};
+
+// What the main thread does once the document has been parsed, before committing anything. One step each.
+enum GLTFStartStep {
+    GLTF_START_RESULT,
+    GLTF_START_LAZY_MATERIALS,
+    GLTF_START_SCENE_GRAPH,
+    GLTF_START_ANIMATIONS,
+    GLTF_START_SKINS,
+    GLTF_START_STEP_COUNT,
+};
+
+struct GLTFLoadBatch {
+    Arena arena;
+    RendererUploadTicket* ticket;
+};
+
+// A commit being copied into upload memory reserved in the open batch. Textures go row by row into the
+// renderer's upload layout, meshes as one block.
+struct GLTFStagedUpload {
+    u32 job; // GLTF_NO_STAGED_UPLOAD when nothing is being copied
+    u8* src; // Packed
+    u8* dst; // The reservation
+    u64 size; // Of src
+    u64 copied;
+    MaterialCreateInfo material_info; // Textures only
+    TextureUploadLayout layout;
+    u32 level;
+    u32 row;
+};
+
+struct GLTFSlice {
+    f32 start;
+    f32 length;
+};
+
+struct GLTFLoader {
+    Renderer* renderer;
+    TextureCache* texture_cache;
+    GLTFLoadOptions options;
+    char* path;
+
+    Arena loader_arena; // Sized from the document once it's parsed
+    Arena* result_arena; // In the result's memory, likewise
+    Thread loader_thread;
+
+    volatile u32 parsed;
+    GLTFScene scene;
+    Semaphore sources_copied; // Signalled once the main thread has copied lazy images' sources out of the document
+
+    u32 num_jobs;
+    GLTFJob* jobs;
+    volatile u32 next_job;
+    volatile u32 num_completed;
+    volatile u32* completed_jobs; // Job index + 1 for every finished job, 0 until written
+
+    GLTFImageResult* image_results;
+    GLTFGeometryResult* geometry_results;
+
+    // Main thread state
+    bool finished;
+    f32 start_time;
+    RendererUploadStats upload_start; // For the uploads logged when the load finishes
+    f32 seconds_per_byte; // Step cost estimate
+    u32 next_start_step;
+    u32 next_commit;
+    GLTFStagedUpload staged;
+
+    RendererUploadContext* batch_context;
+    u64 batch_bytes;
+    u32 num_batches; // Submitted so far
+    u32 num_completed_batches;
+    GLTFLoadBatch batches[MAX_GLTF_LOAD_BATCHES]; // Indexed by batch number modulo MAX_GLTF_LOAD_BATCHES
+
+    u32* image_batches;
+    u32* geometry_batches;
+    Material* image_materials;
+    Mesh* geometry_meshes;
+    SkinnedVertices** geometry_skin_vertices;
+    bool* geometry_posed; // Skinned geometries already in the result's skinned meshes
+    HashMap* material_batches;
+
+    // A pass over the pending instances can take several steps; kept instances are compacted as it goes.
+    u32 num_pending_instances;
+    u32* pending_instances;
+    u32 reveal_cursor;
+    u32 num_kept_instances;
+    u32* node_map; // GLTF node index to scene graph node
+
+    GLTFMeshStats mesh_stats;
+    GLTFTextureStats texture_stats;
+    LoadGLTFResult result;
+};
+
+internal void merge_gltf_mesh_stats(GLTFMeshStats* total, GLTFMeshStats* stats) {
+    accumulate_vertex_cache_stats(&total->cache_before, stats->cache_before);
+    accumulate_vertex_cache_stats(&total->cache_after, stats->cache_after);
+    total->vertices_before_weld += stats->vertices_before_weld;
+    total->vertices_after_weld += stats->vertices_after_weld;
+    total->meshlet_count += stats->meshlet_count;
+    total->meshlet_vertices += stats->meshlet_vertices;
+    total->meshlet_triangles += stats->meshlet_triangles;
+    total->index_bytes_u32 += stats->index_bytes_u32;
+    total->index_bytes_uploaded += stats->index_bytes_uploaded;
+    for (u32 i = 0; i < MAX_MESH_LODS; ++i) {
+        total->lod_triangles[i] += stats->lod_triangles[i];
+    }
+    total->vertex_bytes += stats->vertex_bytes;
+    total->compact_vertex_bytes += stats->compact_vertex_bytes;
+}
+
+internal void run_image_job(GLTFLoadOptions* options, GLTFImage* image, GLTFImageResult* result) {
+    Scratch scratch = get_scratch(0, 0);
+
+    u64 encoded_size = 0;
+    void* encoded_memory = read_image_source(scratch.arena, image, &encoded_size, 0);
+
+    // Decoded even if the texture cache turns out to have it; the cache is only consulted on the main thread.
+    result->content_key = texture_content_key(encoded_memory, encoded_size);
+
+    // Workers can't reserve upload memory, so images are decoded to page allocations.
+    GLTFUploadTarget target = {};
+    decode_gltf_image(options, &target, encoded_memory, encoded_size, &result->image);
+
+    release_scratch(scratch);
+}
+
+internal void run_geometry_job(GLTFLoadOptions* options, GLTFGeometry* geometry, GLTFGeometryResult* result) {
+    Scratch scratch = get_scratch(0, 0);
+
+    // Workers can't reserve upload memory, so the upload data goes to a page allocation.
+    GLTFUploadTarget target = {};
+    MeshCreateInfo mesh_info = prepare_geometry_mesh(scratch.arena, &target, options, geometry, &result->stats, &result->info);
+
+    u64 meshlet_size = (u64)result->info.num_meshlets * sizeof(Meshlet);
+    u64 skin_size = result->info.skin_vertices ? (u64)result->info.skin_vertices->vertex_count * (sizeof(Vertex) + sizeof(SkinInfluence)) : 0;
+    u64 memory_size = skin_size + meshlet_size;
+
+    u8* memory = memory_size > 0 ? (u8*)page_alloc(memory_size) : 0;
+    u8* cursor = memory;
+
+    if (skin_size > 0) {
+        SkinnedVertices* skin_vertices = &result->skin_vertices;
+        *skin_vertices = *result->info.skin_vertices;
+
+        memcpy(cursor, skin_vertices->bind_vertices, skin_vertices->vertex_count * sizeof(Vertex));
+        skin_vertices->bind_vertices = (Vertex*)cursor;
+        cursor += skin_vertices->vertex_count * sizeof(Vertex);
+
+        memcpy(cursor, skin_vertices->influences, skin_vertices->vertex_count * sizeof(SkinInfluence));
+        skin_vertices->influences = (SkinInfluence*)cursor;
+        cursor += skin_vertices->vertex_count * sizeof(SkinInfluence);
+
+        result->info.skin_vertices = skin_vertices;
+    }
+
+    if (meshlet_size > 0) {
+        memcpy(cursor, result->info.meshlets, meshlet_size);
+        result->info.meshlets = (Meshlet*)cursor;
+    }
+
+    result->memory = memory;
+    result->mesh_info = mesh_info;
+
+    release_scratch(scratch);
+}
+
+internal void gltf_worker_proc(void* data) {
+    GLTFLoader* loader = (GLTFLoader*)data;
+
+    while (true) {
+        u32 job_index = atomic_increment(&loader->next_job) - 1;
+        if (job_index >= loader->num_jobs) {
+            break;
+        }
+
+        GLTFJob* job = &loader->jobs[job_index];
+
+        switch (job->type) {
+            case GLTF_JOB_IMAGE:
+                run_image_job(&loader->options, &loader->scene.images[job->index], &loader->image_results[job->index]);
+                break;
+            case GLTF_JOB_GEOMETRY:
+                run_geometry_job(&loader->options, &loader->scene.geometries[job->index], &loader->geometry_results[job->index]);
+                break;
+        }
+
+        u32 slot = atomic_increment(&loader->num_completed) - 1;
+        atomic_store(&loader->completed_jobs[slot], job_index + 1);
+    }
+}
+
+// Everything the loader keeps besides its result: the scene and the jobs the threads work from, and the main
+// thread's bookkeeping, set up here so starting the commits only builds the result.
+internal void build_gltf_loader_state(GLTFLoader* loader, Arena* arena, GLTFDocument* doc) {
+    Scratch scratch = get_scratch(&arena, 1);
+
+    GLTFScene* scene = &loader->scene;
+
+    if (doc) {
+        parse_gltf_scene(arena, doc, scene);
+    }
+    else {
+        *scene = {};
+    }
+
+    // Only images that some material uses are decoded.
+    bool* image_used = arena_push_array_zero(scratch.arena, bool, scene->num_images);
+    for (u32 i = 0; i < scene->num_materials; ++i) {
+        image_used[scene->material_images[i]] = true;
+    }
+
+    loader->jobs = arena_push_array(arena, GLTFJob, scene->num_images + scene->num_geometries);
+    loader->num_jobs = 0;
+
+    for (u32 i = 0; i < scene->num_images; ++i) {
+        if (!image_used[i]) {
+            continue;
+        }
+
+        // With lazy materials, images are decoded on first use instead.
+        if (!loader->options.lazy_materials) {
+            loader->jobs[loader->num_jobs++] = { GLTF_JOB_IMAGE, i };
+        }
+    }
+
+    for (u32 i = 0; i < scene->num_geometries; ++i) {
+        loader->jobs[loader->num_jobs++] = { GLTF_JOB_GEOMETRY, i };
+    }
+
+    loader->completed_jobs = arena_push_array_zero(arena, u32, loader->num_jobs);
+    loader->image_results = arena_push_array_zero(arena, GLTFImageResult, scene->num_images);
+    loader->geometry_results = arena_push_array_zero(arena, GLTFGeometryResult, scene->num_geometries);
+
+    for (u32 i = 0; i < MAX_GLTF_LOAD_BATCHES; ++i) {
+        loader->batches[i].arena = arena_init(arena_push(arena, GLTF_LOAD_BATCH_ARENA_SIZE), GLTF_LOAD_BATCH_ARENA_SIZE);
+    }
+
+    loader->image_batches = arena_push_array(arena, u32, scene->num_images);
+    loader->geometry_batches = arena_push_array(arena, u32, scene->num_geometries);
+    loader->image_materials = arena_push_array(arena, Material, scene->num_images);
+    loader->geometry_meshes = arena_push_array(arena, Mesh, scene->num_geometries);
+    loader->geometry_skin_vertices = arena_push_array(arena, SkinnedVertices*, scene->num_geometries);
+    loader->geometry_posed = arena_push_array_zero(arena, bool, scene->num_geometries);
+    loader->material_batches = hash_map_new(arena, scene->num_images + 1);
+
+    for (u32 i = 0; i < scene->num_images; ++i) {
+        loader->image_batches[i] = GLTF_NOT_UPLOADED;
+    }
+
+    for (u32 i = 0; i < scene->num_geometries; ++i) {
+        loader->geometry_batches[i] = GLTF_NOT_UPLOADED;
+    }
+
+    loader->num_pending_instances = scene->num_instances;
+    loader->pending_instances = arena_push_array(arena, u32, scene->num_instances);
+
+    for (u32 i = 0; i < scene->num_instances; ++i) {
+        loader->pending_instances[i] = i;
+    }
+
+    loader->node_map = arena_push_array(arena, u32, scene->num_nodes);
+
+    release_scratch(scratch);
+}
+
+internal void gltf_loader_proc(void* data) {
+    GLTFLoader* loader = (GLTFLoader*)data;
+
+    // The document and its buffers stay in this thread's scratch until every job has run, and with lazy materials
+    // until the main thread has copied the image sources out of it.
+    Scratch scratch = get_scratch(0, 0);
+
+    GLTFDocument* doc = arena_push_struct(scratch.arena, GLTFDocument);
+    if (!read_gltf_document(scratch.arena, loader->path, doc, 0)) {
+        doc = 0;
+    }
+
+    // What the loader keeps depends on the document, so it's built once in scratch to measure it and then again in
+    // an arena of just that size.
+    Scratch measure = get_scratch(&scratch.arena, 1);
+
+    u8* measure_start = measure.arena->cursor;
+    build_gltf_loader_state(loader, measure.arena, doc);
+    u64 arena_size = measure.arena->cursor - measure_start;
+
+    release_scratch(measure);
+
+    loader->loader_arena = arena_init(page_alloc(arena_size), arena_size);
+    build_gltf_loader_state(loader, &loader->loader_arena, doc);
+
+    u32 thread_count = loader->options.worker_count ? loader->options.worker_count : processor_count() - 1;
+    u32 num_worker_threads = thread_count > 1 ? thread_count - 1 : 0;
+    Thread* worker_threads = arena_push_array(scratch.arena, Thread, num_worker_threads);
+
+    for (u32 i = 0; i < num_worker_threads; ++i) {
+        worker_threads[i] = thread_start(scratch.arena, gltf_worker_proc, loader, GLTF_WORKER_SCRATCH_SIZE);
+    }
+
+    // The loader arena's bookkeeping belongs to the main thread from here on.
+    atomic_store(&loader->parsed, 1);
+
+    gltf_worker_proc(loader);
+
+    for (u32 i = 0; i < num_worker_threads; ++i) {
+        thread_join(worker_threads[i]);
+    }
+
+    if (loader->options.lazy_materials) {
+        semaphore_wait(loader->sources_copied);
+    }
+
+    release_scratch(scratch);
+}
+
+GLTFLoader* gltf_begin_load(Arena* arena, Renderer* renderer, TextureCache* texture_cache, GLTFLoadOptions* options, char* path) {
+    GLTFLoader* loader = arena_push_struct_zero(arena, GLTFLoader);
+
+    loader->renderer = renderer;
+    loader->texture_cache = texture_cache;
+    loader->options = *options;
+    loader->sources_copied = semaphore_create(0);
+    loader->start_time = engine_time();
+    loader->upload_start = renderer_upload_stats(renderer);
+    loader->seconds_per_byte = GLTF_INITIAL_SECONDS_PER_BYTE;
+    loader->staged.job = GLTF_NO_STAGED_UPLOAD;
+
+    u64 path_size = strlen(path) + 1;
+    loader->path = (char*)arena_push(arena, path_size);
+    memcpy(loader->path, path, path_size);
+
+    loader->loader_thread = thread_start(arena, gltf_loader_proc, loader, GLTF_LOADER_SCRATCH_SIZE);
+
+    return loader;
+}
+
+internal bool gltf_step_fits(GLTFLoader* loader, GLTFSlice* slice, u64 bytes) {
+    f32 estimate = (f32)(bytes + GLTF_STEP_OVERHEAD) * loader->seconds_per_byte;
+    return engine_time() - slice->start + estimate <= slice->length;
+}
+
+// Slower steps raise the estimate at once and faster ones lower it gradually, so one quick step doesn't let the
+// next one overrun.
+internal void gltf_step_done(GLTFLoader* loader, f32 step_start, u64 bytes) {
+    f32 seconds_per_byte = (engine_time() - step_start) / (f32)(bytes + GLTF_STEP_OVERHEAD);
+
+    if (seconds_per_byte > loader->seconds_per_byte) {
+        loader->seconds_per_byte = seconds_per_byte;
+    }
+    else {
+        loader->seconds_per_byte = loader->seconds_per_byte * 0.9f + seconds_per_byte * 0.1f;
+    }
+}
+
+// Roughly the bytes each start step copies or writes.
+internal u64 gltf_start_step_bytes(GLTFLoader* loader, GLTFStartStep step) {
+    GLTFScene* scene = &loader->scene;
+    u64 bytes = 0;
+
+    switch (step) {
+        case GLTF_START_RESULT:
+            bytes = (u64)scene->num_instance_transforms * sizeof(XMFLOAT4X3) + (u64)scene->num_instances * sizeof(MeshInstance);
+            break;
+        case GLTF_START_LAZY_MATERIALS:
+            if (loader->options.lazy_materials) {
+                for (u32 i = 0; i < scene->num_images; ++i) {
+                    bytes += scene->images[i].uri ? strlen(scene->images[i].uri) : scene->images[i].view->len;
+                }
+            }
+            break;
+        case GLTF_START_SCENE_GRAPH:
+            bytes = (u64)scene->num_nodes * (3 * sizeof(XMVECTOR) + 2 * sizeof(XMMATRIX));
+            break;
+        case GLTF_START_ANIMATIONS:
+            for (u32 i = 0; i < scene->num_animations; ++i) {
+                for (u32 j = 0; j < scene->animations[i].num_tracks; ++j) {
+                    bytes += (u64)scene->animations[i].tracks[j].key_count * (sizeof(f32) + sizeof(XMVECTOR));
+                }
+            }
+            break;
+        case GLTF_START_SKINS:
+            for (u32 i = 0; i < scene->num_skins; ++i) {
+                bytes += (u64)scene->skins[i].num_joints * (sizeof(XMMATRIX) + sizeof(u32));
+            }
+            break;
+        default:
+            break;
+    }
+
+    return bytes;
+}
+
+// Builds the result's arrays, and the hierarchy, which exists up front so it can be placed and animated before its
+// instances appear.
+internal void run_gltf_start_step(GLTFLoader* loader, GLTFStartStep step) {
+    GLTFScene* scene = &loader->scene;
+    LoadGLTFResult* result = &loader->result;
+
+    if (step == GLTF_START_RESULT) {
+        loader->result_arena = new_gltf_result_arena(scene, &loader->options, result);
+    }
+
+    Arena* arena = loader->result_arena;
+
+    switch (step) {
+        case GLTF_START_RESULT:
+            // Materials are indexed by glTF material like the synchronous path, and counted once the load
+            // finishes. The other arrays are filled in commit order and grow as the load progresses.
+            result->materials = arena_push_array(arena, Material, scene->num_materials);
+            result->meshes = arena_push_array(arena, Mesh, scene->num_geometries);
+            result->mesh_infos = arena_push_array(arena, GLTFMeshInfo, scene->num_geometries);
+            result->instances = arena_push_array_zero(arena, MeshInstance, scene->num_instances - scene->num_batched_instances);
+            result->instance_nodes = arena_push_array(arena, u32, scene->num_instances - scene->num_batched_instances);
+            result->instance_materials = arena_push_array(arena, u32, scene->num_instances - scene->num_batched_instances);
+            result->instance_batches = arena_push_array(arena, MeshInstanceBatch, scene->num_batched_instances);
+            result->instance_batch_nodes = arena_push_array(arena, u32, scene->num_batched_instances);
+            result->instance_batch_materials = arena_push_array(arena, u32, scene->num_batched_instances);
+            result->instance_transforms = copy_instance_transforms(arena, scene);
+            result->skinned_meshes = arena_push_array(arena, SkinnedMesh, scene->num_geometries);
+            break;
+        case GLTF_START_LAZY_MATERIALS:
+            if (loader->options.lazy_materials) {
+                result->lazy_materials = build_lazy_gltf_materials(arena, loader->texture_cache, &loader->options, scene, result);
+                semaphore_signal(loader->sources_copied, 1);
+            }
+            break;
+        case GLTF_START_SCENE_GRAPH:
+            result->scene_graph = scene_graph_new(arena, scene->num_nodes, scene->node_parents, scene->node_translations, scene->node_rotations, scene->node_scales, loader->node_map);
+            break;
+        case GLTF_START_ANIMATIONS:
+            result->num_animations = scene->num_animations;
+            result->animations = create_gltf_animations(arena, scene, loader->node_map);
+            break;
+        case GLTF_START_SKINS:
+            result->num_skins = scene->num_skins;
+            result->skins = create_gltf_skins(arena, scene, loader->node_map);
+            break;
+        default:
+            break;
+    }
+}
+
+// Returns true once every start step has run.
+internal bool start_gltf_commits(GLTFLoader* loader, GLTFSlice* slice) {
+    while (loader->next_start_step < GLTF_START_STEP_COUNT) {
+        GLTFStartStep step = (GLTFStartStep)loader->next_start_step;
+        u64 bytes = gltf_start_step_bytes(loader, step);
+
+        if (!gltf_step_fits(loader, slice, bytes)) {
+            return false;
+        }
+
+        f32 step_start = engine_time();
+        run_gltf_start_step(loader, step);
+        gltf_step_done(loader, step_start, bytes);
+
+        ++loader->next_start_step;
+    }
+
+    return true;
+}
+
+internal void submit_gltf_batch(GLTFLoader* loader) {
+    GLTFLoadBatch* batch = &loader->batches[loader->num_batches % MAX_GLTF_LOAD_BATCHES];
+    batch->ticket = renderer_submit_upload_context(&batch->arena, loader->renderer, loader->batch_context);
+
+    ++loader->num_batches;
+    loader->batch_context = 0;
+    loader->batch_bytes = 0;
+}
+
+// Whether a batch is open or one can be, which it can't while every batch is in flight.
+internal bool gltf_batch_available(GLTFLoader* loader) {
+    return loader->batch_context || loader->num_batches - loader->num_completed_batches < MAX_GLTF_LOAD_BATCHES;
+}
+
+internal RendererUploadContext* get_gltf_batch(GLTFLoader* loader) {
+    if (!loader->batch_context) {
+        assert(gltf_batch_available(loader));
+
+        GLTFLoadBatch* batch = &loader->batches[loader->num_batches % MAX_GLTF_LOAD_BATCHES];
+        arena_clear(&batch->arena);
+        loader->batch_context = renderer_open_upload_context(&batch->arena, loader->renderer);
+    }
+    return loader->batch_context;
+}
+
+// Every glTF material using the image holds its own reference, like the synchronous path.
+internal void add_gltf_image_materials(GLTFLoader* loader, u32 image_index, Material material, u64 batch) {
+    loader->image_materials[image_index] = material;
+    loader->image_batches[image_index] = (u32)batch;
+
+    bool first_reference = true;
+
+    for (u32 i = 0; i < loader->scene.num_materials; ++i) {
+        if (loader->scene.material_images[i] == image_index) {
+            if (!first_reference) {
+                texture_cache_add_ref(loader->texture_cache, material);
+            }
+            first_reference = false;
+            loader->result.materials[i] = material;
+        }
+    }
+}
+
+// Takes the image from the texture cache if this load or a previous one has it. Otherwise starts copying it into
+// the open batch.
+internal void begin_gltf_image_commit(GLTFLoader* loader, u32 job_index, u32 image_index) {
+    GLTFImage* image = &loader->scene.images[image_index];
+    GLTFImageResult* image_result = &loader->image_results[image_index];
+
+    Material material;
+
+    if ((image->uri && texture_cache_acquire_uri(loader->texture_cache, image->uri, &material)) ||
+        texture_cache_acquire_content(loader->texture_cache, image->uri, &image_result->content_key, &material))
+    {
+        // Either shared with an image committed earlier in this load, or resident from a previous one.
+        u64 batch;
+        if (!hash_map_get(loader->material_batches, material.handle, &batch)) {
+            batch = 0;
+        }
+        ++loader->texture_stats.num_shared;
+
+        free_gltf_image(&image_result->image);
+        add_gltf_image_materials(loader, image_index, material, batch);
+        return;
+    }
+
+    GLTFStagedUpload* staged = &loader->staged;
+    *staged = {};
+    staged->job = job_index;
+    staged->material_info = gltf_image_material_info(&image_result->image);
+    staged->src = (u8*)image_result->image.data;
+    staged->size = gltf_image_size(&image_result->image);
+
+    renderer_texture_upload_layout(loader->renderer, &staged->material_info, &staged->layout);
+    staged->dst = (u8*)renderer_reserve_upload(loader->renderer, get_gltf_batch(loader), staged->layout.size);
+}
+
+internal void begin_gltf_geometry_commit(GLTFLoader* loader, u32 job_index, u32 geometry_index) {
+    MeshCreateInfo* mesh_info = &loader->geometry_results[geometry_index].mesh_info;
+    u32 index_stride = mesh_info->index_format == INDEX_FORMAT_U16 ? sizeof(u16) : sizeof(u32);
+
+    // The vertices and indices are one block, indices last.
+    GLTFStagedUpload* staged = &loader->staged;
+    *staged = {};
+    staged->job = job_index;
+    staged->src = (u8*)mesh_info->vertex_data;
+    staged->size = (u64)((u8*)mesh_info->index_data - (u8*)mesh_info->vertex_data) + (u64)mesh_info->index_count * index_stride;
+    staged->dst = (u8*)renderer_reserve_upload(loader->renderer, get_gltf_batch(loader), staged->size);
+}
+
+internal u32 texture_level_rows(TextureFormat format, u32 height) {
+    return format == TEXTURE_FORMAT_RGBA8 ? height : (height + 3) / 4;
+}
+
+// Bytes the next copy step moves: whole rows of a texture, at least one, or the next piece of a mesh.
+internal u64 staged_copy_step_bytes(GLTFStagedUpload* staged) {
+    u64 remaining = staged->size - staged->copied;
+
+    if (!staged->material_info.texture_data) {
+        return remaining < GLTF_COPY_STEP_SIZE ? remaining : GLTF_COPY_STEP_SIZE;
+    }
+
+    MaterialCreateInfo* info = &staged->material_info;
+    u32 width = info->texture_w >> staged->level ? info->texture_w >> staged->level : 1;
+    u32 height = info->texture_h >> staged->level ? info->texture_h >> staged->level : 1;
+    u32 num_rows = texture_level_rows(info->format, height);
+    u64 row_size = texture_chain_size(info->format, width, height, 1) / num_rows;
+
+    u64 rows = GLTF_COPY_STEP_SIZE / row_size;
+    rows = rows < 1 ? 1 : rows;
+    rows = rows < num_rows - staged->row ? rows : num_rows - staged->row;
+
+    return rows * row_size;
+}
+
+internal void copy_staged_step(GLTFStagedUpload* staged, u64 bytes) {
+    if (!staged->material_info.texture_data) {
+        memcpy(staged->dst + staged->copied, staged->src + staged->copied, bytes);
+        staged->copied += bytes;
+        return;
+    }
+
+    MaterialCreateInfo* info = &staged->material_info;
+    u32 width = info->texture_w >> staged->level ? info->texture_w >> staged->level : 1;
+    u32 height = info->texture_h >> staged->level ? info->texture_h >> staged->level : 1;
+    u32 num_rows = texture_level_rows(info->format, height);
+    u64 row_size = texture_chain_size(info->format, width, height, 1) / num_rows;
+
+    u8* dst = staged->dst + staged->layout.level_offsets[staged->level];
+    u32 pitch = staged->layout.row_pitches[staged->level];
+
+    for (u64 copied = 0; copied < bytes; copied += row_size) {
+        memcpy(dst + (u64)staged->row * pitch, staged->src + staged->copied, row_size);
+        staged->copied += row_size;
+
+        if (++staged->row == num_rows) {
+            staged->row = 0;
+            ++staged->level;
+        }
+    }
+}
+
+// Every byte is in upload memory, so creating the texture copies nothing more.
+internal void finish_gltf_image_commit(GLTFLoader* loader, u32 image_index) {
+    GLTFImage* image = &loader->scene.images[image_index];
+    GLTFImageResult* image_result = &loader->image_results[image_index];
+
+    MaterialCreateInfo material_info = loader->staged.material_info;
+    material_info.texture_data = loader->staged.dst;
+
+    Material material = renderer_new_material(loader->renderer, loader->batch_context, &material_info);
+    texture_cache_insert(loader->texture_cache, image->uri, &image_result->content_key, material);
+
+    u64 batch = loader->num_batches + 1;
+    hash_map_put(loader->material_batches, material.handle, batch);
+
+    loader->batch_bytes += loader->staged.size;
+    add_gltf_texture_stats(&loader->texture_stats, &image_result->image);
+    free_gltf_image(&image_result->image);
+
+    add_gltf_image_materials(loader, image_index, material, batch);
+}
+
+// Bytes finishing the geometry's commit copies into the result's arena.
+internal u64 gltf_geometry_info_bytes(GLTFGeometryResult* geometry_result) {
+    GLTFMeshInfo* info = &geometry_result->info;
+    u64 bytes = (u64)info->num_meshlets * sizeof(Meshlet);
+
+    if (info->skin_vertices) {
+        bytes += (u64)info->skin_vertices->vertex_count * (sizeof(Vertex) + sizeof(SkinInfluence));
+    }
+
+    return bytes;
+}
+
+internal void finish_gltf_geometry_commit(GLTFLoader* loader, u32 geometry_index) {
+    GLTFGeometryResult* geometry_result = &loader->geometry_results[geometry_index];
+
+    MeshCreateInfo mesh_info = geometry_result->mesh_info;
+    mesh_info.vertex_data = loader->staged.dst;
+    mesh_info.index_data = loader->staged.dst + ((u8*)geometry_result->mesh_info.index_data - (u8*)geometry_result->mesh_info.vertex_data);
+
+    Mesh mesh = renderer_new_mesh(loader->renderer, loader->batch_context, &mesh_info);
+    loader->batch_bytes += loader->staged.size;
+
+    // The mesh info is returned, so it moves out of the page allocation into the result's.
+    GLTFMeshInfo info = geometry_result->info;
+
+    if (info.num_meshlets > 0) {
+        info.meshlets = arena_push_array(loader->result_arena, Meshlet, info.num_meshlets);
+        memcpy(info.meshlets, geometry_result->info.meshlets, info.num_meshlets * sizeof(Meshlet));
+    }
+
+    if (SkinnedVertices* src = geometry_result->info.skin_vertices) {
+        info.skin_vertices = arena_push_struct(loader->result_arena, SkinnedVertices);
+        *info.skin_vertices = *src;
+        info.skin_vertices->bind_vertices = arena_push_array(loader->result_arena, Vertex, src->vertex_count);
+        info.skin_vertices->influences = arena_push_array(loader->result_arena, SkinInfluence, src->vertex_count);
+        memcpy(info.skin_vertices->bind_vertices, src->bind_vertices, src->vertex_count * sizeof(Vertex));
+        memcpy(info.skin_vertices->influences, src->influences, src->vertex_count * sizeof(SkinInfluence));
+    }
+
+    merge_gltf_mesh_stats(&loader->mesh_stats, &geometry_result->stats);
+
+    page_free(geometry_result->mesh_info.vertex_data);
+
+    if (geometry_result->memory) {
+        page_free(geometry_result->memory);
+        geometry_result->memory = 0;
+    }
+
+    loader->geometry_meshes[geometry_index] = mesh;
+    loader->geometry_skin_vertices[geometry_index] = info.skin_vertices;
+    loader->geometry_batches[geometry_index] = loader->num_batches + 1;
+
+    LoadGLTFResult* result = &loader->result;
+    result->meshes[result->num_meshes] = mesh;
+    result->mesh_infos[result->num_meshes] = info;
+    ++result->num_meshes;
+}
+
+// Bytes the staged upload's next step moves: a copy step, or creating the texture or mesh once it's all there.
+internal u64 staged_step_bytes(GLTFLoader* loader) {
+    GLTFStagedUpload* staged = &loader->staged;
+
+    if (staged->copied < staged->size) {
+        return staged_copy_step_bytes(staged);
+    }
+
+    GLTFJob* job = &loader->jobs[staged->job];
+    return job->type == GLTF_JOB_GEOMETRY ? gltf_geometry_info_bytes(&loader->geometry_results[job->index]) : 0;
+}
+
+internal void run_staged_step(GLTFLoader* loader, u64 bytes) {
+    GLTFStagedUpload* staged = &loader->staged;
+
+    if (staged->copied < staged->size) {
+        copy_staged_step(staged, bytes);
+        return;
+    }
+
+    GLTFJob* job = &loader->jobs[staged->job];
+
+    switch (job->type) {
+        case GLTF_JOB_IMAGE:
+            finish_gltf_image_commit(loader, job->index);
+            break;
+        case GLTF_JOB_GEOMETRY:
+            finish_gltf_geometry_commit(loader, job->index);
+            break;
+    }
+
+    staged->job = GLTF_NO_STAGED_UPLOAD;
+    ++loader->next_commit;
+}
+
+// Commits finished jobs in order, a step at a time, for as long as the slice allows.
+internal void commit_gltf_jobs(GLTFLoader* loader, GLTFSlice* slice) {
+    while (true) {
+        if (loader->staged.job != GLTF_NO_STAGED_UPLOAD) {
+            u64 bytes = staged_step_bytes(loader);
+            if (!gltf_step_fits(loader, slice, bytes)) {
+                return;
+            }
+
+            f32 step_start = engine_time();
+            run_staged_step(loader, bytes);
+            gltf_step_done(loader, step_start, bytes);
+        }
+        else {
+            if (loader->next_commit == loader->num_jobs) {
+                return;
+            }
+
+            u32 completed = atomic_load(&loader->completed_jobs[loader->next_commit]);
+            if (!completed || !gltf_batch_available(loader) || !gltf_step_fits(loader, slice, 0)) {
+                return;
+            }
+
+            f32 step_start = engine_time();
+            GLTFJob* job = &loader->jobs[completed - 1];
+
+            switch (job->type) {
+                case GLTF_JOB_IMAGE:
+                    begin_gltf_image_commit(loader, completed - 1, job->index);
+                    break;
+                case GLTF_JOB_GEOMETRY:
+                    begin_gltf_geometry_commit(loader, completed - 1, job->index);
+                    break;
+            }
+
+            // Images the texture cache had are committed already.
+            if (loader->staged.job == GLTF_NO_STAGED_UPLOAD) {
+                ++loader->next_commit;
+            }
+
+            gltf_step_done(loader, step_start, 0);
+        }
+
+        if (loader->staged.job == GLTF_NO_STAGED_UPLOAD && loader->batch_bytes >= loader->options.upload_batch_size) {
+            if (!gltf_step_fits(loader, slice, 0)) {
+                return;
+            }
+
+            f32 step_start = engine_time();
+            submit_gltf_batch(loader);
+            gltf_step_done(loader, step_start, 0);
+        }
+    }
+}
+
+internal bool gltf_batch_ready(GLTFLoader* loader, u32 batch) {
+    return batch <= loader->num_completed_batches;
+}
+
+internal void reveal_gltf_instance(GLTFLoader* loader, u32 instance_index) {
+    GLTFScene* scene = &loader->scene;
+    LoadGLTFResult* result = &loader->result;
+    GLTFSceneInstance* src = &scene->instances[instance_index];
+
+    // A skinned mesh is only rewritten once its upload has completed, so it's posed from its first reveal on.
+    u32 skin = scene->geometry_skins[src->geometry];
+    if (skin != GLTF_NO_SKIN && !loader->geometry_posed[src->geometry]) {
+        result->skinned_meshes[result->num_skinned_meshes++] = gltf_skinned_mesh(loader->geometry_meshes[src->geometry], &result->skins[skin], loader->geometry_skin_vertices[src->geometry]);
+        loader->geometry_posed[src->geometry] = true;
+    }
+
+    u32 node = gltf_instance_graph_node(scene, src, loader->node_map);
+
+    Mesh mesh = loader->geometry_meshes[src->geometry];
+    Material material;
+
+    if (result->lazy_materials) {
+        material = lazy_gltf_material(loader->renderer, result->lazy_materials, src->material);
+    }
+    else {
+        material = src->material == GLTF_NO_MATERIAL ? renderer_get_default_material(loader->renderer) : loader->image_materials[scene->material_images[src->material]];
+    }
+
+    if (src->num_transforms > 0) {
+        append_gltf_instance_batch(loader->result_arena, result, src, node, mesh, material);
+        return;
+    }
+
+    result->instance_nodes[result->num_instances] = node;
+    result->instance_materials[result->num_instances] = src->material;
+
+    MeshInstance* instance = &result->instances[result->num_instances++];
+    instance->mesh = mesh;
+    instance->material = material;
+    instance->transform = result->scene_graph->world_transforms[node];
+    instance->lod = 0;
+}
+
+// Moves pending instances whose mesh and material batches have completed into the result. One pass over the
+// pending instances per call at most, GLTF_REVEAL_STEP_INSTANCES of them per step.
+internal void reveal_gltf_instances(GLTFLoader* loader, GLTFSlice* slice) {
+    GLTFScene* scene = &loader->scene;
+
+    do {
+        u32 num_step_instances = loader->num_pending_instances - loader->reveal_cursor;
+        num_step_instances = num_step_instances < GLTF_REVEAL_STEP_INSTANCES ? num_step_instances : GLTF_REVEAL_STEP_INSTANCES;
+
+        u64 bytes = (u64)num_step_instances * sizeof(MeshInstance);
+        if (!gltf_step_fits(loader, slice, bytes)) {
+            return;
+        }
+
+        f32 step_start = engine_time();
+
+        // A pass starts with whatever has completed by then.
+        if (loader->reveal_cursor == 0) {
+            while (loader->num_completed_batches < loader->num_batches && renderer_upload_finished(loader->renderer, loader->batches[loader->num_completed_batches % MAX_GLTF_LOAD_BATCHES].ticket)) {
+                ++loader->num_completed_batches;
+            }
+        }
+
+        for (u32 i = 0; i < num_step_instances; ++i) {
+            u32 instance_index = loader->pending_instances[loader->reveal_cursor++];
+            GLTFSceneInstance* src = &scene->instances[instance_index];
+
+            bool ready = gltf_batch_ready(loader, loader->geometry_batches[src->geometry]);
+
+            // Lazy materials start out as the default material, which is always ready.
+            if (src->material != GLTF_NO_MATERIAL && !loader->result.lazy_materials) {
+                ready = ready && gltf_batch_ready(loader, loader->image_batches[scene->material_images[src->material]]);
+            }
+
+            if (ready) {
+                reveal_gltf_instance(loader, instance_index);
+            }
+            else {
+                loader->pending_instances[loader->num_kept_instances++] = instance_index;
+            }
+        }
+
+        gltf_step_done(loader, step_start, bytes);
+    } while (loader->reveal_cursor < loader->num_pending_instances);
+
+    loader->num_pending_instances = loader->num_kept_instances;
+    loader->reveal_cursor = 0;
+    loader->num_kept_instances = 0;
+}
+
+internal void finish_gltf_load(GLTFLoader* loader) {
+    // Every job has been committed and the threads have exited, so this doesn't wait.
+    thread_join(loader->loader_thread);
+
+    if (!loader->options.lazy_materials) {
+        loader->result.num_materials = loader->scene.num_materials;
+        log_gltf_texture_stats(&loader->options, loader->result.num_materials, &loader->texture_stats);
+    }
+    log_gltf_mesh_stats(&loader->options, &loader->scene, &loader->mesh_stats);
+    log_gltf_upload_stats(loader->renderer, &loader->upload_start);
+    debug_message("Background load of '%s' finished in %.2f s with %u upload batches.\n", loader->path, engine_time() - loader->start_time, loader->num_batches);
+
+    semaphore_destroy(loader->sources_copied);
+    page_free(loader->loader_arena.base);
+    loader->loader_arena = {};
+    loader->finished = true;
+}
+
+bool gltf_update_load(GLTFLoader* loader, f32 time_slice) {
+    if (loader->finished) {
+        return true;
+    }
+
+    if (!atomic_load(&loader->parsed)) {
+        return false;
+    }
+
+    // A step slowed down by something else, like the thread being preempted, can leave an estimate that no step fits
+    // under. Easing it each update lets the load go on, and a rate that really is that slow gets measured again.
+    loader->seconds_per_byte *= GLTF_STEP_ESTIMATE_DECAY;
+
+    GLTFSlice slice = { engine_time(), time_slice };
+
+    if (!start_gltf_commits(loader, &slice)) {
+        return false;
+    }
+
+    commit_gltf_jobs(loader, &slice);
+
+    // Whatever was recorded this call goes out now, so nothing waits on a batch that isn't full yet, unless an upload
+    // is still being copied into it.
+    if (loader->batch_context && loader->staged.job == GLTF_NO_STAGED_UPLOAD && gltf_step_fits(loader, &slice, 0)) {
+        f32 step_start = engine_time();
+        submit_gltf_batch(loader);
+        gltf_step_done(loader, step_start, 0);
+    }
+
+    reveal_gltf_instances(loader, &slice);
+
+    bool committed = loader->next_commit == loader->num_jobs && !loader->batch_context;
+    bool uploaded = loader->num_completed_batches == loader->num_batches && loader->num_pending_instances == 0;
+
+    if (committed && uploaded && thread_finished(loader->loader_thread) && gltf_step_fits(loader, &slice, 0)) {
+        finish_gltf_load(loader);
+    }
+
+    return loader->finished;
+}
+
+LoadGLTFResult* gltf_loader_result(GLTFLoader* loader) {
+    return &loader->result;
+}
@@ -1,12 +1,166 @@
 #pragma once
 
 #include "renderer.h"
+#include "mipmap.h"
+#include "block_compression.h"
+#include "texture_cache.h"
+
+struct GLTFLazyMaterials;
+struct TextureStreamer;
+struct Meshlet;
+struct SceneGraph;
+struct AnimationClip;
+struct Skin;
+struct SkinnedVertices;
+struct SkinnedMesh;
+
+struct GLTFLoadOptions {
+    bool weld_vertices;
+    f32 weld_epsilon;
+    bool optimize_vertex_cache;
+    bool optimize_overdraw;
+    bool optimize_vertex_fetch;
+    f32 overdraw_threshold;
+    bool build_meshlets;
+    u32 meshlet_max_vertices;
+    u32 meshlet_max_triangles;
+    bool compact_vertices;
+    bool generate_lods;
+    u32 max_lods;
+    f32 lod_attribute_weight;
+    bool generate_mips;
+    MipFilter mip_filter;
+    TextureFormat texture_format; // RGBA8 keeps images uncompressed
+    BCQuality texture_quality;
+    bool report_texture_psnr; // Measures each compressed image against its source, at the cost of decoding it
+    u32 worker_count; // Threads processing a background load, 0 for one per processor besides the main thread
+    u64 upload_batch_size; // Upload bytes recorded before a background load submits a batch
+    bool lazy_materials; // Images are decoded and uploaded once an instance using them is seen, see gltf_lazy.h
+    TextureStreamer* texture_streamer; // With lazy_materials, decoded images stream their mips through it instead
+};
+
+GLTFLoadOptions gltf_default_load_options();
+
+// CPU-side data kept for each unique mesh.
+struct GLTFMeshInfo {
+    u32 num_meshlets;
+    Meshlet* meshlets;
+    SkinnedVertices* skin_vertices; // Null unless the mesh is skinned
+};
 
 struct LoadGLTFResult {
+    void* memory; // Set when the load sized memory for the result itself, see gltf_free_result
     u32 num_materials;
     Material* materials;
+    u32 num_meshes;
+    Mesh* meshes;
+    GLTFMeshInfo* mesh_infos; // Parallel to meshes
     u32 num_instances;
     MeshInstance* instances;
+    u32* instance_nodes; // Parallel to instances: the scene graph node each one follows
+    u32* instance_materials; // Parallel to instances: the glTF material each one uses, or GLTF_NO_MATERIAL
+    u32 num_instance_batches;
+    MeshInstanceBatch* instance_batches; // Meshes drawn once per EXT_mesh_gpu_instancing transform
+    u32* instance_batch_nodes; // Parallel to instance_batches
+    u32* instance_batch_materials; // Parallel to instance_batches
+    XMFLOAT4X3* instance_transforms; // Every batch's local transforms, back to back
+    SceneGraph* scene_graph;
+    u32 num_animations;
+    AnimationClip** animations; // Targeting scene_graph
+    u32 num_skins;
+    Skin* skins; // Joints are scene_graph nodes
+    u32 num_skinned_meshes;
+    SkinnedMesh* skinned_meshes; // Posed with skin_meshes every frame; their instances follow the graph root
+    GLTFLazyMaterials* lazy_materials; // Null unless loaded with lazy_materials
+};
+
+#define GLTF_NO_MATERIAL UINT32_MAX
+
+// Where a load spent its time and how many bytes went through it, for finding out why a scene loads slowly and
+// for diffing loads between asset versions.
+
+enum GLTFLoadStage {
+    GLTF_STAGE_FILE_IO,
+    GLTF_STAGE_JSON_PARSE,
+    GLTF_STAGE_BASE64_DECODE,
+    GLTF_STAGE_MESHOPT_DECODE,
+    GLTF_STAGE_SCENE_PARSE, // Resolving the document into geometries, materials and instances, with deduplication
+    GLTF_STAGE_IMAGE_DECODE,
+    GLTF_STAGE_MIP_GENERATION,
+    GLTF_STAGE_TEXTURE_COMPRESSION,
+    GLTF_STAGE_VERTEX_PROCESSING, // Vertex conversion, welding, optimization, meshlets and LODs
+    GLTF_STAGE_UPLOAD_RECORDING, // Renderer calls creating meshes and materials
+    GLTF_STAGE_COUNT,
 };
 
-LoadGLTFResult load_gltf(Arena* arena, Renderer* renderer, RendererUploadContext* upload_context, char* path);
+#define GLTF_REPORT_TOP_COUNT 8
+
+struct GLTFReportMesh {
+    char name[64]; // The glTF mesh's name and the primitive's index
+    u64 bytes; // Vertices and indices as uploaded
+    u32 vertex_count;
+    u32 index_count;
+};
+
+struct GLTFReportTexture {
+    char name[64]; // The image's uri or name
+    u64 bytes; // The chain as uploaded
+    u32 width;
+    u32 height;
+    u32 mip_count;
+    TextureFormat format;
+};
+
+struct GLTFLoadReport {
+    f32 total_seconds;
+    f32 stage_seconds[GLTF_STAGE_COUNT]; // The rest of the total went to bookkeeping, e.g. hashing images
+    u64 bytes_read; // From files: the document, external buffers and external images
+    u64 bytes_decoded; // Base64 and meshopt buffer data, and decoded image texels before mips
+    u64 bytes_staged; // Written to upload memory
+    u64 bytes_staged_in_place; // Of bytes_staged, written there by the loader rather than copied by the renderer
+    u32 num_meshes;
+    u32 num_textures; // Decoded by this load; images shared through the texture cache aren't counted
+    u32 num_top_meshes;
+    GLTFReportMesh top_meshes[GLTF_REPORT_TOP_COUNT]; // Largest first
+    u32 num_top_textures;
+    GLTFReportTexture top_textures[GLTF_REPORT_TOP_COUNT]; // Largest first
+};
+
+// Fills report if it isn't null. Everything the result points to goes in arena, or with a null arena in a page
+// allocation sized from the document, which gltf_free_result frees.
+LoadGLTFResult load_gltf(Arena* arena, Renderer* renderer, RendererUploadContext* upload_context, TextureCache* texture_cache, GLTFLoadOptions* options, char* path, GLTFLoadReport* report);
+
+char* gltf_load_stage_name(GLTFLoadStage stage);
+
+void gltf_print_load_report(GLTFLoadReport* report);
+
+// The report as a JSON document, null-terminated and pushed to arena.
+char* gltf_load_report_json(Arena* arena, GLTFLoadReport* report);
+
+// Background loading. Parsing, image decoding and mesh processing run on worker threads; the calling thread
+// only records finished items into upload batches, each submitted with its own ticket.
+
+struct GLTFLoader;
+
+// The loader and the result go in arena, which is all that doesn't depend on the document: what the result points
+// to goes in a page allocation sized from the document once it's parsed, which gltf_free_result frees.
+GLTFLoader* gltf_begin_load(Arena* arena, Renderer* renderer, TextureCache* texture_cache, GLTFLoadOptions* options, char* path);
+
+// Call once per frame from the thread that owns the renderer. Copies, records and submits uploads, and appends
+// every instance whose mesh and material batches have completed to the result, in steps it expects to fit in
+// time_slice seconds, so a slice too short for any step does nothing. Returns true once everything has been
+// uploaded and every instance is drawable.
+bool gltf_update_load(GLTFLoader* loader, f32 time_slice);
+
+// Grows in place while loading: instances are drawable, and meshes and mesh infos are in upload order. Materials
+// are indexed by glTF material and filled in as their images upload, but num_materials stays 0 until the load
+// finishes; lazy materials are appended as they're created instead (see gltf_lazy.h). The scene graph and
+// animations are null until the first updates after parsing build them.
+LoadGLTFResult* gltf_loader_result(GLTFLoader* loader);
+
+// Frees the memory a load sized for its result, if it did. The meshes and materials the result holds aren't freed.
+void gltf_free_result(LoadGLTFResult* result);
+
+// The content key of the document's JSON, read on the calling thread. A .glb's binary chunk and the files the
+// document refers to aren't read, so a change to those alone keeps the key.
+TextureContentKey gltf_document_key(char* path);
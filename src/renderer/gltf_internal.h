@@ -0,0 +1,193 @@
+#pragma once
+
+#include "gltf.h"
+#include "animation.h"
+#include "skinning.h"
+#include "mesh_optimizer.h"
+#include "meshopt_decoder.h"
+#include "texture_streaming.h"
+#include "utility/json.h"
+
+// What the glTF loaders share: documents are parsed into scenes in gltf.cpp, lazy materials (gltf_lazy.cpp) create
+// their materials from a scene's images and worlds (gltf_world.cpp) stream cells of a scene, the same way the eager
+// paths create meshes and materials.
+
+struct GLTFBuffer {
+    u64 len;
+    void* memory;
+    File file; // Where a deferred buffer is read from, starting file_offset bytes in, while memory is null
+    u64 file_offset;
+};
+
+// An EXT_meshopt_compression view, as the document describes it.
+struct GLTFCompressedView {
+    GLTFBuffer* buffer; // Null if the view isn't compressed
+    u64 offset;
+    u64 len;
+    u32 stride;
+    u32 count;
+    char* mode;
+    MeshoptFilter filter;
+};
+
+struct GLTFBufferView {
+    GLTFBuffer* buffer;
+    u64 len;
+    u64 offset;
+    u64 stride; // 0 when elements are tightly packed
+    GLTFCompressedView* compression; // Set in deferred documents, whose compressed views are decoded on demand
+};
+
+enum GLTFType {
+    GLTF_BYTE = 0x1400,
+    GLTF_UNSIGNED_BYTE = 0x1401,
+    GLTF_SHORT = 0x1402,
+    GLTF_UNSIGNED_SHORT = 0x1403,
+    GLTF_INT = 0x1404,
+    GLTF_UNSIGNED_INT = 0x1405,
+    GLTF_FLOAT = 0x1406,
+};
+
+struct GLTFAccessor {
+    GLTFBufferView* view;
+    u64 offset;
+    GLTFType type;
+    u32 count;
+    int component_count;
+    bool normalized; // Integer components map to [0, 1] or [-1, 1] (KHR_mesh_quantization)
+    bool has_bounds; // min and max are the document's, for VEC3 accessors that aren't normalized
+    XMFLOAT3 min;
+    XMFLOAT3 max;
+};
+
+struct GLTFImage {
+    char name[64]; // For load reports
+    char* uri;
+    GLTFBufferView* view;
+    bool loaded;
+    Material material;
+};
+
+struct GLTFGeometry {
+    char name[64]; // For load reports: the first mesh and primitive it came from
+    GLTFAccessor* pos;
+    GLTFAccessor* norm;
+    GLTFAccessor* uv;
+    GLTFAccessor* indices;
+    GLTFAccessor* joints; // Null unless skinned
+    GLTFAccessor* weights;
+};
+
+#define GLTF_NO_SKIN UINT32_MAX
+
+// Documents are read whole, or deferred: then only the JSON is read (and embedded base64 buffers, which are part
+// of it), and buffers are left in their files to be read a range at a time with read_gltf_accessor. Files only
+// found in a mounted pak can't be read in ranges, so they're read whole even then.
+struct GLTFDocument {
+    char dir[1024];
+    Json* root;
+    bool deferred;
+    u32 num_buffers;
+    GLTFBuffer* buffers; // Memory is null for buffers without data (EXT_meshopt_compression fallbacks)
+    GLTFCompressedView* compressed_views; // Parallel to bufferViews
+    GLTFBuffer* decoded_views; // Parallel to bufferViews; memory is null unless the view was compressed and decoded
+};
+
+struct GLTFAnimation {
+    u32 num_tracks;
+    AnimationTrackDesc* tracks;
+};
+
+struct GLTFSceneInstance {
+    u32 node; // Index into the scene's node arrays
+    u32 geometry;
+    u32 material;
+    u32 first_transform; // num_transforms > 0 makes this a batch drawn once per transform, relative to the node
+    u32 num_transforms;
+};
+
+// Everything the loaders act on, resolved from the document into flat arrays. Building it never touches the
+// renderer, so background loads build it on the loader thread. Geometries are already deduplicated, and
+// primitives and instances refer to them and to materials by index.
+struct GLTFScene {
+    u32 num_images;
+    GLTFImage* images;
+    u32 num_materials;
+    u32* material_images;
+    u32 num_geometries;
+    GLTFGeometry* geometries;
+    u32 num_instances;
+    GLTFSceneInstance* instances;
+    u32 num_batched_instances; // Instances with transforms
+    u32 num_instance_transforms;
+    XMFLOAT4X3* instance_transforms; // Every node's EXT_mesh_gpu_instancing transforms, back to back
+
+    // Local transforms as authored, for building the scene graph.
+    u32 num_nodes;
+    u32* node_parents;
+    XMVECTOR* node_translations;
+    XMVECTOR* node_rotations;
+    XMVECTOR* node_scales;
+
+    // Track nodes are GLTF node indices until the clips are created.
+    u32 num_animations;
+    GLTFAnimation* animations;
+
+    // Joint nodes are GLTF node indices until the skins are created. A skinned geometry holds a single pose, so it
+    // takes the skin of the first skinned node drawing it, and every instance of it draws that pose.
+    u32 num_skins;
+    Skin* skins;
+    u32* geometry_skins; // Parallel to geometries
+
+    u32 num_primitives;
+    u32 num_deduplicated_primitives;
+    u64 deduplicated_bytes;
+};
+
+struct GLTFMeshStats {
+    VertexCacheStats cache_before;
+    VertexCacheStats cache_after;
+    u64 vertices_before_weld;
+    u64 vertices_after_weld;
+    u64 meshlet_count;
+    u64 meshlet_vertices;
+    u64 meshlet_triangles;
+    u64 index_bytes_u32;
+    u64 index_bytes_uploaded;
+    u64 lod_triangles[MAX_MESH_LODS];
+    u64 vertex_bytes;
+    u64 compact_vertex_bytes;
+};
+
+struct GLTFTextureStats {
+    u32 num_decoded;
+    u32 num_shared;
+    u32 num_mip_levels; // Generated below the decoded images
+    f32 mip_seconds;
+    u32 num_compressed;
+    f32 compress_seconds;
+    u32 num_psnr; // Compressed images measured, when the options ask for it
+    f32 min_psnr;
+    f32 psnr_sum; // Excluding lossless images
+    u32 num_lossless;
+    u64 texture_bytes; // As uploaded
+};
+
+// gltf.cpp
+bool read_gltf_document(Arena* arena, char* path, GLTFDocument* doc, GLTFLoadReport* report);
+bool read_gltf_document_deferred(Arena* arena, char* path, GLTFDocument* doc);
+void close_gltf_document(GLTFDocument* doc);
+GLTFAccessor* read_gltf_accessor(Arena* arena, GLTFAccessor* accessor);
+GLTFGeometry read_gltf_geometry(Arena* arena, GLTFGeometry* geometry);
+void parse_gltf_scene(Arena* arena, GLTFDocument* doc, GLTFScene* scene);
+u32 gltf_instance_graph_node(GLTFScene* scene, GLTFSceneInstance* instance, u32* node_map);
+XMVECTOR* read_accessor_vectors(Arena* arena, GLTFAccessor* accessor);
+Mesh create_geometry_mesh(Arena* arena, Renderer* renderer, RendererUploadContext* upload_context, GLTFLoadOptions* options, GLTFGeometry* geometry, GLTFMeshStats* stats, GLTFMeshInfo* info, GLTFLoadReport* report);
+Material acquire_image_material(Arena* arena, Renderer* renderer, RendererUploadContext* upload_context, TextureCache* texture_cache, GLTFLoadOptions* options, GLTFImage* image, GLTFTextureStats* stats, GLTFLoadReport* report);
+StreamedTexture stream_gltf_image(Arena* arena, TextureStreamer* streamer, GLTFLoadOptions* options, GLTFImage* image, GLTFTextureStats* stats);
+void log_gltf_texture_stats(GLTFLoadOptions* options, u32 num_materials, GLTFTextureStats* stats);
+
+// gltf_lazy.cpp
+GLTFLazyMaterials* build_lazy_gltf_materials(Arena* arena, TextureCache* texture_cache, GLTFLoadOptions* options, GLTFScene* scene, LoadGLTFResult* result);
+u64 lazy_gltf_materials_size(GLTFScene* scene);
+Material lazy_gltf_material(Renderer* renderer, GLTFLazyMaterials* lazy, u32 material);
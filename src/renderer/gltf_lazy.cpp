@@ -0,0 +1,397 @@
+#include <string.h>
+
+#include "gltf_lazy.h"
+#include "gltf_internal.h"
+#include "texture_cache.h"
+
+enum GLTFLazyImageState {
+    GLTF_LAZY_IMAGE_UNREQUESTED,
+    GLTF_LAZY_IMAGE_REQUESTED,
+    GLTF_LAZY_IMAGE_UPLOADING,
+    GLTF_LAZY_IMAGE_READY,
+};
+
+// The images some material uses, decoded as instances using them come into view. Everything lives in the result's
+// arena, which grows by an upload context and ticket for every update that decodes something.
+struct GLTFLazyMaterials {
+    Arena* arena;
+    GLTFLoadOptions options;
+
+    u32 num_images;
+    GLTFImage* images; // Sources copied out of the document, which is gone long before they're decoded
+    GLTFLazyImageState* image_states;
+    RendererUploadTicket** image_tickets; // Set while uploading
+    StreamedTexture* streamed_textures; // Set once decoded, when the options stream textures
+
+    u32 num_materials;
+    u32* material_images; // Parallel to the glTF materials, indexing images
+
+    u32 num_unrequested;
+    u32 num_requested;
+    u32 next_decode;
+    u32* requested; // In request order; each image is requested once
+    u32 num_uploading;
+    u32* uploading;
+    u32 num_ready;
+
+    GLTFTextureStats texture_stats;
+};
+
+// Copies an image's uri or embedded bytes into arena, so decoding it doesn't need the document.
+internal void keep_gltf_image_source(Arena* arena, GLTFImage* image) {
+    if (image->uri) {
+        u64 uri_size = strlen(image->uri) + 1;
+        char* uri = (char*)arena_push(arena, uri_size);
+        memcpy(uri, image->uri, uri_size);
+        image->uri = uri;
+        return;
+    }
+
+    GLTFBuffer* buffer = arena_push_struct(arena, GLTFBuffer);
+    buffer->len = image->view->len;
+    buffer->memory = arena_push(arena, buffer->len);
+    memcpy(buffer->memory, (u8*)image->view->buffer->memory + image->view->offset, buffer->len);
+
+    GLTFBufferView* view = arena_push_struct_zero(arena, GLTFBufferView);
+    view->buffer = buffer;
+    view->len = buffer->len;
+
+    image->view = view;
+}
+
+// Every glTF material using the image holds its own reference, like the eager paths.
+internal void add_lazy_image_materials(GLTFLazyMaterials* lazy, TextureCache* texture_cache, LoadGLTFResult* result, u32 image_index) {
+    Material material = lazy->images[image_index].material;
+    bool first_reference = true;
+
+    for (u32 i = 0; i < lazy->num_materials; ++i) {
+        if (lazy->material_images[i] == image_index) {
+            if (!first_reference) {
+                texture_cache_add_ref(texture_cache, material);
+            }
+            first_reference = false;
+            result->materials[result->num_materials++] = material;
+        }
+    }
+}
+
+// Builds the table for a result whose materials array has room for every glTF material. Images the texture cache
+// already has by uri are ready from the start, as the eager paths would have shared them without decoding.
+GLTFLazyMaterials* build_lazy_gltf_materials(Arena* arena, TextureCache* texture_cache, GLTFLoadOptions* options, GLTFScene* scene, LoadGLTFResult* result) {
+    Scratch scratch = get_scratch(&arena, 1);
+
+    GLTFLazyMaterials* lazy = arena_push_struct_zero(arena, GLTFLazyMaterials);
+    lazy->arena = arena;
+    lazy->options = *options;
+
+    lazy->images = arena_push_array(arena, GLTFImage, scene->num_images);
+    lazy->num_materials = scene->num_materials;
+    lazy->material_images = arena_push_array(arena, u32, scene->num_materials);
+
+    u32* image_map = arena_push_array(scratch.arena, u32, scene->num_images);
+    for (u32 i = 0; i < scene->num_images; ++i) {
+        image_map[i] = UINT32_MAX;
+    }
+
+    for (u32 i = 0; i < scene->num_materials; ++i) {
+        u32 scene_image = scene->material_images[i];
+
+        if (image_map[scene_image] == UINT32_MAX) {
+            GLTFImage* image = &lazy->images[lazy->num_images];
+            *image = scene->images[scene_image];
+            image->loaded = false;
+            keep_gltf_image_source(arena, image);
+
+            image_map[scene_image] = lazy->num_images++;
+        }
+
+        lazy->material_images[i] = image_map[scene_image];
+    }
+
+    lazy->image_states = arena_push_array_zero(arena, GLTFLazyImageState, lazy->num_images);
+    lazy->image_tickets = arena_push_array_zero(arena, RendererUploadTicket*, lazy->num_images);
+    lazy->streamed_textures = arena_push_array_zero(arena, StreamedTexture, lazy->num_images);
+    lazy->requested = arena_push_array(arena, u32, lazy->num_images);
+    lazy->uploading = arena_push_array(arena, u32, lazy->num_images);
+    lazy->num_unrequested = lazy->num_images;
+
+    for (u32 i = 0; i < lazy->num_images; ++i) {
+        GLTFImage* image = &lazy->images[i];
+
+        // Streamed textures aren't shared through the cache.
+        if (!options->texture_streamer && image->uri && texture_cache_acquire_uri(texture_cache, image->uri, &image->material)) {
+            image->loaded = true;
+            lazy->image_states[i] = GLTF_LAZY_IMAGE_READY;
+            --lazy->num_unrequested;
+            ++lazy->num_ready;
+            ++lazy->texture_stats.num_shared;
+
+            add_lazy_image_materials(lazy, texture_cache, result, i);
+        }
+    }
+
+    release_scratch(scratch);
+
+    return lazy;
+}
+
+// The most build_lazy_gltf_materials pushes to its arena, were every image used.
+u64 lazy_gltf_materials_size(GLTFScene* scene) {
+    u64 size = arena_array_size(GLTFLazyMaterials, 1);
+    size += arena_array_size(GLTFImage, scene->num_images) + arena_array_size(u32, scene->num_materials);
+    size += arena_array_size(GLTFLazyImageState, scene->num_images) + arena_array_size(RendererUploadTicket*, scene->num_images);
+    size += arena_array_size(StreamedTexture, scene->num_images) + 2 * arena_array_size(u32, scene->num_images);
+
+    for (u32 i = 0; i < scene->num_images; ++i) {
+        GLTFImage* image = &scene->images[i];
+
+        if (image->uri) {
+            size += arena_push_size(strlen(image->uri) + 1);
+        }
+        else {
+            size += arena_array_size(GLTFBuffer, 1) + arena_push_size(image->view->len) + arena_array_size(GLTFBufferView, 1);
+        }
+    }
+
+    return size;
+}
+
+// What an instance draws with: its material once the image is uploaded, or whatever the streamer has resident of
+// it, and the default material until then.
+Material lazy_gltf_material(Renderer* renderer, GLTFLazyMaterials* lazy, u32 material) {
+    if (material != GLTF_NO_MATERIAL) {
+        u32 image = lazy->material_images[material];
+
+        if (lazy->image_states[image] == GLTF_LAZY_IMAGE_READY) {
+            if (lazy->options.texture_streamer) {
+                return texture_streamer_material(lazy->options.texture_streamer, lazy->streamed_textures[image]);
+            }
+            return lazy->images[image].material;
+        }
+    }
+
+    return renderer_get_default_material(renderer);
+}
+
+// Mirrors the culling shader: the bounds are outside once all eight corners are behind one plane.
+internal bool gltf_bounds_visible(AABB* aabb, XMMATRIX transform, XMVECTOR* frustum) {
+    XMVECTOR corners[8];
+
+    for (int i = 0; i < 8; ++i) {
+        XMVECTOR corner = XMVectorSet(i & 1 ? aabb->max.x : aabb->min.x, i & 2 ? aabb->max.y : aabb->min.y, i & 4 ? aabb->max.z : aabb->min.z, 1.0f);
+        corners[i] = XMVector3Transform(corner, transform);
+    }
+
+    for (int plane = 0; plane < 6; ++plane) {
+        bool any_in_front = false;
+
+        for (int i = 0; i < 8 && !any_in_front; ++i) {
+            any_in_front = XMVectorGetX(XMPlaneDotCoord(frustum[plane], corners[i])) > 0.0f;
+        }
+
+        if (!any_in_front) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Returns true if seeing an instance with material would do something: request its image, or report a use of the
+// streamed texture it became.
+internal bool lazy_material_wants_visibility(GLTFLazyMaterials* lazy, u32 material) {
+    if (material == GLTF_NO_MATERIAL) {
+        return false;
+    }
+
+    GLTFLazyImageState state = lazy->image_states[lazy->material_images[material]];
+    return state == GLTF_LAZY_IMAGE_UNREQUESTED || (state == GLTF_LAZY_IMAGE_READY && lazy->options.texture_streamer);
+}
+
+internal void see_lazy_material(GLTFLazyMaterials* lazy, u32 material, AABB* aabb, XMMATRIX transform) {
+    u32 image = lazy->material_images[material];
+
+    if (lazy->image_states[image] == GLTF_LAZY_IMAGE_UNREQUESTED) {
+        lazy->image_states[image] = GLTF_LAZY_IMAGE_REQUESTED;
+        lazy->requested[lazy->num_requested++] = image;
+        --lazy->num_unrequested;
+    }
+    else {
+        texture_streamer_use(lazy->options.texture_streamer, lazy->streamed_textures[image], aabb, transform);
+    }
+}
+
+void gltf_request_visible_materials(Renderer* renderer, LoadGLTFResult* result, XMVECTOR* frustum) {
+    GLTFLazyMaterials* lazy = result->lazy_materials;
+
+    if (!lazy || (lazy->num_unrequested == 0 && !lazy->options.texture_streamer)) {
+        return;
+    }
+
+    for (u32 i = 0; i < result->num_instances; ++i) {
+        MeshInstance* instance = &result->instances[i];
+        u32 material = result->instance_materials[i];
+
+        if (!lazy_material_wants_visibility(lazy, material)) {
+            continue;
+        }
+
+        AABB aabb = renderer_mesh_aabb(renderer, instance->mesh);
+        if (gltf_bounds_visible(&aabb, instance->transform, frustum)) {
+            see_lazy_material(lazy, material, &aabb, instance->transform);
+        }
+    }
+
+    for (u32 i = 0; i < result->num_instance_batches; ++i) {
+        MeshInstanceBatch* batch = &result->instance_batches[i];
+        u32 material = result->instance_batch_materials[i];
+
+        if (!lazy_material_wants_visibility(lazy, material)) {
+            continue;
+        }
+
+        AABB aabb = renderer_mesh_aabb(renderer, batch->mesh);
+
+        // A request needs one visible instance; a streamed texture's level depends on every one.
+        for (u32 j = 0; j < batch->num_instances && lazy_material_wants_visibility(lazy, material); ++j) {
+            XMMATRIX transform = XMLoadFloat4x3(&batch->local_transforms[j]) * batch->transform;
+
+            if (gltf_bounds_visible(&aabb, transform, frustum)) {
+                see_lazy_material(lazy, material, &aabb, transform);
+            }
+        }
+    }
+}
+
+// Returns true if any upload completed.
+internal bool poll_lazy_gltf_uploads(Renderer* renderer, GLTFLazyMaterials* lazy) {
+    u32 num_still_uploading = 0;
+
+    for (u32 i = 0; i < lazy->num_uploading; ++i) {
+        u32 image = lazy->uploading[i];
+
+        if (renderer_upload_finished(renderer, lazy->image_tickets[image])) {
+            lazy->image_states[image] = GLTF_LAZY_IMAGE_READY;
+            lazy->image_tickets[image] = 0;
+            ++lazy->num_ready;
+        }
+        else {
+            lazy->uploading[num_still_uploading++] = image;
+        }
+    }
+
+    bool any_finished = num_still_uploading < lazy->num_uploading;
+    lazy->num_uploading = num_still_uploading;
+
+    return any_finished;
+}
+
+// Decodes and records the image, or shares a material the cache already has. A shared material waits for the upload
+// of the image it came from if that's still in flight, and for this call's batch otherwise.
+internal void decode_lazy_image(Renderer* renderer, RendererUploadContext* upload_context, TextureCache* texture_cache, LoadGLTFResult* result, u32 image_index) {
+    GLTFLazyMaterials* lazy = result->lazy_materials;
+    GLTFImage* image = &lazy->images[image_index];
+
+    // A streamed texture is drawn with the default material until the streamer has created its tail.
+    if (lazy->options.texture_streamer) {
+        lazy->streamed_textures[image_index] = stream_gltf_image(lazy->arena, lazy->options.texture_streamer, &lazy->options, image, &lazy->texture_stats);
+        lazy->image_states[image_index] = GLTF_LAZY_IMAGE_READY;
+        ++lazy->num_ready;
+        return;
+    }
+
+    u32 num_decoded = lazy->texture_stats.num_decoded;
+    Material material = acquire_image_material(lazy->arena, renderer, upload_context, texture_cache, &lazy->options, image, &lazy->texture_stats, 0);
+
+    lazy->image_states[image_index] = GLTF_LAZY_IMAGE_UPLOADING;
+    lazy->uploading[lazy->num_uploading++] = image_index;
+
+    if (lazy->texture_stats.num_decoded == num_decoded) {
+        for (u32 i = 0; i < lazy->num_uploading - 1; ++i) {
+            GLTFImage* other = &lazy->images[lazy->uploading[i]];
+
+            if (other->material.handle == material.handle) {
+                lazy->image_tickets[image_index] = lazy->image_tickets[lazy->uploading[i]];
+                break;
+            }
+        }
+    }
+
+    add_lazy_image_materials(lazy, texture_cache, result, image_index);
+}
+
+void gltf_update_lazy_materials(Renderer* renderer, TextureCache* texture_cache, LoadGLTFResult* result, f32 time_slice) {
+    GLTFLazyMaterials* lazy = result->lazy_materials;
+
+    if (!lazy) {
+        return;
+    }
+
+    u32 num_ready_before = lazy->num_ready;
+
+    if (lazy->next_decode < lazy->num_requested) {
+        // Streamed textures upload through the streamer.
+        RendererUploadContext* upload_context = 0;
+        if (!lazy->options.texture_streamer) {
+            upload_context = renderer_open_upload_context(lazy->arena, renderer);
+        }
+
+        u32 first_uploading = lazy->num_uploading;
+
+        f32 slice_start = engine_time();
+
+        // At least one image is decoded per call, so a slice shorter than any single decode still makes progress.
+        while (lazy->next_decode < lazy->num_requested) {
+            decode_lazy_image(renderer, upload_context, texture_cache, result, lazy->requested[lazy->next_decode++]);
+
+            if (engine_time() - slice_start >= time_slice) {
+                break;
+            }
+        }
+
+        if (upload_context) {
+            RendererUploadTicket* ticket = renderer_submit_upload_context(lazy->arena, renderer, upload_context);
+
+            for (u32 i = first_uploading; i < lazy->num_uploading; ++i) {
+                u32 image = lazy->uploading[i];
+
+                // Images sharing a material from an earlier batch already wait on that batch.
+                if (!lazy->image_tickets[image]) {
+                    lazy->image_tickets[image] = ticket;
+                }
+            }
+        }
+    }
+
+    // Streamed textures' materials are replaced whenever the streamer's uploads complete, so their instances are
+    // refreshed every frame.
+    if (!poll_lazy_gltf_uploads(renderer, lazy) && !lazy->options.texture_streamer) {
+        return;
+    }
+
+    for (u32 i = 0; i < result->num_instances; ++i) {
+        result->instances[i].material = lazy_gltf_material(renderer, lazy, result->instance_materials[i]);
+    }
+
+    for (u32 i = 0; i < result->num_instance_batches; ++i) {
+        result->instance_batches[i].material = lazy_gltf_material(renderer, lazy, result->instance_batch_materials[i]);
+    }
+
+    if (lazy->num_ready > num_ready_before && lazy->num_ready == lazy->num_images) {
+        log_gltf_texture_stats(&lazy->options, lazy->num_materials, &lazy->texture_stats);
+    }
+}
+
+void gltf_release_streamed_textures(LoadGLTFResult* result) {
+    GLTFLazyMaterials* lazy = result->lazy_materials;
+
+    if (!lazy || !lazy->options.texture_streamer) {
+        return;
+    }
+
+    for (u32 i = 0; i < lazy->num_images; ++i) {
+        if (lazy->image_states[i] == GLTF_LAZY_IMAGE_READY) {
+            texture_streamer_remove(lazy->options.texture_streamer, lazy->streamed_textures[i]);
+        }
+    }
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "gltf.h"
+
+// Lazy materials. A scene loaded with lazy_materials decodes no images up front, except to reuse what the texture
+// cache has by uri: its instances start out drawn with the default material. Each image is requested the first
+// time an instance using it survives culling, then decoded and uploaded, and its instances switch to it once the
+// upload completes. Materials join the result's materials, with their references, as they're created. The images'
+// sources are kept in the result's arena until then, so embedded images stay in memory in encoded form.
+//
+// With a texture_streamer in the options, decoded images become textures of the streamer instead, which aren't
+// shared through the texture cache or held in the result's materials. Each frame, instances inside the frustum
+// report their uses to it, and are drawn with whatever levels it has resident.
+
+// Requests the images of every instance inside the frustum still drawn with a placeholder, testing each instance's
+// bounds the way the renderer culls them. Streamed textures have their uses reported, so call it after
+// texture_streamer_begin_frame and before texture_streamer_update.
+void gltf_request_visible_materials(Renderer* renderer, LoadGLTFResult* result, XMVECTOR* frustum);
+
+// Call once per frame from the thread that owns the renderer; does nothing unless the result has lazy materials.
+// Decodes requested images in request order until time_slice seconds have passed (at least one per call), submits
+// their uploads and switches instances over to every material whose upload has completed.
+void gltf_update_lazy_materials(Renderer* renderer, TextureCache* texture_cache, LoadGLTFResult* result, f32 time_slice);
+
+// Removes the textures a result streams from their streamer. Call before freeing the result.
+void gltf_release_streamed_textures(LoadGLTFResult* result);
@@ -0,0 +1,693 @@
+#include <math.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "gltf_world.h"
+#include "gltf_internal.h"
+#include "texture_cache.h"
+#include "scene_graph.h"
+#include "utility/hash.h"
+
+#define MAX_GLTF_WORLD_BATCHES 8
+#define GLTF_WORLD_BATCH_ARENA_SIZE (16 * 1024)
+
+enum GLTFWorldCellState {
+    GLTF_WORLD_CELL_UNLOADED,
+    GLTF_WORLD_CELL_STREAMING,
+    GLTF_WORLD_CELL_LOADED,
+};
+
+// Instances, batches, geometries and images are ranges of the world's arrays, which are sorted by cell.
+struct GLTFWorldCell {
+    i32 x;
+    i32 z;
+    GLTFWorldCellState state;
+    u64 batch; // Serial of the last upload batch its meshes wait on; its materials are asked about directly
+    f32 distance; // From the camera as of the last update
+    u32 draw_offset; // Of its instances in the draw list, or UINT32_MAX while not drawn
+
+    u32 first_instance;
+    u32 num_instances;
+    u32 first_batch;
+    u32 num_batches;
+    u32 first_geometry;
+    u32 num_geometries;
+    u32 first_image;
+    u32 num_images;
+};
+
+struct GLTFWorldBatch {
+    Arena arena;
+    RendererUploadTicket* ticket;
+};
+
+struct GLTFWorld {
+    Renderer* renderer;
+    TextureCache* texture_cache;
+    GLTFLoadOptions options;
+    GLTFWorldOptions world_options;
+
+    Arena arena; // Everything but this struct, sized to fit and freed when the world is closed
+    GLTFDocument doc; // Deferred, so its buffers are still in their files
+    GLTFScene scene;
+
+    u32 num_cells;
+    GLTFWorldCell* cells;
+
+    MeshInstance* cell_instances; // Meshes and materials are set while the cell is loaded
+    u32* cell_instance_geometries;
+    u32* cell_instance_materials;
+    MeshInstanceBatch* cell_batches;
+    u32* cell_batch_geometries;
+    u32* cell_batch_materials;
+    u32* cell_geometries;
+    u32* cell_images;
+
+    // Shared between cells, held while referenced by a loaded or streaming cell. Images are resident while loaded.
+    u32* geometry_refs;
+    bool* geometry_resident;
+    Mesh* geometry_meshes;
+    u64* geometry_batches;
+    u32* image_refs;
+
+    GLTFWorldBatch batches[MAX_GLTF_WORLD_BATCHES];
+    u32 first_batch;
+    u32 num_batches;
+    u64 num_submitted_batches;
+    u64 num_completed_batches;
+
+    // Geometries and images whose last reference was dropped, freed together at the end of an update unless a cell
+    // streaming in took them back.
+    u32 num_dropped_geometries;
+    u32* dropped_geometries;
+    u32 num_dropped_images;
+    u32* dropped_images;
+
+    GLTFWorldInstances draw;
+    GLTFWorldStats stats;
+};
+
+// From the document's bounds on positions where it gives them, which glTF requires, so opening a world doesn't read
+// its vertices.
+internal AABB gltf_geometry_aabb(GLTFGeometry* geometry) {
+    AABB aabb = {};
+
+    if (geometry->pos->has_bounds) {
+        aabb.min = geometry->pos->min;
+        aabb.max = geometry->pos->max;
+        return aabb;
+    }
+
+    Scratch scratch = get_scratch(0, 0);
+
+    GLTFAccessor* pos = read_gltf_accessor(scratch.arena, geometry->pos);
+    XMVECTOR* positions = read_accessor_vectors(scratch.arena, pos);
+
+    XMVECTOR aabb_min =  XMVectorSplatInfinity();
+    XMVECTOR aabb_max = -XMVectorSplatInfinity();
+
+    for (u32 i = 0; i < pos->count; ++i) {
+        aabb_min = XMVectorMin(aabb_min, positions[i]);
+        aabb_max = XMVectorMax(aabb_max, positions[i]);
+    }
+
+    release_scratch(scratch);
+
+    XMStoreFloat3(&aabb.min, aabb_min);
+    XMStoreFloat3(&aabb.max, aabb_max);
+
+    return aabb;
+}
+
+// Coordinates are offset so that the cell at the origin doesn't get key 0, which the hash map reserves.
+internal u64 gltf_world_cell_key(i32 x, i32 z) {
+    u64 key = ((u64)((u32)x ^ 0x80000000u) << 32) | ((u32)z ^ 0x80000000u);
+    assert(key != 0);
+    return key;
+}
+
+internal u32 find_gltf_world_cell(HashMap* cell_map, u32* num_cells, i32* cell_xs, i32* cell_zs, XMVECTOR center, f32 cell_size) {
+    i32 x = (i32)floorf(XMVectorGetX(center) / cell_size);
+    i32 z = (i32)floorf(XMVectorGetZ(center) / cell_size);
+
+    u64 key = gltf_world_cell_key(x, z);
+    u64 cell;
+
+    if (!hash_map_get(cell_map, key, &cell)) {
+        cell = (*num_cells)++;
+        cell_xs[cell] = x;
+        cell_zs[cell] = z;
+        hash_map_put(cell_map, key, cell);
+    }
+
+    return (u32)cell;
+}
+
+// Opens the document and partitions it, with everything the world keeps going to world_arena.
+internal void build_gltf_world(GLTFWorld* world, Arena* world_arena, char* path) {
+    GLTFWorldOptions* world_options = &world->world_options;
+    GLTFScene* scene = &world->scene;
+
+    if (read_gltf_document_deferred(world_arena, path, &world->doc)) {
+        parse_gltf_scene(world_arena, &world->doc, scene);
+    }
+    else {
+        *scene = {};
+    }
+
+    Scratch scratch = get_scratch(&world_arena, 1);
+
+    // Transforms are baked once, from a graph that's only needed here.
+    u32* node_map = arena_push_array(scratch.arena, u32, scene->num_nodes);
+    SceneGraph* graph = scene_graph_new(scratch.arena, scene->num_nodes, scene->node_parents, scene->node_translations, scene->node_rotations, scene->node_scales, node_map);
+
+    AABB* geometry_aabbs = arena_push_array(scratch.arena, AABB, scene->num_geometries);
+    for (u32 i = 0; i < scene->num_geometries; ++i) {
+        geometry_aabbs[i] = gltf_geometry_aabb(&scene->geometries[i]);
+    }
+
+    // Each instance goes to the cell its bounds are centered in; a batch goes where the centers of its copies are
+    // on average.
+
+    u32* instance_cells = arena_push_array(scratch.arena, u32, scene->num_instances);
+    i32* cell_xs = arena_push_array(scratch.arena, i32, scene->num_instances);
+    i32* cell_zs = arena_push_array(scratch.arena, i32, scene->num_instances);
+    HashMap* cell_map = hash_map_new(scratch.arena, scene->num_instances + 1);
+
+    for (u32 i = 0; i < scene->num_instances; ++i) {
+        GLTFSceneInstance* src = &scene->instances[i];
+        AABB* aabb = &geometry_aabbs[src->geometry];
+
+        XMVECTOR local_center = (XMLoadFloat3(&aabb->min) + XMLoadFloat3(&aabb->max)) * 0.5f;
+        XMMATRIX transform = graph->world_transforms[gltf_instance_graph_node(scene, src, node_map)];
+        XMVECTOR center;
+
+        if (src->num_transforms > 0) {
+            center = XMVectorZero();
+            for (u32 j = 0; j < src->num_transforms; ++j) {
+                center += XMVector3Transform(local_center, XMLoadFloat4x3(&scene->instance_transforms[src->first_transform + j]) * transform);
+            }
+            center /= (f32)src->num_transforms;
+        }
+        else {
+            center = XMVector3Transform(local_center, transform);
+        }
+
+        instance_cells[i] = find_gltf_world_cell(cell_map, &world->num_cells, cell_xs, cell_zs, center, world_options->cell_size);
+    }
+
+    world->cells = arena_push_array_zero(world_arena, GLTFWorldCell, world->num_cells);
+
+    for (u32 i = 0; i < world->num_cells; ++i) {
+        world->cells[i].x = cell_xs[i];
+        world->cells[i].z = cell_zs[i];
+        world->cells[i].draw_offset = UINT32_MAX;
+    }
+
+    for (u32 i = 0; i < scene->num_instances; ++i) {
+        GLTFWorldCell* cell = &world->cells[instance_cells[i]];
+
+        if (scene->instances[i].num_transforms > 0) {
+            ++cell->num_batches;
+        }
+        else {
+            ++cell->num_instances;
+        }
+    }
+
+    u32 num_single_instances = scene->num_instances - scene->num_batched_instances;
+    u32 instance_cursor = 0;
+    u32 batch_cursor = 0;
+
+    for (u32 i = 0; i < world->num_cells; ++i) {
+        GLTFWorldCell* cell = &world->cells[i];
+        cell->first_instance = instance_cursor;
+        cell->first_batch = batch_cursor;
+        instance_cursor += cell->num_instances;
+        batch_cursor += cell->num_batches;
+        cell->num_instances = 0;
+        cell->num_batches = 0;
+    }
+
+    world->cell_instances = arena_push_array_zero(world_arena, MeshInstance, num_single_instances);
+    world->cell_instance_geometries = arena_push_array(world_arena, u32, num_single_instances);
+    world->cell_instance_materials = arena_push_array(world_arena, u32, num_single_instances);
+    world->cell_batches = arena_push_array_zero(world_arena, MeshInstanceBatch, scene->num_batched_instances);
+    world->cell_batch_geometries = arena_push_array(world_arena, u32, scene->num_batched_instances);
+    world->cell_batch_materials = arena_push_array(world_arena, u32, scene->num_batched_instances);
+
+    for (u32 i = 0; i < scene->num_instances; ++i) {
+        GLTFSceneInstance* src = &scene->instances[i];
+        GLTFWorldCell* cell = &world->cells[instance_cells[i]];
+        XMMATRIX transform = graph->world_transforms[gltf_instance_graph_node(scene, src, node_map)];
+
+        if (src->num_transforms > 0) {
+            u32 index = cell->first_batch + cell->num_batches++;
+
+            MeshInstanceBatch* batch = &world->cell_batches[index];
+            batch->transform = transform;
+            batch->num_instances = src->num_transforms;
+            batch->local_transforms = scene->instance_transforms + src->first_transform;
+            batch->lods = arena_push_array_zero(world_arena, u8, src->num_transforms);
+
+            world->cell_batch_geometries[index] = src->geometry;
+            world->cell_batch_materials[index] = src->material;
+        }
+        else {
+            u32 index = cell->first_instance + cell->num_instances++;
+
+            world->cell_instances[index].transform = transform;
+            world->cell_instance_geometries[index] = src->geometry;
+            world->cell_instance_materials[index] = src->material;
+        }
+    }
+
+    // Each cell lists the geometries and images its instances use once, for reference counting.
+
+    u32* geometry_stamps = arena_push_array(scratch.arena, u32, scene->num_geometries);
+    u32* image_stamps = arena_push_array(scratch.arena, u32, scene->num_images);
+    memset(geometry_stamps, 0xFF, scene->num_geometries * sizeof(u32));
+    memset(image_stamps, 0xFF, scene->num_images * sizeof(u32));
+
+    world->cell_geometries = arena_push_array(world_arena, u32, scene->num_instances);
+    world->cell_images = arena_push_array(world_arena, u32, scene->num_instances);
+
+    u32 geometry_cursor = 0;
+    u32 image_cursor = 0;
+
+    for (u32 i = 0; i < world->num_cells; ++i) {
+        GLTFWorldCell* cell = &world->cells[i];
+        cell->first_geometry = geometry_cursor;
+        cell->first_image = image_cursor;
+
+        for (u32 j = 0; j < cell->num_instances + cell->num_batches; ++j) {
+            bool batched = j >= cell->num_instances;
+            u32 geometry = batched ? world->cell_batch_geometries[cell->first_batch + j - cell->num_instances] : world->cell_instance_geometries[cell->first_instance + j];
+            u32 material = batched ? world->cell_batch_materials[cell->first_batch + j - cell->num_instances] : world->cell_instance_materials[cell->first_instance + j];
+
+            if (geometry_stamps[geometry] != i) {
+                geometry_stamps[geometry] = i;
+                world->cell_geometries[geometry_cursor++] = geometry;
+            }
+
+            if (material != GLTF_NO_MATERIAL && image_stamps[scene->material_images[material]] != i) {
+                image_stamps[scene->material_images[material]] = i;
+                world->cell_images[image_cursor++] = scene->material_images[material];
+            }
+        }
+
+        cell->num_geometries = geometry_cursor - cell->first_geometry;
+        cell->num_images = image_cursor - cell->first_image;
+    }
+
+    release_scratch(scratch);
+
+    world->geometry_refs = arena_push_array_zero(world_arena, u32, scene->num_geometries);
+    world->geometry_resident = arena_push_array_zero(world_arena, bool, scene->num_geometries);
+    world->geometry_meshes = arena_push_array(world_arena, Mesh, scene->num_geometries);
+    world->geometry_batches = arena_push_array(world_arena, u64, scene->num_geometries);
+    world->image_refs = arena_push_array_zero(world_arena, u32, scene->num_images);
+
+    for (u32 i = 0; i < MAX_GLTF_WORLD_BATCHES; ++i) {
+        world->batches[i].arena = arena_init(arena_push(world_arena, GLTF_WORLD_BATCH_ARENA_SIZE), GLTF_WORLD_BATCH_ARENA_SIZE);
+    }
+
+    world->dropped_geometries = arena_push_array(world_arena, u32, scene->num_geometries);
+    world->dropped_images = arena_push_array(world_arena, u32, scene->num_images);
+
+    world->draw.instances = arena_push_array(world_arena, MeshInstance, num_single_instances);
+    world->draw.instance_batches = arena_push_array(world_arena, MeshInstanceBatch, scene->num_batched_instances);
+
+    world->stats.num_cells = world->num_cells;
+}
+
+GLTFWorld* gltf_open_world(Arena* arena, Renderer* renderer, TextureCache* texture_cache, GLTFLoadOptions* options, GLTFWorldOptions* world_options, char* path) {
+    assert(world_options->cell_size > 0.0f && world_options->unload_radius >= world_options->load_radius);
+
+    GLTFWorld* world = arena_push_struct_zero(arena, GLTFWorld);
+
+    world->renderer = renderer;
+    world->texture_cache = texture_cache;
+    world->options = *options;
+    world->world_options = *world_options;
+
+    // What a world keeps depends on the document, so it's built once in scratch to measure it and then again in an
+    // arena of just that size. Only the JSON is read, so that's cheap next to streaming.
+    Scratch scratch = get_scratch(&arena, 1);
+
+    GLTFWorld measured = *world;
+    u8* measure_start = scratch.arena->cursor;
+    build_gltf_world(&measured, scratch.arena, path);
+    u64 arena_size = scratch.arena->cursor - measure_start;
+    close_gltf_document(&measured.doc);
+
+    release_scratch(scratch);
+
+    world->arena = arena_init(page_alloc(arena_size), arena_size);
+    build_gltf_world(world, &world->arena, path);
+
+    debug_message("Partitioned '%s' into %u cells of %.1f units, keeping %.1f KB.\n", path, world->num_cells, world_options->cell_size, arena_size / 1024.0f);
+
+    return world;
+}
+
+internal void retire_gltf_world_batches(GLTFWorld* world) {
+    while (world->num_batches > 0) {
+        GLTFWorldBatch* batch = &world->batches[world->first_batch];
+        if (!renderer_upload_finished(world->renderer, batch->ticket)) {
+            break;
+        }
+
+        world->first_batch = (world->first_batch + 1) % MAX_GLTF_WORLD_BATCHES;
+        --world->num_batches;
+        ++world->num_completed_batches;
+    }
+}
+
+internal void add_gltf_world_bytes(GLTFWorldStats* stats, u64 size) {
+    stats->bytes_resident += size;
+
+    if (stats->bytes_resident > stats->peak_bytes_resident) {
+        stats->peak_bytes_resident = stats->bytes_resident;
+    }
+}
+
+// Takes the cell's references, creating what nobody held yet in upload_context.
+internal void load_gltf_world_cell(GLTFWorld* world, GLTFWorldCell* cell, RendererUploadContext* upload_context) {
+    GLTFScene* scene = &world->scene;
+    u64 batch = world->num_submitted_batches + 1;
+
+    cell->batch = 0;
+
+    for (u32 i = 0; i < cell->num_geometries; ++i) {
+        u32 geometry = world->cell_geometries[cell->first_geometry + i];
+
+        ++world->geometry_refs[geometry];
+
+        if (!world->geometry_resident[geometry]) {
+            // The geometry's data is read from the document's files, and is done with once the upload is recorded,
+            // along with the mesh info worlds don't keep.
+            Scratch scratch = get_scratch(0, 0);
+            GLTFMeshStats mesh_stats = {};
+            GLTFMeshInfo mesh_info;
+
+            GLTFGeometry resident = read_gltf_geometry(scratch.arena, &scene->geometries[geometry]);
+            Mesh mesh = create_geometry_mesh(scratch.arena, world->renderer, upload_context, &world->options, &resident, &mesh_stats, &mesh_info, 0);
+            release_scratch(scratch);
+
+            world->geometry_resident[geometry] = true;
+            world->geometry_meshes[geometry] = mesh;
+            world->geometry_batches[geometry] = batch;
+            add_gltf_world_bytes(&world->stats, renderer_mesh_size(world->renderer, mesh));
+        }
+
+        if (world->geometry_batches[geometry] > cell->batch) {
+            cell->batch = world->geometry_batches[geometry];
+        }
+    }
+
+    for (u32 i = 0; i < cell->num_images; ++i) {
+        u32 image_index = world->cell_images[cell->first_image + i];
+        GLTFImage* image = &scene->images[image_index];
+
+        ++world->image_refs[image_index];
+
+        if (!image->loaded) {
+            GLTFTextureStats texture_stats = {};
+
+            Material material = acquire_image_material(&world->arena, world->renderer, upload_context, world->texture_cache, &world->options, image, &texture_stats, 0);
+            add_gltf_world_bytes(&world->stats, renderer_material_size(world->renderer, material));
+        }
+    }
+
+    Material default_material = renderer_get_default_material(world->renderer);
+
+    for (u32 i = 0; i < cell->num_instances; ++i) {
+        u32 index = cell->first_instance + i;
+        u32 material = world->cell_instance_materials[index];
+
+        MeshInstance* instance = &world->cell_instances[index];
+        instance->mesh = world->geometry_meshes[world->cell_instance_geometries[index]];
+        instance->material = material == GLTF_NO_MATERIAL ? default_material : scene->images[scene->material_images[material]].material;
+        instance->lod = 0;
+    }
+
+    for (u32 i = 0; i < cell->num_batches; ++i) {
+        u32 index = cell->first_batch + i;
+        u32 material = world->cell_batch_materials[index];
+
+        MeshInstanceBatch* batch_instance = &world->cell_batches[index];
+        batch_instance->mesh = world->geometry_meshes[world->cell_batch_geometries[index]];
+        batch_instance->material = material == GLTF_NO_MATERIAL ? default_material : scene->images[scene->material_images[material]].material;
+        memset(batch_instance->lods, 0, batch_instance->num_instances);
+    }
+
+    cell->state = GLTF_WORLD_CELL_STREAMING;
+    ++world->stats.cell_loads;
+}
+
+internal void unload_gltf_world_cell(GLTFWorld* world, GLTFWorldCell* cell) {
+    for (u32 i = 0; i < cell->num_geometries; ++i) {
+        u32 geometry = world->cell_geometries[cell->first_geometry + i];
+
+        if (--world->geometry_refs[geometry] == 0) {
+            world->dropped_geometries[world->num_dropped_geometries++] = geometry;
+        }
+    }
+
+    for (u32 i = 0; i < cell->num_images; ++i) {
+        u32 image_index = world->cell_images[cell->first_image + i];
+
+        if (--world->image_refs[image_index] == 0) {
+            world->dropped_images[world->num_dropped_images++] = image_index;
+        }
+    }
+
+    cell->state = GLTF_WORLD_CELL_UNLOADED;
+    ++world->stats.cell_unloads;
+}
+
+// Frees the meshes and releases the materials of dropped resources no cell took back, each in one call.
+internal void free_dropped_gltf_world_resources(GLTFWorld* world) {
+    Scratch scratch = get_scratch(0, 0);
+
+    Mesh* meshes = arena_push_array(scratch.arena, Mesh, world->num_dropped_geometries);
+    Material* materials = arena_push_array(scratch.arena, Material, world->num_dropped_images);
+    u32 num_meshes = 0;
+    u32 num_materials = 0;
+
+    for (u32 i = 0; i < world->num_dropped_geometries; ++i) {
+        u32 geometry = world->dropped_geometries[i];
+
+        if (world->geometry_refs[geometry] == 0 && world->geometry_resident[geometry]) {
+            world->stats.bytes_resident -= renderer_mesh_size(world->renderer, world->geometry_meshes[geometry]);
+            world->geometry_resident[geometry] = false;
+            meshes[num_meshes++] = world->geometry_meshes[geometry];
+        }
+    }
+
+    for (u32 i = 0; i < world->num_dropped_images; ++i) {
+        GLTFImage* image = &world->scene.images[world->dropped_images[i]];
+
+        if (world->image_refs[world->dropped_images[i]] == 0 && image->loaded) {
+            world->stats.bytes_resident -= renderer_material_size(world->renderer, image->material);
+            image->loaded = false;
+            materials[num_materials++] = image->material;
+        }
+    }
+
+    renderer_free_meshes(world->renderer, num_meshes, meshes);
+    texture_cache_release_batch(world->texture_cache, world->renderer, num_materials, materials);
+
+    world->num_dropped_geometries = 0;
+    world->num_dropped_images = 0;
+
+    release_scratch(scratch);
+}
+
+// Materials are asked about one by one, since one shared from the texture cache may still be on its way in
+// another owner's upload.
+internal bool gltf_world_cell_uploaded(GLTFWorld* world, GLTFWorldCell* cell) {
+    if (cell->batch > world->num_completed_batches) {
+        return false;
+    }
+
+    for (u32 i = 0; i < cell->num_images; ++i) {
+        GLTFImage* image = &world->scene.images[world->cell_images[cell->first_image + i]];
+
+        if (!renderer_material_uploaded(world->renderer, image->material)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Returns true if any cell became drawable.
+internal bool finish_gltf_world_cells(GLTFWorld* world) {
+    bool any_finished = false;
+
+    for (u32 i = 0; i < world->num_cells; ++i) {
+        GLTFWorldCell* cell = &world->cells[i];
+
+        if (cell->state == GLTF_WORLD_CELL_STREAMING && gltf_world_cell_uploaded(world, cell)) {
+            cell->state = GLTF_WORLD_CELL_LOADED;
+            any_finished = true;
+        }
+    }
+
+    return any_finished;
+}
+
+internal void rebuild_gltf_world_draw_list(GLTFWorld* world) {
+    GLTFWorldInstances* draw = &world->draw;
+
+    // LODs the renderer wrote back go to the cells first, to keep their hysteresis.
+    for (u32 i = 0; i < world->num_cells; ++i) {
+        GLTFWorldCell* cell = &world->cells[i];
+
+        if (cell->draw_offset != UINT32_MAX && cell->state == GLTF_WORLD_CELL_LOADED) {
+            for (u32 j = 0; j < cell->num_instances; ++j) {
+                world->cell_instances[cell->first_instance + j].lod = draw->instances[cell->draw_offset + j].lod;
+            }
+        }
+    }
+
+    draw->num_instances = 0;
+    draw->num_instance_batches = 0;
+
+    world->stats.num_loaded_cells = 0;
+    world->stats.num_streaming_cells = 0;
+
+    for (u32 i = 0; i < world->num_cells; ++i) {
+        GLTFWorldCell* cell = &world->cells[i];
+        cell->draw_offset = UINT32_MAX;
+
+        if (cell->state == GLTF_WORLD_CELL_STREAMING) {
+            ++world->stats.num_streaming_cells;
+        }
+
+        if (cell->state != GLTF_WORLD_CELL_LOADED) {
+            continue;
+        }
+
+        cell->draw_offset = draw->num_instances;
+
+        memcpy(draw->instances + draw->num_instances, world->cell_instances + cell->first_instance, cell->num_instances * sizeof(MeshInstance));
+        memcpy(draw->instance_batches + draw->num_instance_batches, world->cell_batches + cell->first_batch, cell->num_batches * sizeof(MeshInstanceBatch));
+        draw->num_instances += cell->num_instances;
+        draw->num_instance_batches += cell->num_batches;
+
+        ++world->stats.num_loaded_cells;
+    }
+}
+
+// Distance from the camera to the nearest point of the cell, on the XZ plane.
+internal f32 gltf_world_cell_distance(GLTFWorld* world, GLTFWorldCell* cell, XMVECTOR camera_position) {
+    f32 cell_size = world->world_options.cell_size;
+
+    f32 x = XMVectorGetX(camera_position);
+    f32 z = XMVectorGetZ(camera_position);
+
+    f32 dx = fmaxf(fmaxf(cell->x * cell_size - x, x - (cell->x + 1) * cell_size), 0.0f);
+    f32 dz = fmaxf(fmaxf(cell->z * cell_size - z, z - (cell->z + 1) * cell_size), 0.0f);
+
+    return sqrtf(dx * dx + dz * dz);
+}
+
+struct GLTFWorldCellLoad {
+    f32 distance;
+    u32 cell;
+};
+
+internal int compare_gltf_world_cell_loads(const void* a, const void* b) {
+    f32 da = ((GLTFWorldCellLoad*)a)->distance;
+    f32 db = ((GLTFWorldCellLoad*)b)->distance;
+
+    // Nearest first, and by cell to keep the order deterministic.
+    if (da < db) return -1;
+    if (da > db) return 1;
+    return (int)((GLTFWorldCellLoad*)a)->cell - (int)((GLTFWorldCellLoad*)b)->cell;
+}
+
+void gltf_update_world(GLTFWorld* world, XMVECTOR camera_position, f32 time_slice) {
+    Scratch scratch = get_scratch(0, 0);
+
+    retire_gltf_world_batches(world);
+    bool changed = finish_gltf_world_cells(world);
+
+    GLTFWorldCellLoad* loads = arena_push_array(scratch.arena, GLTFWorldCellLoad, world->num_cells);
+    u32 num_loads = 0;
+
+    for (u32 i = 0; i < world->num_cells; ++i) {
+        GLTFWorldCell* cell = &world->cells[i];
+        cell->distance = gltf_world_cell_distance(world, cell, camera_position);
+
+        if (cell->state == GLTF_WORLD_CELL_LOADED && cell->distance > world->world_options.unload_radius) {
+            unload_gltf_world_cell(world, cell);
+            changed = true;
+        }
+        else if (cell->state == GLTF_WORLD_CELL_UNLOADED && cell->distance < world->world_options.load_radius) {
+            loads[num_loads++] = { cell->distance, i };
+        }
+    }
+
+    // Released first, so a cell streaming in can reacquire what another just dropped before it's freed.
+    if (num_loads > 0 && world->num_batches < MAX_GLTF_WORLD_BATCHES) {
+        qsort(loads, num_loads, sizeof(GLTFWorldCellLoad), compare_gltf_world_cell_loads);
+
+        GLTFWorldBatch* batch = &world->batches[(world->first_batch + world->num_batches) % MAX_GLTF_WORLD_BATCHES];
+        arena_clear(&batch->arena);
+        RendererUploadContext* upload_context = renderer_open_upload_context(&batch->arena, world->renderer);
+
+        f32 slice_start = engine_time();
+
+        // At least one cell is loaded per call, so a slice shorter than any single cell still makes progress.
+        for (u32 i = 0; i < num_loads; ++i) {
+            load_gltf_world_cell(world, &world->cells[loads[i].cell], upload_context);
+
+            if (engine_time() - slice_start >= time_slice) {
+                break;
+            }
+        }
+
+        batch->ticket = renderer_submit_upload_context(&batch->arena, world->renderer, upload_context);
+        ++world->num_batches;
+        ++world->num_submitted_batches;
+        changed = true;
+    }
+
+    free_dropped_gltf_world_resources(world);
+
+    // Uploads that finish straight away are drawable this frame.
+    retire_gltf_world_batches(world);
+    changed = finish_gltf_world_cells(world) || changed;
+
+    if (changed) {
+        rebuild_gltf_world_draw_list(world);
+    }
+
+    release_scratch(scratch);
+}
+
+GLTFWorldInstances gltf_world_instances(GLTFWorld* world) {
+    return world->draw;
+}
+
+GLTFWorldStats gltf_world_stats(GLTFWorld* world) {
+    return world->stats;
+}
+
+void gltf_close_world(GLTFWorld* world) {
+    for (u32 i = 0; i < world->num_cells; ++i) {
+        if (world->cells[i].state != GLTF_WORLD_CELL_UNLOADED) {
+            unload_gltf_world_cell(world, &world->cells[i]);
+        }
+    }
+
+    free_dropped_gltf_world_resources(world);
+    close_gltf_document(&world->doc);
+
+    page_free(world->arena.base);
+    *world = {};
+}
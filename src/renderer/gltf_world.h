@@ -0,0 +1,58 @@
+#pragma once
+
+#include "gltf.h"
+
+// World partition. A scene too large to keep resident is opened as a world instead of being loaded. Its instances
+// are bucketed into a grid of square cells on the XZ plane by the centers of their world-space bounds, and only cells
+// near the camera have their meshes and materials on the GPU: cells within load_radius are streamed in nearest first,
+// and released once they're farther than unload_radius, so cells near the boundary don't stream in and out as the
+// camera moves back and forth. GPU memory is bounded by what the cells within unload_radius hold, however large the
+// world is. So is CPU memory: opening a world reads only the document's JSON, and a cell's vertices, indices and
+// embedded images are read from the document's files as it streams in, and dropped once its uploads are recorded.
+//
+// Meshes and images used by several cells are created once and kept while any of those cells is loaded. Worlds are
+// static: node transforms are baked when the world is opened, animations aren't loaded and skinned meshes keep their
+// bind pose.
+
+struct GLTFWorld;
+
+struct GLTFWorldOptions {
+    f32 cell_size; // Edge length of the cells, in world units
+    f32 load_radius; // Cells whose nearest point is closer than this to the camera, on the XZ plane, are streamed in
+    f32 unload_radius; // Loaded cells are released once they're farther than this; at least load_radius
+};
+
+// What the loaded cells draw. The renderer's LOD write-back into instances is kept across updates.
+struct GLTFWorldInstances {
+    u32 num_instances;
+    MeshInstance* instances;
+    u32 num_instance_batches;
+    MeshInstanceBatch* instance_batches;
+};
+
+struct GLTFWorldStats {
+    u32 num_cells;
+    u32 num_loaded_cells; // Drawn
+    u32 num_streaming_cells; // Waiting for uploads
+    u64 cell_loads;
+    u64 cell_unloads;
+    u64 bytes_resident; // Meshes and materials held for loaded and streaming cells
+    u64 peak_bytes_resident;
+};
+
+// Reads and partitions the document, keeping its files open. Nothing is uploaded until the first update.
+GLTFWorld* gltf_open_world(Arena* arena, Renderer* renderer, TextureCache* texture_cache, GLTFLoadOptions* options, GLTFWorldOptions* world_options, char* path);
+
+// Frees every cell's meshes, releases its materials and closes the document.
+void gltf_close_world(GLTFWorld* world);
+
+// Call once per frame from the thread that owns the renderer. Releases loaded cells beyond unload_radius, streams in
+// cells within load_radius nearest first until time_slice seconds have passed (at least one cell per call), and
+// draws cells once their uploads have completed, including those of materials shared from the texture cache that
+// another owner is still uploading. Cells still streaming are only released after they've loaded.
+void gltf_update_world(GLTFWorld* world, XMVECTOR camera_position, f32 time_slice);
+
+// Valid until the next update.
+GLTFWorldInstances gltf_world_instances(GLTFWorld* world);
+
+GLTFWorldStats gltf_world_stats(GLTFWorld* world);
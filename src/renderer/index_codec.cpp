@@ -0,0 +1,160 @@
+#include <tmmintrin.h>
+#include <string.h>
+
+#include "index_codec.h"
+
+#define INDEX_STREAM_PADDING 16
+
+struct IndexShuffleTable {
+    u8 masks[256][16];
+    u8 lengths[256];
+};
+
+// For every control byte: a pshufb mask that spreads the four variable-length values into u32 lanes, and
+// the total number of data bytes they occupy.
+internal constexpr IndexShuffleTable build_index_shuffle_table() {
+    IndexShuffleTable table = {};
+
+    for (int control = 0; control < 256; ++control) {
+        int offset = 0;
+
+        for (int lane = 0; lane < 4; ++lane) {
+            int length = ((control >> (lane * 2)) & 3) + 1;
+
+            for (int byte = 0; byte < 4; ++byte) {
+                table.masks[control][lane * 4 + byte] = (u8)(byte < length ? offset + byte : 0x80);
+            }
+
+            offset += length;
+        }
+
+        table.lengths[control] = (u8)offset;
+    }
+
+    return table;
+}
+
+global_var constexpr IndexShuffleTable index_shuffle_table = build_index_shuffle_table();
+
+internal u32 zigzag_encode(u32 delta) {
+    return (delta << 1) ^ (u32)((i32)delta >> 31);
+}
+
+internal u32 zigzag_decode(u32 value) {
+    return (value >> 1) ^ (0 - (value & 1));
+}
+
+internal u32 zigzag_length(u32 value) {
+    if (value < (1u << 8)) return 1;
+    if (value < (1u << 16)) return 2;
+    if (value < (1u << 24)) return 3;
+    return 4;
+}
+
+u64 index_stream_bound(u32 index_count) {
+    return (index_count + 3) / 4 + (u64)index_count * 4 + INDEX_STREAM_PADDING;
+}
+
+IndexStream encode_index_stream(Arena* arena, u32* indices, u32 index_count) {
+    Scratch scratch = get_scratch(&arena, 1);
+
+    u64 bound = index_stream_bound(index_count);
+    u8* buffer = arena_push_array_zero(scratch.arena, u8, bound);
+
+    u32 control_size = (index_count + 3) / 4;
+    u8* controls = buffer;
+    u8* data = buffer + control_size;
+
+    u32 previous = 0;
+
+    for (u32 i = 0; i < index_count; ++i) {
+        u32 value = zigzag_encode(indices[i] - previous);
+        u32 length = zigzag_length(value);
+        previous = indices[i];
+
+        controls[i / 4] |= (u8)((length - 1) << ((i % 4) * 2));
+
+        for (u32 byte = 0; byte < length; ++byte) {
+            *data++ = (u8)(value >> (byte * 8));
+        }
+    }
+
+    u64 size = (data - buffer) + INDEX_STREAM_PADDING;
+    assert(size <= bound && size <= UINT32_MAX);
+
+    IndexStream stream = {};
+    stream.index_count = index_count;
+    stream.size = (u32)size;
+    stream.data = arena_push_array(arena, u8, size);
+    memcpy(stream.data, buffer, size);
+
+    release_scratch(scratch);
+
+    return stream;
+}
+
+// Decodes four indices per iteration: shuffle the packed bytes into lanes, undo the zigzag, and prefix-sum
+// the deltas on top of the last index of the previous group. The final partial group is decoded scalar.
+internal void decode_index_stream_internal(IndexStream* stream, u32* dst32, u16* dst16) {
+    u32 group_count = stream->index_count / 4;
+
+    u8* controls = stream->data;
+    u8* data = stream->data + (stream->index_count + 3) / 4;
+
+    __m128i one = _mm_set1_epi32(1);
+    __m128i narrow = _mm_setr_epi8(0, 1, 4, 5, 8, 9, 12, 13, -1, -1, -1, -1, -1, -1, -1, -1);
+    __m128i last = _mm_setzero_si128();
+
+    for (u32 group = 0; group < group_count; ++group) {
+        u8 control = controls[group];
+
+        __m128i packed = _mm_loadu_si128((__m128i*)data);
+        __m128i values = _mm_shuffle_epi8(packed, _mm_loadu_si128((__m128i*)index_shuffle_table.masks[control]));
+        data += index_shuffle_table.lengths[control];
+
+        values = _mm_xor_si128(_mm_srli_epi32(values, 1), _mm_sub_epi32(_mm_setzero_si128(), _mm_and_si128(values, one)));
+
+        values = _mm_add_epi32(values, _mm_slli_si128(values, 4));
+        values = _mm_add_epi32(values, _mm_slli_si128(values, 8));
+        values = _mm_add_epi32(values, last);
+
+        if (dst32) {
+            _mm_storeu_si128((__m128i*)(dst32 + group * 4), values);
+        }
+        else {
+            _mm_storel_epi64((__m128i*)(dst16 + group * 4), _mm_shuffle_epi8(values, narrow));
+        }
+
+        last = _mm_shuffle_epi32(values, _MM_SHUFFLE(3, 3, 3, 3));
+    }
+
+    u32 previous = (u32)_mm_cvtsi128_si32(last);
+
+    for (u32 i = group_count * 4; i < stream->index_count; ++i) {
+        u32 length = ((controls[i / 4] >> ((i % 4) * 2)) & 3) + 1;
+
+        u32 value = 0;
+        for (u32 byte = 0; byte < length; ++byte) {
+            value |= (u32)data[byte] << (byte * 8);
+        }
+
+        data += length;
+        previous += zigzag_decode(value);
+
+        if (dst32) {
+            dst32[i] = previous;
+        }
+        else {
+            assert(previous <= UINT16_MAX);
+            dst16[i] = (u16)previous;
+        }
+    }
+}
+
+void decode_index_stream(IndexStream* stream, u32* dst) {
+    decode_index_stream_internal(stream, dst, 0);
+}
+
+void decode_index_stream_u16(IndexStream* stream, u16* dst) {
+    decode_index_stream_internal(stream, 0, dst);
+}
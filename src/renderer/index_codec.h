@@ -0,0 +1,23 @@
+#pragma once
+
+#include "common.h"
+
+// Compressed triangle list index streams. Each index is stored as the zigzagged delta from the previous one
+// in 1-4 bytes, with a 2-bit length code per index packed four to a control byte (stream vbyte). Streams are
+// self-contained byte blobs, so they can be kept in memory or written to disk as-is.
+//
+// Layout: [ceil(index_count / 4) control bytes] [data bytes] [16 bytes of padding for the decoder's wide loads]
+
+struct IndexStream {
+    u32 index_count;
+    u32 size;
+    u8* data;
+};
+
+u64 index_stream_bound(u32 index_count);
+
+IndexStream encode_index_stream(Arena* arena, u32* indices, u32 index_count);
+
+// SSSE3 decoders; every D3D12-capable x64 CPU supports SSSE3.
+void decode_index_stream(IndexStream* stream, u32* dst);
+void decode_index_stream_u16(IndexStream* stream, u16* dst);
@@ -0,0 +1,34 @@
+#include <math.h>
+
+#include "lod.h"
+
+f32 lod_pixels_per_unit(AABB* aabb, XMMATRIX transform, XMVECTOR camera_position, f32 projection_scale) {
+    XMVECTOR aabb_min = XMLoadFloat3(&aabb->min);
+    XMVECTOR aabb_max = XMLoadFloat3(&aabb->max);
+
+    f32 scale_x = XMVectorGetX(XMVector3LengthSq(transform.r[0]));
+    f32 scale_y = XMVectorGetX(XMVector3LengthSq(transform.r[1]));
+    f32 scale_z = XMVectorGetX(XMVector3LengthSq(transform.r[2]));
+    f32 max_scale = sqrtf(fmaxf(scale_x, fmaxf(scale_y, scale_z)));
+
+    XMVECTOR center = XMVector3Transform((aabb_min + aabb_max) * 0.5f, transform);
+    f32 radius = XMVectorGetX(XMVector3Length(aabb_max - aabb_min)) * 0.5f * max_scale;
+
+    f32 distance = XMVectorGetX(XMVector3Length(center - camera_position)) - radius;
+    distance = fmaxf(distance, 1e-3f);
+
+    return projection_scale * max_scale / distance;
+}
+
+u32 select_mesh_lod(MeshLOD* lods, u32 lod_count, u32 current_lod, f32 pixels_per_unit, f32 max_error_pixels, f32 hysteresis) {
+    for (u32 i = lod_count - 1; i > 0; --i) {
+        f32 projected_error = lods[i].error * pixels_per_unit;
+        f32 limit = i > current_lod ? max_error_pixels * (1.0f - hysteresis) : max_error_pixels;
+
+        if (projected_error <= limit) {
+            return i;
+        }
+    }
+
+    return 0;
+}
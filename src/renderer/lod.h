@@ -0,0 +1,14 @@
+#pragma once
+
+#include "renderer.h"
+
+#define LOD_HYSTERESIS 0.25f
+
+// Pixels covered by one object-space unit at the point of the instance's bounding sphere nearest the camera.
+// projection_scale is viewport_height / (2 * tan(vertical_fov / 2)).
+f32 lod_pixels_per_unit(AABB* aabb, XMMATRIX transform, XMVECTOR camera_position, f32 projection_scale);
+
+// Picks the coarsest LOD whose projected error stays within max_error_pixels. Moving to a coarser level than
+// current_lod additionally requires the error to be (1 - hysteresis) below the limit, so instances sitting near a
+// transition distance don't switch back and forth every frame.
+u32 select_mesh_lod(MeshLOD* lods, u32 lod_count, u32 current_lod, f32 pixels_per_unit, f32 max_error_pixels, f32 hysteresis);
@@ -0,0 +1,926 @@
+#include <float.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mesh_optimizer.h"
+#include "utility/hash.h"
+
+struct TriangleAdjacency {
+    u32* counts;
+    u32* offsets;
+    u32* triangles;
+};
+
+internal TriangleAdjacency build_triangle_adjacency(Arena* arena, u32* indices, u32 index_count, u32 vertex_count) {
+    TriangleAdjacency adjacency = {};
+    adjacency.counts = arena_push_array_zero(arena, u32, vertex_count);
+    adjacency.offsets = arena_push_array(arena, u32, vertex_count);
+    adjacency.triangles = arena_push_array(arena, u32, index_count);
+
+    for (u32 i = 0; i < index_count; ++i) {
+        assert(indices[i] < vertex_count);
+        ++adjacency.counts[indices[i]];
+    }
+
+    u32 offset = 0;
+    for (u32 i = 0; i < vertex_count; ++i) {
+        adjacency.offsets[i] = offset;
+        offset += adjacency.counts[i];
+    }
+
+    for (u32 i = 0; i < index_count; ++i) {
+        adjacency.triangles[adjacency.offsets[indices[i]]++] = i / 3;
+    }
+
+    for (u32 i = 0; i < vertex_count; ++i) {
+        adjacency.offsets[i] -= adjacency.counts[i];
+    }
+
+    return adjacency;
+}
+
+// Cache timestamps implement a FIFO cache without storing it: a vertex is resident if fewer than
+// cache_size misses happened since it was last loaded. Bumping the timestamp by cache_size + 1 flushes it.
+
+internal u32 cache_touch(u32* cache_timestamps, u32* timestamp, u32 cache_size, u32 vertex) {
+    if (*timestamp - cache_timestamps[vertex] > cache_size) {
+        cache_timestamps[vertex] = (*timestamp)++;
+        return 1;
+    }
+    return 0;
+}
+
+internal u32 cache_touch_triangle(u32* cache_timestamps, u32* timestamp, u32 cache_size, u32* triangle) {
+    u32 misses = 0;
+    misses += cache_touch(cache_timestamps, timestamp, cache_size, triangle[0]);
+    misses += cache_touch(cache_timestamps, timestamp, cache_size, triangle[1]);
+    misses += cache_touch(cache_timestamps, timestamp, cache_size, triangle[2]);
+    return misses;
+}
+
+VertexCacheStats analyze_vertex_cache(u32* indices, u32 index_count, u32 vertex_count, u32 cache_size) {
+    Scratch scratch = get_scratch(0, 0);
+
+    u32* cache_timestamps = arena_push_array_zero(scratch.arena, u32, vertex_count);
+    u8* referenced = arena_push_array_zero(scratch.arena, u8, vertex_count);
+    u32 timestamp = cache_size + 1;
+
+    VertexCacheStats stats = {};
+    stats.triangle_count = index_count / 3;
+
+    for (u32 i = 0; i < index_count; ++i) {
+        u32 v = indices[i];
+        assert(v < vertex_count);
+
+        stats.vertices_transformed += cache_touch(cache_timestamps, &timestamp, cache_size, v);
+
+        stats.vertex_count += !referenced[v];
+        referenced[v] = 1;
+    }
+
+    if (stats.triangle_count > 0) {
+        stats.acmr = (f32)stats.vertices_transformed / (f32)stats.triangle_count;
+        stats.atvr = (f32)stats.vertices_transformed / (f32)stats.vertex_count;
+    }
+
+    release_scratch(scratch);
+
+    return stats;
+}
+
+void optimize_vertex_cache(u32* indices, u32 index_count, u32 vertex_count, u32 cache_size) {
+    assert(index_count % 3 == 0);
+
+    if (index_count == 0) {
+        return;
+    }
+
+    Scratch scratch = get_scratch(0, 0);
+
+    u32 triangle_count = index_count / 3;
+
+    TriangleAdjacency adjacency = build_triangle_adjacency(scratch.arena, indices, index_count, vertex_count);
+
+    u32* live_triangles = arena_push_array(scratch.arena, u32, vertex_count);
+    memcpy(live_triangles, adjacency.counts, vertex_count * sizeof(u32));
+
+    u32* cache_timestamps = arena_push_array_zero(scratch.arena, u32, vertex_count);
+    u8* emitted = arena_push_array_zero(scratch.arena, u8, triangle_count);
+
+    u32* dead_end = arena_push_array(scratch.arena, u32, index_count);
+    u32 dead_end_top = 0;
+
+    u32* result = arena_push_array(scratch.arena, u32, index_count);
+    u32 result_count = 0;
+
+    u32 timestamp = cache_size + 1;
+    u32 input_cursor = 1;
+    u32 current = 0;
+
+    while (current != UINT32_MAX) {
+        u32 candidates_begin = dead_end_top;
+
+        // Fan out: emit every remaining triangle around the current vertex.
+
+        u32* neighbours = adjacency.triangles + adjacency.offsets[current];
+        for (u32 i = 0; i < adjacency.counts[current]; ++i) {
+            u32 triangle = neighbours[i];
+            if (emitted[triangle]) {
+                continue;
+            }
+
+            for (u32 k = 0; k < 3; ++k) {
+                u32 v = indices[triangle * 3 + k];
+
+                result[result_count++] = v;
+                dead_end[dead_end_top++] = v;
+
+                --live_triangles[v];
+                cache_touch(cache_timestamps, &timestamp, cache_size, v);
+            }
+
+            emitted[triangle] = 1;
+        }
+
+        // Pick the next fanning vertex: the one among the just-emitted vertices that stays in the cache
+        // longest while its remaining triangles are emitted. Fall back to the dead-end stack, then input order.
+
+        u32 best = UINT32_MAX;
+        i32 best_priority = -1;
+
+        for (u32 i = candidates_begin; i < dead_end_top; ++i) {
+            u32 v = dead_end[i];
+            if (live_triangles[v] == 0) {
+                continue;
+            }
+
+            i32 priority = 0;
+            if (timestamp - cache_timestamps[v] + 2 * live_triangles[v] <= cache_size) {
+                priority = (i32)(timestamp - cache_timestamps[v]);
+            }
+
+            if (priority > best_priority) {
+                best = v;
+                best_priority = priority;
+            }
+        }
+
+        while (best == UINT32_MAX && dead_end_top > 0) {
+            u32 v = dead_end[--dead_end_top];
+            if (live_triangles[v] > 0) {
+                best = v;
+            }
+        }
+
+        while (best == UINT32_MAX && input_cursor < vertex_count) {
+            if (live_triangles[input_cursor] > 0) {
+                best = input_cursor;
+            }
+            ++input_cursor;
+        }
+
+        current = best;
+    }
+
+    assert(result_count == index_count);
+    memcpy(indices, result, index_count * sizeof(u32));
+
+    release_scratch(scratch);
+}
+
+struct WeldKey {
+    i32 components[8];
+};
+
+internal WeldKey quantize_vertex(Vertex* v, f32 inv_epsilon) {
+    f32* src = (f32*)v;
+    WeldKey key;
+
+    for (int i = 0; i < ARRAY_LEN(key.components); ++i) {
+        key.components[i] = (i32)floorf(src[i] * inv_epsilon + 0.5f);
+    }
+
+    return key;
+}
+
+internal u32 hash_weld_key(void* key) {
+    u64 words[4];
+    memcpy(words, key, sizeof(words));
+
+    u64 h = words[0] * 0x9E3779B185EBCA87ull;
+    h ^= words[1] * 0xC2B2AE3D27D4EB4Full;
+    h ^= words[2] * 0x165667B19E3779F9ull;
+    h ^= words[3] * 0x27D4EB2F165667C5ull;
+
+    return (u32)hash_u64(h);
+}
+
+u32 weld_vertices(Vertex* vertices, u32* indices, u32 index_count, u32 vertex_count, f32 epsilon) {
+    static_assert(sizeof(Vertex) == sizeof(WeldKey), "Weld keys quantize every float of the vertex");
+
+    Scratch scratch = get_scratch(0, 0);
+
+    u32 capacity = 16;
+    while (capacity < vertex_count * 2) {
+        capacity *= 2;
+    }
+
+    u32 mask = capacity - 1;
+
+    // Table slots hold compacted vertex ids. Representatives are written to their compacted position
+    // as soon as they are found, so probes compare against already-compacted data.
+
+    u32* table = arena_push_array(scratch.arena, u32, capacity);
+    memset(table, 0xFF, capacity * sizeof(u32));
+
+    u32* remap = arena_push_array(scratch.arena, u32, vertex_count);
+
+    bool quantize = epsilon > 0.0f;
+    f32 inv_epsilon = quantize ? 1.0f / epsilon : 0.0f;
+    WeldKey* keys = quantize ? arena_push_array(scratch.arena, WeldKey, vertex_count) : 0;
+
+    u32 unique_count = 0;
+
+    for (u32 v = 0; v < vertex_count; ++v) {
+        WeldKey key;
+        void* key_data = &vertices[v];
+
+        if (quantize) {
+            key = quantize_vertex(&vertices[v], inv_epsilon);
+            key_data = &key;
+        }
+
+        u32 slot = hash_weld_key(key_data) & mask;
+
+        while (true) {
+            u32 existing = table[slot];
+
+            if (existing == UINT32_MAX) {
+                table[slot] = unique_count;
+                remap[v] = unique_count;
+
+                if (quantize) {
+                    keys[unique_count] = key;
+                }
+
+                vertices[unique_count++] = vertices[v];
+                break;
+            }
+
+            void* existing_data = quantize ? (void*)&keys[existing] : (void*)&vertices[existing];
+            if (memcmp(existing_data, key_data, sizeof(WeldKey)) == 0) {
+                remap[v] = existing;
+                break;
+            }
+
+            slot = (slot + 1) & mask;
+        }
+    }
+
+    for (u32 i = 0; i < index_count; ++i) {
+        assert(indices[i] < vertex_count);
+        indices[i] = remap[indices[i]];
+    }
+
+    release_scratch(scratch);
+
+    return unique_count;
+}
+
+struct ClusterSortKey {
+    f32 key;
+    u32 cluster;
+};
+
+internal int compare_cluster_sort_keys(const void* a, const void* b) {
+    f32 ka = ((ClusterSortKey*)a)->key;
+    f32 kb = ((ClusterSortKey*)b)->key;
+
+    // Descending, so clusters far out along their facing direction draw first and occlude the rest.
+    if (ka > kb) return -1;
+    if (ka < kb) return 1;
+    return 0;
+}
+
+void optimize_overdraw(u32* indices, u32 index_count, Vertex* vertices, u32 vertex_count, u32 cache_size, f32 threshold) {
+    assert(index_count % 3 == 0);
+
+    if (index_count == 0) {
+        return;
+    }
+
+    Scratch scratch = get_scratch(0, 0);
+
+    u32 triangle_count = index_count / 3;
+
+    u32* cache_timestamps = arena_push_array_zero(scratch.arena, u32, vertex_count);
+    u32 timestamp = cache_size + 1;
+
+    // Hard boundaries: a triangle that misses on all three vertices almost always starts a new patch.
+
+    u32* hard_clusters = arena_push_array(scratch.arena, u32, triangle_count);
+    u32 num_hard_clusters = 0;
+
+    for (u32 t = 0; t < triangle_count; ++t) {
+        u32 misses = cache_touch_triangle(cache_timestamps, &timestamp, cache_size, indices + t * 3);
+        if (t == 0 || misses == 3) {
+            hard_clusters[num_hard_clusters++] = t;
+        }
+    }
+
+    // Soft boundaries: split hard clusters further wherever the running ACMR is within threshold of the cluster's.
+
+    u32* clusters = arena_push_array(scratch.arena, u32, triangle_count + 1);
+    u32 num_clusters = 0;
+
+    for (u32 c = 0; c < num_hard_clusters; ++c) {
+        u32 start = hard_clusters[c];
+        u32 end = c + 1 < num_hard_clusters ? hard_clusters[c + 1] : triangle_count;
+
+        timestamp += cache_size + 1;
+
+        u32 cluster_misses = 0;
+        for (u32 t = start; t < end; ++t) {
+            cluster_misses += cache_touch_triangle(cache_timestamps, &timestamp, cache_size, indices + t * 3);
+        }
+
+        f32 cluster_threshold = threshold * (f32)cluster_misses / (f32)(end - start);
+
+        clusters[num_clusters++] = start;
+        timestamp += cache_size + 1;
+
+        u32 running_misses = 0;
+        u32 running_triangles = 0;
+
+        for (u32 t = start; t < end; ++t) {
+            running_misses += cache_touch_triangle(cache_timestamps, &timestamp, cache_size, indices + t * 3);
+            ++running_triangles;
+
+            if ((f32)running_misses / (f32)running_triangles <= cluster_threshold) {
+                clusters[num_clusters++] = t + 1;
+                timestamp += cache_size + 1;
+                running_misses = 0;
+                running_triangles = 0;
+            }
+        }
+
+        if (clusters[num_clusters - 1] == end) {
+            --num_clusters;
+        }
+    }
+
+    clusters[num_clusters] = triangle_count;
+
+    // Sort clusters by how far their area-weighted centroid lies along their average normal, relative to the mesh centroid.
+
+    XMFLOAT3* cluster_centroids = arena_push_array(scratch.arena, XMFLOAT3, num_clusters);
+    XMFLOAT3* cluster_normals = arena_push_array(scratch.arena, XMFLOAT3, num_clusters);
+
+    XMVECTOR mesh_centroid = XMVectorZero();
+    f32 mesh_area = 0.0f;
+
+    for (u32 c = 0; c < num_clusters; ++c) {
+        XMVECTOR centroid = XMVectorZero();
+        XMVECTOR normal = XMVectorZero();
+        f32 area = 0.0f;
+
+        for (u32 t = clusters[c]; t < clusters[c + 1]; ++t) {
+            XMVECTOR p0 = XMLoadFloat3(&vertices[indices[t * 3 + 0]].pos);
+            XMVECTOR p1 = XMLoadFloat3(&vertices[indices[t * 3 + 1]].pos);
+            XMVECTOR p2 = XMLoadFloat3(&vertices[indices[t * 3 + 2]].pos);
+
+            XMVECTOR triangle_normal = XMVector3Cross(p1 - p0, p2 - p0);
+            f32 triangle_area = XMVectorGetX(XMVector3Length(triangle_normal));
+
+            centroid += (p0 + p1 + p2) * (triangle_area / 3.0f);
+            normal += triangle_normal;
+            area += triangle_area;
+        }
+
+        mesh_centroid += centroid;
+        mesh_area += area;
+
+        if (area > 0.0f) {
+            XMStoreFloat3(&cluster_centroids[c], centroid / area);
+        }
+        else {
+            cluster_centroids[c] = vertices[indices[clusters[c] * 3]].pos;
+        }
+
+        XMStoreFloat3(&cluster_normals[c], XMVector3Normalize(normal));
+    }
+
+    if (mesh_area > 0.0f) {
+        mesh_centroid /= mesh_area;
+    }
+
+    ClusterSortKey* sort_keys = arena_push_array(scratch.arena, ClusterSortKey, num_clusters);
+
+    for (u32 c = 0; c < num_clusters; ++c) {
+        XMVECTOR offset = XMLoadFloat3(&cluster_centroids[c]) - mesh_centroid;
+        sort_keys[c].key = XMVectorGetX(XMVector3Dot(offset, XMLoadFloat3(&cluster_normals[c])));
+        sort_keys[c].cluster = c;
+    }
+
+    qsort(sort_keys, num_clusters, sizeof(ClusterSortKey), compare_cluster_sort_keys);
+
+    u32* result = arena_push_array(scratch.arena, u32, index_count);
+    u32 result_count = 0;
+
+    for (u32 i = 0; i < num_clusters; ++i) {
+        u32 c = sort_keys[i].cluster;
+        u32 cluster_index_count = (clusters[c + 1] - clusters[c]) * 3;
+        memcpy(result + result_count, indices + clusters[c] * 3, cluster_index_count * sizeof(u32));
+        result_count += cluster_index_count;
+    }
+
+    assert(result_count == index_count);
+    memcpy(indices, result, index_count * sizeof(u32));
+
+    release_scratch(scratch);
+}
+
+u32 optimize_vertex_fetch(Vertex* vertices, u32* indices, u32 index_count, u32 vertex_count) {
+    Scratch scratch = get_scratch(0, 0);
+
+    Vertex* original = arena_push_array(scratch.arena, Vertex, vertex_count);
+    memcpy(original, vertices, vertex_count * sizeof(Vertex));
+
+    u32* remap = arena_push_array(scratch.arena, u32, vertex_count);
+    memset(remap, 0xFF, vertex_count * sizeof(u32));
+
+    u32 next_vertex = 0;
+
+    for (u32 i = 0; i < index_count; ++i) {
+        u32 v = indices[i];
+        assert(v < vertex_count);
+
+        if (remap[v] == UINT32_MAX) {
+            remap[v] = next_vertex;
+            vertices[next_vertex++] = original[v];
+        }
+
+        indices[i] = remap[v];
+    }
+
+    release_scratch(scratch);
+
+    return next_vertex;
+}
+
+// Symmetric 4x4 error quadric plus the total area it was accumulated from.
+struct Quadric {
+    f64 a00, a01, a02, a03;
+    f64 a11, a12, a13;
+    f64 a22, a23;
+    f64 a33;
+    f64 weight;
+};
+
+internal void quadric_add_plane(Quadric* q, f64 a, f64 b, f64 c, f64 d, f64 weight) {
+    q->a00 += weight * a * a;
+    q->a01 += weight * a * b;
+    q->a02 += weight * a * c;
+    q->a03 += weight * a * d;
+    q->a11 += weight * b * b;
+    q->a12 += weight * b * c;
+    q->a13 += weight * b * d;
+    q->a22 += weight * c * c;
+    q->a23 += weight * c * d;
+    q->a33 += weight * d * d;
+    q->weight += weight;
+}
+
+internal void quadric_add(Quadric* q, Quadric* other) {
+    q->a00 += other->a00;
+    q->a01 += other->a01;
+    q->a02 += other->a02;
+    q->a03 += other->a03;
+    q->a11 += other->a11;
+    q->a12 += other->a12;
+    q->a13 += other->a13;
+    q->a22 += other->a22;
+    q->a23 += other->a23;
+    q->a33 += other->a33;
+    q->weight += other->weight;
+}
+
+// Area-weighted mean squared distance from p to the planes accumulated in a + b.
+internal f64 quadric_error(Quadric* a, Quadric* b, XMFLOAT3 p) {
+    f64 x = p.x, y = p.y, z = p.z;
+
+    f64 a00 = a->a00 + b->a00, a01 = a->a01 + b->a01, a02 = a->a02 + b->a02, a03 = a->a03 + b->a03;
+    f64 a11 = a->a11 + b->a11, a12 = a->a12 + b->a12, a13 = a->a13 + b->a13;
+    f64 a22 = a->a22 + b->a22, a23 = a->a23 + b->a23;
+    f64 a33 = a->a33 + b->a33;
+
+    f64 error = a00 * x * x + 2.0 * a01 * x * y + 2.0 * a02 * x * z + 2.0 * a03 * x
+              + a11 * y * y + 2.0 * a12 * y * z + 2.0 * a13 * y
+              + a22 * z * z + 2.0 * a23 * z
+              + a33;
+
+    f64 weight = a->weight + b->weight;
+    return weight > 0.0 ? fmax(error, 0.0) / weight : 0.0;
+}
+
+internal XMVECTOR triangle_normal(Vertex* vertices, u32 a, u32 b, u32 c) {
+    XMVECTOR p0 = XMLoadFloat3(&vertices[a].pos);
+    XMVECTOR p1 = XMLoadFloat3(&vertices[b].pos);
+    XMVECTOR p2 = XMLoadFloat3(&vertices[c].pos);
+    return XMVector3Cross(p1 - p0, p2 - p0);
+}
+
+struct EdgeCollapse {
+    f32 cost;
+    f32 error;
+    u32 src;
+    u32 dst;
+};
+
+internal int compare_edge_collapses(const void* a, const void* b) {
+    f32 cost_a = ((EdgeCollapse*)a)->cost;
+    f32 cost_b = ((EdgeCollapse*)b)->cost;
+    return (cost_a > cost_b) - (cost_a < cost_b);
+}
+
+f32 point_triangle_distance(XMVECTOR p, XMVECTOR a, XMVECTOR b, XMVECTOR c) {
+    XMVECTOR ab = b - a;
+    XMVECTOR ac = c - a;
+    XMVECTOR closest;
+
+    XMVECTOR ap = p - a;
+    f32 d1 = XMVectorGetX(XMVector3Dot(ab, ap));
+    f32 d2 = XMVectorGetX(XMVector3Dot(ac, ap));
+
+    XMVECTOR bp = p - b;
+    f32 d3 = XMVectorGetX(XMVector3Dot(ab, bp));
+    f32 d4 = XMVectorGetX(XMVector3Dot(ac, bp));
+
+    XMVECTOR cp = p - c;
+    f32 d5 = XMVectorGetX(XMVector3Dot(ab, cp));
+    f32 d6 = XMVectorGetX(XMVector3Dot(ac, cp));
+
+    f32 va = d3 * d6 - d5 * d4;
+    f32 vb = d5 * d2 - d1 * d6;
+    f32 vc = d1 * d4 - d3 * d2;
+
+    if (d1 <= 0.0f && d2 <= 0.0f) {
+        closest = a;
+    }
+    else if (d3 >= 0.0f && d4 <= d3) {
+        closest = b;
+    }
+    else if (d6 >= 0.0f && d5 <= d6) {
+        closest = c;
+    }
+    else if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) {
+        closest = a + ab * (d1 / (d1 - d3));
+    }
+    else if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) {
+        closest = a + ac * (d2 / (d2 - d6));
+    }
+    else if (va <= 0.0f && d4 - d3 >= 0.0f && d5 - d6 >= 0.0f) {
+        closest = b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+    }
+    else {
+        f32 denom = 1.0f / (va + vb + vc);
+        closest = a + ab * (vb * denom) + ac * (vc * denom);
+    }
+
+    return XMVectorGetX(XMVector3Length(p - closest));
+}
+
+// How far src ends up from the triangles around it once it has collapsed onto dst.
+internal f32 collapse_distance(Vertex* vertices, u32* indices, TriangleAdjacency* adjacency, u32 src, u32 dst) {
+    XMVECTOR p = XMLoadFloat3(&vertices[src].pos);
+    f32 distance = XMVectorGetX(XMVector3Length(p - XMLoadFloat3(&vertices[dst].pos)));
+
+    u32* neighbours = adjacency->triangles + adjacency->offsets[src];
+
+    for (u32 i = 0; i < adjacency->counts[src]; ++i) {
+        u32* triangle = indices + neighbours[i] * 3;
+
+        if (triangle[0] == dst || triangle[1] == dst || triangle[2] == dst) {
+            continue;
+        }
+
+        XMVECTOR moved[3];
+        for (u32 k = 0; k < 3; ++k) {
+            moved[k] = XMLoadFloat3(&vertices[triangle[k] == src ? dst : triangle[k]].pos);
+        }
+
+        distance = fminf(distance, point_triangle_distance(p, moved[0], moved[1], moved[2]));
+    }
+
+    return distance;
+}
+
+// How far vertex v is from the triangles around center.
+internal f32 fan_distance(Vertex* vertices, u32* indices, TriangleAdjacency* adjacency, u32 v, u32 center) {
+    XMVECTOR p = XMLoadFloat3(&vertices[v].pos);
+    f32 distance = XMVectorGetX(XMVector3Length(p - XMLoadFloat3(&vertices[center].pos)));
+
+    u32* neighbours = adjacency->triangles + adjacency->offsets[center];
+
+    for (u32 i = 0; i < adjacency->counts[center]; ++i) {
+        u32* triangle = indices + neighbours[i] * 3;
+
+        XMVECTOR a = XMLoadFloat3(&vertices[triangle[0]].pos);
+        XMVECTOR b = XMLoadFloat3(&vertices[triangle[1]].pos);
+        XMVECTOR c = XMLoadFloat3(&vertices[triangle[2]].pos);
+
+        distance = fminf(distance, point_triangle_distance(p, a, b, c));
+    }
+
+    return distance;
+}
+
+// Rejects a collapse if any surviving triangle around src would turn by more than ~75 degrees.
+internal bool collapse_flips_triangles(Vertex* vertices, u32* indices, TriangleAdjacency* adjacency, u32 src, u32 dst) {
+    u32* neighbours = adjacency->triangles + adjacency->offsets[src];
+
+    for (u32 i = 0; i < adjacency->counts[src]; ++i) {
+        u32* triangle = indices + neighbours[i] * 3;
+
+        if (triangle[0] == dst || triangle[1] == dst || triangle[2] == dst) {
+            continue;
+        }
+
+        u32 moved[3];
+        for (u32 k = 0; k < 3; ++k) {
+            moved[k] = triangle[k] == src ? dst : triangle[k];
+        }
+
+        XMVECTOR before = triangle_normal(vertices, triangle[0], triangle[1], triangle[2]);
+        XMVECTOR after = triangle_normal(vertices, moved[0], moved[1], moved[2]);
+
+        f32 d = XMVectorGetX(XMVector3Dot(before, after));
+        f32 lengths = XMVectorGetX(XMVector3Length(before)) * XMVectorGetX(XMVector3Length(after));
+
+        if (d <= 0.25f * lengths) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+u32 simplify_mesh(u32* dst, u32* indices, u32 index_count, Vertex* vertices, u32 vertex_count, u32 target_index_count, f32 max_error, f32 attribute_weight, f32* result_error) {
+    assert(index_count % 3 == 0);
+
+    Scratch scratch = get_scratch(0, 0);
+
+    memcpy(dst, indices, index_count * sizeof(u32));
+    *result_error = 0.0f;
+
+    if (index_count == 0) {
+        release_scratch(scratch);
+        return 0;
+    }
+
+    // Per-vertex quadrics from the area-weighted planes of the surrounding triangles.
+
+    Quadric* quadrics = arena_push_array_zero(scratch.arena, Quadric, vertex_count);
+
+    XMVECTOR aabb_min = XMVectorSplatInfinity();
+    XMVECTOR aabb_max = -XMVectorSplatInfinity();
+
+    for (u32 i = 0; i < index_count; i += 3) {
+        XMVECTOR normal = triangle_normal(vertices, indices[i + 0], indices[i + 1], indices[i + 2]);
+        f32 length = XMVectorGetX(XMVector3Length(normal));
+
+        XMVECTOR p0 = XMLoadFloat3(&vertices[indices[i]].pos);
+        aabb_min = XMVectorMin(aabb_min, p0);
+        aabb_max = XMVectorMax(aabb_max, p0);
+
+        if (length == 0.0f) {
+            continue;
+        }
+
+        normal /= length;
+
+        XMFLOAT3 n;
+        XMStoreFloat3(&n, normal);
+        f32 d = -XMVectorGetX(XMVector3Dot(normal, p0));
+
+        for (u32 k = 0; k < 3; ++k) {
+            quadric_add_plane(&quadrics[indices[i + k]], n.x, n.y, n.z, d, length * 0.5f);
+        }
+    }
+
+    f32 extent = XMVectorGetX(XMVector3Length(aabb_max - aabb_min));
+    f32 inv_extent_sq = extent > 0.0f ? 1.0f / (extent * extent) : 0.0f;
+
+    // Vertices on open edges are locked. After welding, attribute seams show up as open edges too, so this keeps
+    // both mesh borders and UV/normal discontinuities in place.
+
+    u8* locked = arena_push_array_zero(scratch.arena, u8, vertex_count);
+    HashMap* edges = hash_map_new(scratch.arena, index_count);
+
+    for (u32 i = 0; i < index_count; ++i) {
+        u32 a = indices[i];
+        u32 b = indices[i - i % 3 + (i + 1) % 3];
+        hash_map_put(edges, (((u64)a << 32) | b) + 1, 1);
+    }
+
+    for (u32 i = 0; i < index_count; ++i) {
+        u32 a = indices[i];
+        u32 b = indices[i - i % 3 + (i + 1) % 3];
+
+        u64 unused;
+        if (!hash_map_get(edges, (((u64)b << 32) | a) + 1, &unused)) {
+            locked[a] = 1;
+            locked[b] = 1;
+        }
+    }
+
+    u32* remap = arena_push_array(scratch.arena, u32, vertex_count);
+    for (u32 i = 0; i < vertex_count; ++i) {
+        remap[i] = i;
+    }
+
+    EdgeCollapse* best = arena_push_array(scratch.arena, EdgeCollapse, vertex_count);
+    EdgeCollapse* collapses = arena_push_array(scratch.arena, EdgeCollapse, vertex_count);
+    u8* touched = arena_push_array(scratch.arena, u8, vertex_count);
+
+    u32 current_count = index_count;
+
+    // Each pass picks the cheapest collapse per vertex, applies them cheapest first while keeping the
+    // neighbourhoods of collapses disjoint, then rewrites the index buffer.
+
+    while (current_count > target_index_count) {
+        Scratch pass_scratch = get_scratch(&scratch.arena, 1);
+
+        TriangleAdjacency adjacency = build_triangle_adjacency(pass_scratch.arena, dst, current_count, vertex_count);
+
+        for (u32 i = 0; i < vertex_count; ++i) {
+            best[i].cost = FLT_MAX;
+        }
+
+        for (u32 i = 0; i < current_count; ++i) {
+            u32 src = dst[i];
+            u32 target = dst[i - i % 3 + (i + 1) % 3];
+
+            if (locked[src]) {
+                continue;
+            }
+
+            f32 error = (f32)quadric_error(&quadrics[src], &quadrics[target], vertices[target].pos);
+
+            XMVECTOR normal_delta = XMLoadFloat3(&vertices[src].norm) - XMLoadFloat3(&vertices[target].norm);
+            XMVECTOR uv_delta = XMLoadFloat2(&vertices[src].uv) - XMLoadFloat2(&vertices[target].uv);
+            f32 attribute_error = XMVectorGetX(XMVector3LengthSq(normal_delta)) + XMVectorGetX(XMVector2LengthSq(uv_delta));
+
+            f32 cost = error * inv_extent_sq + attribute_weight * attribute_error;
+
+            if (cost < best[src].cost) {
+                best[src].cost = cost;
+                best[src].error = sqrtf(error);
+                best[src].src = src;
+                best[src].dst = target;
+            }
+        }
+
+        u32 collapse_count = 0;
+        for (u32 i = 0; i < vertex_count; ++i) {
+            if (best[i].cost != FLT_MAX) {
+                collapses[collapse_count++] = best[i];
+            }
+        }
+
+        qsort(collapses, collapse_count, sizeof(EdgeCollapse), compare_edge_collapses);
+
+        memset(touched, 0, vertex_count);
+
+        u32 triangles_to_remove = (current_count - target_index_count) / 3;
+        u32 triangles_removed = 0;
+        u32 applied = 0;
+
+        for (u32 i = 0; i < collapse_count && triangles_removed < triangles_to_remove; ++i) {
+            EdgeCollapse* collapse = &collapses[i];
+
+            if (collapse->error > max_error) {
+                break;
+            }
+
+            if (touched[collapse->src] || touched[collapse->dst]) {
+                continue;
+            }
+
+            if (collapse_flips_triangles(vertices, dst, &adjacency, collapse->src, collapse->dst)) {
+                continue;
+            }
+
+            if (collapse_distance(vertices, dst, &adjacency, collapse->src, collapse->dst) > max_error) {
+                continue;
+            }
+
+            u32* neighbours = adjacency.triangles + adjacency.offsets[collapse->src];
+            for (u32 k = 0; k < adjacency.counts[collapse->src]; ++k) {
+                u32* triangle = dst + neighbours[k] * 3;
+                touched[triangle[0]] = 1;
+                touched[triangle[1]] = 1;
+                touched[triangle[2]] = 1;
+
+                triangles_removed += triangle[0] == collapse->dst || triangle[1] == collapse->dst || triangle[2] == collapse->dst;
+            }
+
+            remap[collapse->src] = collapse->dst;
+            quadric_add(&quadrics[collapse->dst], &quadrics[collapse->src]);
+
+            ++applied;
+        }
+
+        release_scratch(pass_scratch);
+
+        if (applied == 0) {
+            break;
+        }
+
+        u32 write = 0;
+        for (u32 i = 0; i < current_count; i += 3) {
+            u32 a = remap[dst[i + 0]];
+            u32 b = remap[dst[i + 1]];
+            u32 c = remap[dst[i + 2]];
+
+            if (a != b && b != c && c != a) {
+                dst[write++] = a;
+                dst[write++] = b;
+                dst[write++] = c;
+            }
+        }
+
+        current_count = write;
+    }
+
+    // The quadric error is an area-weighted mean, so it can report less than the surface actually moved, and
+    // collapses compound. The error reported is measured instead: how far each input vertex ends up from the
+    // triangles around the vertex it collapsed into, which bounds how far it is from the simplified surface.
+
+    TriangleAdjacency adjacency = build_triangle_adjacency(scratch.arena, dst, current_count, vertex_count);
+
+    memset(touched, 0, vertex_count);
+
+    for (u32 i = 0; i < index_count; ++i) {
+        u32 v = indices[i];
+        if (touched[v]) {
+            continue;
+        }
+        touched[v] = 1;
+
+        u32 representative = v;
+        while (remap[representative] != representative) {
+            representative = remap[representative];
+        }
+
+        if (representative != v) {
+            *result_error = fmaxf(*result_error, fan_distance(vertices, dst, &adjacency, v, representative));
+        }
+    }
+
+    release_scratch(scratch);
+
+    return current_count;
+}
+
+u32 build_mesh_lods(u32* dst, MeshLOD* lods, u32 max_lods, u32* indices, u32 index_count, Vertex* vertices, u32 vertex_count, f32 attribute_weight) {
+    assert(max_lods >= 1 && max_lods <= MAX_MESH_LODS);
+
+    memcpy(dst, indices, index_count * sizeof(u32));
+
+    lods[0].index_offset = 0;
+    lods[0].index_count = index_count;
+    lods[0].error = 0.0f;
+
+    u32 lod_count = 1;
+    u32 offset = index_count;
+
+    while (lod_count < max_lods) {
+        MeshLOD* previous = &lods[lod_count - 1];
+
+        u32 target = (previous->index_count / 6) * 3;
+        if (target < 3 * MESH_LOD_MIN_TRIANGLES) {
+            break;
+        }
+
+        f32 error;
+        u32 count = simplify_mesh(dst + offset, dst + previous->index_offset, previous->index_count, vertices, vertex_count, target, FLT_MAX, attribute_weight, &error);
+
+        // Stop once locked borders and seams keep the simplifier from making meaningful progress.
+        if (count > previous->index_count - previous->index_count / 8) {
+            break;
+        }
+
+        optimize_vertex_cache(dst + offset, count, vertex_count, VERTEX_CACHE_SIZE);
+
+        MeshLOD* lod = &lods[lod_count++];
+        lod->index_offset = offset;
+        lod->index_count = count;
+        lod->error = previous->error + error;
+
+        offset += count;
+    }
+
+    return lod_count;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "renderer.h"
+
+// CPU mesh processing run by the loader before geometry is handed to the renderer.
+// All passes operate in place on 32-bit triangle list index buffers.
+
+#define VERTEX_CACHE_SIZE 16
+
+struct VertexCacheStats {
+    u32 triangle_count;
+    u32 vertex_count;
+    u32 vertices_transformed;
+    f32 acmr;
+    f32 atvr;
+};
+
+// Simulates a FIFO post-transform cache. ACMR is transformed vertices per triangle, ATVR is
+// transformed vertices per referenced vertex (1.0 is optimal).
+VertexCacheStats analyze_vertex_cache(u32* indices, u32 index_count, u32 vertex_count, u32 cache_size);
+
+// Merges vertices with identical payloads, or payloads that snap to the same grid cell of size epsilon when
+// epsilon > 0. Rewrites indices, compacts the vertex array and returns the new vertex count.
+u32 weld_vertices(Vertex* vertices, u32* indices, u32 index_count, u32 vertex_count, f32 epsilon);
+
+// Tipsify (Sander et al. 2007): reorders triangles for post-transform cache efficiency.
+void optimize_vertex_cache(u32* indices, u32 index_count, u32 vertex_count, u32 cache_size);
+
+// Splits a cache-optimized index buffer into clusters and sorts them so outward-facing clusters draw first.
+// Threshold bounds the ACMR increase allowed in exchange for smaller clusters (1.05 is a good default).
+void optimize_overdraw(u32* indices, u32 index_count, Vertex* vertices, u32 vertex_count, u32 cache_size, f32 threshold);
+
+// Reorders vertices by first use and drops unreferenced ones. Returns the new vertex count.
+u32 optimize_vertex_fetch(Vertex* vertices, u32* indices, u32 index_count, u32 vertex_count);
+
+// Quadric error edge collapse (Garland & Heckbert 1997). Vertices only collapse onto existing vertices, so the
+// result indexes the same vertex buffer. Vertices on open edges, which include attribute seams after welding,
+// are locked. attribute_weight scales the squared normal and UV difference of a collapse against the squared
+// position error relative to the mesh extent. max_error limits how far each collapse on its own moves the surface.
+// Writes at most index_count indices to dst, returns the new count, and reports the largest object-space error
+// introduced, measured as how far the input vertices end up from the simplified surface. Collapses compound, so
+// that can exceed max_error.
+u32 simplify_mesh(u32* dst, u32* indices, u32 index_count, Vertex* vertices, u32 vertex_count, u32 target_index_count, f32 max_error, f32 attribute_weight, f32* result_error);
+
+// Distance from p to the closest point on triangle abc (Ericson, Real-Time Collision Detection 5.1.5). Degenerate
+// triangles are measured as their edges.
+f32 point_triangle_distance(XMVECTOR p, XMVECTOR a, XMVECTOR b, XMVECTOR c);
+
+#define MESH_LOD_MIN_TRIANGLES 64
+
+// Builds a chain of up to max_lods levels, each targeting half the triangles of the previous one and laid out
+// back to back in dst (which must hold index_count * max_lods indices). LOD 0 is a copy of the input. Errors
+// accumulate down the chain. Returns the number of levels built.
+u32 build_mesh_lods(u32* dst, MeshLOD* lods, u32 max_lods, u32* indices, u32 index_count, Vertex* vertices, u32 vertex_count, f32 attribute_weight);
@@ -0,0 +1,246 @@
+#include <math.h>
+#include <string.h>
+
+#include "meshlet.h"
+
+#define MESHLET_UNASSIGNED 0xFF
+
+// A meshlet is only closed early when the next triangle would overflow its vertices, at which point it already
+// holds at least max_vertices - 2 vertices, each introduced by a distinct index.
+u32 meshlet_count_bound(u32 index_count, u32 max_vertices, u32 max_triangles) {
+    u32 limit_by_vertices = (index_count + max_vertices - 3) / (max_vertices - 2);
+    u32 limit_by_triangles = (index_count / 3 + max_triangles - 1) / max_triangles;
+    return limit_by_vertices > limit_by_triangles ? limit_by_vertices : limit_by_triangles;
+}
+
+MeshletBuildResult build_meshlets(Arena* arena, u32* indices, u32 index_count, u32 vertex_count, u32 max_vertices, u32 max_triangles) {
+    assert(index_count % 3 == 0);
+    assert(max_vertices >= 3 && max_vertices < MESHLET_UNASSIGNED);
+    assert(max_triangles >= 1);
+
+    Scratch scratch = get_scratch(&arena, 1);
+
+    u32 triangle_count = index_count / 3;
+    u32 max_meshlets = meshlet_count_bound(index_count, max_vertices, max_triangles);
+
+    MeshletBuildResult result = {};
+    result.meshlets = arena_push_array(arena, MeshletRange, max_meshlets);
+    result.vertices = arena_push_array(arena, u32, index_count);
+    result.triangles = arena_push_array(arena, u8, index_count);
+
+    u8* local_index = arena_push_array(scratch.arena, u8, vertex_count);
+    memset(local_index, MESHLET_UNASSIGNED, vertex_count);
+
+    MeshletRange current = {};
+
+    for (u32 t = 0; t < triangle_count; ++t) {
+        u32* triangle = indices + t * 3;
+
+        u32 new_vertices = (local_index[triangle[0]] == MESHLET_UNASSIGNED) +
+                           (local_index[triangle[1]] == MESHLET_UNASSIGNED) +
+                           (local_index[triangle[2]] == MESHLET_UNASSIGNED);
+
+        if (current.vertex_count + new_vertices > max_vertices || current.triangle_count == max_triangles) {
+            for (u32 i = 0; i < current.vertex_count; ++i) {
+                local_index[result.vertices[current.vertex_offset + i]] = MESHLET_UNASSIGNED;
+            }
+
+            result.meshlets[result.meshlet_count++] = current;
+
+            current.vertex_offset += current.vertex_count;
+            current.triangle_offset += current.triangle_count;
+            current.vertex_count = 0;
+            current.triangle_count = 0;
+        }
+
+        for (u32 k = 0; k < 3; ++k) {
+            u32 v = triangle[k];
+            assert(v < vertex_count);
+
+            if (local_index[v] == MESHLET_UNASSIGNED) {
+                local_index[v] = (u8)current.vertex_count;
+                result.vertices[current.vertex_offset + current.vertex_count++] = v;
+            }
+
+            result.triangles[(current.triangle_offset + current.triangle_count) * 3 + k] = local_index[v];
+        }
+
+        ++current.triangle_count;
+    }
+
+    if (current.triangle_count > 0) {
+        result.meshlets[result.meshlet_count++] = current;
+    }
+
+    assert(result.meshlet_count <= max_meshlets);
+
+    release_scratch(scratch);
+
+    return result;
+}
+
+void write_meshlet_indices(MeshletBuildResult* build, u32* indices) {
+    for (u32 m = 0; m < build->meshlet_count; ++m) {
+        MeshletRange* meshlet = &build->meshlets[m];
+
+        u32* meshlet_vertices = build->vertices + meshlet->vertex_offset;
+        u8* meshlet_triangles = build->triangles + meshlet->triangle_offset * 3;
+        u32* dst = indices + meshlet->triangle_offset * 3;
+
+        for (u32 i = 0; i < meshlet->triangle_count * 3; ++i) {
+            dst[i] = meshlet_vertices[meshlet_triangles[i]];
+        }
+    }
+}
+
+MeshletBounds compute_meshlet_bounds(MeshletBuildResult* build, MeshletRange* meshlet, Vertex* vertices) {
+    u32* meshlet_vertices = build->vertices + meshlet->vertex_offset;
+    u8* meshlet_triangles = build->triangles + meshlet->triangle_offset * 3;
+
+    MeshletBounds bounds = {};
+
+    // Ritter's bounding sphere: start from the most separated pair of axis extremes, then grow to cover every vertex.
+
+    u32 extremes[6] = {};
+    for (u32 i = 1; i < meshlet->vertex_count; ++i) {
+        XMFLOAT3 p = vertices[meshlet_vertices[i]].pos;
+
+        for (int axis = 0; axis < 3; ++axis) {
+            f32 value = (&p.x)[axis];
+            if (value < (&vertices[meshlet_vertices[extremes[axis * 2 + 0]]].pos.x)[axis]) extremes[axis * 2 + 0] = i;
+            if (value > (&vertices[meshlet_vertices[extremes[axis * 2 + 1]]].pos.x)[axis]) extremes[axis * 2 + 1] = i;
+        }
+    }
+
+    XMVECTOR center = XMVectorZero();
+    f32 radius = -1.0f;
+
+    for (int axis = 0; axis < 3; ++axis) {
+        XMVECTOR a = XMLoadFloat3(&vertices[meshlet_vertices[extremes[axis * 2 + 0]]].pos);
+        XMVECTOR b = XMLoadFloat3(&vertices[meshlet_vertices[extremes[axis * 2 + 1]]].pos);
+        f32 half_span = XMVectorGetX(XMVector3Length(b - a)) * 0.5f;
+
+        if (half_span > radius) {
+            center = (a + b) * 0.5f;
+            radius = half_span;
+        }
+    }
+
+    for (u32 i = 0; i < meshlet->vertex_count; ++i) {
+        XMVECTOR p = XMLoadFloat3(&vertices[meshlet_vertices[i]].pos);
+        f32 distance = XMVectorGetX(XMVector3Length(p - center));
+
+        if (distance > radius) {
+            f32 new_radius = (radius + distance) * 0.5f;
+            center += (p - center) * ((new_radius - radius) / distance);
+            radius = new_radius;
+        }
+    }
+
+    XMStoreFloat3(&bounds.center, center);
+    bounds.radius = radius;
+
+    // Normal cone: the axis is the average triangle normal and the spread is the widest deviation from it.
+    // If the normals span a hemisphere or more the cone is degenerate and a cutoff of 1 disables the test.
+
+    XMVECTOR axis = XMVectorZero();
+
+    for (u32 t = 0; t < meshlet->triangle_count; ++t) {
+        XMVECTOR p0 = XMLoadFloat3(&vertices[meshlet_vertices[meshlet_triangles[t * 3 + 0]]].pos);
+        XMVECTOR p1 = XMLoadFloat3(&vertices[meshlet_vertices[meshlet_triangles[t * 3 + 1]]].pos);
+        XMVECTOR p2 = XMLoadFloat3(&vertices[meshlet_vertices[meshlet_triangles[t * 3 + 2]]].pos);
+
+        XMVECTOR normal = XMVector3Cross(p1 - p0, p2 - p0);
+        if (XMVectorGetX(XMVector3LengthSq(normal)) > 0.0f) {
+            axis += XMVector3Normalize(normal);
+        }
+    }
+
+    bounds.cone_cutoff = 1.0f;
+    bounds.cone_apex = bounds.center;
+
+    if (XMVectorGetX(XMVector3LengthSq(axis)) == 0.0f) {
+        return bounds;
+    }
+
+    axis = XMVector3Normalize(axis);
+    XMStoreFloat3(&bounds.cone_axis, axis);
+
+    f32 min_dot = 1.0f;
+    f32 max_t = 0.0f;
+
+    for (u32 t = 0; t < meshlet->triangle_count; ++t) {
+        XMVECTOR p0 = XMLoadFloat3(&vertices[meshlet_vertices[meshlet_triangles[t * 3 + 0]]].pos);
+        XMVECTOR p1 = XMLoadFloat3(&vertices[meshlet_vertices[meshlet_triangles[t * 3 + 1]]].pos);
+        XMVECTOR p2 = XMLoadFloat3(&vertices[meshlet_vertices[meshlet_triangles[t * 3 + 2]]].pos);
+
+        XMVECTOR normal = XMVector3Cross(p1 - p0, p2 - p0);
+        if (XMVectorGetX(XMVector3LengthSq(normal)) == 0.0f) {
+            continue;
+        }
+
+        normal = XMVector3Normalize(normal);
+
+        f32 d = XMVectorGetX(XMVector3Dot(normal, axis));
+        if (d < min_dot) {
+            min_dot = d;
+        }
+
+        // Pull the apex back along the axis until it is behind every triangle's plane.
+        if (d > 0.0f) {
+            f32 t_plane = XMVectorGetX(XMVector3Dot(center - p0, normal)) / d;
+            if (t_plane > max_t) {
+                max_t = t_plane;
+            }
+        }
+    }
+
+    if (min_dot <= 0.0f) {
+        return bounds;
+    }
+
+    XMStoreFloat3(&bounds.cone_apex, center - axis * max_t);
+    bounds.cone_cutoff = sqrtf(1.0f - min_dot * min_dot);
+
+    return bounds;
+}
+
+bool meshlet_culled(MeshletBounds* bounds, XMMATRIX transform, XMVECTOR* frustum, XMVECTOR camera_position) {
+    f32 scale_x = XMVectorGetX(XMVector3LengthSq(transform.r[0]));
+    f32 scale_y = XMVectorGetX(XMVector3LengthSq(transform.r[1]));
+    f32 scale_z = XMVectorGetX(XMVector3LengthSq(transform.r[2]));
+    f32 max_scale = sqrtf(fmaxf(scale_x, fmaxf(scale_y, scale_z)));
+
+    XMVECTOR center = XMVector3Transform(XMLoadFloat3(&bounds->center), transform);
+    f32 radius = bounds->radius * max_scale;
+
+    for (int i = 0; i < 6; ++i) {
+        if (XMVectorGetX(XMPlaneDotCoord(frustum[i], center)) < -radius) {
+            return true;
+        }
+    }
+
+    if (bounds->cone_cutoff < 1.0f) {
+        XMVECTOR apex = XMVector3Transform(XMLoadFloat3(&bounds->cone_apex), transform);
+        XMVECTOR axis = XMVector3Normalize(XMVector3TransformNormal(XMLoadFloat3(&bounds->cone_axis), transform));
+        XMVECTOR view = XMVector3Normalize(apex - camera_position);
+
+        if (XMVectorGetX(XMVector3Dot(view, axis)) >= bounds->cone_cutoff) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+u32 cull_meshlets(Meshlet* meshlets, u32 meshlet_count, XMMATRIX transform, XMVECTOR* frustum, XMVECTOR camera_position, u32* visible) {
+    u32 visible_count = 0;
+
+    for (u32 i = 0; i < meshlet_count; ++i) {
+        if (!meshlet_culled(&meshlets[i].bounds, transform, frustum, camera_position)) {
+            visible[visible_count++] = i;
+        }
+    }
+
+    return visible_count;
+}
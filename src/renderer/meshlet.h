@@ -0,0 +1,53 @@
+#pragma once
+
+#include "renderer.h"
+
+#define MESHLET_MAX_VERTICES 64
+#define MESHLET_MAX_TRIANGLES 124
+
+struct MeshletRange {
+    u32 vertex_offset;
+    u32 vertex_count;
+    u32 triangle_offset;
+    u32 triangle_count;
+};
+
+struct MeshletBuildResult {
+    u32 meshlet_count;
+    MeshletRange* meshlets;
+    u32* vertices;
+    u8* triangles;
+};
+
+// Greedily packs triangles into meshlets in index buffer order, so the input should already be
+// optimized for vertex cache locality. Each meshlet references at most max_vertices (<= 255) vertices
+// through `vertices` and stores three local vertex indices per triangle in `triangles`.
+MeshletBuildResult build_meshlets(Arena* arena, u32* indices, u32 index_count, u32 vertex_count, u32 max_vertices, u32 max_triangles);
+
+// The most meshlets build_meshlets can make of index_count indices.
+u32 meshlet_count_bound(u32 index_count, u32 max_vertices, u32 max_triangles);
+
+// Rewrites a triangle list index buffer so each meshlet's triangles are contiguous, starting at triangle_offset * 3.
+void write_meshlet_indices(MeshletBuildResult* build, u32* indices);
+
+struct MeshletBounds {
+    XMFLOAT3 center;
+    f32 radius;
+    XMFLOAT3 cone_apex;
+    f32 cone_cutoff;
+    XMFLOAT3 cone_axis;
+    f32 pad0;
+};
+
+MeshletBounds compute_meshlet_bounds(MeshletBuildResult* build, MeshletRange* meshlet, Vertex* vertices);
+
+struct Meshlet {
+    MeshletBounds bounds;
+    u32 index_offset;
+    u32 index_count;
+};
+
+// CPU reference for cluster culling. Frustum planes and camera position are in world space, and the
+// backface cone test assumes the transform has uniform scale and does not mirror.
+bool meshlet_culled(MeshletBounds* bounds, XMMATRIX transform, XMVECTOR* frustum, XMVECTOR camera_position);
+u32 cull_meshlets(Meshlet* meshlets, u32 meshlet_count, XMMATRIX transform, XMVECTOR* frustum, XMVECTOR camera_position, u32* visible);
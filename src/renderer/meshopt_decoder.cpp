@@ -0,0 +1,579 @@
+#include <tmmintrin.h>
+#include <string.h>
+#include <math.h>
+
+#include "meshopt_decoder.h"
+
+#define MESHOPT_VERTEX_HEADER 0xA0
+#define MESHOPT_INDEX_HEADER 0xE0
+#define MESHOPT_SEQUENCE_HEADER 0xD0
+
+#define MESHOPT_BYTE_GROUP_SIZE 16
+#define MESHOPT_BYTE_GROUP_DECODE_LIMIT 24 // Largest group encoding, so a group can be read without bounds checks
+#define MESHOPT_VERTEX_BLOCK_SIZE_BYTES 8192
+#define MESHOPT_VERTEX_BLOCK_MAX_SIZE 256
+#define MESHOPT_TAIL_MIN_SIZE 32
+
+struct MeshoptGroupTable {
+    u8 shuffles[256][8];
+    u8 counts[256];
+};
+
+// For every mask of 8 values that hit the sentinel: a pshufb mask that moves the values stored after the packed
+// bits into those lanes (zeroing the rest), and how many such bytes there are.
+internal constexpr MeshoptGroupTable build_meshopt_group_table() {
+    MeshoptGroupTable table = {};
+
+    for (int mask = 0; mask < 256; ++mask) {
+        int count = 0;
+
+        for (int lane = 0; lane < 8; ++lane) {
+            if (mask & (1 << lane)) {
+                table.shuffles[mask][lane] = (u8)count++;
+            }
+            else {
+                table.shuffles[mask][lane] = 0x80;
+            }
+        }
+
+        table.counts[mask] = (u8)count;
+    }
+
+    return table;
+}
+
+global_var constexpr MeshoptGroupTable meshopt_group_table = build_meshopt_group_table();
+
+// Groups of 16 bytes are stored as 0, 2, 4 or 8 bits per value. Packed values are MSB first; a value equal to the
+// largest one the width can hold is a sentinel, and the real byte follows the packed bits.
+internal u8* decode_byte_group(u8* data, u8* dst, int bits_log2) {
+    __m128i sel;
+    __m128i rest;
+    u32 packed_size;
+
+    switch (bits_log2) {
+        case 0:
+            _mm_storeu_si128((__m128i*)dst, _mm_setzero_si128());
+            return data;
+
+        case 1: {
+            int packed;
+            memcpy(&packed, data, sizeof(packed));
+
+            __m128i sel2 = _mm_cvtsi32_si128(packed);
+            __m128i sel22 = _mm_unpacklo_epi8(_mm_srli_epi16(sel2, 4), sel2);
+            __m128i sel2222 = _mm_unpacklo_epi8(_mm_srli_epi16(sel22, 2), sel22);
+            sel = _mm_and_si128(sel2222, _mm_set1_epi8(3));
+            rest = _mm_loadu_si128((__m128i*)(data + 4));
+            packed_size = 4;
+        } break;
+
+        case 2: {
+            __m128i sel4 = _mm_loadl_epi64((__m128i*)data);
+            __m128i sel44 = _mm_unpacklo_epi8(_mm_srli_epi16(sel4, 4), sel4);
+            sel = _mm_and_si128(sel44, _mm_set1_epi8(15));
+            rest = _mm_loadu_si128((__m128i*)(data + 8));
+            packed_size = 8;
+        } break;
+
+        default:
+            _mm_storeu_si128((__m128i*)dst, _mm_loadu_si128((__m128i*)data));
+            return data + MESHOPT_BYTE_GROUP_SIZE;
+    }
+
+    __m128i sentinel = _mm_set1_epi8(bits_log2 == 1 ? 3 : 15);
+    __m128i mask = _mm_cmpeq_epi8(sel, sentinel);
+
+    int mask16 = _mm_movemask_epi8(mask);
+    u8 mask0 = (u8)(mask16 & 255);
+    u8 mask1 = (u8)(mask16 >> 8);
+
+    // The second half's extra bytes follow the first half's. Unused lanes stay >= 0x80 after the offset.
+    __m128i shuffle0 = _mm_loadl_epi64((__m128i*)meshopt_group_table.shuffles[mask0]);
+    __m128i shuffle1 = _mm_add_epi8(_mm_loadl_epi64((__m128i*)meshopt_group_table.shuffles[mask1]), _mm_set1_epi8((char)meshopt_group_table.counts[mask0]));
+    __m128i shuffle = _mm_unpacklo_epi64(shuffle0, shuffle1);
+
+    __m128i result = _mm_or_si128(_mm_shuffle_epi8(rest, shuffle), _mm_andnot_si128(mask, sel));
+    _mm_storeu_si128((__m128i*)dst, result);
+
+    return data + packed_size + meshopt_group_table.counts[mask0] + meshopt_group_table.counts[mask1];
+}
+
+// A header with two bits per group selects each group's width.
+internal u8* decode_bytes(u8* data, u8* data_end, u8* dst, u32 size) {
+    u8* header = data;
+    u32 header_size = (size / MESHOPT_BYTE_GROUP_SIZE + 3) / 4;
+
+    if ((u64)(data_end - data) < header_size) {
+        return 0;
+    }
+
+    data += header_size;
+
+    for (u32 i = 0; i < size; i += MESHOPT_BYTE_GROUP_SIZE) {
+        if ((u64)(data_end - data) < MESHOPT_BYTE_GROUP_DECODE_LIMIT) {
+            return 0;
+        }
+
+        u32 group = i / MESHOPT_BYTE_GROUP_SIZE;
+        int bits_log2 = (header[group / 4] >> ((group % 4) * 2)) & 3;
+        data = decode_byte_group(data, dst + i, bits_log2);
+    }
+
+    return data;
+}
+
+internal __m128i unzigzag8(__m128i v) {
+    __m128i magnitude = _mm_and_si128(_mm_srli_epi16(v, 1), _mm_set1_epi8(0x7F));
+    __m128i sign = _mm_sub_epi8(_mm_setzero_si128(), _mm_and_si128(v, _mm_set1_epi8(1)));
+    return _mm_xor_si128(magnitude, sign);
+}
+
+// Every byte of the vertex is a separate stream of zigzagged deltas from the same byte of the previous vertex.
+// Streams are decoded four at a time and transposed so each 32-bit lane holds one vertex's bytes; the deltas are
+// then summed across lanes, carrying the previous vertex between groups, and whole dwords are stored.
+internal u8* decode_vertex_block(u8* data, u8* data_end, u8* vertex_data, u32 vertex_count, u32 stride, u8* last_vertex) {
+    u8 buffer[4][MESHOPT_VERTEX_BLOCK_MAX_SIZE];
+    u32 aligned_count = (vertex_count + MESHOPT_BYTE_GROUP_SIZE - 1) & ~(MESHOPT_BYTE_GROUP_SIZE - 1);
+
+    for (u32 k = 0; k < stride; k += 4) {
+        for (u32 j = 0; j < 4; ++j) {
+            data = decode_bytes(data, data_end, buffer[j], aligned_count);
+            if (!data) {
+                return 0;
+            }
+        }
+
+        int previous;
+        memcpy(&previous, last_vertex + k, sizeof(previous));
+        __m128i carry = _mm_set1_epi32(previous);
+
+        u8* dst = vertex_data + k;
+
+        for (u32 i = 0; i < aligned_count; i += MESHOPT_BYTE_GROUP_SIZE) {
+            __m128i s0 = unzigzag8(_mm_loadu_si128((__m128i*)(buffer[0] + i)));
+            __m128i s1 = unzigzag8(_mm_loadu_si128((__m128i*)(buffer[1] + i)));
+            __m128i s2 = unzigzag8(_mm_loadu_si128((__m128i*)(buffer[2] + i)));
+            __m128i s3 = unzigzag8(_mm_loadu_si128((__m128i*)(buffer[3] + i)));
+
+            __m128i s01_lo = _mm_unpacklo_epi8(s0, s1);
+            __m128i s01_hi = _mm_unpackhi_epi8(s0, s1);
+            __m128i s23_lo = _mm_unpacklo_epi8(s2, s3);
+            __m128i s23_hi = _mm_unpackhi_epi8(s2, s3);
+
+            __m128i vertices[4] = {
+                _mm_unpacklo_epi16(s01_lo, s23_lo),
+                _mm_unpackhi_epi16(s01_lo, s23_lo),
+                _mm_unpacklo_epi16(s01_hi, s23_hi),
+                _mm_unpackhi_epi16(s01_hi, s23_hi),
+            };
+
+            for (u32 r = 0; r < 4; ++r) {
+                __m128i v = vertices[r];
+                v = _mm_add_epi8(v, _mm_slli_si128(v, 4));
+                v = _mm_add_epi8(v, _mm_slli_si128(v, 8));
+                v = _mm_add_epi8(v, carry);
+                carry = _mm_shuffle_epi32(v, 0xFF);
+
+                u32 base = i + r * 4;
+                if (base >= vertex_count) {
+                    break;
+                }
+
+                u8* out = dst + (u64)base * stride;
+
+                if (vertex_count - base >= 4) {
+                    int values[4] = {
+                        _mm_cvtsi128_si32(v),
+                        _mm_cvtsi128_si32(_mm_shuffle_epi32(v, 1)),
+                        _mm_cvtsi128_si32(_mm_shuffle_epi32(v, 2)),
+                        _mm_cvtsi128_si32(_mm_shuffle_epi32(v, 3)),
+                    };
+
+                    memcpy(out, &values[0], sizeof(int));
+                    memcpy(out + stride, &values[1], sizeof(int));
+                    memcpy(out + stride * 2, &values[2], sizeof(int));
+                    memcpy(out + stride * 3, &values[3], sizeof(int));
+                }
+                else {
+                    for (u32 l = base; l < vertex_count; ++l) {
+                        int value = _mm_cvtsi128_si32(v);
+                        memcpy(out, &value, sizeof(value));
+                        v = _mm_srli_si128(v, 4);
+                        out += stride;
+                    }
+                }
+            }
+        }
+
+        memcpy(last_vertex + k, dst + (u64)(vertex_count - 1) * stride, 4);
+    }
+
+    return data;
+}
+
+bool meshopt_decode_vertices(void* dst, u32 count, u32 stride, u8* src, u64 size) {
+    if (stride == 0 || stride > 256 || stride % 4 != 0) {
+        return false;
+    }
+
+    if (size < 1 || src[0] != MESHOPT_VERTEX_HEADER) {
+        return false;
+    }
+
+    u8* data = src + 1;
+    u8* data_end = src + size;
+
+    // The first vertex sits at the very end, after zero padding up to the minimum tail size. The padding is what
+    // lets the last groups be read without bounds checks.
+    u32 tail_size = stride < MESHOPT_TAIL_MIN_SIZE ? MESHOPT_TAIL_MIN_SIZE : stride;
+    if ((u64)(data_end - data) < tail_size) {
+        return false;
+    }
+
+    u8 last_vertex[256];
+    memcpy(last_vertex, data_end - stride, stride);
+
+    u32 block_size = (MESHOPT_VERTEX_BLOCK_SIZE_BYTES / stride) & ~(MESHOPT_BYTE_GROUP_SIZE - 1);
+    if (block_size > MESHOPT_VERTEX_BLOCK_MAX_SIZE) {
+        block_size = MESHOPT_VERTEX_BLOCK_MAX_SIZE;
+    }
+
+    for (u32 offset = 0; offset < count; offset += block_size) {
+        u32 block_count = count - offset < block_size ? count - offset : block_size;
+
+        data = decode_vertex_block(data, data_end, (u8*)dst + (u64)offset * stride, block_count, stride, last_vertex);
+        if (!data) {
+            return false;
+        }
+    }
+
+    return (u64)(data_end - data) == tail_size;
+}
+
+internal u32 decode_vbyte(u8** data) {
+    u8* cursor = *data;
+    u8 lead = *cursor++;
+
+    u32 result = lead & 127;
+
+    if (lead >= 128) {
+        u32 shift = 7;
+
+        for (int i = 0; i < 4; ++i) {
+            u8 group = *cursor++;
+            result |= (u32)(group & 127) << shift;
+            shift += 7;
+
+            if (group < 128) {
+                break;
+            }
+        }
+    }
+
+    *data = cursor;
+    return result;
+}
+
+internal u32 decode_index_delta(u8** data, u32 last) {
+    u32 v = decode_vbyte(data);
+    return last + ((v >> 1) ^ (0 - (v & 1)));
+}
+
+internal void write_index(void* dst, u32 index_size, u32 i, u32 value) {
+    if (index_size == 2) {
+        ((u16*)dst)[i] = (u16)value;
+    }
+    else {
+        ((u32*)dst)[i] = value;
+    }
+}
+
+internal void write_triangle(void* dst, u32 index_size, u32 i, u32 a, u32 b, u32 c) {
+    write_index(dst, index_size, i + 0, a);
+    write_index(dst, index_size, i + 1, b);
+    write_index(dst, index_size, i + 2, c);
+}
+
+struct MeshoptIndexFifos {
+    u32 edges[16][2];
+    u32 vertices[16];
+    u32 edge_offset;
+    u32 vertex_offset;
+};
+
+internal void push_edge(MeshoptIndexFifos* fifos, u32 a, u32 b) {
+    fifos->edges[fifos->edge_offset][0] = a;
+    fifos->edges[fifos->edge_offset][1] = b;
+    fifos->edge_offset = (fifos->edge_offset + 1) & 15;
+}
+
+internal void push_vertex(MeshoptIndexFifos* fifos, u32 v, bool advance) {
+    fifos->vertices[fifos->vertex_offset] = v;
+    fifos->vertex_offset = (fifos->vertex_offset + (advance ? 1 : 0)) & 15;
+}
+
+// Each triangle is a code byte: either an edge from a FIFO of recent edges plus a third vertex (new, from a FIFO
+// of recent vertices, or explicit), or three such vertices with the pair of FIFO codes looked up in a 16 entry
+// table stored at the end of the stream. Explicit indices are zigzagged varint deltas from the last one.
+bool meshopt_decode_triangles(void* dst, u32 count, u32 index_size, u8* src, u64 size) {
+    if (count % 3 != 0 || (index_size != 2 && index_size != 4)) {
+        return false;
+    }
+
+    if (size < 1 + count / 3 + 16 || (src[0] & 0xF0) != MESHOPT_INDEX_HEADER) {
+        return false;
+    }
+
+    int version = src[0] & 0x0F;
+    if (version > 1) {
+        return false;
+    }
+
+    MeshoptIndexFifos fifos;
+    memset(&fifos, 0xFF, sizeof(fifos.edges) + sizeof(fifos.vertices));
+    fifos.edge_offset = 0;
+    fifos.vertex_offset = 0;
+
+    u32 next = 0;
+    u32 last = 0;
+    u32 fec_max = version >= 1 ? 13 : 15;
+
+    u8* code = src + 1;
+    u8* data = code + count / 3;
+    u8* data_safe_end = src + size - 16; // A triangle reads at most 16 bytes of data
+    u8* codeaux_table = data_safe_end;
+
+    for (u32 i = 0; i < count; i += 3) {
+        if (data > data_safe_end) {
+            return false;
+        }
+
+        u8 codetri = *code++;
+
+        if (codetri < 0xF0) {
+            u32 fe = codetri >> 4;
+            u32* edge = fifos.edges[(fifos.edge_offset - 1 - fe) & 15];
+            u32 a = edge[0];
+            u32 b = edge[1];
+
+            u32 fec = codetri & 15;
+            u32 c;
+
+            if (fec < fec_max) {
+                bool is_next = fec == 0;
+                c = is_next ? next : fifos.vertices[(fifos.vertex_offset - 1 - fec) & 15];
+                next += is_next ? 1 : 0;
+
+                push_vertex(&fifos, c, is_next);
+            }
+            else {
+                // Version 1 codes 13 and 14 are the last explicit index -1 and +1.
+                c = last = fec != 15 ? last + (fec == 13 ? (u32)-1 : 1u) : decode_index_delta(&data, last);
+                push_vertex(&fifos, c, true);
+            }
+
+            write_triangle(dst, index_size, i, a, b, c);
+
+            push_edge(&fifos, c, b);
+            push_edge(&fifos, a, c);
+        }
+        else {
+            u32 a, b, c;
+            u32 feb, fec;
+
+            if (codetri < 0xFE) {
+                u8 codeaux = codeaux_table[codetri & 15];
+                feb = codeaux >> 4;
+                fec = codeaux & 15;
+
+                a = next++;
+                b = feb == 0 ? next++ : fifos.vertices[(fifos.vertex_offset - feb) & 15];
+                c = fec == 0 ? next++ : fifos.vertices[(fifos.vertex_offset - fec) & 15];
+            }
+            else {
+                u8 codeaux = *data++;
+                u32 fea = codetri == 0xFE ? 0 : 15;
+                feb = codeaux >> 4;
+                fec = codeaux & 15;
+
+                // A zero aux byte that didn't come from the table restarts the new vertex counter.
+                if (codeaux == 0) {
+                    next = 0;
+                }
+
+                a = fea == 0 ? next++ : 0;
+                b = feb == 0 ? next++ : fifos.vertices[(fifos.vertex_offset - feb) & 15];
+                c = fec == 0 ? next++ : fifos.vertices[(fifos.vertex_offset - fec) & 15];
+
+                if (fea == 15) last = a = decode_index_delta(&data, last);
+                if (feb == 15) last = b = decode_index_delta(&data, last);
+                if (fec == 15) last = c = decode_index_delta(&data, last);
+            }
+
+            write_triangle(dst, index_size, i, a, b, c);
+
+            push_vertex(&fifos, a, true);
+            push_vertex(&fifos, b, feb == 0 || feb == 15);
+            push_vertex(&fifos, c, fec == 0 || fec == 15);
+
+            push_edge(&fifos, b, a);
+            push_edge(&fifos, c, b);
+            push_edge(&fifos, a, c);
+        }
+    }
+
+    // The table doubles as padding, so the data has to end exactly where it starts.
+    return data == data_safe_end;
+}
+
+// Indices are zigzagged varint deltas against one of two baselines, picked by the low bit.
+bool meshopt_decode_index_sequence(void* dst, u32 count, u32 index_size, u8* src, u64 size) {
+    if (index_size != 2 && index_size != 4) {
+        return false;
+    }
+
+    if (size < 1 + (u64)count + 4 || (src[0] & 0xF0) != MESHOPT_SEQUENCE_HEADER || (src[0] & 0x0F) > 1) {
+        return false;
+    }
+
+    u8* data = src + 1;
+    u8* data_safe_end = src + size - 4; // An index reads at most 5 bytes
+
+    u32 last[2] = {};
+
+    for (u32 i = 0; i < count; ++i) {
+        if (data >= data_safe_end) {
+            return false;
+        }
+
+        u32 v = decode_vbyte(&data);
+        u32 baseline = v & 1;
+        v >>= 1;
+
+        u32 index = last[baseline] + ((v >> 1) ^ (0 - (v & 1)));
+        last[baseline] = index;
+
+        write_index(dst, index_size, i, index);
+    }
+
+    return data == data_safe_end;
+}
+
+internal i32 round_to_int(f32 x) {
+    return (i32)(x + (x >= 0.0f ? 0.5f : -0.5f));
+}
+
+// Octahedral x and y with z holding the scale 1 is encoded at; the fourth component is left alone.
+internal void decode_filter_octahedral_i8(i8* data, u32 count) {
+    for (u32 i = 0; i < count; ++i) {
+        i8* v = data + i * 4;
+
+        f32 x = (f32)v[0];
+        f32 y = (f32)v[1];
+        f32 z = (f32)v[2] - fabsf(x) - fabsf(y);
+
+        f32 t = z >= 0.0f ? 0.0f : z;
+        x += x >= 0.0f ? t : -t;
+        y += y >= 0.0f ? t : -t;
+
+        f32 s = 127.0f / sqrtf(x * x + y * y + z * z);
+        v[0] = (i8)round_to_int(x * s);
+        v[1] = (i8)round_to_int(y * s);
+        v[2] = (i8)round_to_int(z * s);
+    }
+}
+
+internal void decode_filter_octahedral_i16(i16* data, u32 count) {
+    for (u32 i = 0; i < count; ++i) {
+        i16* v = data + i * 4;
+
+        f32 x = (f32)v[0];
+        f32 y = (f32)v[1];
+        f32 z = (f32)v[2] - fabsf(x) - fabsf(y);
+
+        f32 t = z >= 0.0f ? 0.0f : z;
+        x += x >= 0.0f ? t : -t;
+        y += y >= 0.0f ? t : -t;
+
+        f32 s = 32767.0f / sqrtf(x * x + y * y + z * z);
+        v[0] = (i16)round_to_int(x * s);
+        v[1] = (i16)round_to_int(y * s);
+        v[2] = (i16)round_to_int(z * s);
+    }
+}
+
+// Three components of a unit quaternion plus, in the fourth, the index of the dropped largest one (low two bits)
+// and the scale the others were encoded at.
+internal void decode_filter_quaternion(i16* data, u32 count) {
+    f32 scale = 1.0f / sqrtf(2.0f);
+
+    for (u32 i = 0; i < count; ++i) {
+        i16* q = data + i * 4;
+
+        i32 sf = q[3] | 3;
+        f32 ss = scale / (f32)sf;
+
+        f32 x = (f32)q[0] * ss;
+        f32 y = (f32)q[1] * ss;
+        f32 z = (f32)q[2] * ss;
+
+        f32 ww = 1.0f - x * x - y * y - z * z;
+        f32 w = sqrtf(ww >= 0.0f ? ww : 0.0f);
+
+        i32 qc = q[3] & 3;
+        q[(qc + 1) & 3] = (i16)round_to_int(x * 32767.0f);
+        q[(qc + 2) & 3] = (i16)round_to_int(y * 32767.0f);
+        q[(qc + 3) & 3] = (i16)round_to_int(z * 32767.0f);
+        q[(qc + 0) & 3] = (i16)round_to_int(w * 32767.0f);
+    }
+}
+
+// Each 32-bit value is a 24-bit signed mantissa under an 8-bit signed exponent.
+internal void decode_filter_exponential(u32* data, u32 count) {
+    for (u32 i = 0; i < count; ++i) {
+        i32 mantissa = (i32)(data[i] << 8) >> 8;
+        i32 exponent = (i32)data[i] >> 24;
+
+        u32 bits = (u32)(exponent + 127) << 23;
+        f32 value;
+        memcpy(&value, &bits, sizeof(value));
+        value *= (f32)mantissa;
+
+        memcpy(&data[i], &value, sizeof(value));
+    }
+}
+
+bool meshopt_decode_filter(MeshoptFilter filter, void* data, u32 count, u32 stride) {
+    switch (filter) {
+        case MESHOPT_FILTER_NONE:
+            return true;
+
+        case MESHOPT_FILTER_OCTAHEDRAL:
+            if (stride == 4) {
+                decode_filter_octahedral_i8((i8*)data, count);
+                return true;
+            }
+            if (stride == 8) {
+                decode_filter_octahedral_i16((i16*)data, count);
+                return true;
+            }
+            return false;
+
+        case MESHOPT_FILTER_QUATERNION:
+            if (stride != 8) {
+                return false;
+            }
+            decode_filter_quaternion((i16*)data, count);
+            return true;
+
+        case MESHOPT_FILTER_EXPONENTIAL:
+            if (stride % 4 != 0) {
+                return false;
+            }
+            decode_filter_exponential((u32*)data, count * (stride / 4));
+            return true;
+    }
+
+    return false;
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include "common.h"
+
+// Decoders for the bitstreams of EXT_meshopt_compression: meshoptimizer's vertex codec (version 0) and its index
+// codecs (versions 0 and 1). Each returns false when the data is malformed or doesn't hold exactly count elements.
+
+bool meshopt_decode_vertices(void* dst, u32 count, u32 stride, u8* src, u64 size);
+bool meshopt_decode_triangles(void* dst, u32 count, u32 index_size, u8* src, u64 size);
+bool meshopt_decode_index_sequence(void* dst, u32 count, u32 index_size, u8* src, u64 size);
+
+enum MeshoptFilter {
+    MESHOPT_FILTER_NONE,
+    MESHOPT_FILTER_OCTAHEDRAL,
+    MESHOPT_FILTER_QUATERNION,
+    MESHOPT_FILTER_EXPONENTIAL,
+};
+
+// Undoes a filter in place over count decoded elements of stride bytes. Returns false if the stride doesn't suit
+// the filter.
+bool meshopt_decode_filter(MeshoptFilter filter, void* data, u32 count, u32 stride);
@@ -0,0 +1,317 @@
+#include <emmintrin.h>
+#include <math.h>
+
+#include "mipmap.h"
+#include "utility/work_queue.h"
+
+#define MIP_ROWS_PER_CHUNK 32
+
+// Kaiser-windowed sinc, as NVTT uses for mipmaps: a radius of three destination texels with alpha 4.
+#define KAISER_RADIUS 3.0f
+#define KAISER_ALPHA 4.0f
+
+// Levels below the top are kept as linear unorm16 while the chain is built, so 8-bit rounding doesn't compound
+// from level to level. Both conversions go through tables.
+struct MipTables {
+    f32 srgb_to_linear[256];
+    u8 linear_to_srgb[65536];
+    u8 linear_to_unorm8[65536];
+};
+
+global_var MipTables mip_tables;
+
+internal bool build_mip_tables() {
+    for (u32 i = 0; i < 256; ++i) {
+        f32 c = i / 255.0f;
+        mip_tables.srgb_to_linear[i] = c <= 0.04045f ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+    }
+
+    for (u32 i = 0; i < 65536; ++i) {
+        f32 c = i / 65535.0f;
+        f32 srgb = c <= 0.0031308f ? c * 12.92f : 1.055f * powf(c, 1.0f / 2.4f) - 0.055f;
+        mip_tables.linear_to_srgb[i] = (u8)(srgb * 255.0f + 0.5f);
+        mip_tables.linear_to_unorm8[i] = (u8)((i * 255 + 32767) / 65535);
+    }
+
+    return true;
+}
+
+global_var bool mip_tables_built = build_mip_tables();
+
+u32 mip_level_count(u32 width, u32 height) {
+    u32 size = width > height ? width : height;
+
+    u32 levels = 1;
+    while (size > 1) {
+        size /= 2;
+        ++levels;
+    }
+
+    return levels;
+}
+
+u64 mip_chain_texels(u32 width, u32 height, u32 num_levels) {
+    u64 texels = 0;
+
+    for (u32 i = 0; i < num_levels; ++i) {
+        texels += (u64)width * height;
+        width = width > 1 ? width / 2 : 1;
+        height = height > 1 ? height / 2 : 1;
+    }
+
+    return texels;
+}
+
+// Each destination texel along one axis reads a contiguous run of source texels.
+struct MipTaps {
+    u32 max_count;
+    u32* first;
+    u32* count;
+    f32* weights; // max_count per destination texel
+};
+
+internal f32 bessel_i0(f32 x) {
+    f32 sum = 1.0f;
+    f32 term = 1.0f;
+
+    for (int k = 1; k < 32 && term > sum * 1e-8f; ++k) {
+        f32 t = x / (2.0f * k);
+        term *= t * t;
+        sum += term;
+    }
+
+    return sum;
+}
+
+// x is in destination texels.
+internal f32 kaiser_kernel(f32 x) {
+    if (fabsf(x) >= KAISER_RADIUS) {
+        return 0.0f;
+    }
+
+    f32 pi_x = 3.14159265f * x;
+    f32 sinc = x == 0.0f ? 1.0f : sinf(pi_x) / pi_x;
+    f32 t = x / KAISER_RADIUS;
+
+    return sinc * bessel_i0(KAISER_ALPHA * sqrtf(1.0f - t * t)) / bessel_i0(KAISER_ALPHA);
+}
+
+// Destination texel d covers source texels [d * scale, (d + 1) * scale). The box weights each source texel by its
+// overlap with that span; the Kaiser kernel is stretched by scale. Taps past an edge fold onto the edge texel.
+internal MipTaps build_mip_taps(Arena* arena, MipFilter filter, u32 src_size, u32 dst_size) {
+    f32 scale = (f32)src_size / (f32)dst_size;
+    f32 radius = filter == MIP_FILTER_BOX ? 0.5f * scale : KAISER_RADIUS * scale;
+
+    MipTaps taps;
+    taps.max_count = (u32)ceilf(2.0f * radius) + 2;
+    if (taps.max_count > src_size) {
+        taps.max_count = src_size;
+    }
+
+    taps.first = arena_push_array(arena, u32, dst_size);
+    taps.count = arena_push_array(arena, u32, dst_size);
+    taps.weights = arena_push_array_zero(arena, f32, (u64)dst_size * taps.max_count);
+
+    for (u32 d = 0; d < dst_size; ++d) {
+        f32 center = (d + 0.5f) * scale;
+        i32 lo = (i32)floorf(center - radius);
+        i32 hi = (i32)ceilf(center + radius) - 1;
+
+        i32 first = lo > 0 ? lo : 0;
+        i32 last = hi < (i32)src_size - 1 ? hi : (i32)src_size - 1;
+
+        taps.first[d] = (u32)first;
+        taps.count[d] = (u32)(last - first + 1);
+        assert(taps.count[d] <= taps.max_count);
+
+        f32* weights = taps.weights + (u64)d * taps.max_count;
+        f32 total = 0.0f;
+
+        for (i32 i = lo; i <= hi; ++i) {
+            f32 weight;
+            if (filter == MIP_FILTER_BOX) {
+                f32 begin = fmaxf((f32)i, center - radius);
+                f32 end = fminf((f32)(i + 1), center + radius);
+                weight = fmaxf(end - begin, 0.0f);
+            }
+            else {
+                weight = kaiser_kernel((i + 0.5f - center) / scale);
+            }
+
+            i32 index = i < first ? first : i > last ? last : i;
+            weights[index - first] += weight;
+            total += weight;
+        }
+
+        for (u32 k = 0; k < taps.count[d]; ++k) {
+            weights[k] /= total;
+        }
+    }
+
+    return taps;
+}
+
+struct MipLevelResample {
+    MipTaps* x_taps;
+    MipTaps* y_taps;
+    bool srgb;
+    u32 src_width;
+    u32* src_texels; // Only for level 0
+    u16* src_linear; // Four channels per texel, for every other level
+    u32 dst_width;
+    u32* dst_texels;
+    u16* dst_linear; // Null for the last level
+};
+
+// Expands one source row to linear floats and filters it horizontally.
+internal void filter_mip_row(MipLevelResample* level, u32 src_row, __m128* expanded, __m128* out) {
+    __m128i zero = _mm_setzero_si128();
+
+    if (level->src_texels) {
+        u8* src = (u8*)(level->src_texels + (u64)src_row * level->src_width);
+
+        for (u32 x = 0; x < level->src_width; ++x) {
+            u8* texel = src + x * 4;
+            if (level->srgb) {
+                f32* table = mip_tables.srgb_to_linear;
+                expanded[x] = _mm_setr_ps(table[texel[0]], table[texel[1]], table[texel[2]], texel[3] / 255.0f);
+            }
+            else {
+                __m128i wide = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(*(int*)texel), zero), zero);
+                expanded[x] = _mm_mul_ps(_mm_cvtepi32_ps(wide), _mm_set1_ps(1.0f / 255.0f));
+            }
+        }
+    }
+    else {
+        u16* src = level->src_linear + (u64)src_row * level->src_width * 4;
+
+        for (u32 x = 0; x < level->src_width; ++x) {
+            __m128i wide = _mm_unpacklo_epi16(_mm_loadl_epi64((__m128i*)(src + x * 4)), zero);
+            expanded[x] = _mm_mul_ps(_mm_cvtepi32_ps(wide), _mm_set1_ps(1.0f / 65535.0f));
+        }
+    }
+
+    MipTaps* taps = level->x_taps;
+
+    for (u32 x = 0; x < level->dst_width; ++x) {
+        __m128* src = expanded + taps->first[x];
+        f32* weights = taps->weights + (u64)x * taps->max_count;
+
+        __m128 sum = _mm_setzero_ps();
+        for (u32 k = 0; k < taps->count[x]; ++k) {
+            sum = _mm_add_ps(sum, _mm_mul_ps(src[k], _mm_set1_ps(weights[k])));
+        }
+
+        out[x] = sum;
+    }
+}
+
+// Horizontally filtered source rows are cached in a ring as large as the widest vertical footprint, which
+// consecutive destination rows mostly share.
+internal void resample_mip_rows(void* data, u32 begin, u32 end) {
+    MipLevelResample* level = (MipLevelResample*)data;
+    MipTaps* taps = level->y_taps;
+    u32 dst_width = level->dst_width;
+
+    Scratch scratch = get_scratch(0, 0);
+
+    __m128* expanded = arena_push_array(scratch.arena, __m128, level->src_width);
+    __m128* sum = arena_push_array(scratch.arena, __m128, dst_width);
+    __m128* ring = arena_push_array(scratch.arena, __m128, (u64)taps->max_count * dst_width);
+    u32* ring_rows = arena_push_array(scratch.arena, u32, taps->max_count);
+
+    for (u32 i = 0; i < taps->max_count; ++i) {
+        ring_rows[i] = UINT32_MAX;
+    }
+
+    u8* to_color8 = level->srgb ? mip_tables.linear_to_srgb : mip_tables.linear_to_unorm8;
+
+    for (u32 y = begin; y < end; ++y) {
+        f32* weights = taps->weights + (u64)y * taps->max_count;
+
+        for (u32 x = 0; x < dst_width; ++x) {
+            sum[x] = _mm_setzero_ps();
+        }
+
+        for (u32 k = 0; k < taps->count[y]; ++k) {
+            u32 src_row = taps->first[y] + k;
+            u32 slot = src_row % taps->max_count;
+            __m128* row = ring + (u64)slot * dst_width;
+
+            if (ring_rows[slot] != src_row) {
+                filter_mip_row(level, src_row, expanded, row);
+                ring_rows[slot] = src_row;
+            }
+
+            __m128 weight = _mm_set1_ps(weights[k]);
+            for (u32 x = 0; x < dst_width; ++x) {
+                sum[x] = _mm_add_ps(sum[x], _mm_mul_ps(row[x], weight));
+            }
+        }
+
+        u32* dst = level->dst_texels + (u64)y * dst_width;
+        u16* dst_linear = level->dst_linear ? level->dst_linear + (u64)y * dst_width * 4 : 0;
+
+        for (u32 x = 0; x < dst_width; ++x) {
+            // The Kaiser kernel's negative lobes can overshoot.
+            __m128 clamped = _mm_min_ps(_mm_max_ps(sum[x], _mm_setzero_ps()), _mm_set1_ps(1.0f));
+            __m128i quantized = _mm_cvtps_epi32(_mm_mul_ps(clamped, _mm_set1_ps(65535.0f)));
+
+            u32 q[4];
+            _mm_storeu_si128((__m128i*)q, quantized);
+
+            dst[x] = (u32)to_color8[q[0]] | ((u32)to_color8[q[1]] << 8) | ((u32)to_color8[q[2]] << 16) | ((u32)mip_tables.linear_to_unorm8[q[3]] << 24);
+
+            if (dst_linear) {
+                for (int c = 0; c < 4; ++c) {
+                    dst_linear[x * 4 + c] = (u16)q[c];
+                }
+            }
+        }
+    }
+
+    release_scratch(scratch);
+}
+
+void generate_mips(WorkQueue* queue, MipFilter filter, bool srgb, u32 width, u32 height, u32 num_levels, u32* chain) {
+    assert(mip_tables_built);
+    assert(num_levels >= 1 && num_levels <= mip_level_count(width, height));
+
+    Scratch scratch = get_scratch(0, 0);
+
+    u32* src = chain;
+    u16* src_linear = 0;
+    u32 src_width = width;
+    u32 src_height = height;
+
+    for (u32 i = 1; i < num_levels; ++i) {
+        u32 dst_width = src_width > 1 ? src_width / 2 : 1;
+        u32 dst_height = src_height > 1 ? src_height / 2 : 1;
+
+        u32* dst = src + (u64)src_width * src_height;
+        u16* dst_linear = i + 1 < num_levels ? arena_push_array(scratch.arena, u16, (u64)dst_width * dst_height * 4) : 0;
+
+        MipTaps x_taps = build_mip_taps(scratch.arena, filter, src_width, dst_width);
+        MipTaps y_taps = build_mip_taps(scratch.arena, filter, src_height, dst_height);
+
+        MipLevelResample level;
+        level.x_taps = &x_taps;
+        level.y_taps = &y_taps;
+        level.srgb = srgb;
+        level.src_width = src_width;
+        level.src_texels = src_linear ? 0 : src;
+        level.src_linear = src_linear;
+        level.dst_width = dst_width;
+        level.dst_texels = dst;
+        level.dst_linear = dst_linear;
+
+        work_queue_parallel_for(queue, resample_mip_rows, &level, dst_height, MIP_ROWS_PER_CHUNK);
+
+        src = dst;
+        src_linear = dst_linear;
+        src_width = dst_width;
+        src_height = dst_height;
+    }
+
+    release_scratch(scratch);
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include "common.h"
+
+struct WorkQueue;
+
+enum MipFilter {
+    MIP_FILTER_BOX,
+    MIP_FILTER_KAISER,
+};
+
+// Levels in a full chain. Each level halves the one above, rounding down, until both dimensions are 1.
+u32 mip_level_count(u32 width, u32 height);
+
+// Texels in the first num_levels levels of a chain packed largest first.
+u64 mip_chain_texels(u32 width, u32 height, u32 num_levels);
+
+// Fills levels 1 to num_levels - 1 of an RGBA8 chain packed largest first, given level 0. Each level is resampled
+// from the one above at full precision, so odd dimensions are weighted by coverage rather than dropping a texel.
+// With srgb, color is filtered in linear space; alpha always is. Edges are clamped. Rows are split across the work
+// queue, which may be null.
+void generate_mips(WorkQueue* queue, MipFilter filter, bool srgb, u32 width, u32 height, u32 num_levels, u32* chain);
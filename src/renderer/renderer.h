@@ -24,6 +24,18 @@ struct MeshInstance {
     Mesh mesh;
     Material material;
     XMMATRIX transform;
+    u32 lod; // Written back by the renderer's LOD selection and read next frame for hysteresis
+};
+
+// Many copies of one mesh, e.g. foliage. Each copy is a 3x4 affine transform relative to the batch transform,
+// which is 48 bytes per copy instead of a whole MeshInstance.
+struct MeshInstanceBatch {
+    Mesh mesh;
+    Material material;
+    XMMATRIX transform; // Applied after each local transform
+    u32 num_instances;
+    XMFLOAT4X3* local_transforms;
+    u8* lods; // Per instance, like MeshInstance::lod
 };
 
 struct RendererCamera {
@@ -40,15 +52,23 @@ struct LineMesh {
     u32* line_indices;
 };
 
+struct MeshVertexUpdate;
+
 struct RendererFrameData {
     u32 queue_len;
     u32 num_line_meshes;
+    u32 num_mesh_updates;
+    u32 num_instance_batches;
     RendererCamera* camera;
 
     MeshInstance* queue;
+    MeshInstanceBatch* instance_batches;
 
     LineMesh* line_meshes;
+    MeshVertexUpdate* mesh_updates; // Written before anything this frame draws
     XMVECTOR frustum[6];
+
+    f32 lod_error_pixels; // Largest projected LOD error tolerated, 0 always draws LOD 0
 };
 
 void renderer_render_frame(Renderer* r, RendererFrameData* frame);
@@ -63,12 +83,53 @@ RendererUploadTicket* renderer_submit_upload_context(Arena* arena, Renderer* r,
 bool renderer_upload_finished(Renderer* r, RendererUploadTicket* ticket);
 void renderer_flush_upload(Renderer* r, RendererUploadTicket* ticket);
 
+// Zero-copy uploads. Instead of building data in its own memory for renderer_new_mesh or renderer_new_material to
+// copy into upload memory, a producer can reserve upload memory in the context and write its final bytes there.
+// Create infos pointing into a reservation are copied to the GPU straight out of it. Reservations last until the
+// context is submitted. Upload memory may be write-combined: write it front to back and don't read it back.
+void* renderer_reserve_upload(Renderer* r, RendererUploadContext* upload_context, u64 size);
+
+// Bytes that reached upload memory since the renderer was created, either copied there by create calls or written
+// in place through reservations.
+struct RendererUploadStats {
+    u64 bytes_copied;
+    u64 bytes_in_place;
+};
+
+RendererUploadStats renderer_upload_stats(Renderer* r);
+
 struct Vertex {
     XMFLOAT3 pos;
     XMFLOAT3 norm;
     XMFLOAT2 uv;
 };
 
+enum VertexFormat {
+    VERTEX_FORMAT_FULL,
+    VERTEX_FORMAT_COMPACT,
+};
+
+// 16 bytes: positions as unorm16 within the mesh AABB, octahedral normals as snorm16, UVs as half floats.
+struct CompactVertex {
+    u16 pos[3];
+    u16 pad0;
+    i16 norm[2];
+    u16 uv[2];
+};
+
+// Maps compact positions back to object space: pos = position_offset + q * position_scale.
+struct VertexDequantization {
+    XMFLOAT3 position_offset;
+    f32 pad0;
+    XMFLOAT3 position_scale;
+    f32 pad1;
+};
+
+enum IndexFormat {
+    INDEX_FORMAT_U32,
+    INDEX_FORMAT_U16,
+};
+
 struct AABB {
     XMFLOAT3 min;
     f32 pad0;
@@ -76,11 +137,26 @@ struct AABB {
     f32 pad1;
 };
 
+#define MAX_MESH_LODS 5
+#define MAX_MIP_LEVELS 16
+
+// A level of detail is a range of the mesh's index buffer. Error is the object-space geometric deviation from LOD 0.
+struct MeshLOD {
+    u32 index_offset;
+    u32 index_count;
+    f32 error;
+};
+
 struct MeshCreateInfo {
-    Vertex* vertex_data;
-    u32* index_data;
+    VertexFormat vertex_format;
+    void* vertex_data; // Vertex or CompactVertex, depending on vertex_format
+    VertexDequantization dequantization; // Only read for VERTEX_FORMAT_COMPACT
+    IndexFormat index_format;
+    void* index_data; // u32 or u16, depending on index_format
     u32 vertex_count;
     u32 index_count;
+    u32 lod_count; // 0 means a single LOD covering every index
+    MeshLOD lods[MAX_MESH_LODS];
     AABB aabb;
 };
 
@@ -88,6 +164,63 @@ Mesh renderer_new_mesh(Renderer* r, RendererUploadContext* upload_context, MeshC
 void renderer_free_mesh(Renderer* r, Mesh mesh);
 bool renderer_mesh_alive(Renderer* r, Mesh mesh);
 
-Material renderer_new_material(Renderer* r, RendererUploadContext* upload_context, u32 texture_w, u32 texture_h, void* texture_data);
+// Freeing doesn't wait for the GPU: the handle dies at once and the memory is released once the frames already
+// submitted have finished with it, and the upload it was created in if that hasn't been submitted yet.
+void renderer_free_meshes(Renderer* r, u32 count, Mesh* meshes);
+
+// Estimated GPU memory held by the mesh's buffers, for budgeting.
+u64 renderer_mesh_size(Renderer* r, Mesh mesh);
+
+// The object-space bounds the mesh is culled with.
+AABB renderer_mesh_aabb(Renderer* r, Mesh mesh);
+
+// Replaces every vertex of a VERTEX_FORMAT_FULL mesh for the frame it's passed to, e.g. with skinned positions.
+// The topology and LODs stay as created; the bounds used for culling and LOD selection become aabb.
+struct MeshVertexUpdate {
+    Mesh mesh;
+    Vertex* vertices;
+    AABB aabb;
+};
+
+enum TextureFormat {
+    TEXTURE_FORMAT_RGBA8,
+    TEXTURE_FORMAT_BC1, // RGB, 8 bytes per 4x4 block
+    TEXTURE_FORMAT_BC3, // RGBA, 16 bytes per block
+    TEXTURE_FORMAT_BC5, // RG, 16 bytes per block
+    TEXTURE_FORMAT_BC7, // RGBA, 16 bytes per block
+};
+
+// A texture and its mips, packed largest first. Each level halves the one above, rounding down, as generate_mips
+// produces them. Block formats store each level as rows of 4x4 blocks, as bc_compress_chain produces them, and need
+// level 0 to be a multiple of 4 in both dimensions.
+struct MaterialCreateInfo {
+    u32 texture_w;
+    u32 texture_h;
+    u32 mip_count; // 0 is the same as 1, level 0 alone
+    TextureFormat format;
+    void* texture_data;
+};
+
+Material renderer_new_material(Renderer* r, RendererUploadContext* upload_context, MaterialCreateInfo* info);
+
+// How a texture has to be laid out in a reservation for renderer_new_material to copy it in place, with
+// texture_data pointing at the start: level i begins level_offsets[i] bytes in, and its rows (of blocks, for block
+// formats) are row_pitches[i] bytes apart. Any other texture_data is expected packed, as described above.
+struct TextureUploadLayout {
+    u64 size;
+    u64 level_offsets[MAX_MIP_LEVELS];
+    u32 row_pitches[MAX_MIP_LEVELS];
+};
+
+void renderer_texture_upload_layout(Renderer* r, MaterialCreateInfo* info, TextureUploadLayout* layout);
 void renderer_free_material(Renderer* r, Material mat);
 bool renderer_material_alive(Renderer* r, Material mat);
+void renderer_free_materials(Renderer* r, u32 count, Material* mats);
+
+// Whether the upload that created the material has finished, so whoever takes a material from a cache can tell when
+// someone else's upload of it is still in flight. Free materials only once the context they were created in has been
+// submitted.
+bool renderer_material_uploaded(Renderer* r, Material mat);
+
+// Estimated GPU memory held by the material's texture, for budgeting.
+u64 renderer_material_size(Renderer* r, Material mat);
@@ -1,3 +1,5 @@
+#if !RENDERER_NULL
+
 #include <dxgi1_4.h>
 #include <agility/d3d12.h>
 #include <dxc/dxcapi.h>
@@ -5,6 +7,7 @@
 #include <stb_image.h>
 
 #include "renderer.h"
+#include "lod.h"
 #include "utility/resource_pool.h"
 
 extern "C" __declspec(dllexport) extern const UINT D3D12SDKVersion = 606;
@@ -161,7 +164,7 @@ struct IndirectCommand {
     u32 ibuffer_index;
     u32 transform_index;
     u32 texture_index;
-    u32 aabb_index;
+    u32 mesh_constants_index;
     D3D12_DRAW_ARGUMENTS draw_arguments;
 };
 
@@ -177,17 +180,35 @@ struct ReleasableResource {
     ID3D12Resource* resource;
 };
 
+// A freed mesh's or material's GPU objects, kept until both queues pass the fence values they had signalled when
+// it was freed, so freeing doesn't wait for the GPU. One freed before the context its upload is recorded in was
+// submitted waits for that submission instead, since the copy still writes to it.
+struct RetiredResource {
+    RetiredResource* next;
+    RetiredResource* next_pending; // Next one retired from the same open context
+    u64 direct_fence_val;
+    u64 copy_fence_val;
+    u32 count;
+    ID3D12Resource* resources[2];
+    Descriptor views[2];
+    ConstantBuffer* cbuffer;
+};
+
+// Pools are recycled once their command list has executed. Dedicated pools hold a single upload too big for a pool
+// and are released instead.
 struct UploadPool {
     UploadPool* next;
     ID3D12Resource* resource;
     void* ptr;
     u64 cursor;
+    b32 dedicated;
 };
 
 struct UploadChunk {
     ID3D12Resource* resource;
     u64 offset;
     u64 size;
+    void* ptr; // Where the CPU writes the chunk
 };
 
 struct CommandList {
@@ -204,22 +225,44 @@ struct CommandList {
     ReleasableResource* releasable_resources;
 };
 
+// Per-mesh constants read by culling (aabb) and vertex fetch (dequantization, vertex and index formats).
+struct MeshConstants {
+    AABB aabb;
+    VertexDequantization dequantization;
+    u32 vertex_format;
+    u32 index_format;
+};
+
 struct MeshData {
     ID3D12Resource* vbuffer;
     ID3D12Resource* ibuffer;
     Descriptor vbuffer_view;
     Descriptor ibuffer_view;
-    ConstantBuffer* aabb_cbuffer;
-    u32 index_count;
+    ConstantBuffer* mesh_cbuffer;
+    MeshConstants constants; // Kept to rebuild mesh_cbuffer when the vertices are replaced
+    u32 vertex_count;
+    AABB aabb;
+    u32 lod_count;
+    MeshLOD lods[MAX_MESH_LODS];
+    u64 size; // Bytes allocated for both buffers
+    RendererUploadContext* upload_context; // Where its upload is recorded, null once that's submitted
+    u64 next_pending; // Next mesh created in the same context, until it's submitted
 };
 
 struct MaterialData {
     ID3D12Resource* texture;
     Descriptor texture_view;
+    u64 size;
+    u64 upload_fence_val; // Copy queue fence value of its upload, UINT64_MAX until that's submitted
+    RendererUploadContext* upload_context; // Where its upload is recorded, null once that's submitted
+    u64 next_pending; // Next material created in the same context, until it's submitted
 };
 
 struct RendererUploadContext {
     CommandList* cmd;
+    u64 pending_meshes; // Created in the context, linked through next_pending
+    u64 pending_materials; // Likewise
+    RetiredResource* retired_resources; // Freed before the context was submitted, linked through next_pending
 };
 
 struct RendererUploadTicket {
@@ -268,6 +311,9 @@ struct Renderer {
 
     ReleasableResource* releasable_resource_slots;
 
+    RetiredResource* retired_resources;
+    RetiredResource* retired_resource_slots;
+
     IDXGIFactory3* factory;
     IDXGIAdapter* adapter;
     ID3D12Device* device;
@@ -290,6 +336,8 @@ struct Renderer {
     WritableMesh* available_writable_meshes;
     WritableArgumentBuffer* available_writable_argument_buffers;
     UploadPool* available_upload_pools;
+    UploadPool* dedicated_upload_slots;
+    RendererUploadStats upload_stats;
 
     CommandList* available_command_lists;
     CommandList* executing_command_lists;
@@ -342,7 +390,65 @@ internal ReleasableResource* release_releasable_resource(Renderer* r, Releasable
     return next;
 }
 
+// A resource whose upload is recorded in a context that's still open waits for that context's submission.
+internal RetiredResource* retire_resources(Renderer* r, RendererUploadContext* upload_context) {
+    RetiredResource* retired;
+
+    if (!r->retired_resource_slots) {
+        retired = arena_push_struct(&r->arena, RetiredResource);
+    }
+    else {
+        retired = r->retired_resource_slots;
+        r->retired_resource_slots = retired->next;
+    }
+
+    *retired = {};
+    retired->direct_fence_val = r->direct_queue.fence_val;
+    retired->copy_fence_val = r->copy_queue.fence_val;
+
+    if (upload_context) {
+        retired->copy_fence_val = UINT64_MAX;
+        retired->next_pending = upload_context->retired_resources;
+        upload_context->retired_resources = retired;
+    }
+
+    retired->next = r->retired_resources;
+    r->retired_resources = retired;
+
+    return retired;
+}
+
+internal void release_retired_resources(Renderer* r) {
+    u64 direct_completed = r->direct_queue.fence->GetCompletedValue();
+    u64 copy_completed = r->copy_queue.fence->GetCompletedValue();
+
+    for (RetiredResource** p_retired = &r->retired_resources; *p_retired;) {
+        RetiredResource* retired = *p_retired;
+
+        if (direct_completed >= retired->direct_fence_val && copy_completed >= retired->copy_fence_val) {
+            for (u32 i = 0; i < retired->count; ++i) {
+                free_descriptor(&r->bindless_heap, retired->views[i]);
+                retired->resources[i]->Release();
+            }
+
+            if (retired->cbuffer) {
+                retired->cbuffer->next = r->available_constant_buffers;
+                r->available_constant_buffers = retired->cbuffer;
+            }
+
+            *p_retired = retired->next;
+            retired->next = r->retired_resource_slots;
+            r->retired_resource_slots = retired;
+        }
+        else {
+            p_retired = &retired->next;
+        }
+    }
+}
+
 internal void update_available_command_lists(Renderer* r) { 
+    release_retired_resources(r);
+
     for (CommandList** p_cmd = &r->executing_command_lists; *p_cmd;)
     {
         CommandList* cmd = *p_cmd;
@@ -351,10 +457,19 @@ internal void update_available_command_lists(Renderer* r) {
             // Add all in-flight resources back into available pools
 
             for (UploadPool* pool = cmd->upload_pools; pool;) {
-                pool->cursor = 0;
                 UploadPool* next = pool->next;
-                pool->next = r->available_upload_pools;
-                r->available_upload_pools = pool;
+
+                if (pool->dedicated) {
+                    pool->resource->Release();
+                    pool->next = r->dedicated_upload_slots;
+                    r->dedicated_upload_slots = pool;
+                }
+                else {
+                    pool->cursor = 0;
+                    pool->next = r->available_upload_pools;
+                    r->available_upload_pools = pool;
+                }
+
                 pool = next;
             }
 
@@ -616,15 +731,23 @@ internal UploadPool* get_upload_pool(Renderer* r) {
     }
 }
 
-internal UploadChunk get_upload_chunk(Renderer* r, CommandList* cmd, void* data, u32 size) {
+// Chunks start at the placement alignment, so any of them can be the source of a texture copy.
+internal u64 upload_pool_offset(UploadPool* pool) {
+    return (pool->cursor + D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT - 1) & ~(u64)(D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT - 1);
+}
+
+internal UploadChunk reserve_upload_chunk(Renderer* r, CommandList* cmd, u64 size) {
     // TODO: pool these allocations - don't want to make a resource for every upload
 
+    UploadChunk chunk = {};
+    chunk.size = size;
+
     if (size <= UPLOAD_POOL_CAPACITY) {        
         UploadPool* chosen_pool = 0;
 
         for (UploadPool* p = cmd->upload_pools; p; p = p->next) {
-            u64 available_capacity = UPLOAD_POOL_CAPACITY - p->cursor;
-            if (available_capacity >= size) {
+            u64 offset = upload_pool_offset(p);
+            if (!p->dedicated && offset <= UPLOAD_POOL_CAPACITY && UPLOAD_POOL_CAPACITY - offset >= size) {
                 chosen_pool = p;
                 break;
             }
@@ -636,15 +759,10 @@ internal UploadChunk get_upload_chunk(Renderer* r, CommandList* cmd, void* data,
             cmd->upload_pools = chosen_pool;
         }
 
-        UploadChunk chunk = {};
         chunk.resource = chosen_pool->resource;
-        chunk.offset = chosen_pool->cursor;
-        chosen_pool->cursor += size;
-        chunk.size = size;
-
-        memcpy((u8*)chosen_pool->ptr + chunk.offset, data, size);
-
-        return chunk;
+        chunk.offset = upload_pool_offset(chosen_pool);
+        chunk.ptr = (u8*)chosen_pool->ptr + chunk.offset;
+        chosen_pool->cursor = chunk.offset + size;
     }
     else {
         D3D12_RESOURCE_DESC buffer_desc = {};
@@ -659,22 +777,60 @@ internal UploadChunk get_upload_chunk(Renderer* r, CommandList* cmd, void* data,
         D3D12_HEAP_PROPERTIES heap_props = {};
         heap_props.Type = D3D12_HEAP_TYPE_UPLOAD;
 
-        ID3D12Resource* resource;
-        r->device->CreateCommittedResource(&heap_props, D3D12_HEAP_FLAG_NONE, &buffer_desc, D3D12_RESOURCE_STATE_GENERIC_READ, 0, IID_PPV_ARGS(&resource));
-        append_releasable_resource(r, resource, &cmd->releasable_resources);
+        UploadPool* pool = r->dedicated_upload_slots;
+        if (pool) {
+            r->dedicated_upload_slots = pool->next;
+        }
+        else {
+            pool = arena_push_struct(&r->arena, UploadPool);
+        }
+
+        r->device->CreateCommittedResource(&heap_props, D3D12_HEAP_FLAG_NONE, &buffer_desc, D3D12_RESOURCE_STATE_GENERIC_READ, 0, IID_PPV_ARGS(&pool->resource));
+        pool->resource->Map(0, 0, &pool->ptr);
+        pool->cursor = size;
+        pool->dedicated = true;
+
+        pool->next = cmd->upload_pools;
+        cmd->upload_pools = pool;
 
         debug_message("Upload too big to fit into upload pool; created dedicated staging buffer.\n");
 
-        void* ptr = 0;
-        resource->Map(0, 0, &ptr);
-        memcpy(ptr, data, size);
+        chunk.resource = pool->resource;
+        chunk.ptr = pool->ptr;
+    }
+
+    return chunk;
+}
+
+// Finds data in memory the command list has already reserved, so it can be copied from in place.
+internal bool find_upload_chunk(CommandList* cmd, void* data, u64 size, UploadChunk* chunk) {
+    for (UploadPool* p = cmd->upload_pools; p; p = p->next) {
+        u8* begin = (u8*)p->ptr;
+        if ((u8*)data >= begin && (u8*)data + size <= begin + p->cursor) {
+            chunk->resource = p->resource;
+            chunk->offset = (u8*)data - begin;
+            chunk->size = size;
+            chunk->ptr = data;
+            return true;
+        }
+    }
+
+    return false;
+}
 
-        UploadChunk chunk = {};
-        chunk.resource = resource;
-        chunk.size = size;
+internal UploadChunk get_upload_chunk(Renderer* r, CommandList* cmd, void* data, u64 size) {
+    UploadChunk chunk;
 
-        return chunk;
+    if (find_upload_chunk(cmd, data, size, &chunk)) {
+        r->upload_stats.bytes_in_place += size;
+    }
+    else {
+        chunk = reserve_upload_chunk(r, cmd, size);
+        memcpy(chunk.ptr, data, size);
+        r->upload_stats.bytes_copied += size;
     }
+
+    return chunk;
 }
 
 internal void write_buffer(Renderer* r, CommandList* cmd, ID3D12Resource* dst, void* data, u32 size) {
@@ -940,7 +1096,12 @@ Renderer* renderer_init(Arena* arena, void* window) {
     r->device->CreateUnorderedAccessView(r->gpu_argument_count, 0, &buffer_uav_desc, cpu_descriptor_handle(&r->bindless_heap, r->gpu_argument_count_uav));
 
     u8 default_texture_data[4] = { 128, 128, 128, 128 };
-    r->default_material = renderer_new_material(r, upload_context, 1, 1, default_texture_data);
+
+    MaterialCreateInfo default_material_info = {};
+    default_material_info.texture_w = 1;
+    default_material_info.texture_h = 1;
+    default_material_info.texture_data = default_texture_data;
+    r->default_material = renderer_new_material(r, upload_context, &default_material_info);
 
     renderer_flush_upload(r, renderer_submit_upload_context(scratch.arena, r, upload_context));
 
@@ -957,18 +1118,19 @@ internal void wait_device_idle(Renderer* r) {
 void renderer_release_backend(Renderer* r) {
     UNUSED(r);
 #if _DEBUG
+    renderer_free_material(r, r->default_material);
+
     wait_device_idle(r);
 
     update_available_command_lists(r);
     assert(!r->executing_command_lists);
+    assert(!r->retired_resources);
 
     for (CommandList* cmd = r->available_command_lists; cmd; cmd = cmd->next) {
         cmd->allocator->Release();
         cmd->list->Release();
     }
 
-    renderer_free_material(r, r->default_material);
-
     r->gpu_argument_buffer->Release();
     r->gpu_argument_count->Release();
 
@@ -1092,11 +1254,6 @@ internal void drop_constant_buffer(CommandList* cmd, ConstantBuffer* buf) {
     cmd->constant_buffers = buf;
 }
 
-internal void immediate_drop_constant_buffer(Renderer* r, ConstantBuffer* buf) {
-    buf->next = r->available_constant_buffers;
-    r->available_constant_buffers = buf;
-}
-
 internal WritableMesh* get_writable_mesh(Renderer* r, XMFLOAT4* vertex_data, u32 vertex_count, u32* index_data, u32 index_count) {
     WritableMesh* writable_mesh;
 
@@ -1220,6 +1377,36 @@ internal void drop_writable_argument_buffer(CommandList* cmd, WritableArgumentBu
     cmd->writable_argument_buffers = buf;
 }
 
+// Fills the command drawing one mesh with one transform and returns the LOD it selected.
+internal u32 fill_indirect_command(Renderer* r, CommandList* cmd, RendererFrameData* frame, IndirectCommand* indirect_command, Mesh mesh, Material material, XMMATRIX transform, u32 current_lod, XMVECTOR camera_position, f32 lod_projection_scale) {
+    MeshData* mesh_data = resource_pool_access(r->mesh_pool, mesh.handle, MeshData);
+    MaterialData* mat_data = resource_pool_access(r->material_pool, material.handle, MaterialData);
+
+    ConstantBuffer* transform_cbuffer = get_constant_buffer(r, &transform, sizeof(transform));
+    drop_constant_buffer(cmd, transform_cbuffer);
+
+    u32 lod = 0;
+    if (frame->lod_error_pixels > 0.0f && mesh_data->lod_count > 1) {
+        f32 pixels_per_unit = lod_pixels_per_unit(&mesh_data->aabb, transform, camera_position, lod_projection_scale);
+        if (current_lod >= mesh_data->lod_count) {
+            current_lod = 0;
+        }
+        lod = select_mesh_lod(mesh_data->lods, mesh_data->lod_count, current_lod, pixels_per_unit, frame->lod_error_pixels, LOD_HYSTERESIS);
+    }
+
+    indirect_command->vbuffer_index = mesh_data->vbuffer_view.index;
+    indirect_command->ibuffer_index = mesh_data->ibuffer_view.index;
+    indirect_command->transform_index = transform_cbuffer->cbv.index;
+    indirect_command->texture_index = mat_data->texture_view.index;
+    indirect_command->mesh_constants_index = mesh_data->mesh_cbuffer->cbv.index;
+    indirect_command->draw_arguments.VertexCountPerInstance = mesh_data->lods[lod].index_count;
+    indirect_command->draw_arguments.InstanceCount = 1;
+    indirect_command->draw_arguments.StartVertexLocation = mesh_data->lods[lod].index_offset;
+    indirect_command->draw_arguments.StartInstanceLocation = 0;
+
+    return lod;
+}
+
 void renderer_render_frame(Renderer* r, RendererFrameData* frame) {
     Scratch scratch = get_scratch(0, 0);
 
@@ -1231,6 +1418,34 @@ void renderer_render_frame(Renderer* r, RendererFrameData* frame) {
 
     CommandList* cmd = open_command_list(r, D3D12_COMMAND_LIST_TYPE_DIRECT);
 
+    // Vertex buffers decay to common between frames, so each update is a promoted copy followed by one transition.
+    // The constants move to a new buffer because frames in flight may still read the old one.
+    if (frame->num_mesh_updates > 0) {
+        D3D12_RESOURCE_BARRIER* update_barriers = arena_push_array_zero(scratch.arena, D3D12_RESOURCE_BARRIER, frame->num_mesh_updates);
+
+        for (u32 i = 0; i < frame->num_mesh_updates; ++i) {
+            MeshVertexUpdate* update = &frame->mesh_updates[i];
+            MeshData* mesh_data = resource_pool_access(r->mesh_pool, update->mesh.handle, MeshData);
+            assert(mesh_data->constants.vertex_format == VERTEX_FORMAT_FULL);
+
+            write_buffer(r, cmd, mesh_data->vbuffer, update->vertices, mesh_data->vertex_count * sizeof(Vertex));
+
+            update_barriers[i].Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
+            update_barriers[i].Transition.pResource = mesh_data->vbuffer;
+            update_barriers[i].Transition.StateBefore = D3D12_RESOURCE_STATE_COPY_DEST;
+            update_barriers[i].Transition.StateAfter = D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE;
+            update_barriers[i].Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
+
+            mesh_data->aabb = update->aabb;
+            mesh_data->constants.aabb = update->aabb;
+
+            drop_constant_buffer(cmd, mesh_data->mesh_cbuffer);
+            mesh_data->mesh_cbuffer = get_constant_buffer(r, &mesh_data->constants, sizeof(mesh_data->constants));
+        }
+
+        cmd->list->ResourceBarrier(frame->num_mesh_updates, update_barriers);
+    }
+
     D3D12_RESOURCE_BARRIER barrier = {};
     barrier.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
     barrier.Transition.pResource = r->swapchain_buffers[swapchain_index];
@@ -1270,26 +1485,29 @@ void renderer_render_frame(Renderer* r, RendererFrameData* frame) {
     ConstantBuffer* frustum_cbuffer = get_constant_buffer(r, frame->frustum, sizeof(frame->frustum));
     drop_constant_buffer(cmd, frustum_cbuffer);
 
-    IndirectCommand* indirect_commands = arena_push_array(scratch.arena, IndirectCommand, frame->queue_len);
-    int num_commands = frame->queue_len;
+    u32 num_commands = frame->queue_len;
+    for (u32 i = 0; i < frame->num_instance_batches; ++i) {
+        num_commands += frame->instance_batches[i].num_instances;
+    }
+
+    IndirectCommand* indirect_commands = arena_push_array(scratch.arena, IndirectCommand, num_commands);
+
+    XMVECTOR camera_position = frame->camera->transform.r[3];
+    f32 lod_projection_scale = (f32)swapchain_desc.Height / (2.0f * tanf(frame->camera->fov / aspect_ratio * 0.5f));
 
     for (u32 i = 0; i < frame->queue_len; ++i) {
         MeshInstance* instance = &frame->queue[i];
+        instance->lod = fill_indirect_command(r, cmd, frame, &indirect_commands[i], instance->mesh, instance->material, instance->transform, instance->lod, camera_position, lod_projection_scale);
+    }
 
-        MeshData* mesh_data = resource_pool_access(r->mesh_pool, instance->mesh.handle, MeshData);
-        MaterialData* mat_data = resource_pool_access(r->material_pool, instance->material.handle, MaterialData);
-
-        ConstantBuffer* transform_cbuffer = get_constant_buffer(r, &instance->transform, sizeof(instance->transform));
-        drop_constant_buffer(cmd, transform_cbuffer);
+    u32 command_index = frame->queue_len;
+    for (u32 i = 0; i < frame->num_instance_batches; ++i) {
+        MeshInstanceBatch* batch = &frame->instance_batches[i];
 
-        IndirectCommand* indirect_command = &indirect_commands[i];
-        indirect_command->vbuffer_index = mesh_data->vbuffer_view.index;
-        indirect_command->ibuffer_index = mesh_data->ibuffer_view.index;
-        indirect_command->transform_index = transform_cbuffer->cbv.index;
-        indirect_command->texture_index = mat_data->texture_view.index;
-        indirect_command->aabb_index = mesh_data->aabb_cbuffer->cbv.index;
-        indirect_command->draw_arguments.VertexCountPerInstance = mesh_data->index_count;
-        indirect_command->draw_arguments.InstanceCount = 1;
+        for (u32 j = 0; j < batch->num_instances; ++j) {
+            XMMATRIX transform = XMLoadFloat4x3(&batch->local_transforms[j]) * batch->transform;
+            batch->lods[j] = (u8)fill_indirect_command(r, cmd, frame, &indirect_commands[command_index++], batch->mesh, batch->material, transform, batch->lods[j], camera_position, lod_projection_scale);
+        }
     }
 
     if (num_commands > 0) {
@@ -1366,6 +1584,28 @@ RendererUploadTicket* renderer_submit_upload_context(Arena* arena, Renderer* r,
     submit_command_list(r, &r->copy_queue, context->cmd);
     RendererUploadTicket* ticket = arena_push_struct(arena, RendererUploadTicket);
     ticket->fence_val = command_queue_signal(&r->copy_queue);
+
+    for (u64 handle = context->pending_meshes; handle;) {
+        MeshData* data = resource_pool_access(r->mesh_pool, handle, MeshData);
+        data->upload_context = 0;
+        handle = data->next_pending;
+    }
+
+    for (u64 handle = context->pending_materials; handle;) {
+        MaterialData* data = resource_pool_access(r->material_pool, handle, MaterialData);
+        data->upload_fence_val = ticket->fence_val;
+        data->upload_context = 0;
+        handle = data->next_pending;
+    }
+
+    for (RetiredResource* retired = context->retired_resources; retired; retired = retired->next_pending) {
+        retired->copy_fence_val = ticket->fence_val;
+    }
+
+    context->pending_meshes = 0;
+    context->pending_materials = 0;
+    context->retired_resources = 0;
+
     return ticket;
 }
 
@@ -1377,11 +1617,24 @@ void renderer_flush_upload(Renderer* r, RendererUploadTicket* ticket) {
     command_queue_wait(&r->copy_queue, ticket->fence_val);
 }
 
+void* renderer_reserve_upload(Renderer* r, RendererUploadContext* upload_context, u64 size) {
+    return reserve_upload_chunk(r, upload_context->cmd, size).ptr;
+}
+
+RendererUploadStats renderer_upload_stats(Renderer* r) {
+    return r->upload_stats;
+}
+
 Mesh renderer_new_mesh(Renderer* r, RendererUploadContext* upload_context, MeshCreateInfo* info) {
     u64 handle = resource_pool_alloc(r->mesh_pool);
 
-    u32 vertex_data_size = info->vertex_count * sizeof(Vertex);
-    u32 index_data_size = info->index_count * sizeof(u32);
+    u32 vertex_stride = info->vertex_format == VERTEX_FORMAT_COMPACT ? sizeof(CompactVertex) : sizeof(Vertex);
+    u32 vertex_data_size = info->vertex_count * vertex_stride;
+    u32 index_stride = info->index_format == INDEX_FORMAT_U16 ? sizeof(u16) : sizeof(u32);
+    u32 index_data_size = info->index_count * index_stride;
+
+    // Indices are read through a raw view, which addresses whole dwords.
+    u32 index_buffer_size = (index_data_size + 3) & ~3u;
 
     MeshData* data = resource_pool_access(r->mesh_pool, handle, MeshData);
 
@@ -1398,13 +1651,19 @@ Mesh renderer_new_mesh(Renderer* r, RendererUploadContext* upload_context, MeshC
 
     resource_desc.Width = vertex_data_size;
     r->device->CreateCommittedResource(&heap_props, D3D12_HEAP_FLAG_NONE, &resource_desc, D3D12_RESOURCE_STATE_COMMON, 0, IID_PPV_ARGS(&data->vbuffer));
+    data->size = r->device->GetResourceAllocationInfo(0, 1, &resource_desc).SizeInBytes;
 
-    resource_desc.Width = index_data_size;
+    resource_desc.Width = index_buffer_size;
     r->device->CreateCommittedResource(&heap_props, D3D12_HEAP_FLAG_NONE, &resource_desc, D3D12_RESOURCE_STATE_COMMON, 0, IID_PPV_ARGS(&data->ibuffer));
+    data->size += r->device->GetResourceAllocationInfo(0, 1, &resource_desc).SizeInBytes;
 
     write_buffer(r, upload_context->cmd, data->vbuffer, info->vertex_data, vertex_data_size);
     write_buffer(r, upload_context->cmd, data->ibuffer, info->index_data, index_data_size);
 
+    data->upload_context = upload_context;
+    data->next_pending = upload_context->pending_meshes;
+    upload_context->pending_meshes = handle;
+
     data->vbuffer_view = alloc_descriptor(&r->bindless_heap);
     data->ibuffer_view = alloc_descriptor(&r->bindless_heap);
 
@@ -1413,16 +1672,37 @@ Mesh renderer_new_mesh(Renderer* r, RendererUploadContext* upload_context, MeshC
     srv_desc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
 
     srv_desc.Buffer.NumElements = info->vertex_count;
-    srv_desc.Buffer.StructureByteStride = sizeof(Vertex);
+    srv_desc.Buffer.StructureByteStride = vertex_stride;
     r->device->CreateShaderResourceView(data->vbuffer, &srv_desc, cpu_descriptor_handle(&r->bindless_heap, data->vbuffer_view));
 
-    srv_desc.Buffer.NumElements = info->index_count;
-    srv_desc.Buffer.StructureByteStride = sizeof(u32);
+    srv_desc.Format = DXGI_FORMAT_R32_TYPELESS;
+    srv_desc.Buffer.NumElements = index_buffer_size / 4;
+    srv_desc.Buffer.StructureByteStride = 0;
+    srv_desc.Buffer.Flags = D3D12_BUFFER_SRV_FLAG_RAW;
     r->device->CreateShaderResourceView(data->ibuffer, &srv_desc, cpu_descriptor_handle(&r->bindless_heap, data->ibuffer_view));
 
-    data->index_count = info->index_count;
+    data->vertex_count = info->vertex_count;
+    data->aabb = info->aabb;
 
-    data->aabb_cbuffer = get_constant_buffer(r, &info->aabb, sizeof(AABB));
+    if (info->lod_count > 0) {
+        assert(info->lod_count <= MAX_MESH_LODS);
+        data->lod_count = info->lod_count;
+        memcpy(data->lods, info->lods, info->lod_count * sizeof(MeshLOD));
+    }
+    else {
+        data->lod_count = 1;
+        data->lods[0].index_offset = 0;
+        data->lods[0].index_count = info->index_count;
+        data->lods[0].error = 0.0f;
+    }
+
+    MeshConstants* constants = &data->constants;
+    *constants = {};
+    constants->aabb = info->aabb;
+    constants->dequantization = info->dequantization;
+    constants->vertex_format = info->vertex_format;
+    constants->index_format = info->index_format;
+    data->mesh_cbuffer = get_constant_buffer(r, constants, sizeof(*constants));
 
     Mesh mesh = {};
     mesh.handle = handle;
@@ -1430,62 +1710,163 @@ Mesh renderer_new_mesh(Renderer* r, RendererUploadContext* upload_context, MeshC
     return mesh;
 }
 
-void renderer_free_mesh(Renderer* r, Mesh mesh) {
-    wait_device_idle(r);
+// Takes a mesh freed before its context was submitted out of the context's pending meshes.
+internal void unlink_pending_mesh(Renderer* r, RendererUploadContext* upload_context, u64 handle) {
+    u64* p_handle = &upload_context->pending_meshes;
+    while (*p_handle != handle) {
+        p_handle = &resource_pool_access(r->mesh_pool, *p_handle, MeshData)->next_pending;
+    }
 
-    MeshData* data = resource_pool_access(r->mesh_pool, mesh.handle, MeshData);
+    *p_handle = resource_pool_access(r->mesh_pool, handle, MeshData)->next_pending;
+}
 
-    immediate_drop_constant_buffer(r, data->aabb_cbuffer);
+internal void release_mesh(Renderer* r, Mesh mesh) {
+    MeshData* data = resource_pool_access(r->mesh_pool, mesh.handle, MeshData);
 
-    free_descriptor(&r->bindless_heap, data->ibuffer_view);
-    free_descriptor(&r->bindless_heap, data->vbuffer_view);
+    if (data->upload_context) {
+        unlink_pending_mesh(r, data->upload_context, mesh.handle);
+    }
 
-    data->ibuffer->Release();
-    data->vbuffer->Release();
+    RetiredResource* retired = retire_resources(r, data->upload_context);
+    retired->count = 2;
+    retired->resources[0] = data->vbuffer;
+    retired->resources[1] = data->ibuffer;
+    retired->views[0] = data->vbuffer_view;
+    retired->views[1] = data->ibuffer_view;
+    retired->cbuffer = data->mesh_cbuffer;
 
     resource_pool_free(r->mesh_pool, mesh.handle);
 }
 
+void renderer_free_mesh(Renderer* r, Mesh mesh) {
+    release_mesh(r, mesh);
+}
+
+void renderer_free_meshes(Renderer* r, u32 count, Mesh* meshes) {
+    for (u32 i = 0; i < count; ++i) {
+        release_mesh(r, meshes[i]);
+    }
+}
+
 bool renderer_mesh_alive(Renderer* r, Mesh mesh) {
     return resource_pool_handle_valid(r->mesh_pool, mesh.handle);
 }
 
-Material renderer_new_material(Renderer* r, RendererUploadContext* upload_context, u32 texture_w, u32 texture_h, void* texture_data) {
-    u64 handle = resource_pool_alloc(r->material_pool);
+u64 renderer_mesh_size(Renderer* r, Mesh mesh) {
+    return resource_pool_access(r->mesh_pool, mesh.handle, MeshData)->size;
+}
 
-    MaterialData* data = resource_pool_access(r->material_pool, handle, MaterialData);
+AABB renderer_mesh_aabb(Renderer* r, Mesh mesh) {
+    return resource_pool_access(r->mesh_pool, mesh.handle, MeshData)->aabb;
+}
+
+internal DXGI_FORMAT dxgi_texture_format(TextureFormat format) {
+    switch (format) {
+        case TEXTURE_FORMAT_RGBA8:
+            return DXGI_FORMAT_R8G8B8A8_UNORM;
+        case TEXTURE_FORMAT_BC1:
+            return DXGI_FORMAT_BC1_UNORM;
+        case TEXTURE_FORMAT_BC3:
+            return DXGI_FORMAT_BC3_UNORM;
+        case TEXTURE_FORMAT_BC5:
+            return DXGI_FORMAT_BC5_UNORM;
+        case TEXTURE_FORMAT_BC7:
+            return DXGI_FORMAT_BC7_UNORM;
+        default:
+            assert(false && "Unknown texture format");
+            return DXGI_FORMAT_UNKNOWN;
+    }
+}
+
+internal D3D12_RESOURCE_DESC texture_resource_desc(MaterialCreateInfo* info) {
+    u32 mip_count = info->mip_count > 0 ? info->mip_count : 1;
+    assert(mip_count <= MAX_MIP_LEVELS);
+    assert(info->format == TEXTURE_FORMAT_RGBA8 || (info->texture_w % 4 == 0 && info->texture_h % 4 == 0));
 
     D3D12_RESOURCE_DESC texture_desc = {};
     texture_desc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
-    texture_desc.Width = texture_w;
-    texture_desc.Height = texture_h;
+    texture_desc.Width = info->texture_w;
+    texture_desc.Height = info->texture_h;
     texture_desc.DepthOrArraySize = 1;
-    texture_desc.MipLevels = 1;
-    texture_desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+    texture_desc.MipLevels = (u16)mip_count;
+    texture_desc.Format = dxgi_texture_format(info->format);
     texture_desc.SampleDesc.Count = 1;
 
+    return texture_desc;
+}
+
+void renderer_texture_upload_layout(Renderer* r, MaterialCreateInfo* info, TextureUploadLayout* layout) {
+    D3D12_RESOURCE_DESC texture_desc = texture_resource_desc(info);
+
+    D3D12_PLACED_SUBRESOURCE_FOOTPRINT footprints[MAX_MIP_LEVELS];
+    r->device->GetCopyableFootprints(&texture_desc, 0, texture_desc.MipLevels, 0, footprints, 0, 0, &layout->size);
+
+    for (u32 i = 0; i < texture_desc.MipLevels; ++i) {
+        layout->level_offsets[i] = footprints[i].Offset;
+        layout->row_pitches[i] = footprints[i].Footprint.RowPitch;
+    }
+}
+
+Material renderer_new_material(Renderer* r, RendererUploadContext* upload_context, MaterialCreateInfo* info) {
+    u64 handle = resource_pool_alloc(r->material_pool);
+
+    MaterialData* data = resource_pool_access(r->material_pool, handle, MaterialData);
+
+    D3D12_RESOURCE_DESC texture_desc = texture_resource_desc(info);
+    u32 mip_count = texture_desc.MipLevels;
+
     D3D12_HEAP_PROPERTIES heap_props = {};
     heap_props.Type = D3D12_HEAP_TYPE_DEFAULT;
 
     r->device->CreateCommittedResource(&heap_props, D3D12_HEAP_FLAG_NONE, &texture_desc, D3D12_RESOURCE_STATE_COPY_DEST, 0, IID_PPV_ARGS(&data->texture));
+    data->size = r->device->GetResourceAllocationInfo(0, 1, &texture_desc).SizeInBytes;
+    data->upload_fence_val = UINT64_MAX;
+    data->upload_context = upload_context;
+    data->next_pending = upload_context->pending_materials;
+    upload_context->pending_materials = handle;
+
+    // Every level goes into one upload chunk, with rows padded to the pitch the copy requires. Rows of block
+    // formats are rows of blocks. Texture data already reserved in the context is laid out that way.
+    D3D12_PLACED_SUBRESOURCE_FOOTPRINT footprints[MAX_MIP_LEVELS];
+    u32 row_counts[MAX_MIP_LEVELS];
+    u64 row_sizes[MAX_MIP_LEVELS];
+    u64 staging_size = 0;
+    r->device->GetCopyableFootprints(&texture_desc, 0, mip_count, 0, footprints, row_counts, row_sizes, &staging_size);
+
+    UploadChunk upload_chunk;
+
+    if (find_upload_chunk(upload_context->cmd, info->texture_data, staging_size, &upload_chunk)) {
+        r->upload_stats.bytes_in_place += staging_size;
+    }
+    else {
+        upload_chunk = reserve_upload_chunk(r, upload_context->cmd, staging_size);
 
-    UploadChunk upload_chunk = get_upload_chunk(r, upload_context->cmd, texture_data, texture_w * texture_h * sizeof(u32));
-    
-    D3D12_TEXTURE_COPY_LOCATION dest_loc = {};
-    dest_loc.pResource = data->texture;
-    dest_loc.Type = D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX;
-
-    D3D12_TEXTURE_COPY_LOCATION src_loc = {};
-    src_loc.pResource = upload_chunk.resource;
-    src_loc.Type = D3D12_TEXTURE_COPY_TYPE_PLACED_FOOTPRINT;
-    src_loc.PlacedFootprint.Footprint.Format = texture_desc.Format;
-    src_loc.PlacedFootprint.Offset = upload_chunk.offset;
-    src_loc.PlacedFootprint.Footprint.Width = texture_w;
-    src_loc.PlacedFootprint.Footprint.Height = texture_h;
-    src_loc.PlacedFootprint.Footprint.Depth = 1;
-    src_loc.PlacedFootprint.Footprint.RowPitch = texture_w * sizeof(u32);
-        
-    upload_context->cmd->list->CopyTextureRegion(&dest_loc, 0, 0, 0, &src_loc, 0);
+        u8* src = (u8*)info->texture_data;
+
+        for (u32 i = 0; i < mip_count; ++i) {
+            for (u32 row = 0; row < row_counts[i]; ++row) {
+                memcpy((u8*)upload_chunk.ptr + footprints[i].Offset + (u64)row * footprints[i].Footprint.RowPitch, src, row_sizes[i]);
+                src += row_sizes[i];
+            }
+        }
+
+        r->upload_stats.bytes_copied += src - (u8*)info->texture_data;
+    }
+
+    for (u32 i = 0; i < mip_count; ++i) {
+        D3D12_TEXTURE_COPY_LOCATION dest_loc = {};
+        dest_loc.pResource = data->texture;
+        dest_loc.Type = D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX;
+        dest_loc.SubresourceIndex = i;
+
+        D3D12_TEXTURE_COPY_LOCATION src_loc = {};
+        src_loc.pResource = upload_chunk.resource;
+        src_loc.Type = D3D12_TEXTURE_COPY_TYPE_PLACED_FOOTPRINT;
+        src_loc.PlacedFootprint = footprints[i];
+        src_loc.PlacedFootprint.Offset += upload_chunk.offset;
+
+        upload_context->cmd->list->CopyTextureRegion(&dest_loc, 0, 0, 0, &src_loc, 0);
+    }
 
     data->texture_view = alloc_descriptor(&r->bindless_heap);
 
@@ -1503,16 +1884,52 @@ Material renderer_new_material(Renderer* r, RendererUploadContext* upload_contex
     return mat;
 }
 
-void renderer_free_material(Renderer* r, Material mat) {
-    wait_device_idle(r);
+// Takes a material freed before its context was submitted out of the context's pending materials.
+internal void unlink_pending_material(Renderer* r, RendererUploadContext* upload_context, u64 handle) {
+    u64* p_handle = &upload_context->pending_materials;
+    while (*p_handle != handle) {
+        p_handle = &resource_pool_access(r->material_pool, *p_handle, MaterialData)->next_pending;
+    }
 
+    *p_handle = resource_pool_access(r->material_pool, handle, MaterialData)->next_pending;
+}
+
+internal void release_material(Renderer* r, Material mat) {
     MaterialData* data = resource_pool_access(r->material_pool, mat.handle, MaterialData);
-    data->texture->Release();
-    free_descriptor(&r->bindless_heap, data->texture_view);
+
+    if (data->upload_context) {
+        unlink_pending_material(r, data->upload_context, mat.handle);
+    }
+
+    RetiredResource* retired = retire_resources(r, data->upload_context);
+    retired->count = 1;
+    retired->resources[0] = data->texture;
+    retired->views[0] = data->texture_view;
     
     resource_pool_free(r->material_pool, mat.handle);
 }
 
+void renderer_free_material(Renderer* r, Material mat) {
+    release_material(r, mat);
+}
+
+void renderer_free_materials(Renderer* r, u32 count, Material* mats) {
+    for (u32 i = 0; i < count; ++i) {
+        release_material(r, mats[i]);
+    }
+}
+
 bool renderer_material_alive(Renderer* r, Material mat) {
     return resource_pool_handle_valid(r->material_pool, mat.handle);
 }
+
+bool renderer_material_uploaded(Renderer* r, Material mat) {
+    MaterialData* data = resource_pool_access(r->material_pool, mat.handle, MaterialData);
+    return data->upload_fence_val != UINT64_MAX && command_queue_reached(&r->copy_queue, data->upload_fence_val);
+}
+
+u64 renderer_material_size(Renderer* r, Material mat) {
+    return resource_pool_access(r->material_pool, mat.handle, MaterialData)->size;
+}
+
+#endif
@@ -0,0 +1,421 @@
+#if RENDERER_NULL
+
+#include <string.h>
+
+#include "renderer.h"
+#include "utility/resource_pool.h"
+
+// A backend without a GPU, selected with RENDERER_NULL, for running the engine headless and measuring the CPU side
+// of loading. Resources keep only what the renderer reports back. Uploads are staged exactly as the D3D12 backend
+// stages them, so the upload stats match, and they complete as soon as they're submitted.
+
+#define MAX_MESHES (8 * 1024)
+#define MAX_MATERIALS (8 * 1024)
+
+#define UPLOAD_BLOCK_CAPACITY (64 * 1024 * 1024)
+
+// D3D12's copy rules, so reservations are laid out the same way.
+#define TEXTURE_PITCH_ALIGNMENT 256
+#define TEXTURE_PLACEMENT_ALIGNMENT 512
+
+// Resources are sized as D3D12 places committed resources, so budgets behave the same.
+#define RESOURCE_PLACEMENT_ALIGNMENT (64 * 1024)
+
+// Header of a page allocation whose memory starts TEXTURE_PLACEMENT_ALIGNMENT bytes in. Blocks bigger than
+// UPLOAD_BLOCK_CAPACITY hold one upload and are freed instead of recycled.
+struct UploadBlock {
+    UploadBlock* next;
+    u64 capacity;
+    u64 cursor;
+};
+
+struct MeshData {
+    u32 vertex_count;
+    u32 index_count;
+    AABB aabb;
+    u32 lod_count;
+    MeshLOD lods[MAX_MESH_LODS];
+    u64 size;
+};
+
+struct MaterialData {
+    u32 width;
+    u32 height;
+    u32 mip_count;
+    TextureFormat format;
+    u64 size;
+    u64 upload_fence_val; // UINT64_MAX until the context it was created in is submitted
+    RendererUploadContext* upload_context; // Where it was created, null once that's submitted
+    u64 next_pending; // Next material created in the same context, until it's submitted
+};
+
+struct RendererUploadContext {
+    UploadBlock* blocks;
+    u64 pending_materials; // Created in the context, linked through next_pending
+};
+
+struct RendererUploadTicket {
+    u64 fence_val;
+};
+
+struct Renderer {
+    ResourcePool* mesh_pool;
+    ResourcePool* material_pool;
+    UploadBlock* available_upload_blocks;
+    RendererUploadStats upload_stats;
+    u64 fence_val;
+    Material default_material;
+};
+
+internal u8* upload_block_memory(UploadBlock* block) {
+    return (u8*)block + TEXTURE_PLACEMENT_ALIGNMENT;
+}
+
+internal u64 align_up(u64 x, u64 alignment) {
+    return (x + alignment - 1) & ~(alignment - 1);
+}
+
+internal void* reserve_upload_memory(Renderer* r, RendererUploadContext* context, u64 size) {
+    UploadBlock* chosen_block = 0;
+
+    for (UploadBlock* block = context->blocks; block; block = block->next) {
+        u64 offset = align_up(block->cursor, TEXTURE_PLACEMENT_ALIGNMENT);
+        if (offset <= block->capacity && block->capacity - offset >= size) {
+            chosen_block = block;
+            break;
+        }
+    }
+
+    if (!chosen_block) {
+        if (size <= UPLOAD_BLOCK_CAPACITY && r->available_upload_blocks) {
+            chosen_block = r->available_upload_blocks;
+            r->available_upload_blocks = chosen_block->next;
+        }
+        else {
+            u64 capacity = size > UPLOAD_BLOCK_CAPACITY ? size : UPLOAD_BLOCK_CAPACITY;
+            chosen_block = (UploadBlock*)page_alloc(TEXTURE_PLACEMENT_ALIGNMENT + capacity);
+            chosen_block->capacity = capacity;
+        }
+
+        chosen_block->cursor = 0;
+        chosen_block->next = context->blocks;
+        context->blocks = chosen_block;
+    }
+
+    u64 offset = align_up(chosen_block->cursor, TEXTURE_PLACEMENT_ALIGNMENT);
+    chosen_block->cursor = offset + size;
+
+    return upload_block_memory(chosen_block) + offset;
+}
+
+internal bool is_reserved(RendererUploadContext* context, void* data, u64 size) {
+    for (UploadBlock* block = context->blocks; block; block = block->next) {
+        u8* begin = upload_block_memory(block);
+        if ((u8*)data >= begin && (u8*)data + size <= begin + block->cursor) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+internal void stage_upload(Renderer* r, RendererUploadContext* context, void* data, u64 size) {
+    if (is_reserved(context, data, size)) {
+        r->upload_stats.bytes_in_place += size;
+    }
+    else {
+        memcpy(reserve_upload_memory(r, context, size), data, size);
+        r->upload_stats.bytes_copied += size;
+    }
+}
+
+Renderer* renderer_init(Arena* arena, void* window) {
+    UNUSED(window);
+
+    Renderer* r = arena_push_struct_zero(arena, Renderer);
+    r->mesh_pool = resource_pool_new(arena, MAX_MESHES, sizeof(MeshData));
+    r->material_pool = resource_pool_new(arena, MAX_MATERIALS, sizeof(MaterialData));
+
+    Scratch scratch = get_scratch(&arena, 1);
+
+    RendererUploadContext* upload_context = renderer_open_upload_context(scratch.arena, r);
+
+    u8 default_texture_data[4] = { 128, 128, 128, 128 };
+
+    MaterialCreateInfo default_material_info = {};
+    default_material_info.texture_w = 1;
+    default_material_info.texture_h = 1;
+    default_material_info.texture_data = default_texture_data;
+    r->default_material = renderer_new_material(r, upload_context, &default_material_info);
+
+    renderer_flush_upload(r, renderer_submit_upload_context(scratch.arena, r, upload_context));
+
+    release_scratch(scratch);
+
+    return r;
+}
+
+void renderer_release_backend(Renderer* r) {
+    UNUSED(r);
+#if _DEBUG
+    renderer_free_material(r, r->default_material);
+
+    assert(resource_pool_num_allocations(r->mesh_pool) == 0 && "Outstanding meshes. Free all meshes in debug builds.");
+    assert(resource_pool_num_allocations(r->material_pool) == 0 && "Outstanding materials. Free all materials in debug builds.");
+
+    for (UploadBlock* block = r->available_upload_blocks; block;) {
+        UploadBlock* next = block->next;
+        page_free(block);
+        block = next;
+    }
+#endif
+}
+
+void renderer_handle_resize(Renderer* r, u32 width, u32 height) {
+    UNUSED(r);
+    UNUSED(width);
+    UNUSED(height);
+}
+
+void renderer_render_frame(Renderer* r, RendererFrameData* frame) {
+    UNUSED(r);
+    UNUSED(frame);
+}
+
+Material renderer_get_default_material(Renderer* r) {
+    return r->default_material;
+}
+
+RendererUploadContext* renderer_open_upload_context(Arena* arena, Renderer* r) {
+    UNUSED(r);
+    return arena_push_struct_zero(arena, RendererUploadContext);
+}
+
+// There's nothing to wait for, so the context's upload memory is recycled straight away.
+RendererUploadTicket* renderer_submit_upload_context(Arena* arena, Renderer* r, RendererUploadContext* context) {
+    for (UploadBlock* block = context->blocks; block;) {
+        UploadBlock* next = block->next;
+
+        if (block->capacity > UPLOAD_BLOCK_CAPACITY) {
+            page_free(block);
+        }
+        else {
+            block->next = r->available_upload_blocks;
+            r->available_upload_blocks = block;
+        }
+
+        block = next;
+    }
+
+    context->blocks = 0;
+
+    RendererUploadTicket* ticket = arena_push_struct(arena, RendererUploadTicket);
+    ticket->fence_val = ++r->fence_val;
+
+    for (u64 handle = context->pending_materials; handle;) {
+        MaterialData* data = resource_pool_access(r->material_pool, handle, MaterialData);
+        data->upload_fence_val = ticket->fence_val;
+        data->upload_context = 0;
+        handle = data->next_pending;
+    }
+
+    context->pending_materials = 0;
+
+    return ticket;
+}
+
+bool renderer_upload_finished(Renderer* r, RendererUploadTicket* ticket) {
+    return ticket->fence_val <= r->fence_val;
+}
+
+void renderer_flush_upload(Renderer* r, RendererUploadTicket* ticket) {
+    UNUSED(r);
+    UNUSED(ticket);
+}
+
+void* renderer_reserve_upload(Renderer* r, RendererUploadContext* upload_context, u64 size) {
+    return reserve_upload_memory(r, upload_context, size);
+}
+
+RendererUploadStats renderer_upload_stats(Renderer* r) {
+    return r->upload_stats;
+}
+
+Mesh renderer_new_mesh(Renderer* r, RendererUploadContext* upload_context, MeshCreateInfo* info) {
+    u64 handle = resource_pool_alloc(r->mesh_pool);
+
+    u32 vertex_stride = info->vertex_format == VERTEX_FORMAT_COMPACT ? sizeof(CompactVertex) : sizeof(Vertex);
+    u32 index_stride = info->index_format == INDEX_FORMAT_U16 ? sizeof(u16) : sizeof(u32);
+    u64 vertex_data_size = (u64)info->vertex_count * vertex_stride;
+    u64 index_data_size = (u64)info->index_count * index_stride;
+
+    stage_upload(r, upload_context, info->vertex_data, vertex_data_size);
+    stage_upload(r, upload_context, info->index_data, index_data_size);
+
+    MeshData* data = resource_pool_access(r->mesh_pool, handle, MeshData);
+    data->size = align_up(vertex_data_size, RESOURCE_PLACEMENT_ALIGNMENT) + align_up(index_data_size, RESOURCE_PLACEMENT_ALIGNMENT);
+    data->vertex_count = info->vertex_count;
+    data->index_count = info->index_count;
+    data->aabb = info->aabb;
+
+    if (info->lod_count > 0) {
+        assert(info->lod_count <= MAX_MESH_LODS);
+        data->lod_count = info->lod_count;
+        memcpy(data->lods, info->lods, info->lod_count * sizeof(MeshLOD));
+    }
+    else {
+        data->lod_count = 1;
+        data->lods[0].index_offset = 0;
+        data->lods[0].index_count = info->index_count;
+        data->lods[0].error = 0.0f;
+    }
+
+    Mesh mesh = {};
+    mesh.handle = handle;
+
+    return mesh;
+}
+
+void renderer_free_mesh(Renderer* r, Mesh mesh) {
+    resource_pool_free(r->mesh_pool, mesh.handle);
+}
+
+bool renderer_mesh_alive(Renderer* r, Mesh mesh) {
+    return resource_pool_handle_valid(r->mesh_pool, mesh.handle);
+}
+
+void renderer_free_meshes(Renderer* r, u32 count, Mesh* meshes) {
+    for (u32 i = 0; i < count; ++i) {
+        renderer_free_mesh(r, meshes[i]);
+    }
+}
+
+u64 renderer_mesh_size(Renderer* r, Mesh mesh) {
+    return resource_pool_access(r->mesh_pool, mesh.handle, MeshData)->size;
+}
+
+AABB renderer_mesh_aabb(Renderer* r, Mesh mesh) {
+    return resource_pool_access(r->mesh_pool, mesh.handle, MeshData)->aabb;
+}
+
+// Bytes in one row of a level, and how many rows it has. Rows of block formats are rows of 4x4 blocks.
+internal u64 texture_row_size(TextureFormat format, u32 width, u32 height, u32* num_rows) {
+    if (format == TEXTURE_FORMAT_RGBA8) {
+        *num_rows = height;
+        return (u64)width * sizeof(u32);
+    }
+
+    *num_rows = (height + 3) / 4;
+    return (u64)((width + 3) / 4) * (format == TEXTURE_FORMAT_BC1 ? 8 : 16);
+}
+
+void renderer_texture_upload_layout(Renderer* r, MaterialCreateInfo* info, TextureUploadLayout* layout) {
+    UNUSED(r);
+
+    u32 mip_count = info->mip_count > 0 ? info->mip_count : 1;
+    assert(mip_count <= MAX_MIP_LEVELS);
+    assert(info->format == TEXTURE_FORMAT_RGBA8 || (info->texture_w % 4 == 0 && info->texture_h % 4 == 0));
+
+    u32 width = info->texture_w;
+    u32 height = info->texture_h;
+    u64 cursor = 0;
+
+    for (u32 i = 0; i < mip_count; ++i) {
+        u32 num_rows;
+        u64 row_size = texture_row_size(info->format, width, height, &num_rows);
+
+        layout->level_offsets[i] = align_up(cursor, TEXTURE_PLACEMENT_ALIGNMENT);
+        layout->row_pitches[i] = (u32)align_up(row_size, TEXTURE_PITCH_ALIGNMENT);
+        cursor = layout->level_offsets[i] + (u64)layout->row_pitches[i] * (num_rows - 1) + row_size;
+
+        width = width > 1 ? width / 2 : 1;
+        height = height > 1 ? height / 2 : 1;
+    }
+
+    layout->size = cursor;
+}
+
+Material renderer_new_material(Renderer* r, RendererUploadContext* upload_context, MaterialCreateInfo* info) {
+    u64 handle = resource_pool_alloc(r->material_pool);
+
+    TextureUploadLayout layout;
+    renderer_texture_upload_layout(r, info, &layout);
+
+    MaterialData* data = resource_pool_access(r->material_pool, handle, MaterialData);
+    data->width = info->texture_w;
+    data->height = info->texture_h;
+    data->mip_count = info->mip_count > 0 ? info->mip_count : 1;
+    data->format = info->format;
+    data->size = align_up(layout.size, RESOURCE_PLACEMENT_ALIGNMENT);
+    data->upload_fence_val = UINT64_MAX;
+    data->upload_context = upload_context;
+    data->next_pending = upload_context->pending_materials;
+    upload_context->pending_materials = handle;
+
+    if (is_reserved(upload_context, info->texture_data, layout.size)) {
+        r->upload_stats.bytes_in_place += layout.size;
+    }
+    else {
+        u8* staging = (u8*)reserve_upload_memory(r, upload_context, layout.size);
+        u8* src = (u8*)info->texture_data;
+
+        u32 width = info->texture_w;
+        u32 height = info->texture_h;
+
+        for (u32 i = 0; i < data->mip_count; ++i) {
+            u32 num_rows;
+            u64 row_size = texture_row_size(info->format, width, height, &num_rows);
+
+            for (u32 row = 0; row < num_rows; ++row) {
+                memcpy(staging + layout.level_offsets[i] + (u64)row * layout.row_pitches[i], src, row_size);
+                src += row_size;
+            }
+
+            width = width > 1 ? width / 2 : 1;
+            height = height > 1 ? height / 2 : 1;
+        }
+
+        r->upload_stats.bytes_copied += src - (u8*)info->texture_data;
+    }
+
+    Material mat;
+    mat.handle = handle;
+
+    return mat;
+}
+
+// A material freed before its context is submitted comes out of the context's pending materials, like D3D12's.
+void renderer_free_material(Renderer* r, Material mat) {
+    MaterialData* data = resource_pool_access(r->material_pool, mat.handle, MaterialData);
+
+    if (data->upload_context) {
+        u64* p_handle = &data->upload_context->pending_materials;
+        while (*p_handle != mat.handle) {
+            p_handle = &resource_pool_access(r->material_pool, *p_handle, MaterialData)->next_pending;
+        }
+
+        *p_handle = data->next_pending;
+    }
+
+    resource_pool_free(r->material_pool, mat.handle);
+}
+
+bool renderer_material_alive(Renderer* r, Material mat) {
+    return resource_pool_handle_valid(r->material_pool, mat.handle);
+}
+
+bool renderer_material_uploaded(Renderer* r, Material mat) {
+    return resource_pool_access(r->material_pool, mat.handle, MaterialData)->upload_fence_val <= r->fence_val;
+}
+
+void renderer_free_materials(Renderer* r, u32 count, Material* mats) {
+    for (u32 i = 0; i < count; ++i) {
+        renderer_free_material(r, mats[i]);
+    }
+}
+
+u64 renderer_material_size(Renderer* r, Material mat) {
+    return resource_pool_access(r->material_pool, mat.handle, MaterialData)->size;
+}
+
+#endif
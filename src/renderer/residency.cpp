@@ -0,0 +1,490 @@
+#include <string.h>
+
+#include "residency.h"
+#include "block_compression.h"
+#include "utility/resource_pool.h"
+
+// Each update submits its uploads as one batch. Batches complete in submission order, and an update waits for a
+// slot before creating anything once this many are in flight.
+#define MAX_RESIDENCY_BATCHES 8
+#define RESIDENCY_BATCH_ARENA_SIZE (16 * 1024)
+
+enum ResidencyKind {
+    RESIDENCY_KIND_NONE, // A free slot
+    RESIDENCY_KIND_MESH,
+    RESIDENCY_KIND_MATERIAL,
+};
+
+enum ResidencyState {
+    RESIDENCY_STATE_EVICTED,
+    RESIDENCY_STATE_QUEUED,
+    RESIDENCY_STATE_LOADED, // Drawable once its batch has completed
+};
+
+struct ResidencyEntry {
+    ResidencyKind kind;
+    ResidencyState state;
+    ResidencyMeshProc* mesh_proc;
+    ResidencyMaterialProc* material_proc;
+    void* source_data;
+    u64 cache_size; // Non-zero when source_data is a cache owned by the manager
+    u64 resource; // The renderer's handle while loaded
+    u64 size; // GPU bytes, known once loaded
+    u64 batch;
+    u64 last_used_frame;
+    u64 prev; // Loaded entries, least recently used first
+    u64 next;
+};
+
+struct ResidencyBatch {
+    Arena arena;
+    RendererUploadTicket* ticket;
+};
+
+struct ResidencyManager {
+    Renderer* renderer;
+    u64 budget;
+    u64 frame;
+
+    ResourcePool* entries;
+    u64 lru_head;
+    u64 lru_tail;
+
+    u32 num_queued;
+    u64* queued; // In the order they were missed
+
+    // Renderer resources of removed and evicted entries, freed together by the next update.
+    u32 capacity;
+    u32 num_dropped_meshes;
+    Mesh* dropped_meshes;
+    u32 num_dropped_materials;
+    Material* dropped_materials;
+
+    u32 first_batch;
+    u32 num_batches;
+    ResidencyBatch batches[MAX_RESIDENCY_BATCHES];
+    u64 num_submitted_batches;
+    u64 num_completed_batches;
+
+    ResidencyStats stats;
+};
+
+ResidencyManager* residency_new(Arena* arena, Renderer* renderer, u32 capacity, u64 budget) {
+    ResidencyManager* manager = arena_push_struct_zero(arena, ResidencyManager);
+
+    manager->renderer = renderer;
+    manager->budget = budget;
+
+    manager->entries = resource_pool_new(arena, capacity, sizeof(ResidencyEntry));
+    manager->queued = arena_push_array(arena, u64, capacity);
+
+    manager->capacity = capacity;
+    manager->dropped_meshes = arena_push_array(arena, Mesh, capacity);
+    manager->dropped_materials = arena_push_array(arena, Material, capacity);
+
+    for (u32 i = 0; i < MAX_RESIDENCY_BATCHES; ++i) {
+        manager->batches[i].arena = arena_init(arena_push(arena, RESIDENCY_BATCH_ARENA_SIZE), RESIDENCY_BATCH_ARENA_SIZE);
+    }
+
+    return manager;
+}
+
+void residency_set_budget(ResidencyManager* manager, u64 budget) {
+    manager->budget = budget;
+}
+
+internal ResidencyEntry* get_entry(ResidencyManager* manager, u64 handle) {
+    assert(resource_pool_handle_valid(manager->entries, handle) && "Resource is not owned by this manager");
+    return resource_pool_access(manager->entries, handle, ResidencyEntry);
+}
+
+internal u64 new_entry(ResidencyManager* manager, ResidencyKind kind, void* source_data) {
+    u64 handle = resource_pool_alloc(manager->entries);
+
+    ResidencyEntry* entry = get_entry(manager, handle);
+    *entry = {};
+    entry->kind = kind;
+    entry->source_data = source_data;
+
+    return handle;
+}
+
+internal bool entry_ready(ResidencyManager* manager, ResidencyEntry* entry) {
+    return entry->state == RESIDENCY_STATE_LOADED && entry->batch <= manager->num_completed_batches;
+}
+
+internal void lru_unlink(ResidencyManager* manager, ResidencyEntry* entry) {
+    if (entry->prev) {
+        get_entry(manager, entry->prev)->next = entry->next;
+    }
+    else {
+        manager->lru_head = entry->next;
+    }
+
+    if (entry->next) {
+        get_entry(manager, entry->next)->prev = entry->prev;
+    }
+    else {
+        manager->lru_tail = entry->prev;
+    }
+
+    entry->prev = 0;
+    entry->next = 0;
+}
+
+internal void lru_push_back(ResidencyManager* manager, u64 handle, ResidencyEntry* entry) {
+    entry->prev = manager->lru_tail;
+    entry->next = 0;
+
+    if (manager->lru_tail) {
+        get_entry(manager, manager->lru_tail)->next = handle;
+    }
+    else {
+        manager->lru_head = handle;
+    }
+
+    manager->lru_tail = handle;
+}
+
+// Unloads the entry, leaving its renderer resource to be freed with the rest of the update's.
+internal void drop_entry_resource(ResidencyManager* manager, ResidencyEntry* entry) {
+    assert(entry->state == RESIDENCY_STATE_LOADED);
+
+    lru_unlink(manager, entry);
+
+    if (entry->kind == RESIDENCY_KIND_MESH) {
+        assert(manager->num_dropped_meshes < manager->capacity && "Too many meshes dropped between updates");
+        manager->dropped_meshes[manager->num_dropped_meshes++] = { entry->resource };
+    }
+    else {
+        assert(manager->num_dropped_materials < manager->capacity && "Too many materials dropped between updates");
+        manager->dropped_materials[manager->num_dropped_materials++] = { entry->resource };
+    }
+
+    entry->state = RESIDENCY_STATE_EVICTED;
+    entry->resource = 0;
+
+    manager->stats.bytes_resident -= entry->size;
+    --manager->stats.num_resident;
+}
+
+ResidentMesh residency_add_mesh(ResidencyManager* manager, ResidencyMeshProc* proc, void* data) {
+    ResidentMesh mesh;
+    mesh.handle = new_entry(manager, RESIDENCY_KIND_MESH, data);
+    get_entry(manager, mesh.handle)->mesh_proc = proc;
+    return mesh;
+}
+
+ResidentMaterial residency_add_material(ResidencyManager* manager, ResidencyMaterialProc* proc, void* data) {
+    ResidentMaterial material;
+    material.handle = new_entry(manager, RESIDENCY_KIND_MATERIAL, data);
+    get_entry(manager, material.handle)->material_proc = proc;
+    return material;
+}
+
+// Caches are page allocations holding the create info, with its data pointing just past it.
+
+internal void cached_mesh_proc(void* data, Arena* arena, MeshCreateInfo* info) {
+    UNUSED(arena);
+    *info = *(MeshCreateInfo*)data;
+}
+
+internal void cached_material_proc(void* data, Arena* arena, MaterialCreateInfo* info) {
+    UNUSED(arena);
+    *info = *(MaterialCreateInfo*)data;
+}
+
+internal void set_entry_cache(ResidencyManager* manager, u64 handle, u64 cache_size) {
+    get_entry(manager, handle)->cache_size = cache_size;
+    manager->stats.bytes_cached += cache_size;
+}
+
+ResidentMesh residency_add_mesh_cached(ResidencyManager* manager, MeshCreateInfo* info) {
+    u64 vertex_size = (u64)info->vertex_count * (info->vertex_format == VERTEX_FORMAT_COMPACT ? sizeof(CompactVertex) : sizeof(Vertex));
+    u64 index_size = (u64)info->index_count * (info->index_format == INDEX_FORMAT_U16 ? sizeof(u16) : sizeof(u32));
+    u64 cache_size = sizeof(MeshCreateInfo) + vertex_size + index_size;
+
+    u8* cache = (u8*)page_alloc(cache_size);
+
+    MeshCreateInfo* cached_info = (MeshCreateInfo*)cache;
+    *cached_info = *info;
+    cached_info->vertex_data = cache + sizeof(MeshCreateInfo);
+    cached_info->index_data = cache + sizeof(MeshCreateInfo) + vertex_size;
+
+    memcpy(cached_info->vertex_data, info->vertex_data, vertex_size);
+    memcpy(cached_info->index_data, info->index_data, index_size);
+
+    ResidentMesh mesh = residency_add_mesh(manager, cached_mesh_proc, cache);
+    set_entry_cache(manager, mesh.handle, cache_size);
+
+    return mesh;
+}
+
+ResidentMaterial residency_add_material_cached(ResidencyManager* manager, MaterialCreateInfo* info) {
+    u32 mip_count = info->mip_count > 0 ? info->mip_count : 1;
+    u64 texture_size = texture_chain_size(info->format, info->texture_w, info->texture_h, mip_count);
+    u64 cache_size = sizeof(MaterialCreateInfo) + texture_size;
+
+    u8* cache = (u8*)page_alloc(cache_size);
+
+    MaterialCreateInfo* cached_info = (MaterialCreateInfo*)cache;
+    *cached_info = *info;
+    cached_info->texture_data = cache + sizeof(MaterialCreateInfo);
+
+    memcpy(cached_info->texture_data, info->texture_data, texture_size);
+
+    ResidentMaterial material = residency_add_material(manager, cached_material_proc, cache);
+    set_entry_cache(manager, material.handle, cache_size);
+
+    return material;
+}
+
+internal void remove_entry(ResidencyManager* manager, u64 handle, ResidencyKind kind) {
+    ResidencyEntry* entry = get_entry(manager, handle);
+    assert(entry->kind == kind);
+    UNUSED(kind);
+
+    if (entry->state == RESIDENCY_STATE_LOADED) {
+        drop_entry_resource(manager, entry);
+    }
+    else if (entry->state == RESIDENCY_STATE_QUEUED) {
+        for (u32 i = 0; i < manager->num_queued; ++i) {
+            if (manager->queued[i] == handle) {
+                memmove(manager->queued + i, manager->queued + i + 1, (manager->num_queued - i - 1) * sizeof(u64));
+                --manager->num_queued;
+                break;
+            }
+        }
+    }
+
+    if (entry->cache_size) {
+        page_free(entry->source_data);
+        manager->stats.bytes_cached -= entry->cache_size;
+    }
+
+    entry->kind = RESIDENCY_KIND_NONE;
+    resource_pool_free(manager->entries, handle);
+}
+
+void residency_remove_mesh(ResidencyManager* manager, ResidentMesh mesh) {
+    remove_entry(manager, mesh.handle, RESIDENCY_KIND_MESH);
+}
+
+void residency_remove_material(ResidencyManager* manager, ResidentMaterial material) {
+    remove_entry(manager, material.handle, RESIDENCY_KIND_MATERIAL);
+}
+
+// Returns the entry if it's ready to draw.
+internal ResidencyEntry* use_entry(ResidencyManager* manager, u64 handle, ResidencyKind kind) {
+    ResidencyEntry* entry = get_entry(manager, handle);
+    assert(entry->kind == kind);
+    UNUSED(kind);
+
+    if (entry->state == RESIDENCY_STATE_LOADED && entry->last_used_frame != manager->frame) {
+        lru_unlink(manager, entry);
+        lru_push_back(manager, handle, entry);
+    }
+
+    entry->last_used_frame = manager->frame;
+
+    if (entry_ready(manager, entry)) {
+        ++manager->stats.hits;
+        return entry;
+    }
+
+    ++manager->stats.misses;
+
+    if (entry->state == RESIDENCY_STATE_EVICTED) {
+        entry->state = RESIDENCY_STATE_QUEUED;
+        manager->queued[manager->num_queued++] = handle;
+    }
+
+    return 0;
+}
+
+bool residency_use_mesh(ResidencyManager* manager, ResidentMesh resident, Mesh* mesh) {
+    ResidencyEntry* entry = use_entry(manager, resident.handle, RESIDENCY_KIND_MESH);
+    if (!entry) {
+        return false;
+    }
+
+    mesh->handle = entry->resource;
+    return true;
+}
+
+Material residency_use_material(ResidencyManager* manager, ResidentMaterial resident) {
+    ResidencyEntry* entry = use_entry(manager, resident.handle, RESIDENCY_KIND_MATERIAL);
+    if (!entry) {
+        return renderer_get_default_material(manager->renderer);
+    }
+
+    Material material;
+    material.handle = entry->resource;
+    return material;
+}
+
+internal void retire_batches(ResidencyManager* manager) {
+    while (manager->num_batches > 0) {
+        ResidencyBatch* batch = &manager->batches[manager->first_batch];
+        if (!renderer_upload_finished(manager->renderer, batch->ticket)) {
+            break;
+        }
+
+        manager->first_batch = (manager->first_batch + 1) % MAX_RESIDENCY_BATCHES;
+        --manager->num_batches;
+        ++manager->num_completed_batches;
+    }
+}
+
+// Evicts least recently used entries until needed more bytes fit in the budget. Entries used this frame are never
+// evicted, and neither are ones whose uploads are in flight. Returns false if the budget can't be met.
+internal bool make_room(ResidencyManager* manager, u64 needed) {
+    u64 handle = manager->lru_head;
+
+    while (manager->stats.bytes_resident + needed > manager->budget) {
+        if (!handle) {
+            return false;
+        }
+
+        ResidencyEntry* entry = get_entry(manager, handle);
+
+        // The list is in order of use, so everything from here on was used this frame.
+        if (entry->last_used_frame == manager->frame) {
+            return false;
+        }
+
+        u64 next = entry->next;
+
+        if (entry_ready(manager, entry)) {
+            ++manager->stats.evictions;
+            manager->stats.bytes_evicted += entry->size;
+            drop_entry_resource(manager, entry);
+        }
+
+        handle = next;
+    }
+
+    return true;
+}
+
+internal void load_entry(ResidencyManager* manager, u64 handle, RendererUploadContext* upload_context) {
+    ResidencyEntry* entry = get_entry(manager, handle);
+    Scratch scratch = get_scratch(0, 0);
+
+    if (entry->kind == RESIDENCY_KIND_MESH) {
+        MeshCreateInfo info = {};
+        entry->mesh_proc(entry->source_data, scratch.arena, &info);
+
+        entry->resource = renderer_new_mesh(manager->renderer, upload_context, &info).handle;
+        entry->size = renderer_mesh_size(manager->renderer, { entry->resource });
+    }
+    else {
+        MaterialCreateInfo info = {};
+        entry->material_proc(entry->source_data, scratch.arena, &info);
+
+        entry->resource = renderer_new_material(manager->renderer, upload_context, &info).handle;
+        entry->size = renderer_material_size(manager->renderer, { entry->resource });
+    }
+
+    release_scratch(scratch);
+
+    entry->state = RESIDENCY_STATE_LOADED;
+    entry->batch = manager->num_submitted_batches + 1;
+    entry->last_used_frame = manager->frame;
+    lru_push_back(manager, handle, entry);
+
+    ResidencyStats* stats = &manager->stats;
+    ++stats->loads;
+    ++stats->num_resident;
+    stats->bytes_loaded += entry->size;
+    stats->bytes_resident += entry->size;
+
+    if (stats->bytes_resident > stats->peak_bytes_resident) {
+        stats->peak_bytes_resident = stats->bytes_resident;
+    }
+}
+
+internal void free_dropped_resources(ResidencyManager* manager) {
+    renderer_free_meshes(manager->renderer, manager->num_dropped_meshes, manager->dropped_meshes);
+    renderer_free_materials(manager->renderer, manager->num_dropped_materials, manager->dropped_materials);
+
+    manager->num_dropped_meshes = 0;
+    manager->num_dropped_materials = 0;
+}
+
+void residency_update(ResidencyManager* manager, u64 max_upload_bytes) {
+    retire_batches(manager);
+
+    ResidencyBatch* batch = 0;
+    if (manager->num_batches < MAX_RESIDENCY_BATCHES) {
+        batch = &manager->batches[(manager->first_batch + manager->num_batches) % MAX_RESIDENCY_BATCHES];
+    }
+
+    RendererUploadContext* upload_context = 0;
+    u64 bytes_uploaded = 0;
+    u32 num_loaded = 0;
+    u32 num_kept = 0;
+
+    for (u32 i = 0; i < manager->num_queued; ++i) {
+        u64 handle = manager->queued[i];
+        ResidencyEntry* entry = get_entry(manager, handle);
+
+        // Room is made ahead for resources loaded before, whose size is known, and after for new ones. Resources
+        // used this frame are loaded past the budget, as they'd be kept past it.
+        bool load = batch && (num_loaded == 0 || bytes_uploaded < max_upload_bytes) &&
+                    (!entry->size || make_room(manager, entry->size) || entry->last_used_frame == manager->frame);
+
+        if (!load) {
+            manager->queued[num_kept++] = handle;
+            continue;
+        }
+
+        if (!upload_context) {
+            arena_clear(&batch->arena);
+            upload_context = renderer_open_upload_context(&batch->arena, manager->renderer);
+        }
+
+        load_entry(manager, handle, upload_context);
+
+        bytes_uploaded += entry->size;
+        ++num_loaded;
+    }
+
+    manager->num_queued = num_kept;
+
+    make_room(manager, 0);
+
+    if (upload_context) {
+        batch->ticket = renderer_submit_upload_context(&batch->arena, manager->renderer, upload_context);
+        ++manager->num_batches;
+        ++manager->num_submitted_batches;
+    }
+
+    free_dropped_resources(manager);
+
+    // Uploads that finish straight away are drawable next frame.
+    retire_batches(manager);
+
+    ++manager->frame;
+}
+
+ResidencyStats residency_stats(ResidencyManager* manager) {
+    return manager->stats;
+}
+
+void residency_destroy(ResidencyManager* manager) {
+    ResourcePool* pool = manager->entries;
+
+    // Slots are zeroed when the pool is created and marked free when removed, so live entries are the ones with a
+    // kind.
+    for (u32 i = 0; i < pool->capacity; ++i) {
+        u64 handle = ((u64)pool->generations[i] << 32) | i;
+        ResidencyEntry* entry = resource_pool_access(pool, handle, ResidencyEntry);
+
+        if (entry->kind != RESIDENCY_KIND_NONE) {
+            remove_entry(manager, handle, entry->kind);
+        }
+    }
+
+    free_dropped_resources(manager);
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "renderer.h"
+
+// Keeps meshes and materials on the GPU within a memory budget. Resources are registered with a way to create
+// them, are created the first time they're used, and are evicted least recently used first when the budget runs
+// out, to be created again the next time they're used. The renderer's pools only hold what's resident, so far more
+// resources can be registered than the renderer has room for.
+//
+// Handles stay valid across evictions; the renderer handle behind one changes each time it's created. Resolve
+// handles while building each frame: using a resource is what keeps it resident, and a resource used this frame is
+// never evicted, even if that leaves the budget exceeded.
+//
+// Nothing in the engine registers with it yet. The glTF loader creates its meshes and materials directly and keeps
+// no source to create one again from, so loaded scenes stay resident for as long as they're held.
+
+struct ResidencyManager;
+
+struct ResidentMesh {
+    u64 handle;
+};
+
+struct ResidentMaterial {
+    u64 handle;
+};
+
+// Fill info with the resource's data, pushed to arena, which lives until the upload has been recorded.
+typedef void ResidencyMeshProc(void* data, Arena* arena, MeshCreateInfo* info);
+typedef void ResidencyMaterialProc(void* data, Arena* arena, MaterialCreateInfo* info);
+
+struct ResidencyStats {
+    u64 hits; // Uses of resources ready to draw
+    u64 misses; // Uses of resources still evicted or uploading
+    u64 loads;
+    u64 evictions;
+    u64 bytes_loaded;
+    u64 bytes_evicted;
+    u64 bytes_resident; // Including uploads in flight
+    u64 peak_bytes_resident;
+    u64 bytes_cached; // CPU copies kept by resources added with a cache
+    u32 num_resident;
+};
+
+ResidencyManager* residency_new(Arena* arena, Renderer* renderer, u32 capacity, u64 budget);
+
+// Frees every resource and cache. Handles are invalid afterwards.
+void residency_destroy(ResidencyManager* manager);
+
+// Takes effect at the next update.
+void residency_set_budget(ResidencyManager* manager, u64 budget);
+
+// Resources created on demand by calling proc with data.
+ResidentMesh residency_add_mesh(ResidencyManager* manager, ResidencyMeshProc* proc, void* data);
+ResidentMaterial residency_add_material(ResidencyManager* manager, ResidencyMaterialProc* proc, void* data);
+
+// Resources with no other source: info's data is copied to CPU memory the manager keeps until the resource is
+// removed, and recreated from there.
+ResidentMesh residency_add_mesh_cached(ResidencyManager* manager, MeshCreateInfo* info);
+ResidentMaterial residency_add_material_cached(ResidencyManager* manager, MaterialCreateInfo* info);
+
+// The GPU resource is freed by the next update.
+void residency_remove_mesh(ResidencyManager* manager, ResidentMesh mesh);
+void residency_remove_material(ResidencyManager* manager, ResidentMaterial material);
+
+// Marks the resource used this frame. Returns false while it isn't ready to draw, having queued it for the next
+// update if it's evicted.
+bool residency_use_mesh(ResidencyManager* manager, ResidentMesh resident, Mesh* mesh);
+
+// Like residency_use_mesh, but returns the default material while the material isn't ready.
+Material residency_use_material(ResidencyManager* manager, ResidentMaterial resident);
+
+// Call once per frame, after the frame's uses, from the thread that owns the renderer. Creates queued resources
+// in the order they were first missed until max_upload_bytes have been uploaded (at least one resource), evicts
+// resources not used this frame until the budget is met, and submits the uploads. Evicted resources are freed in
+// one renderer call.
+void residency_update(ResidencyManager* manager, u64 max_upload_bytes);
+
+ResidencyStats residency_stats(ResidencyManager* manager);
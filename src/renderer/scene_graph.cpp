@@ -0,0 +1,235 @@
+#include <string.h>
+
+#include "scene_graph.h"
+#include "utility/work_queue.h"
+
+#define SCENE_GRAPH_NODES_PER_CHUNK 256
+#define SCENE_GRAPH_INSTANCES_PER_CHUNK 1024
+
+internal bool dirty_bit(u64* bits, u32 index) {
+    return (bits[index / 64] >> (index % 64)) & 1;
+}
+
+internal void set_dirty_bit(u64* bits, u32 index) {
+    bits[index / 64] |= 1ull << (index % 64);
+}
+
+SceneGraph* scene_graph_new(Arena* arena, u32 num_nodes, u32* parents, XMVECTOR* translations, XMVECTOR* rotations, XMVECTOR* scales, u32* node_map) {
+    Scratch scratch = get_scratch(&arena, 1);
+
+    // Input node num_nodes stands in for the root while sorting.
+    u32 total = num_nodes + 1;
+
+    u32* child_offsets = arena_push_array_zero(scratch.arena, u32, total + 1);
+    for (u32 i = 0; i < num_nodes; ++i) {
+        u32 parent = parents[i] == SCENE_NO_PARENT ? num_nodes : parents[i];
+        assert(parent <= num_nodes && parent != i);
+        ++child_offsets[parent + 1];
+    }
+
+    for (u32 i = 0; i < total; ++i) {
+        child_offsets[i + 1] += child_offsets[i];
+    }
+
+    u32* children = arena_push_array(scratch.arena, u32, num_nodes);
+    u32* child_cursors = arena_push_array(scratch.arena, u32, total);
+    memcpy(child_cursors, child_offsets, total * sizeof(u32));
+
+    for (u32 i = 0; i < num_nodes; ++i) {
+        u32 parent = parents[i] == SCENE_NO_PARENT ? num_nodes : parents[i];
+        children[child_cursors[parent]++] = i;
+    }
+
+    // Breadth-first from the root; every pass over the queue is one level.
+    u32* order = arena_push_array(scratch.arena, u32, total);
+    u32* graph_index = arena_push_array(scratch.arena, u32, total);
+    u32* level_starts = arena_push_array(scratch.arena, u32, total + 1);
+
+    u32 num_ordered = 0;
+    u32 num_levels = 0;
+
+    order[num_ordered] = num_nodes;
+    graph_index[num_nodes] = num_ordered++;
+
+    u32 level_start = 0;
+    while (level_start < num_ordered) {
+        u32 level_end = num_ordered;
+        level_starts[num_levels++] = level_start;
+
+        for (u32 i = level_start; i < level_end; ++i) {
+            u32 node = order[i];
+
+            for (u32 j = child_offsets[node]; j < child_offsets[node + 1]; ++j) {
+                order[num_ordered] = children[j];
+                graph_index[children[j]] = num_ordered++;
+            }
+        }
+
+        level_start = level_end;
+    }
+
+    level_starts[num_levels] = num_ordered;
+    assert(num_ordered == total && "Scene graph has a cycle");
+
+    SceneGraph* graph = arena_push_struct_zero(arena, SceneGraph);
+    graph->num_nodes = total;
+    graph->num_levels = num_levels;
+    graph->level_starts = arena_push_array(arena, u32, num_levels + 1);
+    graph->parents = arena_push_array(arena, u32, total);
+    graph->translations = arena_push_array(arena, XMVECTOR, total);
+    graph->rotations = arena_push_array(arena, XMVECTOR, total);
+    graph->scales = arena_push_array(arena, XMVECTOR, total);
+    graph->world_transforms = arena_push_array(arena, XMMATRIX, total);
+    graph->dirty_bits = arena_push_array_zero(arena, u64, (total + 63) / 64);
+    graph->recomputed = arena_push_array_zero(arena, u8, total);
+
+    memcpy(graph->level_starts, level_starts, (num_levels + 1) * sizeof(u32));
+
+    graph->parents[SCENE_GRAPH_ROOT] = SCENE_NO_PARENT;
+    graph->translations[SCENE_GRAPH_ROOT] = XMVectorZero();
+    graph->rotations[SCENE_GRAPH_ROOT] = XMQuaternionIdentity();
+    graph->scales[SCENE_GRAPH_ROOT] = XMVectorSplatOne();
+
+    for (u32 i = 0; i < num_nodes; ++i) {
+        u32 node = graph_index[i];
+        u32 parent = parents[i] == SCENE_NO_PARENT ? num_nodes : parents[i];
+
+        graph->parents[node] = graph_index[parent];
+        graph->translations[node] = translations[i];
+        graph->rotations[node] = rotations[i];
+        graph->scales[node] = scales[i];
+
+        node_map[i] = node;
+    }
+
+    release_scratch(scratch);
+
+    // Dirtying the root recomputes everything.
+    set_dirty_bit(graph->dirty_bits, SCENE_GRAPH_ROOT);
+    graph->first_dirty = SCENE_GRAPH_ROOT;
+    scene_graph_update(graph, 0, 0, 0, 0, 0, 0, 0);
+
+    return graph;
+}
+
+// Every level but the root's holds a node, so there are at most as many levels as graph nodes.
+u64 scene_graph_size(u32 num_nodes) {
+    u32 total = num_nodes + 1;
+
+    u64 size = arena_array_size(SceneGraph, 1);
+    size += arena_array_size(u32, total + 1);
+    size += arena_array_size(u32, total);
+    size += 3 * arena_array_size(XMVECTOR, total);
+    size += arena_array_size(XMMATRIX, total);
+    size += arena_array_size(u64, (total + 63) / 64);
+    size += arena_array_size(u8, total);
+
+    return size;
+}
+
+void scene_graph_set_local_transform(SceneGraph* graph, u32 node, XMVECTOR translation, XMVECTOR rotation, XMVECTOR scale) {
+    assert(node < graph->num_nodes);
+
+    graph->translations[node] = translation;
+    graph->rotations[node] = rotation;
+    graph->scales[node] = scale;
+
+    scene_graph_mark_dirty(graph, node);
+}
+
+void scene_graph_mark_dirty(SceneGraph* graph, u32 node) {
+    assert(node < graph->num_nodes);
+
+    set_dirty_bit(graph->dirty_bits, node);
+
+    if (node < graph->first_dirty) {
+        graph->first_dirty = node;
+    }
+}
+
+struct SceneGraphLevelUpdate {
+    SceneGraph* graph;
+    u32 level_start;
+};
+
+// A node is recomputed when it is dirty or its parent was recomputed. Parents are a level up, so their flags are
+// final, and each node's flag is a separate byte, so chunks of a level never share a write.
+internal void update_scene_graph_level(void* data, u32 begin, u32 end) {
+    SceneGraphLevelUpdate* update = (SceneGraphLevelUpdate*)data;
+    SceneGraph* graph = update->graph;
+
+    for (u32 node = update->level_start + begin; node < update->level_start + end; ++node) {
+        u32 parent = graph->parents[node];
+        bool parent_recomputed = parent != SCENE_NO_PARENT && graph->recomputed[parent];
+
+        if (!parent_recomputed && !dirty_bit(graph->dirty_bits, node)) {
+            continue;
+        }
+
+        graph->recomputed[node] = 1;
+
+        XMMATRIX local = XMMatrixAffineTransformation(graph->scales[node], XMVectorZero(), graph->rotations[node], graph->translations[node]);
+        graph->world_transforms[node] = parent == SCENE_NO_PARENT ? local : local * graph->world_transforms[parent];
+    }
+}
+
+struct SceneGraphInstanceUpdate {
+    SceneGraph* graph;
+    MeshInstance* instances;
+    u32* instance_nodes;
+};
+
+internal void update_scene_graph_instances(void* data, u32 begin, u32 end) {
+    SceneGraphInstanceUpdate* update = (SceneGraphInstanceUpdate*)data;
+
+    for (u32 i = begin; i < end; ++i) {
+        u32 node = update->instance_nodes[i];
+
+        if (update->graph->recomputed[node]) {
+            update->instances[i].transform = update->graph->world_transforms[node];
+        }
+    }
+}
+
+void scene_graph_update(SceneGraph* graph, WorkQueue* queue, u32 num_instances, MeshInstance* instances, u32* instance_nodes, u32 num_batches, MeshInstanceBatch* batches, u32* batch_nodes) {
+    if (graph->first_dirty >= graph->num_nodes) {
+        return;
+    }
+
+    // Levels above the first dirty node have nothing to recompute.
+    u32 level = 0;
+    while (graph->level_starts[level + 1] <= graph->first_dirty) {
+        ++level;
+    }
+
+    for (; level < graph->num_levels; ++level) {
+        SceneGraphLevelUpdate update;
+        update.graph = graph;
+        update.level_start = graph->level_starts[level];
+
+        u32 level_size = graph->level_starts[level + 1] - update.level_start;
+        work_queue_parallel_for(queue, update_scene_graph_level, &update, level_size, SCENE_GRAPH_NODES_PER_CHUNK);
+    }
+
+    SceneGraphInstanceUpdate instance_update;
+    instance_update.graph = graph;
+    instance_update.instances = instances;
+    instance_update.instance_nodes = instance_nodes;
+
+    work_queue_parallel_for(queue, update_scene_graph_instances, &instance_update, num_instances, SCENE_GRAPH_INSTANCES_PER_CHUNK);
+
+    // Batches are few and only carry one transform each.
+    for (u32 i = 0; i < num_batches; ++i) {
+        u32 node = batch_nodes[i];
+        if (graph->recomputed[node]) {
+            batches[i].transform = graph->world_transforms[node];
+        }
+    }
+
+    // Nothing before the first dirty node was touched.
+    u32 first_word = graph->first_dirty / 64;
+    memset(graph->dirty_bits + first_word, 0, ((graph->num_nodes + 63) / 64 - first_word) * sizeof(u64));
+    memset(graph->recomputed + graph->first_dirty, 0, graph->num_nodes - graph->first_dirty);
+
+    graph->first_dirty = graph->num_nodes;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "renderer.h"
+
+struct WorkQueue;
+
+#define SCENE_GRAPH_ROOT 0
+#define SCENE_NO_PARENT UINT32_MAX
+
+// Transform hierarchy kept as parallel arrays in breadth-first order: every node comes after its parent and
+// each depth is a contiguous range. Node 0 is a root added by the graph that parentless nodes hang off, so a
+// whole scene can be placed with one transform.
+struct SceneGraph {
+    u32 num_nodes;
+    u32 num_levels;
+    u32* level_starts; // num_levels + 1 entries
+    u32* parents;
+    XMVECTOR* translations;
+    XMVECTOR* rotations; // Quaternions
+    XMVECTOR* scales;
+    XMMATRIX* world_transforms;
+    u64* dirty_bits; // Nodes whose local transform changed since the last update
+    u32 first_dirty; // num_nodes when nothing is dirty
+    u8* recomputed; // Nodes whose world transform changed during the current update
+};
+
+// Nodes can be given in any order; parents index the same arrays, or are SCENE_NO_PARENT. node_map receives each
+// input node's index in the graph. World transforms are up to date on return.
+SceneGraph* scene_graph_new(Arena* arena, u32 num_nodes, u32* parents, XMVECTOR* translations, XMVECTOR* rotations, XMVECTOR* scales, u32* node_map);
+
+// The most scene_graph_new pushes to its arena for num_nodes nodes.
+u64 scene_graph_size(u32 num_nodes);
+
+void scene_graph_set_local_transform(SceneGraph* graph, u32 node, XMVECTOR translation, XMVECTOR rotation, XMVECTOR scale);
+
+// For callers that write the local transform arrays directly.
+void scene_graph_mark_dirty(SceneGraph* graph, u32 node);
+
+// Recomputes the world transforms of dirty nodes and everything below them, level by level, with each level split
+// across the work queue (which may be null). Instances bound to a recomputed node get its new transform in place;
+// instance_nodes is parallel to instances. Instance batches follow their nodes the same way through batch_nodes.
+void scene_graph_update(SceneGraph* graph, WorkQueue* queue, u32 num_instances, MeshInstance* instances, u32* instance_nodes, u32 num_batches, MeshInstanceBatch* batches, u32* batch_nodes);
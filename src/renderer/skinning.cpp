@@ -0,0 +1,195 @@
+#include <intrin.h>
+#include <immintrin.h>
+#include <float.h>
+#include <math.h>
+
+#include "skinning.h"
+#include "scene_graph.h"
+#include "utility/work_queue.h"
+
+// The build targets baseline x64, so AVX2 code is only reached after checking the processor and the OS.
+internal bool cpu_supports_avx2() {
+    int info[4];
+
+    __cpuid(info, 0);
+    if (info[0] < 7) {
+        return false;
+    }
+
+    __cpuid(info, 1);
+    bool fma = (info[2] >> 12) & 1;
+    bool osxsave = (info[2] >> 27) & 1;
+    bool avx = (info[2] >> 28) & 1;
+
+    // The OS has to preserve the upper halves of the YMM registers.
+    if (!fma || !osxsave || !avx || (_xgetbv(0) & 6) != 6) {
+        return false;
+    }
+
+    __cpuidex(info, 7, 0);
+    return (info[1] >> 5) & 1;
+}
+
+global_var bool avx2_supported = cpu_supports_avx2();
+
+bool skinning_has_avx2() {
+    return avx2_supported;
+}
+
+void build_joint_palette(XMMATRIX* palette, Skin* skin, SceneGraph* graph) {
+    XMMATRIX root_inverse = XMMatrixInverse(0, graph->world_transforms[SCENE_GRAPH_ROOT]);
+
+    for (u32 i = 0; i < skin->num_joints; ++i) {
+        palette[i] = skin->inverse_bind_matrices[i] * graph->world_transforms[skin->joint_nodes[i]] * root_inverse;
+    }
+}
+
+void skin_vertices_sse(Vertex* dst, AABB* aabb, SkinnedVertices* vertices, XMMATRIX* palette) {
+    XMVECTOR aabb_min =  XMVectorSplatInfinity();
+    XMVECTOR aabb_max = -XMVectorSplatInfinity();
+
+    for (u32 i = 0; i < vertices->vertex_count; ++i) {
+        Vertex* src = &vertices->bind_vertices[i];
+        SkinInfluence* influence = &vertices->influences[i];
+
+        XMMATRIX blended;
+        XMMATRIX* joint = &palette[influence->joints[0]];
+        XMVECTOR weight = XMVectorReplicate(influence->weights[0]);
+
+        for (int row = 0; row < 4; ++row) {
+            blended.r[row] = XMVectorMultiply(joint->r[row], weight);
+        }
+
+        for (int j = 1; j < 4; ++j) {
+            joint = &palette[influence->joints[j]];
+            weight = XMVectorReplicate(influence->weights[j]);
+
+            for (int row = 0; row < 4; ++row) {
+                blended.r[row] = XMVectorMultiplyAdd(joint->r[row], weight, blended.r[row]);
+            }
+        }
+
+        XMVECTOR pos = XMVector3Transform(XMLoadFloat3(&src->pos), blended);
+        XMVECTOR norm = XMVector3Normalize(XMVector3TransformNormal(XMLoadFloat3(&src->norm), blended));
+
+        Vertex* v = &dst[i];
+        XMStoreFloat3(&v->pos, pos);
+        XMStoreFloat3(&v->norm, norm);
+        v->uv = src->uv;
+
+        aabb_min = XMVectorMin(aabb_min, pos);
+        aabb_max = XMVectorMax(aabb_max, pos);
+    }
+
+    XMStoreFloat3(&aabb->min, aabb_min);
+    XMStoreFloat3(&aabb->max, aabb_max);
+}
+
+// A Vertex is exactly one YMM register, and so are rows 0-1 and rows 2-3 of a joint matrix. The position and
+// normal go through the blended matrix together: position in the low half, normal in the high half, where the
+// translation row is zeroed.
+void skin_vertices_avx2(Vertex* dst, AABB* aabb, SkinnedVertices* vertices, XMMATRIX* palette) {
+    __m256i x_index = _mm256_setr_epi32(0, 0, 0, 0, 3, 3, 3, 3);
+    __m256i y_index = _mm256_setr_epi32(1, 1, 1, 1, 4, 4, 4, 4);
+    __m256i z_index = _mm256_setr_epi32(2, 2, 2, 2, 5, 5, 5, 5);
+    __m256i pack_index = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 6, 7);
+
+    __m128 aabb_min = _mm_set1_ps(INFINITY);
+    __m128 aabb_max = _mm_set1_ps(-INFINITY);
+    __m128 min_length_sq = _mm_set1_ps(FLT_MIN);
+
+    for (u32 i = 0; i < vertices->vertex_count; ++i) {
+        SkinInfluence* influence = &vertices->influences[i];
+
+        f32* joint = (f32*)&palette[influence->joints[0]];
+        __m256 weight = _mm256_set1_ps(influence->weights[0]);
+        __m256 rows01 = _mm256_mul_ps(_mm256_loadu_ps(joint), weight);
+        __m256 rows23 = _mm256_mul_ps(_mm256_loadu_ps(joint + 8), weight);
+
+        for (int j = 1; j < 4; ++j) {
+            joint = (f32*)&palette[influence->joints[j]];
+            weight = _mm256_set1_ps(influence->weights[j]);
+            rows01 = _mm256_fmadd_ps(_mm256_loadu_ps(joint), weight, rows01);
+            rows23 = _mm256_fmadd_ps(_mm256_loadu_ps(joint + 8), weight, rows23);
+        }
+
+        __m256 row0 = _mm256_permute2f128_ps(rows01, rows01, 0x00);
+        __m256 row1 = _mm256_permute2f128_ps(rows01, rows01, 0x11);
+        __m256 row2 = _mm256_permute2f128_ps(rows23, rows23, 0x00);
+        __m256 row3 = _mm256_permute2f128_ps(rows23, rows23, 0x81);
+
+        __m256 v = _mm256_loadu_ps((f32*)&vertices->bind_vertices[i]);
+
+        __m256 pos_norm = _mm256_fmadd_ps(_mm256_permutevar8x32_ps(v, x_index), row0, row3);
+        pos_norm = _mm256_fmadd_ps(_mm256_permutevar8x32_ps(v, y_index), row1, pos_norm);
+        pos_norm = _mm256_fmadd_ps(_mm256_permutevar8x32_ps(v, z_index), row2, pos_norm);
+
+        __m128 pos = _mm256_castps256_ps128(pos_norm);
+        __m128 norm = _mm256_extractf128_ps(pos_norm, 1);
+
+        __m128 length_sq = _mm_dp_ps(norm, norm, 0x7F);
+        norm = _mm_div_ps(norm, _mm_sqrt_ps(_mm_max_ps(length_sq, min_length_sq)));
+
+        __m256 packed = _mm256_permutevar8x32_ps(_mm256_insertf128_ps(_mm256_castps128_ps256(pos), norm, 1), pack_index);
+        _mm256_storeu_ps((f32*)&dst[i], _mm256_blend_ps(packed, v, 0xC0));
+
+        aabb_min = _mm_min_ps(aabb_min, pos);
+        aabb_max = _mm_max_ps(aabb_max, pos);
+    }
+
+    _mm256_zeroupper();
+
+    XMStoreFloat3(&aabb->min, aabb_min);
+    XMStoreFloat3(&aabb->max, aabb_max);
+}
+
+void skin_vertices(Vertex* dst, AABB* aabb, SkinnedVertices* vertices, XMMATRIX* palette) {
+    if (avx2_supported) {
+        skin_vertices_avx2(dst, aabb, vertices, palette);
+    }
+    else {
+        skin_vertices_sse(dst, aabb, vertices, palette);
+    }
+}
+
+struct SkinningJob {
+    SceneGraph* graph;
+    SkinnedMesh* meshes;
+    MeshVertexUpdate* updates;
+};
+
+internal void run_skinning_job(void* data, u32 begin, u32 end) {
+    SkinningJob* job = (SkinningJob*)data;
+
+    for (u32 i = begin; i < end; ++i) {
+        SkinnedMesh* mesh = &job->meshes[i];
+        MeshVertexUpdate* update = &job->updates[i];
+
+        // Meshes sharing a skin each build its palette; that's small next to skinning the vertices.
+        Scratch scratch = get_scratch(0, 0);
+
+        XMMATRIX* palette = arena_push_array(scratch.arena, XMMATRIX, mesh->skin->num_joints);
+        build_joint_palette(palette, mesh->skin, job->graph);
+        skin_vertices(update->vertices, &update->aabb, mesh->vertices, palette);
+
+        release_scratch(scratch);
+    }
+}
+
+MeshVertexUpdate* skin_meshes(Arena* arena, WorkQueue* queue, SceneGraph* graph, u32 num_meshes, SkinnedMesh* meshes) {
+    MeshVertexUpdate* updates = arena_push_array(arena, MeshVertexUpdate, num_meshes);
+
+    for (u32 i = 0; i < num_meshes; ++i) {
+        updates[i].mesh = meshes[i].mesh;
+        updates[i].vertices = arena_push_array(arena, Vertex, meshes[i].vertices->vertex_count);
+    }
+
+    SkinningJob job;
+    job.graph = graph;
+    job.meshes = meshes;
+    job.updates = updates;
+
+    work_queue_parallel_for(queue, run_skinning_job, &job, num_meshes, 1);
+
+    return updates;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "renderer.h"
+
+struct SceneGraph;
+struct WorkQueue;
+
+// Up to four joints per vertex, indexing the skin's joint list. Weights sum to one.
+struct SkinInfluence {
+    u16 joints[4];
+    f32 weights[4];
+};
+
+// Joints are scene graph nodes. An inverse bind matrix takes a mesh from bind space to its joint's space.
+struct Skin {
+    u32 num_joints;
+    u32* joint_nodes;
+    XMMATRIX* inverse_bind_matrices;
+};
+
+// A skinned mesh as loaded: the bind pose in the layout the renderer draws, and the influences of every vertex.
+struct SkinnedVertices {
+    u32 vertex_count;
+    u32 joint_count; // One past the largest joint index used
+    Vertex* bind_vertices;
+    SkinInfluence* influences;
+};
+
+// A renderer mesh posed on the CPU every frame, holding one vertex per bind vertex.
+struct SkinnedMesh {
+    Mesh mesh;
+    Skin* skin;
+    SkinnedVertices* vertices;
+};
+
+// palette[j] = inverse_bind[j] * world[joint j] * inverse(world[root]), so skinned vertices land relative to the
+// graph root and are drawn with its transform.
+void build_joint_palette(XMMATRIX* palette, Skin* skin, SceneGraph* graph);
+
+// Blends the palette by each vertex's influences and writes posed vertices and their bounds. Normals are
+// renormalized; UVs are copied. Uses AVX2 and FMA when the processor has them.
+void skin_vertices(Vertex* dst, AABB* aabb, SkinnedVertices* vertices, XMMATRIX* palette);
+
+// The two paths skin_vertices picks between, so they can be checked against each other. Only call
+// skin_vertices_avx2 when skinning_has_avx2 returns true.
+bool skinning_has_avx2();
+void skin_vertices_sse(Vertex* dst, AABB* aabb, SkinnedVertices* vertices, XMMATRIX* palette);
+void skin_vertices_avx2(Vertex* dst, AABB* aabb, SkinnedVertices* vertices, XMMATRIX* palette);
+
+// Poses every mesh from the graph's current world transforms, with the meshes split across the work queue (which
+// may be null). The updates and their vertices are pushed to arena, ready to pass to the renderer this frame.
+MeshVertexUpdate* skin_meshes(Arena* arena, WorkQueue* queue, SceneGraph* graph, u32 num_meshes, SkinnedMesh* meshes);
@@ -0,0 +1,214 @@
+#include <string.h>
+
+#include "texture_cache.h"
+#include "utility/hash.h"
+#include "utility/resource_pool.h"
+
+// Any constant but 0, so the two halves of a content key are hashed from different starting states.
+#define TEXTURE_CONTENT_SEED 0x5DEECE66Dull
+
+// One of the URIs an entry was loaded from, chained off the entry.
+struct TextureCacheUri {
+    u64 uri_hash;
+    u64 entry;
+    u64 next;
+    char uri[TEXTURE_CACHE_URI_SIZE];
+};
+
+struct TextureCacheEntry {
+    u64 first_uri; // 0 if the entry has no URIs
+    TextureContentKey content;
+    Material material;
+    u32 ref_count;
+};
+
+struct TextureCache {
+    ResourcePool* entries;
+    ResourcePool* uris;
+    HashMap* by_uri; // To the URI's handle
+    HashMap* by_content; // By the first half of the content hash
+    HashMap* by_material;
+};
+
+TextureContentKey texture_content_key(void* content, u64 size) {
+    TextureContentKey key;
+    key.size = size;
+    key.hash[0] = hash_bytes(content, size, 0);
+    key.hash[1] = hash_bytes(content, size, TEXTURE_CONTENT_SEED);
+    return key;
+}
+
+TextureCache* texture_cache_new(Arena* arena, u32 capacity) {
+    TextureCache* cache = arena_push_struct_zero(arena, TextureCache);
+
+    cache->entries = resource_pool_new(arena, capacity, sizeof(TextureCacheEntry));
+    cache->uris = resource_pool_new(arena, capacity, sizeof(TextureCacheUri));
+    cache->by_uri = hash_map_new(arena, capacity);
+    cache->by_content = hash_map_new(arena, capacity);
+    cache->by_material = hash_map_new(arena, capacity);
+
+    return cache;
+}
+
+// Returns the URI's record, or null if it isn't recorded. A URI whose hash another one took first isn't.
+internal TextureCacheUri* find_uri(TextureCache* cache, char* uri, u64 uri_hash) {
+    u64 uri_handle;
+    if (!hash_map_get(cache->by_uri, uri_hash, &uri_handle)) {
+        return 0;
+    }
+
+    TextureCacheUri* entry_uri = resource_pool_access(cache->uris, uri_handle, TextureCacheUri);
+    return strcmp(entry_uri->uri, uri) == 0 ? entry_uri : 0;
+}
+
+internal void add_uri(TextureCache* cache, u64 entry_handle, char* uri) {
+    u64 uri_size = strlen(uri) + 1;
+    u64 uri_hash = hash_string(uri);
+
+    u64 existing;
+    if (uri_size > TEXTURE_CACHE_URI_SIZE || hash_map_get(cache->by_uri, uri_hash, &existing)) {
+        return;
+    }
+
+    TextureCacheEntry* entry = resource_pool_access(cache->entries, entry_handle, TextureCacheEntry);
+
+    u64 uri_handle = resource_pool_alloc(cache->uris);
+    TextureCacheUri* entry_uri = resource_pool_access(cache->uris, uri_handle, TextureCacheUri);
+    entry_uri->uri_hash = uri_hash;
+    entry_uri->entry = entry_handle;
+    entry_uri->next = entry->first_uri;
+    memcpy(entry_uri->uri, uri, uri_size);
+    entry->first_uri = uri_handle;
+
+    hash_map_put(cache->by_uri, uri_hash, uri_handle);
+}
+
+bool texture_cache_acquire_uri(TextureCache* cache, char* uri, Material* material) {
+    TextureCacheUri* entry_uri = find_uri(cache, uri, hash_string(uri));
+    if (!entry_uri) {
+        return false;
+    }
+
+    TextureCacheEntry* entry = resource_pool_access(cache->entries, entry_uri->entry, TextureCacheEntry);
+    ++entry->ref_count;
+    *material = entry->material;
+
+    return true;
+}
+
+bool texture_cache_acquire_content(TextureCache* cache, char* uri, TextureContentKey* key, Material* material) {
+    u64 entry_handle;
+    if (!hash_map_get(cache->by_content, key->hash[0], &entry_handle)) {
+        return false;
+    }
+
+    TextureCacheEntry* entry = resource_pool_access(cache->entries, entry_handle, TextureCacheEntry);
+    if (entry->content.size != key->size || entry->content.hash[1] != key->hash[1]) {
+        return false;
+    }
+
+    ++entry->ref_count;
+    *material = entry->material;
+
+    if (uri) {
+        add_uri(cache, entry_handle, uri);
+    }
+
+    return true;
+}
+
+void texture_cache_insert(TextureCache* cache, char* uri, TextureContentKey* key, Material material) {
+    u64 entry_handle = resource_pool_alloc(cache->entries);
+
+    TextureCacheEntry* entry = resource_pool_access(cache->entries, entry_handle, TextureCacheEntry);
+    entry->first_uri = 0;
+    entry->content = *key;
+    entry->material = material;
+    entry->ref_count = 1;
+
+    if (uri) {
+        add_uri(cache, entry_handle, uri);
+    }
+
+    // On a hash collision the entry already there keeps the key; this one is only found by URI.
+    u64 existing;
+    if (!hash_map_get(cache->by_content, key->hash[0], &existing)) {
+        hash_map_put(cache->by_content, key->hash[0], entry_handle);
+    }
+
+    hash_map_put(cache->by_material, material.handle, entry_handle);
+}
+
+internal TextureCacheEntry* get_material_entry(TextureCache* cache, Material material, u64* entry_handle) {
+    bool found = hash_map_get(cache->by_material, material.handle, entry_handle);
+    assert(found && "Material is not owned by this texture cache");
+    UNUSED(found);
+    return resource_pool_access(cache->entries, *entry_handle, TextureCacheEntry);
+}
+
+void texture_cache_add_ref(TextureCache* cache, Material material) {
+    u64 entry_handle;
+    ++get_material_entry(cache, material, &entry_handle)->ref_count;
+}
+
+// Returns true if that was the last reference, in which case the entry is gone and the material is the caller's
+// to free.
+internal bool drop_ref(TextureCache* cache, Material material) {
+    u64 entry_handle;
+    TextureCacheEntry* entry = get_material_entry(cache, material, &entry_handle);
+
+    assert(entry->ref_count > 0);
+    if (--entry->ref_count > 0) {
+        return false;
+    }
+
+    for (u64 uri_handle = entry->first_uri; uri_handle;) {
+        TextureCacheUri* entry_uri = resource_pool_access(cache->uris, uri_handle, TextureCacheUri);
+        u64 next = entry_uri->next;
+
+        hash_map_remove(cache->by_uri, entry_uri->uri_hash);
+        resource_pool_free(cache->uris, uri_handle);
+
+        uri_handle = next;
+    }
+
+    u64 content_entry;
+    if (hash_map_get(cache->by_content, entry->content.hash[0], &content_entry) && content_entry == entry_handle) {
+        hash_map_remove(cache->by_content, entry->content.hash[0]);
+    }
+
+    hash_map_remove(cache->by_material, material.handle);
+
+    resource_pool_free(cache->entries, entry_handle);
+
+    return true;
+}
+
+void texture_cache_release(TextureCache* cache, Renderer* renderer, Material material) {
+    if (drop_ref(cache, material)) {
+        renderer_free_material(renderer, material);
+    }
+}
+
+u32 texture_cache_release_batch(TextureCache* cache, Renderer* renderer, u32 count, Material* materials) {
+    Scratch scratch = get_scratch(0, 0);
+
+    Material* unreferenced = arena_push_array(scratch.arena, Material, count);
+    u32 num_unreferenced = 0;
+
+    for (u32 i = 0; i < count; ++i) {
+        if (drop_ref(cache, materials[i])) {
+            unreferenced[num_unreferenced++] = materials[i];
+        }
+    }
+
+    renderer_free_materials(renderer, num_unreferenced, unreferenced);
+
+    release_scratch(scratch);
+
+    return num_unreferenced;
+}
+
+u32 texture_cache_num_entries(TextureCache* cache) {
+    return resource_pool_num_allocations(cache->entries);
+}
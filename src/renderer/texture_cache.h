@@ -0,0 +1,38 @@
+#pragma once
+
+#include "renderer.h"
+
+// Shares materials between glTF materials and between loads. Entries are keyed by the absolute
+// source URIs they were loaded from and by the content key of the encoded image bytes, and are freed when their
+// last reference is released. URIs are kept and compared on a hit; URIs of TEXTURE_CACHE_URI_SIZE bytes or more
+// aren't recorded, so those images are only found by content.
+
+#define TEXTURE_CACHE_URI_SIZE 256
+
+// The encoded bytes' size and a 128-bit hash of them. Two different images are far less likely to share one than
+// to be corrupted on disk, so no copy of the bytes is kept to compare against.
+struct TextureContentKey {
+    u64 size;
+    u64 hash[2];
+};
+
+TextureContentKey texture_content_key(void* content, u64 size);
+
+struct TextureCache;
+
+TextureCache* texture_cache_new(Arena* arena, u32 capacity);
+
+bool texture_cache_acquire_uri(TextureCache* cache, char* uri, Material* material);
+
+// On a hit, uri (if not null) is recorded against the entry, so later loads of it hit by URI.
+bool texture_cache_acquire_content(TextureCache* cache, char* uri, TextureContentKey* key, Material* material);
+void texture_cache_insert(TextureCache* cache, char* uri, TextureContentKey* key, Material material);
+
+void texture_cache_add_ref(TextureCache* cache, Material material);
+void texture_cache_release(TextureCache* cache, Renderer* renderer, Material material);
+
+// Releases one reference per entry of materials, which may repeat, and frees every material left unreferenced in
+// one renderer call. Returns how many were freed.
+u32 texture_cache_release_batch(TextureCache* cache, Renderer* renderer, u32 count, Material* materials);
+
+u32 texture_cache_num_entries(TextureCache* cache);
@@ -0,0 +1,405 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "texture_streaming.h"
+#include "block_compression.h"
+#include "lod.h"
+#include "utility/resource_pool.h"
+
+// Each update submits its uploads as one batch, like the residency manager's.
+#define MAX_STREAMING_BATCHES 8
+#define STREAMING_BATCH_ARENA_SIZE (16 * 1024)
+
+struct StreamedTextureEntry {
+    MaterialCreateInfo info; // The whole chain, in a page allocation
+    u32 mip_count;
+    u32 tail_mip; // The coarsest first level
+    u32 first_mip; // Of material, or mip_count while nothing is resident
+    Material material;
+    u32 pending_first_mip;
+    Material pending_material; // Null unless a change is uploading
+    u64 pending_batch;
+    f32 required_mip; // The finest level the latest frame's uses need
+    u64 last_used_frame;
+    u32 index; // In the streamer's textures
+};
+
+struct StreamingBatch {
+    Arena arena;
+    RendererUploadTicket* ticket;
+};
+
+struct TextureStreamer {
+    Renderer* renderer;
+    u64 upload_budget;
+    u64 frame;
+
+    XMFLOAT3 camera_position;
+    f32 projection_scale;
+
+    ResourcePool* entries;
+    u32 num_textures;
+    u64* textures;
+
+    u32 num_pending;
+    u64* pending; // Textures with a change uploading
+
+    // Materials replaced or removed, freed together by the next update.
+    u32 num_dropped_materials;
+    Material* dropped_materials;
+
+    u32 first_batch;
+    u32 num_batches;
+    StreamingBatch batches[MAX_STREAMING_BATCHES];
+    u64 num_submitted_batches;
+    u64 num_completed_batches;
+
+    TextureStreamingStats stats;
+};
+
+TextureStreamer* texture_streamer_new(Arena* arena, Renderer* renderer, u32 capacity, u64 upload_budget) {
+    TextureStreamer* streamer = arena_push_struct_zero(arena, TextureStreamer);
+
+    streamer->renderer = renderer;
+    streamer->upload_budget = upload_budget;
+
+    streamer->entries = resource_pool_new(arena, capacity, sizeof(StreamedTextureEntry));
+    streamer->textures = arena_push_array(arena, u64, capacity);
+    streamer->pending = arena_push_array(arena, u64, capacity);
+
+    // A texture can have both its material and a pending one dropped between updates.
+    streamer->dropped_materials = arena_push_array(arena, Material, 2 * capacity);
+
+    for (u32 i = 0; i < MAX_STREAMING_BATCHES; ++i) {
+        streamer->batches[i].arena = arena_init(arena_push(arena, STREAMING_BATCH_ARENA_SIZE), STREAMING_BATCH_ARENA_SIZE);
+    }
+
+    return streamer;
+}
+
+internal StreamedTextureEntry* get_entry(TextureStreamer* streamer, u64 handle) {
+    assert(resource_pool_handle_valid(streamer->entries, handle) && "Texture is not owned by this streamer");
+    return resource_pool_access(streamer->entries, handle, StreamedTextureEntry);
+}
+
+internal u64 chain_size(StreamedTextureEntry* entry, u32 first_mip, u32 num_levels) {
+    u64 offset = texture_chain_size(entry->info.format, entry->info.texture_w, entry->info.texture_h, first_mip);
+    return texture_chain_size(entry->info.format, entry->info.texture_w, entry->info.texture_h, first_mip + num_levels) - offset;
+}
+
+internal u64 resident_size(StreamedTextureEntry* entry) {
+    return chain_size(entry, entry->first_mip, entry->mip_count - entry->first_mip);
+}
+
+// The first level no larger than the tail size, or the last one a material can start at: block formats need
+// whole blocks.
+internal u32 find_tail_mip(MaterialCreateInfo* info, u32 mip_count) {
+    u32 width = info->texture_w;
+    u32 height = info->texture_h;
+
+    for (u32 i = 0; i < mip_count - 1; ++i) {
+        if (width <= MIP_STREAMING_TAIL_SIZE && height <= MIP_STREAMING_TAIL_SIZE) {
+            return i;
+        }
+
+        width = width > 1 ? width / 2 : 1;
+        height = height > 1 ? height / 2 : 1;
+
+        if (info->format != TEXTURE_FORMAT_RGBA8 && (width % 4 != 0 || height % 4 != 0)) {
+            return i;
+        }
+    }
+
+    return mip_count - 1;
+}
+
+StreamedTexture texture_streamer_add(TextureStreamer* streamer, MaterialCreateInfo* info) {
+    u32 mip_count = info->mip_count > 0 ? info->mip_count : 1;
+    u64 size = texture_chain_size(info->format, info->texture_w, info->texture_h, mip_count);
+
+    StreamedTexture texture;
+    texture.handle = resource_pool_alloc(streamer->entries);
+
+    StreamedTextureEntry* entry = get_entry(streamer, texture.handle);
+    *entry = {};
+    entry->info = *info;
+    entry->info.texture_data = page_alloc(size);
+    memcpy(entry->info.texture_data, info->texture_data, size);
+
+    entry->mip_count = mip_count;
+    entry->tail_mip = find_tail_mip(info, mip_count);
+    entry->first_mip = mip_count;
+    entry->material = renderer_get_default_material(streamer->renderer);
+    entry->required_mip = (f32)entry->tail_mip;
+    entry->last_used_frame = streamer->frame;
+
+    entry->index = streamer->num_textures;
+    streamer->textures[streamer->num_textures++] = texture.handle;
+
+    streamer->stats.bytes_fully_resident += size;
+
+    return texture;
+}
+
+internal void drop_material(TextureStreamer* streamer, Material material) {
+    streamer->dropped_materials[streamer->num_dropped_materials++] = material;
+}
+
+void texture_streamer_remove(TextureStreamer* streamer, StreamedTexture texture) {
+    StreamedTextureEntry* entry = get_entry(streamer, texture.handle);
+
+    if (entry->pending_material.handle) {
+        drop_material(streamer, entry->pending_material);
+
+        for (u32 i = 0; i < streamer->num_pending; ++i) {
+            if (streamer->pending[i] == texture.handle) {
+                streamer->pending[i] = streamer->pending[--streamer->num_pending];
+                break;
+            }
+        }
+    }
+
+    if (entry->first_mip < entry->mip_count) {
+        drop_material(streamer, entry->material);
+        streamer->stats.bytes_resident -= resident_size(entry);
+    }
+
+    streamer->stats.bytes_fully_resident -= chain_size(entry, 0, entry->mip_count);
+    page_free(entry->info.texture_data);
+
+    u64 moved = streamer->textures[--streamer->num_textures];
+    streamer->textures[entry->index] = moved;
+    get_entry(streamer, moved)->index = entry->index;
+
+    resource_pool_free(streamer->entries, texture.handle);
+}
+
+Material texture_streamer_material(TextureStreamer* streamer, StreamedTexture texture) {
+    return get_entry(streamer, texture.handle)->material;
+}
+
+u32 texture_streamer_first_mip(TextureStreamer* streamer, StreamedTexture texture) {
+    return get_entry(streamer, texture.handle)->first_mip;
+}
+
+void texture_streamer_begin_frame(TextureStreamer* streamer, XMVECTOR camera_position, f32 projection_scale) {
+    XMStoreFloat3(&streamer->camera_position, camera_position);
+    streamer->projection_scale = projection_scale;
+}
+
+f32 texture_streaming_required_mip(u32 texture_size, f32 pixels) {
+    return log2f((f32)texture_size / fmaxf(pixels, 1e-3f));
+}
+
+void texture_streamer_use(TextureStreamer* streamer, StreamedTexture texture, AABB* aabb, XMMATRIX transform) {
+    StreamedTextureEntry* entry = get_entry(streamer, texture.handle);
+
+    f32 pixels_per_unit = lod_pixels_per_unit(aabb, transform, XMLoadFloat3(&streamer->camera_position), streamer->projection_scale);
+    f32 diameter = XMVectorGetX(XMVector3Length(XMLoadFloat3(&aabb->max) - XMLoadFloat3(&aabb->min)));
+
+    u32 texture_size = entry->info.texture_w > entry->info.texture_h ? entry->info.texture_w : entry->info.texture_h;
+    f32 required_mip = texture_streaming_required_mip(texture_size, pixels_per_unit * diameter);
+
+    if (entry->last_used_frame != streamer->frame || required_mip < entry->required_mip) {
+        entry->required_mip = required_mip;
+    }
+
+    entry->last_used_frame = streamer->frame;
+}
+
+internal u32 target_mip(TextureStreamer* streamer, StreamedTextureEntry* entry) {
+    if (streamer->frame - entry->last_used_frame > MIP_STREAMING_UNUSED_FRAMES) {
+        return entry->tail_mip;
+    }
+
+    f32 level = floorf(entry->required_mip);
+    if (level > (f32)entry->first_mip) {
+        level = fmaxf(floorf(entry->required_mip - MIP_STREAMING_HYSTERESIS), (f32)entry->first_mip);
+    }
+
+    if (level < 0.0f) {
+        return 0;
+    }
+
+    return level < (f32)entry->tail_mip ? (u32)level : entry->tail_mip;
+}
+
+struct StreamingChange {
+    u64 handle;
+    u32 target_mip;
+    u32 priority; // Tails first, then by how many levels change, loads before unloads
+    u32 order;
+    u64 size;
+};
+
+internal int compare_streaming_changes(const void* a, const void* b) {
+    StreamingChange* ca = (StreamingChange*)a;
+    StreamingChange* cb = (StreamingChange*)b;
+
+    if (ca->priority != cb->priority) return ca->priority > cb->priority ? -1 : 1;
+    if (ca->order != cb->order) return ca->order < cb->order ? -1 : 1;
+    return 0;
+}
+
+internal void retire_batches(TextureStreamer* streamer) {
+    while (streamer->num_batches > 0) {
+        StreamingBatch* batch = &streamer->batches[streamer->first_batch];
+        if (!renderer_upload_finished(streamer->renderer, batch->ticket)) {
+            break;
+        }
+
+        streamer->first_batch = (streamer->first_batch + 1) % MAX_STREAMING_BATCHES;
+        --streamer->num_batches;
+        ++streamer->num_completed_batches;
+    }
+
+    for (u32 i = 0; i < streamer->num_pending;) {
+        StreamedTextureEntry* entry = get_entry(streamer, streamer->pending[i]);
+
+        if (entry->pending_batch > streamer->num_completed_batches) {
+            ++i;
+            continue;
+        }
+
+        if (entry->first_mip < entry->mip_count) {
+            drop_material(streamer, entry->material);
+            streamer->stats.bytes_resident -= resident_size(entry);
+        }
+
+        entry->material = entry->pending_material;
+        entry->first_mip = entry->pending_first_mip;
+        entry->pending_material = {};
+        streamer->stats.bytes_resident += resident_size(entry);
+
+        streamer->pending[i] = streamer->pending[--streamer->num_pending];
+    }
+}
+
+internal void free_dropped_materials(TextureStreamer* streamer) {
+    renderer_free_materials(streamer->renderer, streamer->num_dropped_materials, streamer->dropped_materials);
+    streamer->num_dropped_materials = 0;
+}
+
+internal Material create_level_material(TextureStreamer* streamer, StreamedTextureEntry* entry, u32 first_mip, RendererUploadContext* upload_context) {
+    MaterialCreateInfo info = entry->info;
+    info.texture_w = entry->info.texture_w >> first_mip;
+    info.texture_h = entry->info.texture_h >> first_mip;
+    info.texture_w = info.texture_w > 0 ? info.texture_w : 1;
+    info.texture_h = info.texture_h > 0 ? info.texture_h : 1;
+    info.mip_count = entry->mip_count - first_mip;
+    info.texture_data = (u8*)entry->info.texture_data + chain_size(entry, 0, first_mip);
+
+    return renderer_new_material(streamer->renderer, upload_context, &info);
+}
+
+void texture_streamer_update(TextureStreamer* streamer) {
+    retire_batches(streamer);
+
+    Scratch scratch = get_scratch(0, 0);
+
+    StreamingChange* changes = arena_push_array(scratch.arena, StreamingChange, streamer->num_textures);
+    u32 num_changes = 0;
+
+    for (u32 i = 0; i < streamer->num_textures; ++i) {
+        StreamedTextureEntry* entry = get_entry(streamer, streamer->textures[i]);
+        if (entry->pending_material.handle) {
+            continue;
+        }
+
+        u32 target = target_mip(streamer, entry);
+        if (target == entry->first_mip) {
+            continue;
+        }
+
+        StreamingChange* change = &changes[num_changes++];
+        change->handle = streamer->textures[i];
+        change->target_mip = target;
+        change->order = i;
+        change->size = chain_size(entry, target, entry->mip_count - target);
+
+        if (entry->first_mip == entry->mip_count) {
+            change->priority = 2 * MAX_MIP_LEVELS + 1;
+        }
+        else if (target < entry->first_mip) {
+            change->priority = MAX_MIP_LEVELS + entry->first_mip - target;
+        }
+        else {
+            change->priority = target - entry->first_mip;
+        }
+    }
+
+    qsort(changes, num_changes, sizeof(StreamingChange), compare_streaming_changes);
+
+    StreamingBatch* batch = 0;
+    if (streamer->num_batches < MAX_STREAMING_BATCHES) {
+        batch = &streamer->batches[(streamer->first_batch + streamer->num_batches) % MAX_STREAMING_BATCHES];
+    }
+
+    RendererUploadContext* upload_context = 0;
+    u64 bytes_uploaded = 0;
+    streamer->stats.num_deferred = 0;
+
+    // Tails are always created. Any other change is taken if it fits in what's left of the budget, or if nothing
+    // has been uploaded yet, so a chain bigger than the budget still streams in.
+    for (u32 i = 0; i < num_changes; ++i) {
+        StreamingChange* change = &changes[i];
+        StreamedTextureEntry* entry = get_entry(streamer, change->handle);
+
+        bool tail = entry->first_mip == entry->mip_count;
+        bool fits = bytes_uploaded == 0 || bytes_uploaded + change->size <= streamer->upload_budget;
+
+        if (!batch || !(tail || fits)) {
+            ++streamer->stats.num_deferred;
+            continue;
+        }
+
+        if (!upload_context) {
+            arena_clear(&batch->arena);
+            upload_context = renderer_open_upload_context(&batch->arena, streamer->renderer);
+        }
+
+        entry->pending_material = create_level_material(streamer, entry, change->target_mip, upload_context);
+        entry->pending_first_mip = change->target_mip;
+        entry->pending_batch = streamer->num_submitted_batches + 1;
+        streamer->pending[streamer->num_pending++] = change->handle;
+
+        if (change->target_mip < entry->first_mip) {
+            ++streamer->stats.num_loads;
+        }
+        else {
+            ++streamer->stats.num_unloads;
+        }
+
+        bytes_uploaded += change->size;
+    }
+
+    release_scratch(scratch);
+
+    if (upload_context) {
+        batch->ticket = renderer_submit_upload_context(&batch->arena, streamer->renderer, upload_context);
+        ++streamer->num_batches;
+        ++streamer->num_submitted_batches;
+    }
+
+    streamer->stats.bytes_uploaded += bytes_uploaded;
+
+    // Uploads that finish straight away are drawn with next frame.
+    retire_batches(streamer);
+    free_dropped_materials(streamer);
+
+    ++streamer->frame;
+}
+
+TextureStreamingStats texture_streamer_stats(TextureStreamer* streamer) {
+    return streamer->stats;
+}
+
+void texture_streamer_destroy(TextureStreamer* streamer) {
+    while (streamer->num_textures > 0) {
+        StreamedTexture texture = { streamer->textures[streamer->num_textures - 1] };
+        texture_streamer_remove(streamer, texture);
+    }
+
+    free_dropped_materials(streamer);
+}
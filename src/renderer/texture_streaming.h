@@ -0,0 +1,65 @@
+#pragma once
+
+#include "renderer.h"
+
+// Streams the finer mips of material textures by how large the instances using them appear on screen. Each
+// texture's whole chain is kept in CPU memory; on the GPU it's a material holding the chain from its first
+// resident level down. The levels no larger than MIP_STREAMING_TAIL_SIZE are always resident.
+//
+// Every frame, each use reports an instance's bounds. A texture is assumed to span its instance's bounding
+// sphere once, so it needs about as many texels across as the sphere covers pixels. The update then moves textures
+// toward the levels their uses need, biggest changes first and loads before unloads, uploading at most the frame's
+// budget. Decisions depend only on the calls made, so they're the same on every backend.
+
+#define MIP_STREAMING_TAIL_SIZE 64
+
+// A texture wanting a coarser level moves to it once its need is this many levels past it, so textures sitting
+// near a transition distance don't stream back and forth every frame.
+#define MIP_STREAMING_HYSTERESIS 0.25f
+
+// Frames a texture can go unused before it drops back to its tail.
+#define MIP_STREAMING_UNUSED_FRAMES 60
+
+struct TextureStreamer;
+
+struct StreamedTexture {
+    u64 handle;
+};
+
+struct TextureStreamingStats {
+    u64 bytes_uploaded;
+    u64 bytes_resident; // Of the materials drawn with
+    u64 bytes_fully_resident; // What every texture's whole chain would take, for comparison
+    u64 num_loads; // Changes to finer levels
+    u64 num_unloads; // Changes to coarser levels
+    u32 num_deferred; // Changes the last update left for later to stay within the budget
+};
+
+TextureStreamer* texture_streamer_new(Arena* arena, Renderer* renderer, u32 capacity, u64 upload_budget);
+
+// Frees every texture. Handles are invalid afterwards.
+void texture_streamer_destroy(TextureStreamer* streamer);
+
+// Copies info's chain, which must hold at least one level. Only the tail is created, by the next update; the
+// default material stands in until then.
+StreamedTexture texture_streamer_add(TextureStreamer* streamer, MaterialCreateInfo* info);
+void texture_streamer_remove(TextureStreamer* streamer, StreamedTexture texture);
+
+// The material to draw with this frame. It changes when an update's uploads complete.
+Material texture_streamer_material(TextureStreamer* streamer, StreamedTexture texture);
+
+// The first level of the material drawn with.
+u32 texture_streamer_first_mip(TextureStreamer* streamer, StreamedTexture texture);
+
+// projection_scale is viewport_height / (2 * tan(vertical_fov / 2)), as for lod_pixels_per_unit.
+void texture_streamer_begin_frame(TextureStreamer* streamer, XMVECTOR camera_position, f32 projection_scale);
+void texture_streamer_use(TextureStreamer* streamer, StreamedTexture texture, AABB* aabb, XMMATRIX transform);
+
+// The level whose texels best match the pixels an object spans: 0 once it covers texture_size pixels, one coarser
+// per halving. Fractional, and negative when even level 0 is magnified.
+f32 texture_streaming_required_mip(u32 texture_size, f32 pixels);
+
+// Call once per frame, after the frame's uses, from the thread that owns the renderer.
+void texture_streamer_update(TextureStreamer* streamer);
+
+TextureStreamingStats texture_streamer_stats(TextureStreamer* streamer);
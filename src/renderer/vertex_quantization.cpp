@@ -0,0 +1,265 @@
+#include <emmintrin.h>
+#include <math.h>
+#include <string.h>
+
+#include "vertex_quantization.h"
+
+VertexDequantization vertex_dequantization_from_aabb(AABB* aabb) {
+    XMVECTOR min = XMLoadFloat3(&aabb->min);
+    XMVECTOR max = XMLoadFloat3(&aabb->max);
+
+    VertexDequantization dequantization = {};
+    XMStoreFloat3(&dequantization.position_offset, min);
+    XMStoreFloat3(&dequantization.position_scale, XMVectorMax(max - min, XMVectorZero()) / 65535.0f);
+
+    return dequantization;
+}
+
+internal __m128i select_si128(__m128i mask, __m128i a, __m128i b) {
+    return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+internal __m128 select_ps(__m128 mask, __m128 a, __m128 b) {
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+// Round-to-nearest-even float to half conversion, returning the half in the low 16 bits of each lane.
+// SSE2 has no F16C, so the exponent is rebiased by hand and subnormals are aligned with a float add.
+internal __m128i float_to_half(__m128 f) {
+    __m128i bits = _mm_castps_si128(f);
+    __m128i sign = _mm_and_si128(bits, _mm_set1_epi32((int)0x80000000));
+    __m128i abs_bits = _mm_xor_si128(bits, sign);
+
+    __m128i mantissa_odd = _mm_and_si128(_mm_srli_epi32(abs_bits, 13), _mm_set1_epi32(1));
+    __m128i normal = _mm_sub_epi32(abs_bits, _mm_set1_epi32((127 - 15) << 23));
+    normal = _mm_add_epi32(normal, _mm_add_epi32(_mm_set1_epi32(0xFFF), mantissa_odd));
+    normal = _mm_srli_epi32(normal, 13);
+
+    __m128 denorm_magic = _mm_castsi128_ps(_mm_set1_epi32(((127 - 15) + (23 - 10) + 1) << 23));
+    __m128i denorm = _mm_sub_epi32(_mm_castps_si128(_mm_add_ps(_mm_castsi128_ps(abs_bits), denorm_magic)), _mm_castps_si128(denorm_magic));
+
+    __m128i is_denorm = _mm_cmplt_epi32(abs_bits, _mm_set1_epi32(113 << 23));
+    __m128i is_overflow = _mm_cmpgt_epi32(abs_bits, _mm_set1_epi32(((127 + 16) << 23) - 1));
+    __m128i is_nan = _mm_cmpgt_epi32(abs_bits, _mm_set1_epi32(255 << 23));
+    __m128i inf_or_nan = _mm_or_si128(_mm_set1_epi32(0x7C00), _mm_and_si128(is_nan, _mm_set1_epi32(0x200)));
+
+    __m128i result = select_si128(is_denorm, denorm, normal);
+    result = select_si128(is_overflow, inf_or_nan, result);
+
+    return _mm_or_si128(result, _mm_srli_epi32(sign, 16));
+}
+
+// Expects the half in the low 16 bits of each lane.
+internal __m128 half_to_float(__m128i h) {
+    __m128i exponent_mantissa = _mm_slli_epi32(_mm_and_si128(h, _mm_set1_epi32(0x7FFF)), 13);
+    __m128 f = _mm_mul_ps(_mm_castsi128_ps(exponent_mantissa), _mm_castsi128_ps(_mm_set1_epi32((254 - 15) << 23)));
+
+    __m128i was_inf_or_nan = _mm_castps_si128(_mm_cmpge_ps(f, _mm_castsi128_ps(_mm_set1_epi32((127 + 16) << 23))));
+    __m128i bits = _mm_or_si128(_mm_castps_si128(f), _mm_and_si128(was_inf_or_nan, _mm_set1_epi32(255 << 23)));
+    bits = _mm_or_si128(bits, _mm_slli_epi32(_mm_and_si128(h, _mm_set1_epi32(0x8000)), 16));
+
+    return _mm_castsi128_ps(bits);
+}
+
+void encode_compact_vertices(CompactVertex* dst, Vertex* src, u32 count, VertexDequantization* dequantization) {
+    XMFLOAT3 offset = dequantization->position_offset;
+    XMFLOAT3 scale = dequantization->position_scale;
+
+    __m128 offset_x = _mm_set1_ps(offset.x);
+    __m128 offset_y = _mm_set1_ps(offset.y);
+    __m128 offset_z = _mm_set1_ps(offset.z);
+    __m128 inv_scale_x = _mm_set1_ps(scale.x > 0.0f ? 1.0f / scale.x : 0.0f);
+    __m128 inv_scale_y = _mm_set1_ps(scale.y > 0.0f ? 1.0f / scale.y : 0.0f);
+    __m128 inv_scale_z = _mm_set1_ps(scale.z > 0.0f ? 1.0f / scale.z : 0.0f);
+
+    __m128 zero = _mm_setzero_ps();
+    __m128 one = _mm_set1_ps(1.0f);
+    __m128 unorm16_max = _mm_set1_ps(65535.0f);
+    __m128 sign_mask = _mm_castsi128_ps(_mm_set1_epi32((int)0x80000000));
+    __m128i low16 = _mm_set1_epi32(0xFFFF);
+
+    for (u32 i = 0; i < count; i += 4) {
+        u32 batch = count - i < 4 ? count - i : 4;
+
+        Vertex tail_in[4] = {};
+        CompactVertex tail_out[4];
+
+        Vertex* in = src + i;
+        CompactVertex* out = dst + i;
+
+        if (batch < 4) {
+            memcpy(tail_in, in, batch * sizeof(Vertex));
+            in = tail_in;
+            out = tail_out;
+        }
+
+        // Rows are (pos.xyz, norm.x) and (norm.yz, uv); transposing gives one attribute channel per register.
+        __m128 px = _mm_loadu_ps(&in[0].pos.x);
+        __m128 py = _mm_loadu_ps(&in[1].pos.x);
+        __m128 pz = _mm_loadu_ps(&in[2].pos.x);
+        __m128 nx = _mm_loadu_ps(&in[3].pos.x);
+        _MM_TRANSPOSE4_PS(px, py, pz, nx);
+
+        __m128 ny = _mm_loadu_ps(&in[0].norm.y);
+        __m128 nz = _mm_loadu_ps(&in[1].norm.y);
+        __m128 u = _mm_loadu_ps(&in[2].norm.y);
+        __m128 v = _mm_loadu_ps(&in[3].norm.y);
+        _MM_TRANSPOSE4_PS(ny, nz, u, v);
+
+        __m128i qx = _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_sub_ps(px, offset_x), inv_scale_x), zero), unorm16_max));
+        __m128i qy = _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_sub_ps(py, offset_y), inv_scale_y), zero), unorm16_max));
+        __m128i qz = _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_sub_ps(pz, offset_z), inv_scale_z), zero), unorm16_max));
+
+        // Octahedral mapping: project onto the L1 unit sphere, then fold the lower hemisphere over the diagonals.
+        __m128 l1 = _mm_add_ps(_mm_add_ps(_mm_andnot_ps(sign_mask, nx), _mm_andnot_ps(sign_mask, ny)), _mm_andnot_ps(sign_mask, nz));
+        __m128 inv_l1 = _mm_div_ps(one, _mm_max_ps(l1, _mm_set1_ps(1e-20f)));
+
+        __m128 ox = _mm_mul_ps(nx, inv_l1);
+        __m128 oy = _mm_mul_ps(ny, inv_l1);
+
+        __m128 folded_x = _mm_mul_ps(_mm_sub_ps(one, _mm_andnot_ps(sign_mask, oy)), _mm_or_ps(_mm_and_ps(ox, sign_mask), one));
+        __m128 folded_y = _mm_mul_ps(_mm_sub_ps(one, _mm_andnot_ps(sign_mask, ox)), _mm_or_ps(_mm_and_ps(oy, sign_mask), one));
+
+        __m128 lower_hemisphere = _mm_cmplt_ps(nz, zero);
+        ox = select_ps(lower_hemisphere, folded_x, ox);
+        oy = select_ps(lower_hemisphere, folded_y, oy);
+
+        __m128 snorm16_max = _mm_set1_ps(32767.0f);
+        __m128i sx = _mm_cvtps_epi32(_mm_mul_ps(_mm_min_ps(_mm_max_ps(ox, _mm_set1_ps(-1.0f)), one), snorm16_max));
+        __m128i sy = _mm_cvtps_epi32(_mm_mul_ps(_mm_min_ps(_mm_max_ps(oy, _mm_set1_ps(-1.0f)), one), snorm16_max));
+
+        __m128i hu = float_to_half(u);
+        __m128i hv = float_to_half(v);
+
+        // Each CompactVertex is four dwords: (pos.xy), (pos.z, pad), (norm.xy), (uv).
+        __m128 d0 = _mm_castsi128_ps(_mm_or_si128(qx, _mm_slli_epi32(qy, 16)));
+        __m128 d1 = _mm_castsi128_ps(qz);
+        __m128 d2 = _mm_castsi128_ps(_mm_or_si128(_mm_and_si128(sx, low16), _mm_slli_epi32(sy, 16)));
+        __m128 d3 = _mm_castsi128_ps(_mm_or_si128(hu, _mm_slli_epi32(hv, 16)));
+        _MM_TRANSPOSE4_PS(d0, d1, d2, d3);
+
+        _mm_storeu_ps((f32*)&out[0], d0);
+        _mm_storeu_ps((f32*)&out[1], d1);
+        _mm_storeu_ps((f32*)&out[2], d2);
+        _mm_storeu_ps((f32*)&out[3], d3);
+
+        if (batch < 4) {
+            memcpy(dst + i, tail_out, batch * sizeof(CompactVertex));
+        }
+    }
+}
+
+void decode_compact_vertices(Vertex* dst, CompactVertex* src, u32 count, VertexDequantization* dequantization) {
+    XMFLOAT3 offset = dequantization->position_offset;
+    XMFLOAT3 scale = dequantization->position_scale;
+
+    __m128 offset_x = _mm_set1_ps(offset.x);
+    __m128 offset_y = _mm_set1_ps(offset.y);
+    __m128 offset_z = _mm_set1_ps(offset.z);
+    __m128 scale_x = _mm_set1_ps(scale.x);
+    __m128 scale_y = _mm_set1_ps(scale.y);
+    __m128 scale_z = _mm_set1_ps(scale.z);
+
+    __m128 zero = _mm_setzero_ps();
+    __m128 one = _mm_set1_ps(1.0f);
+    __m128 sign_mask = _mm_castsi128_ps(_mm_set1_epi32((int)0x80000000));
+    __m128i low16 = _mm_set1_epi32(0xFFFF);
+
+    for (u32 i = 0; i < count; i += 4) {
+        u32 batch = count - i < 4 ? count - i : 4;
+
+        CompactVertex tail_in[4] = {};
+        Vertex tail_out[4];
+
+        CompactVertex* in = src + i;
+        Vertex* out = dst + i;
+
+        if (batch < 4) {
+            memcpy(tail_in, in, batch * sizeof(CompactVertex));
+            in = tail_in;
+            out = tail_out;
+        }
+
+        __m128 d0 = _mm_loadu_ps((f32*)&in[0]);
+        __m128 d1 = _mm_loadu_ps((f32*)&in[1]);
+        __m128 d2 = _mm_loadu_ps((f32*)&in[2]);
+        __m128 d3 = _mm_loadu_ps((f32*)&in[3]);
+        _MM_TRANSPOSE4_PS(d0, d1, d2, d3);
+
+        __m128i pos_xy = _mm_castps_si128(d0);
+        __m128i pos_z = _mm_castps_si128(d1);
+        __m128i norm = _mm_castps_si128(d2);
+        __m128i uv = _mm_castps_si128(d3);
+
+        __m128 px = _mm_add_ps(offset_x, _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(pos_xy, low16)), scale_x));
+        __m128 py = _mm_add_ps(offset_y, _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(pos_xy, 16)), scale_y));
+        __m128 pz = _mm_add_ps(offset_z, _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(pos_z, low16)), scale_z));
+
+        __m128 inv_snorm16_max = _mm_set1_ps(1.0f / 32767.0f);
+        __m128 ox = _mm_max_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_slli_epi32(norm, 16), 16)), inv_snorm16_max), _mm_set1_ps(-1.0f));
+        __m128 oy = _mm_max_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(norm, 16)), inv_snorm16_max), _mm_set1_ps(-1.0f));
+
+        // Unfold: points outside the L1 diamond came from the lower hemisphere and move back by the overshoot.
+        __m128 nz = _mm_sub_ps(_mm_sub_ps(one, _mm_andnot_ps(sign_mask, ox)), _mm_andnot_ps(sign_mask, oy));
+        __m128 t = _mm_max_ps(_mm_sub_ps(zero, nz), zero);
+        __m128 nx = _mm_sub_ps(ox, _mm_or_ps(t, _mm_and_ps(ox, sign_mask)));
+        __m128 ny = _mm_sub_ps(oy, _mm_or_ps(t, _mm_and_ps(oy, sign_mask)));
+
+        __m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, nx), _mm_mul_ps(ny, ny)), _mm_mul_ps(nz, nz)));
+        nx = _mm_div_ps(nx, length);
+        ny = _mm_div_ps(ny, length);
+        nz = _mm_div_ps(nz, length);
+
+        __m128 u = half_to_float(_mm_and_si128(uv, low16));
+        __m128 v = half_to_float(_mm_srli_epi32(uv, 16));
+
+        _MM_TRANSPOSE4_PS(px, py, pz, nx);
+        _MM_TRANSPOSE4_PS(ny, nz, u, v);
+
+        _mm_storeu_ps(&out[0].pos.x, px);
+        _mm_storeu_ps(&out[1].pos.x, py);
+        _mm_storeu_ps(&out[2].pos.x, pz);
+        _mm_storeu_ps(&out[3].pos.x, nx);
+
+        _mm_storeu_ps(&out[0].norm.y, ny);
+        _mm_storeu_ps(&out[1].norm.y, nz);
+        _mm_storeu_ps(&out[2].norm.y, u);
+        _mm_storeu_ps(&out[3].norm.y, v);
+
+        if (batch < 4) {
+            memcpy(dst + i, tail_out, batch * sizeof(Vertex));
+        }
+    }
+}
+
+CompactVertexError measure_compact_vertex_error(Vertex* original, CompactVertex* encoded, u32 count, VertexDequantization* dequantization) {
+    Scratch scratch = get_scratch(0, 0);
+
+    Vertex* decoded = arena_push_array(scratch.arena, Vertex, count);
+    decode_compact_vertices(decoded, encoded, count, dequantization);
+
+    CompactVertexError error = {};
+    f32 min_normal_dot = 1.0f;
+
+    for (u32 i = 0; i < count; ++i) {
+        Vertex* a = &original[i];
+        Vertex* b = &decoded[i];
+
+        f32 position_error = XMVectorGetX(XMVector3Length(XMLoadFloat3(&a->pos) - XMLoadFloat3(&b->pos)));
+        error.max_position_error = fmaxf(error.max_position_error, position_error);
+
+        XMVECTOR normal = XMLoadFloat3(&a->norm);
+        if (XMVectorGetX(XMVector3LengthSq(normal)) > 0.0f) {
+            f32 d = XMVectorGetX(XMVector3Dot(XMVector3Normalize(normal), XMLoadFloat3(&b->norm)));
+            min_normal_dot = fminf(min_normal_dot, d);
+        }
+
+        error.max_uv_error = fmaxf(error.max_uv_error, fmaxf(fabsf(a->uv.x - b->uv.x), fabsf(a->uv.y - b->uv.y)));
+    }
+
+    error.max_normal_error_degrees = XMConvertToDegrees(acosf(fmaxf(fminf(min_normal_dot, 1.0f), -1.0f)));
+
+    release_scratch(scratch);
+
+    return error;
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include "renderer.h"
+
+// Conversion between the full Vertex layout and CompactVertex. Both directions process four vertices per
+// iteration with SSE2, and quantization is round-to-nearest everywhere, so the worst-case position error per
+// axis is half of position_scale.
+
+VertexDequantization vertex_dequantization_from_aabb(AABB* aabb);
+
+void encode_compact_vertices(CompactVertex* dst, Vertex* src, u32 count, VertexDequantization* dequantization);
+void decode_compact_vertices(Vertex* dst, CompactVertex* src, u32 count, VertexDequantization* dequantization);
+
+struct CompactVertexError {
+    f32 max_position_error;
+    f32 max_normal_error_degrees;
+    f32 max_uv_error;
+};
+
+// Decodes the compact vertices and compares them against the originals.
+CompactVertexError measure_compact_vertex_error(Vertex* original, CompactVertex* encoded, u32 count, VertexDequantization* dequantization);
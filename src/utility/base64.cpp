@@ -0,0 +1,169 @@
+#include <tmmintrin.h>
+
+#include "base64.h"
+
+enum {
+    BASE64_INVALID = -1,
+    BASE64_WHITESPACE = -2,
+    BASE64_PADDING = -3,
+};
+
+struct Base64Table {
+    i8 values[256];
+};
+
+internal constexpr Base64Table build_base64_table() {
+    Base64Table table = {};
+
+    for (int c = 0; c < 256; ++c) {
+        i8 value = BASE64_INVALID;
+
+        if (c >= 'A' && c <= 'Z') value = (i8)(c - 'A');
+        if (c >= 'a' && c <= 'z') value = (i8)(c - 'a' + 26);
+        if (c >= '0' && c <= '9') value = (i8)(c - '0' + 52);
+        if (c == '+') value = 62;
+        if (c == '/') value = 63;
+        if (c == ' ' || c == '\t' || c == '\r' || c == '\n') value = BASE64_WHITESPACE;
+        if (c == '=') value = BASE64_PADDING;
+
+        table.values[c] = value;
+    }
+
+    return table;
+}
+
+global_var constexpr Base64Table base64_table = build_base64_table();
+
+u64 base64_decoded_size_bound(u64 len) {
+    return (len + 3) / 4 * 3;
+}
+
+// Translates 16 characters to sextets with nibble lookups (Muła and Lemire), and reports whether all of them
+// were in the alphabet. Whitespace, padding and invalid characters all fail here and go to the scalar path.
+internal bool base64_decode_block(u8* src, u8* dst) {
+    __m128i lut_lo = _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+    __m128i lut_hi = _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+    __m128i lut_roll = _mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+    __m128i mask_2f = _mm_set1_epi8(0x2F);
+
+    __m128i chars = _mm_loadu_si128((__m128i*)src);
+
+    __m128i hi_nibbles = _mm_and_si128(_mm_srli_epi32(chars, 4), mask_2f);
+    __m128i lo_nibbles = _mm_and_si128(chars, mask_2f);
+    __m128i hi = _mm_shuffle_epi8(lut_hi, hi_nibbles);
+    __m128i lo = _mm_shuffle_epi8(lut_lo, lo_nibbles);
+
+    if (_mm_movemask_epi8(_mm_cmpgt_epi8(_mm_and_si128(lo, hi), _mm_setzero_si128())) != 0) {
+        return false;
+    }
+
+    __m128i roll = _mm_shuffle_epi8(lut_roll, _mm_add_epi8(_mm_cmpeq_epi8(chars, mask_2f), hi_nibbles));
+    __m128i sextets = _mm_add_epi8(chars, roll);
+
+    // Merge sextet pairs into 12-bit values, then pairs of those into 24-bit values, and pack out the 3 bytes
+    // of each in big-endian order.
+    __m128i merged = _mm_maddubs_epi16(sextets, _mm_set1_epi32(0x01400140));
+    merged = _mm_madd_epi16(merged, _mm_set1_epi32(0x00011000));
+    merged = _mm_shuffle_epi8(merged, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+
+    _mm_storeu_si128((__m128i*)dst, merged);
+
+    return true;
+}
+
+bool base64_decode(void* dst, u64 dst_capacity, char* src, u64 len, u64* decoded_size) {
+    u8* in = (u8*)src;
+    u8* in_end = in + len;
+
+    u8* out = (u8*)dst;
+    u8* out_end = out + dst_capacity;
+
+    *decoded_size = 0;
+
+    for (;;) {
+        // The block store writes 16 bytes for 12 decoded ones, so leave room for the overhang.
+        while (in_end - in >= 16 && out_end - out >= 16 && base64_decode_block(in, out)) {
+            in += 16;
+            out += 12;
+        }
+
+        // Slow path: decode a single quantum, skipping whitespace, then retry the fast path.
+        u32 bits = 0;
+        int count = 0;
+
+        while (in < in_end && count < 4) {
+            i8 value = base64_table.values[*in];
+
+            if (value == BASE64_PADDING) {
+                break;
+            }
+
+            if (value == BASE64_INVALID) {
+                return false;
+            }
+
+            ++in;
+
+            if (value >= 0) {
+                bits = (bits << 6) | (u32)value;
+                ++count;
+            }
+        }
+
+        if (count == 4) {
+            if (out_end - out < 3) {
+                return false;
+            }
+
+            out[0] = (u8)(bits >> 16);
+            out[1] = (u8)(bits >> 8);
+            out[2] = (u8)bits;
+            out += 3;
+
+            continue;
+        }
+
+        // End of input or padding. A final quantum carries 2 or 3 characters; 1 can't encode a whole byte.
+        if (count == 1) {
+            return false;
+        }
+
+        if (count > 1) {
+            int bytes = count - 1;
+            bits <<= (4 - count) * 6;
+
+            if (out_end - out < bytes) {
+                return false;
+            }
+
+            out[0] = (u8)(bits >> 16);
+            if (bytes == 2) {
+                out[1] = (u8)(bits >> 8);
+            }
+            out += bytes;
+        }
+
+        int padding = 0;
+
+        for (; in < in_end; ++in) {
+            i8 value = base64_table.values[*in];
+
+            if (value == BASE64_PADDING) {
+                ++padding;
+            }
+            else if (value != BASE64_WHITESPACE) {
+                return false;
+            }
+        }
+
+        if (padding > 0 && (count == 0 || padding != 4 - count)) {
+            return false;
+        }
+
+        break;
+    }
+
+    *decoded_size = out - (u8*)dst;
+
+    return true;
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+#include "common.h"
+
+// Standard-alphabet base64 (RFC 4648). Whitespace anywhere in the input is skipped and trailing '=' padding
+// is optional, so both data URIs and line-wrapped MIME text decode.
+
+u64 base64_decoded_size_bound(u64 len);
+
+// Decodes `len` characters straight into `dst`, which holds `dst_capacity` bytes. Returns false on invalid
+// characters, misplaced padding, a truncated final quantum or output overflow. Runs of 16 characters free
+// of whitespace and padding are decoded with SSSE3; every D3D12-capable x64 CPU supports SSSE3.
+bool base64_decode(void* dst, u64 dst_capacity, char* src, u64 len, u64* decoded_size);
@@ -0,0 +1,169 @@
+#include <string.h>
+
+#include "hash.h"
+
+#define HASH_PRIME_1 0x9E3779B185EBCA87ull
+#define HASH_PRIME_2 0xC2B2AE3D27D4EB4Full
+#define HASH_PRIME_3 0x165667B19E3779F9ull
+
+internal u64 rotl64(u64 x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+internal u64 read_u64(u8* p) {
+    u64 result;
+    memcpy(&result, p, sizeof(result));
+    return result;
+}
+
+internal u64 hash_round(u64 acc, u64 word) {
+    acc += word * HASH_PRIME_2;
+    acc = rotl64(acc, 31);
+    return acc * HASH_PRIME_1;
+}
+
+u64 hash_u64(u64 x) {
+    x ^= x >> 30;
+    x *= 0xBF58476D1CE4E5B9ull;
+    x ^= x >> 27;
+    x *= 0x94D049BB133111EBull;
+    x ^= x >> 31;
+    return x;
+}
+
+u64 hash_combine(u64 a, u64 b) {
+    return hash_u64(a ^ (b + HASH_PRIME_3 + (a << 6) + (a >> 2)));
+}
+
+u64 hash_bytes(void* data, u64 size, u64 seed) {
+    u8* p = (u8*)data;
+    u8* end = p + size;
+
+    u64 h;
+
+    // Four independent lanes so large buffers hash at memory speed rather than multiply latency.
+    if (size >= 32) {
+        u64 acc[4] = {
+            seed + HASH_PRIME_1 + HASH_PRIME_2,
+            seed + HASH_PRIME_2,
+            seed,
+            seed - HASH_PRIME_1
+        };
+
+        for (; p + 32 <= end; p += 32) {
+            acc[0] = hash_round(acc[0], read_u64(p + 0));
+            acc[1] = hash_round(acc[1], read_u64(p + 8));
+            acc[2] = hash_round(acc[2], read_u64(p + 16));
+            acc[3] = hash_round(acc[3], read_u64(p + 24));
+        }
+
+        h = rotl64(acc[0], 1) + rotl64(acc[1], 7) + rotl64(acc[2], 12) + rotl64(acc[3], 18);
+    }
+    else {
+        h = seed + HASH_PRIME_3;
+    }
+
+    h += size;
+
+    for (; p + 8 <= end; p += 8) {
+        h ^= hash_round(0, read_u64(p));
+        h = rotl64(h, 27) * HASH_PRIME_1 + HASH_PRIME_3;
+    }
+
+    for (; p < end; ++p) {
+        h ^= *p * HASH_PRIME_3;
+        h = rotl64(h, 11) * HASH_PRIME_1;
+    }
+
+    h = hash_u64(h);
+
+    // Zero is reserved as the empty key in HashMap.
+    return h ? h : 1;
+}
+
+u64 hash_string(char* str) {
+    return hash_bytes(str, strlen(str), 0);
+}
+
+HashMap* hash_map_new(Arena* arena, u32 max_count) {
+    u32 capacity = 16;
+    while (capacity < max_count * 2) {
+        capacity *= 2;
+    }
+
+    HashMap* map = arena_push_struct_zero(arena, HashMap);
+    map->capacity = capacity;
+    map->keys = arena_push_array_zero(arena, u64, capacity);
+    map->values = arena_push_array(arena, u64, capacity);
+
+    return map;
+}
+
+bool hash_map_get(HashMap* map, u64 key, u64* value) {
+    assert(key != 0);
+
+    u32 mask = map->capacity - 1;
+
+    for (u32 i = (u32)hash_u64(key) & mask;; i = (i + 1) & mask) {
+        if (map->keys[i] == key) {
+            *value = map->values[i];
+            return true;
+        }
+
+        if (map->keys[i] == 0) {
+            return false;
+        }
+    }
+}
+
+void hash_map_put(HashMap* map, u64 key, u64 value) {
+    assert(key != 0);
+
+    u32 mask = map->capacity - 1;
+
+    for (u32 i = (u32)hash_u64(key) & mask;; i = (i + 1) & mask) {
+        if (map->keys[i] == key) {
+            map->values[i] = value;
+            return;
+        }
+
+        if (map->keys[i] == 0) {
+            assert(map->count < map->capacity / 2 && "Hash map over capacity");
+            map->keys[i] = key;
+            map->values[i] = value;
+            ++map->count;
+            return;
+        }
+    }
+}
+
+bool hash_map_remove(HashMap* map, u64 key) {
+    assert(key != 0);
+
+    u32 mask = map->capacity - 1;
+    u32 i = (u32)hash_u64(key) & mask;
+
+    while (map->keys[i] != key) {
+        if (map->keys[i] == 0) {
+            return false;
+        }
+        i = (i + 1) & mask;
+    }
+
+    // Backward-shift deletion: pull later entries of the probe chain into the hole so lookups never need tombstones.
+    for (u32 j = (i + 1) & mask; map->keys[j] != 0; j = (j + 1) & mask) {
+        u32 home = (u32)hash_u64(map->keys[j]) & mask;
+
+        bool home_between = i <= j ? (i < home && home <= j) : (i < home || home <= j);
+        if (!home_between) {
+            map->keys[i] = map->keys[j];
+            map->values[i] = map->values[j];
+            i = j;
+        }
+    }
+
+    map->keys[i] = 0;
+    --map->count;
+
+    return true;
+}
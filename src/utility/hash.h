@@ -0,0 +1,22 @@
+#pragma once
+
+#include "common.h"
+
+u64 hash_u64(u64 x);
+u64 hash_combine(u64 a, u64 b);
+u64 hash_bytes(void* data, u64 size, u64 seed);
+u64 hash_string(char* str);
+
+// Fixed-capacity open-addressing map from non-zero u64 keys to u64 values.
+struct HashMap {
+    u32 capacity;
+    u32 count;
+    u64* keys;
+    u64* values;
+};
+
+HashMap* hash_map_new(Arena* arena, u32 max_count);
+
+bool hash_map_get(HashMap* map, u64 key, u64* value);
+void hash_map_put(HashMap* map, u64 key, u64 value);
+bool hash_map_remove(HashMap* map, u64 key);
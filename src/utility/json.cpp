@@ -176,6 +176,7 @@ internal Json* parse(Arena* arena, Lexer* l) {
         case TOKEN_STRING: {
             Json* j = new_json(arena, JSON_STRING);
             j->string = extract_token_string(arena, tok);
+            j->string_len = tok.len - 2;
             return j;
         }
         case TOKEN_LSQUARE: {
@@ -262,6 +263,18 @@ int json_len(Json* j) {
     return len;
 };
 
+Json* json_index(Json* j, int index) {
+    assert(j->type == JSON_ARRAY);
+
+    Json* n = j->array_first;
+    for (int i = 0; i < index && n; ++i) {
+        n = n->next;
+    }
+
+    assert(n);
+    return n;
+}
+
 Json* json_query(Json* j, char* str) {
     assert(j->type == JSON_OBJECT);
     
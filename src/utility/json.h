@@ -25,6 +25,7 @@ struct Json {
         Json* array_first;
         StringJsonPair* object_first;
     };
+    u64 string_len;
 };
 
 struct StringJsonPair {
@@ -36,6 +37,7 @@ struct StringJsonPair {
 Json* parse_json_string(Arena* arena, char* str);
 
 int json_len(Json* j);
+Json* json_index(Json* j, int index);
 Json* json_query(Json* j, char* str);
 
 #define JSON_FOREACH(arr, name) for (Json* name = arr->array_first; name; name = name->next)
@@ -0,0 +1,249 @@
+#include <string.h>
+
+#include "lz4.h"
+
+#define LZ4_MIN_MATCH 4
+#define LZ4_LAST_LITERALS 5 // The format requires a block to end with at least this many literals
+#define LZ4_MATCH_FIND_LIMIT 12 // And its last match to start at least this far from the end
+#define LZ4_MAX_OFFSET 65535
+#define LZ4_HASH_BITS 12
+#define LZ4_SKIP_TRIGGER 6 // Each 64 probes without a match lengthen the step by a byte
+
+internal u32 read_u32(u8* p) {
+    u32 result;
+    memcpy(&result, p, sizeof(result));
+    return result;
+}
+
+internal u64 read_u64(u8* p) {
+    u64 result;
+    memcpy(&result, p, sizeof(result));
+    return result;
+}
+
+internal u32 lz4_hash(u32 sequence) {
+    return (sequence * 2654435761u) >> (32 - LZ4_HASH_BITS);
+}
+
+u64 lz4_compress_bound(u64 size) {
+    return size + size / 255 + 16;
+}
+
+internal u8* write_lz4_length(u8* op, u64 len) {
+    len -= 15;
+    while (len >= 255) {
+        *op++ = 255;
+        len -= 255;
+    }
+    *op++ = (u8)len;
+    return op;
+}
+
+// A match length of 0 writes the final sequence, which is only literals. Returns null if it doesn't fit.
+internal u8* write_lz4_sequence(u8* op, u8* op_end, u8* literals, u64 num_literals, u64 offset, u64 match_len) {
+    u64 worst_size = 1 + num_literals / 255 + 1 + num_literals + 2 + match_len / 255 + 1;
+    if (worst_size > (u64)(op_end - op)) {
+        return 0;
+    }
+
+    u8* token = op++;
+    *token = (u8)((num_literals < 15 ? num_literals : 15) << 4);
+    if (num_literals >= 15) {
+        op = write_lz4_length(op, num_literals);
+    }
+
+    memcpy(op, literals, num_literals);
+    op += num_literals;
+
+    if (match_len > 0) {
+        *op++ = (u8)offset;
+        *op++ = (u8)(offset >> 8);
+
+        u64 len = match_len - LZ4_MIN_MATCH;
+        *token = (u8)(*token | (len < 15 ? len : 15));
+        if (len >= 15) {
+            op = write_lz4_length(op, len);
+        }
+    }
+
+    return op;
+}
+
+u64 lz4_compress(void* dst, u64 dst_capacity, void* src, u64 size) {
+    u8* base = (u8*)src;
+    u8* ip = base;
+    u8* anchor = base;
+    u8* input_end = base + size;
+
+    u8* op = (u8*)dst;
+    u8* op_end = op + dst_capacity;
+
+    if (size > LZ4_MATCH_FIND_LIMIT) {
+        // Positions are stored plus one, so zero means empty.
+        u32 table[1 << LZ4_HASH_BITS] = {};
+
+        u8* find_limit = input_end - LZ4_MATCH_FIND_LIMIT;
+        u8* match_limit = input_end - LZ4_LAST_LITERALS;
+        u32 num_probes = 0;
+
+        while (ip <= find_limit) {
+            u32 sequence = read_u32(ip);
+            u32 hash = lz4_hash(sequence);
+            u64 pos = ip - base;
+            u64 candidate = table[hash];
+            table[hash] = (u32)(pos + 1);
+
+            if (candidate == 0 || pos + 1 - candidate > LZ4_MAX_OFFSET || read_u32(base + candidate - 1) != sequence) {
+                ip += 1 + (num_probes++ >> LZ4_SKIP_TRIGGER);
+                continue;
+            }
+
+            u8* ref = base + candidate - 1;
+
+            while (ip > anchor && ref > base && ip[-1] == ref[-1]) {
+                --ip;
+                --ref;
+            }
+
+            u8* match_end = ip + LZ4_MIN_MATCH;
+            u8* ref_end = ref + LZ4_MIN_MATCH;
+
+            while (match_end + 8 <= match_limit && read_u64(match_end) == read_u64(ref_end)) {
+                match_end += 8;
+                ref_end += 8;
+            }
+
+            while (match_end < match_limit && *match_end == *ref_end) {
+                ++match_end;
+                ++ref_end;
+            }
+
+            op = write_lz4_sequence(op, op_end, anchor, ip - anchor, ip - ref, match_end - ip);
+            if (!op) {
+                return 0;
+            }
+
+            // The position just before the match's end is likely to start the next one.
+            if (match_end - 2 > ip) {
+                table[lz4_hash(read_u32(match_end - 2))] = (u32)(match_end - 2 - base + 1);
+            }
+
+            ip = match_end;
+            anchor = ip;
+            num_probes = 0;
+        }
+    }
+
+    op = write_lz4_sequence(op, op_end, anchor, input_end - anchor, 0, 0);
+    if (!op) {
+        return 0;
+    }
+
+    return op - (u8*)dst;
+}
+
+internal bool read_lz4_length(u8** ip, u8* input_end, u64* len) {
+    u8 byte;
+    do {
+        if (*ip >= input_end) {
+            return false;
+        }
+        byte = *(*ip)++;
+        *len += byte;
+    } while (byte == 255);
+
+    return true;
+}
+
+bool lz4_decompress(void* dst, u64 dst_size, void* src, u64 src_size) {
+    u8* ip = (u8*)src;
+    u8* input_end = ip + src_size;
+
+    u8* op = (u8*)dst;
+    u8* op_end = op + dst_size;
+
+    while (true) {
+        if (ip >= input_end) {
+            return false;
+        }
+
+        u8 token = *ip++;
+
+        u64 num_literals = token >> 4;
+        if (num_literals < 15 && input_end - ip >= 16 && op_end - op >= 16) {
+            // A short run is copied as a whole 16 bytes; what lands past its end is overwritten after.
+            memcpy(op, ip, 16);
+        }
+        else {
+            if (num_literals == 15 && !read_lz4_length(&ip, input_end, &num_literals)) {
+                return false;
+            }
+
+            if (num_literals > (u64)(input_end - ip) || num_literals > (u64)(op_end - op)) {
+                return false;
+            }
+
+            memcpy(op, ip, num_literals);
+        }
+
+        ip += num_literals;
+        op += num_literals;
+
+        if (ip == input_end) {
+            break;
+        }
+
+        if (input_end - ip < 2) {
+            return false;
+        }
+
+        u64 offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+
+        if (offset == 0 || offset > (u64)(op - (u8*)dst)) {
+            return false;
+        }
+
+        u64 match_len = token & 15;
+        if (match_len == 15 && !read_lz4_length(&ip, input_end, &match_len)) {
+            return false;
+        }
+        match_len += LZ4_MIN_MATCH;
+
+        if (match_len > (u64)(op_end - op)) {
+            return false;
+        }
+
+        u8* match = op - offset;
+        u8* match_end = op + match_len;
+
+        // Matches are copied in whole words where there's room past their end. Words overlap the match's own output
+        // when it's shorter than the match, but are never longer than the offset, so each is written before it's read.
+        if (offset >= 16 && op_end - match_end >= 16) {
+            do {
+                memcpy(op, match, 16);
+                op += 16;
+                match += 16;
+            } while (op < match_end);
+        }
+        else if (offset >= 8 && op_end - match_end >= 8) {
+            do {
+                memcpy(op, match, 8);
+                op += 8;
+                match += 8;
+            } while (op < match_end);
+        }
+        else if (offset >= match_len) {
+            memcpy(op, match, match_len);
+        }
+        else {
+            for (u64 i = 0; i < match_len; ++i) {
+                op[i] = match[i];
+            }
+        }
+
+        op = match_end;
+    }
+
+    return op == op_end;
+}
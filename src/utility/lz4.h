@@ -0,0 +1,16 @@
+#pragma once
+
+#include "common.h"
+
+// The LZ4 block format, without the frame around it: data compressed here decompresses with the reference
+// library and the other way around. Offsets are 16 bits, so a match reaches at most 64 KB back.
+
+u64 lz4_compress_bound(u64 size);
+
+// Greedy single-probe matching, like the reference's default level. Returns the compressed size, or 0 if it
+// doesn't fit in dst_capacity bytes.
+u64 lz4_compress(void* dst, u64 dst_capacity, void* src, u64 size);
+
+// Decompresses exactly dst_size bytes. Returns false if the input is malformed, reaches outside either buffer or
+// doesn't decompress to exactly dst_size bytes.
+bool lz4_decompress(void* dst, u64 dst_size, void* src, u64 src_size);
@@ -0,0 +1,650 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "pak.h"
+#include "hash.h"
+#include "lz4.h"
+#include "work_queue.h"
+
+#define PAK_MAGIC 0x4B415053 // "SPAK"
+#define PAK_VERSION 2
+
+#define PAK_READ_AHEAD_BLOCK_SIZE (1024 * 1024)
+#define PAK_WORKER_SCRATCH_SIZE (64 * 1024)
+
+#define VFS_MAX_PAKS 8
+#define VFS_RECORDING_PATH_SIZE 256 // Room for each recorded path, on average
+
+// The header is followed by every file's chunks, in the order the files were packed, then the table of contents:
+// the file entries sorted by path hash, each chunk's offset plus one past the last chunk's end, and the files'
+// normalized paths back to back.
+
+struct PakHeader {
+    u32 magic;
+    u32 version;
+    u32 num_files;
+    u32 num_chunks;
+    u64 toc_offset;
+    u64 paths_size;
+};
+
+struct PakFileEntry {
+    u64 path_hash;
+    u64 size;
+    u32 first_chunk;
+    u32 num_chunks;
+    u32 path_offset;
+    u32 path_len;
+};
+
+struct Pak {
+    File file;
+    u32 num_files;
+    u32 num_chunks;
+    PakFileEntry* files;
+    u64* chunk_offsets; // A chunk as large as its data is stored uncompressed
+    char* paths;
+
+    WorkQueue* queue;
+    volatile u32 queue_claims; // The reader that takes it from 0 to 1 has the queue; the rest decompress alone
+
+    Thread read_ahead_thread;
+    Semaphore read_ahead_wake;
+    volatile u32 read_ahead_begin;
+    volatile u32 read_ahead_end;
+    volatile u32 quit;
+    void* read_ahead_buffer;
+};
+
+u32 pak_normalize_path(char* path, char* normalized) {
+    u32 len = 0;
+
+    u32 segment_starts[128];
+    bool segment_is_parent[128];
+    u32 num_segments = 0;
+
+    char* c = path;
+    while (*c) {
+        char* segment = c;
+        while (*c && *c != '/' && *c != '\\') {
+            ++c;
+        }
+
+        u32 segment_len = (u32)(c - segment);
+        if (*c) {
+            ++c;
+        }
+
+        if (segment_len == 0 || (segment_len == 1 && segment[0] == '.')) {
+            continue;
+        }
+
+        bool parent = segment_len == 2 && segment[0] == '.' && segment[1] == '.';
+        if (parent && num_segments > 0 && !segment_is_parent[num_segments - 1]) {
+            len = segment_starts[--num_segments];
+            continue;
+        }
+
+        assert(num_segments < ARRAY_LEN(segment_starts) && len + segment_len + 2 <= PAK_MAX_PATH && "Path too long");
+
+        segment_starts[num_segments] = len;
+        segment_is_parent[num_segments] = parent;
+        ++num_segments;
+
+        if (len > 0) {
+            normalized[len++] = '/';
+        }
+
+        for (u32 i = 0; i < segment_len; ++i) {
+            char ch = segment[i];
+            normalized[len++] = ch >= 'A' && ch <= 'Z' ? (char)(ch - 'A' + 'a') : ch;
+        }
+    }
+
+    normalized[len] = '\0';
+
+    return len;
+}
+
+internal u64 pak_path_hash(char* normalized, u32 len) {
+    // Hash maps can't hold a zero key.
+    u64 hash = hash_bytes(normalized, len, 0);
+    return hash ? hash : 1;
+}
+
+// Another path with the same hash isn't the file.
+internal PakFileEntry* find_pak_file(Pak* pak, char* path) {
+    char normalized[PAK_MAX_PATH];
+    u32 len = pak_normalize_path(path, normalized);
+    u64 path_hash = pak_path_hash(normalized, len);
+
+    u32 low = 0;
+    u32 high = pak->num_files;
+
+    while (low < high) {
+        u32 mid = low + (high - low) / 2;
+        if (pak->files[mid].path_hash < path_hash) {
+            low = mid + 1;
+        }
+        else {
+            high = mid;
+        }
+    }
+
+    if (low < pak->num_files && pak->files[low].path_hash == path_hash) {
+        PakFileEntry* file = &pak->files[low];
+
+        if (file->path_len == len && memcmp(pak->paths + file->path_offset, normalized, len) == 0) {
+            return file;
+        }
+    }
+
+    return 0;
+}
+
+// Only warms the OS's file cache; the data read is thrown away. A read moving the window elsewhere makes the
+// thread start over there.
+internal void pak_read_ahead_proc(void* data) {
+    Pak* pak = (Pak*)data;
+    u32 cursor = 0;
+
+    while (true) {
+        semaphore_wait(pak->read_ahead_wake);
+
+        if (atomic_load(&pak->quit)) {
+            break;
+        }
+
+        u32 begin = atomic_load(&pak->read_ahead_begin);
+        u32 end = atomic_load(&pak->read_ahead_end);
+
+        if (cursor < begin || cursor > end) {
+            cursor = begin;
+        }
+
+        while (cursor < end && atomic_load(&pak->read_ahead_begin) == begin) {
+            u32 block_end = cursor + 1;
+            while (block_end < end && pak->chunk_offsets[block_end + 1] - pak->chunk_offsets[cursor] <= PAK_READ_AHEAD_BLOCK_SIZE) {
+                ++block_end;
+            }
+
+            u64 offset = pak->chunk_offsets[cursor];
+            file_read(pak->file, offset, pak->read_ahead_buffer, pak->chunk_offsets[block_end] - offset);
+
+            cursor = block_end;
+        }
+    }
+}
+
+// Reads trust the table of contents, so one that would have them go outside the file, or decompress past the end
+// of a file's memory, rejects the pak: chunks must fill the space between the header and the table in order, each
+// no larger than PAK_CHUNK_SIZE, and each file's chunks and path must be the pak's, with as many chunks as its size
+// needs.
+internal bool pak_toc_valid(Pak* pak, u64 toc_offset, u64 paths_size) {
+    u64* offsets = pak->chunk_offsets;
+
+    if (offsets[0] != sizeof(PakHeader) || offsets[pak->num_chunks] != toc_offset) {
+        return false;
+    }
+
+    for (u32 i = 0; i < pak->num_chunks; ++i) {
+        if (offsets[i + 1] <= offsets[i] || offsets[i + 1] - offsets[i] > PAK_CHUNK_SIZE) {
+            return false;
+        }
+    }
+
+    for (u32 i = 0; i < pak->num_files; ++i) {
+        PakFileEntry* file = &pak->files[i];
+
+        if ((u64)file->first_chunk + file->num_chunks > pak->num_chunks) {
+            return false;
+        }
+
+        if (file->num_chunks != (file->size + PAK_CHUNK_SIZE - 1) / PAK_CHUNK_SIZE) {
+            return false;
+        }
+
+        if ((u64)file->path_offset + file->path_len > paths_size) {
+            return false;
+        }
+
+        // Binary search needs the entries sorted.
+        if (i > 0 && file->path_hash <= pak->files[i - 1].path_hash) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+Pak* pak_open(Arena* arena, char* path, u32 num_threads) {
+    File file = file_open(path);
+    if (!file.handle) {
+        return 0;
+    }
+
+    u64 size = file_size(file);
+
+    PakHeader header = {};
+    if (size < sizeof(header) || !file_read(file, 0, &header, sizeof(header)) || header.magic != PAK_MAGIC || header.version != PAK_VERSION) {
+        file_close(file);
+        return 0;
+    }
+
+    u64 files_size = header.num_files * sizeof(PakFileEntry);
+    u64 offsets_size = (header.num_chunks + 1) * sizeof(u64);
+
+    if (header.toc_offset > size || header.paths_size > size || header.toc_offset + files_size + offsets_size + header.paths_size != size) {
+        file_close(file);
+        return 0;
+    }
+
+    Pak* pak = arena_push_struct_zero(arena, Pak);
+    pak->file = file;
+    pak->num_files = header.num_files;
+    pak->num_chunks = header.num_chunks;
+    pak->files = arena_push_array(arena, PakFileEntry, header.num_files);
+    pak->chunk_offsets = arena_push_array(arena, u64, header.num_chunks + 1);
+    pak->paths = arena_push_array(arena, char, header.paths_size);
+
+    u64 paths_offset = header.toc_offset + files_size + offsets_size;
+
+    if (!file_read(file, header.toc_offset, pak->files, files_size) || !file_read(file, header.toc_offset + files_size, pak->chunk_offsets, offsets_size) ||
+        !file_read(file, paths_offset, pak->paths, header.paths_size)) {
+        file_close(file);
+        return 0;
+    }
+
+    if (!pak_toc_valid(pak, header.toc_offset, header.paths_size)) {
+        debug_message("Corrupt table of contents in pak '%s'.\n", path);
+        file_close(file);
+        return 0;
+    }
+
+    pak->queue = work_queue_new(arena, num_threads, PAK_WORKER_SCRATCH_SIZE);
+
+    pak->read_ahead_wake = semaphore_create(0);
+    pak->read_ahead_buffer = page_alloc(PAK_READ_AHEAD_BLOCK_SIZE);
+    pak->read_ahead_thread = thread_start(arena, pak_read_ahead_proc, pak, PAK_WORKER_SCRATCH_SIZE);
+
+    u64 uncompressed_size = 0;
+    for (u32 i = 0; i < pak->num_files; ++i) {
+        uncompressed_size += pak->files[i].size;
+    }
+
+    debug_message("Opened pak '%s': %u files, %.1f MB compressed to %.1f MB.\n", path, pak->num_files,
+        uncompressed_size / (1024.0f * 1024.0f), (pak->chunk_offsets[pak->num_chunks] - sizeof(PakHeader)) / (1024.0f * 1024.0f));
+
+    return pak;
+}
+
+void pak_close(Pak* pak) {
+    atomic_store(&pak->quit, 1);
+    semaphore_signal(pak->read_ahead_wake, 1);
+    thread_join(pak->read_ahead_thread);
+
+    semaphore_destroy(pak->read_ahead_wake);
+    page_free(pak->read_ahead_buffer);
+
+    work_queue_destroy(pak->queue);
+    file_close(pak->file);
+}
+
+bool pak_contains(Pak* pak, char* path) {
+    return find_pak_file(pak, path) != 0;
+}
+
+struct PakDecompression {
+    Pak* pak;
+    PakFileEntry* file;
+    u8* compressed;
+    u8* memory;
+    volatile u32 num_failed;
+};
+
+internal void decompress_pak_chunks(void* data, u32 begin, u32 end) {
+    PakDecompression* decompression = (PakDecompression*)data;
+    PakFileEntry* file = decompression->file;
+    u64* offsets = decompression->pak->chunk_offsets + file->first_chunk;
+
+    for (u32 i = begin; i < end; ++i) {
+        u64 chunk_start = (u64)i * PAK_CHUNK_SIZE;
+        u64 chunk_size = file->size - chunk_start < PAK_CHUNK_SIZE ? file->size - chunk_start : PAK_CHUNK_SIZE;
+
+        u8* src = decompression->compressed + (offsets[i] - offsets[0]);
+        u64 src_size = offsets[i + 1] - offsets[i];
+        u8* dst = decompression->memory + chunk_start;
+
+        if (src_size == chunk_size) {
+            memcpy(dst, src, chunk_size);
+        }
+        else if (!lz4_decompress(dst, chunk_size, src, src_size)) {
+            atomic_increment(&decompression->num_failed);
+        }
+    }
+}
+
+bool pak_read(Pak* pak, Arena* arena, char* path, ReadFileResult* result) {
+    PakFileEntry* file = find_pak_file(pak, path);
+    if (!file) {
+        return false;
+    }
+
+    char* memory = (char*)arena_push(arena, file->size + 1);
+    memory[file->size] = '\0';
+
+    if (file->num_chunks > 0) {
+        u32 end_chunk = file->first_chunk + file->num_chunks;
+
+        // Starting it before the read lets the OS queue the reads ahead behind this one.
+        atomic_store(&pak->read_ahead_begin, end_chunk);
+        atomic_store(&pak->read_ahead_end, pak->num_chunks - end_chunk < PAK_READ_AHEAD_CHUNKS ? pak->num_chunks : end_chunk + PAK_READ_AHEAD_CHUNKS);
+        semaphore_signal(pak->read_ahead_wake, 1);
+
+        u64 offset = pak->chunk_offsets[file->first_chunk];
+        u64 compressed_size = pak->chunk_offsets[end_chunk] - offset;
+
+        // A file none of whose chunks compressed is read straight into place.
+        bool stored = compressed_size == file->size;
+
+        Scratch scratch = get_scratch(&arena, 1);
+        u8* compressed = stored ? (u8*)memory : (u8*)arena_push(scratch.arena, compressed_size);
+
+        if (!file_read(pak->file, offset, compressed, compressed_size)) {
+            system_message_box("Failed to read '%s' from a pak", path);
+            assert(false);
+        }
+
+        if (!stored) {
+            PakDecompression decompression = {};
+            decompression.pak = pak;
+            decompression.file = file;
+            decompression.compressed = compressed;
+            decompression.memory = (u8*)memory;
+
+            if (atomic_increment(&pak->queue_claims) == 1) {
+                work_queue_parallel_for(pak->queue, decompress_pak_chunks, &decompression, file->num_chunks, 1);
+                atomic_store(&pak->queue_claims, 0);
+            }
+            else {
+                decompress_pak_chunks(&decompression, 0, file->num_chunks);
+            }
+
+            if (decompression.num_failed > 0) {
+                system_message_box("Corrupt data for '%s' in a pak", path);
+                assert(false);
+            }
+        }
+
+        release_scratch(scratch);
+    }
+
+    result->memory = memory;
+    result->size = file->size;
+
+    return true;
+}
+
+internal int compare_pak_files(const void* a, const void* b) {
+    u64 hash_a = ((PakFileEntry*)a)->path_hash;
+    u64 hash_b = ((PakFileEntry*)b)->path_hash;
+    return hash_a < hash_b ? -1 : hash_a > hash_b;
+}
+
+void pak_build(char* pak_path, u32 num_files, char** paths) {
+    Scratch scratch = get_scratch(0, 0);
+
+    File* files = arena_push_array(scratch.arena, File, num_files);
+    char** entry_paths = arena_push_array(scratch.arena, char*, num_files);
+    char** normalized_paths = arena_push_array(scratch.arena, char*, num_files);
+    PakFileEntry* entries = arena_push_array(scratch.arena, PakFileEntry, num_files);
+    HashMap* packed = hash_map_new(scratch.arena, num_files);
+
+    u32 num_entries = 0;
+    u32 num_chunks = 0;
+    u64 data_bound = 0;
+    u64 max_file_size = 0;
+    u64 paths_size = 0;
+
+    for (u32 i = 0; i < num_files; ++i) {
+        char normalized[PAK_MAX_PATH];
+        u32 len = pak_normalize_path(paths[i], normalized);
+        u64 path_hash = pak_path_hash(normalized, len);
+
+        // The same file named twice is packed once. Two files with the same hash would make one unreadable.
+        u64 existing;
+        if (hash_map_get(packed, path_hash, &existing)) {
+            PakFileEntry* other = &entries[existing];
+
+            if (other->path_len == len && memcmp(normalized_paths[existing], normalized, len) == 0) {
+                continue;
+            }
+
+            system_message_box("Can't pack both '%s' and '%s': their paths hash the same. Rename one of them.", entry_paths[existing], paths[i]);
+            assert(false);
+        }
+        hash_map_put(packed, path_hash, num_entries);
+
+        File file = file_open(paths[i]);
+        if (!file.handle) {
+            system_message_box("Missing file: '%s'", paths[i]);
+            assert(false);
+        }
+
+        PakFileEntry* entry = &entries[num_entries];
+        entry->path_hash = path_hash;
+        entry->size = file_size(file);
+        entry->first_chunk = num_chunks;
+        entry->num_chunks = (u32)((entry->size + PAK_CHUNK_SIZE - 1) / PAK_CHUNK_SIZE);
+        entry->path_offset = (u32)paths_size;
+        entry->path_len = len;
+
+        files[num_entries] = file;
+        entry_paths[num_entries] = paths[i];
+        normalized_paths[num_entries] = (char*)arena_push(scratch.arena, len);
+        memcpy(normalized_paths[num_entries], normalized, len);
+        ++num_entries;
+
+        paths_size += len;
+        assert(paths_size <= UINT32_MAX);
+
+        num_chunks += entry->num_chunks;
+        data_bound += entry->num_chunks * lz4_compress_bound(PAK_CHUNK_SIZE);
+
+        if (entry->size > max_file_size) {
+            max_file_size = entry->size;
+        }
+    }
+
+    u64 toc_size = num_entries * sizeof(PakFileEntry) + (num_chunks + 1) * sizeof(u64) + paths_size;
+    u64 pak_bound = sizeof(PakHeader) + data_bound + toc_size;
+
+    u8* pak_memory = (u8*)page_alloc(pak_bound);
+    u8* file_memory = (u8*)arena_push(scratch.arena, max_file_size);
+    u64* chunk_offsets = arena_push_array(scratch.arena, u64, num_chunks + 1);
+
+    u64 cursor = sizeof(PakHeader);
+    u64 uncompressed_size = 0;
+
+    for (u32 i = 0; i < num_entries; ++i) {
+        PakFileEntry* entry = &entries[i];
+
+        if (!file_read(files[i], 0, file_memory, entry->size)) {
+            system_message_box("Failed to read '%s'", entry_paths[i]);
+            assert(false);
+        }
+        file_close(files[i]);
+
+        for (u32 j = 0; j < entry->num_chunks; ++j) {
+            u64 chunk_start = (u64)j * PAK_CHUNK_SIZE;
+            u64 chunk_size = entry->size - chunk_start < PAK_CHUNK_SIZE ? entry->size - chunk_start : PAK_CHUNK_SIZE;
+
+            u8* dst = pak_memory + cursor;
+            u64 compressed_size = lz4_compress(dst, pak_bound - cursor, file_memory + chunk_start, chunk_size);
+
+            // Data LZ4 can't shrink is stored, which is what a chunk as large as its data means.
+            if (compressed_size == 0 || compressed_size >= chunk_size) {
+                memcpy(dst, file_memory + chunk_start, chunk_size);
+                compressed_size = chunk_size;
+            }
+
+            chunk_offsets[entry->first_chunk + j] = cursor;
+            cursor += compressed_size;
+        }
+
+        uncompressed_size += entry->size;
+    }
+
+    chunk_offsets[num_chunks] = cursor;
+
+    PakHeader* header = (PakHeader*)pak_memory;
+    header->magic = PAK_MAGIC;
+    header->version = PAK_VERSION;
+    header->num_files = num_entries;
+    header->num_chunks = num_chunks;
+    header->toc_offset = cursor;
+    header->paths_size = paths_size;
+
+    // Entries find their paths by offset, so the paths are laid out before the entries are sorted.
+    char* path_table = (char*)pak_memory + cursor + num_entries * sizeof(PakFileEntry) + (num_chunks + 1) * sizeof(u64);
+    for (u32 i = 0; i < num_entries; ++i) {
+        memcpy(path_table + entries[i].path_offset, normalized_paths[i], entries[i].path_len);
+    }
+
+    qsort(entries, num_entries, sizeof(PakFileEntry), compare_pak_files);
+
+    memcpy(pak_memory + cursor, entries, num_entries * sizeof(PakFileEntry));
+    cursor += num_entries * sizeof(PakFileEntry);
+
+    memcpy(pak_memory + cursor, chunk_offsets, (num_chunks + 1) * sizeof(u64));
+    cursor += (num_chunks + 1) * sizeof(u64);
+    cursor += paths_size;
+
+    write_file(pak_path, pak_memory, cursor);
+
+    debug_message("Built pak '%s': %u files, %.1f MB compressed to %.1f MB.\n", pak_path, num_entries,
+        uncompressed_size / (1024.0f * 1024.0f), header->toc_offset / (1024.0f * 1024.0f));
+
+    page_free(pak_memory);
+    release_scratch(scratch);
+}
+
+// Virtual file system
+
+struct VFSRecording {
+    Semaphore lock;
+    Arena arena; // A page allocation of its own, since reads are recorded from whichever thread makes them
+    u32 capacity;
+    u32 num_paths;
+    char** paths;
+    HashMap* recorded;
+};
+
+global_var Pak* vfs_paks[VFS_MAX_PAKS];
+global_var u32 vfs_num_paks;
+global_var VFSRecording* vfs_recording;
+
+void vfs_mount(Pak* pak) {
+    assert(vfs_num_paks < VFS_MAX_PAKS);
+    vfs_paks[vfs_num_paks++] = pak;
+}
+
+void vfs_unmount(Pak* pak) {
+    for (u32 i = 0; i < vfs_num_paks; ++i) {
+        if (vfs_paks[i] == pak) {
+            memmove(&vfs_paks[i], &vfs_paks[i + 1], (vfs_num_paks - i - 1) * sizeof(Pak*));
+            --vfs_num_paks;
+            return;
+        }
+    }
+
+    assert(false && "Pak isn't mounted");
+}
+
+internal void record_vfs_read(VFSRecording* recording, char* path) {
+    char normalized[PAK_MAX_PATH];
+    u32 len = pak_normalize_path(path, normalized);
+    u64 path_hash = pak_path_hash(normalized, len);
+
+    semaphore_wait(recording->lock);
+
+    u64 existing;
+    bool hashed = hash_map_get(recording->recorded, path_hash, &existing);
+    bool recorded = false;
+
+    // Another path with the same hash is recorded too, so pak_build reports the two.
+    if (hashed) {
+        char other[PAK_MAX_PATH];
+        u32 other_len = pak_normalize_path(recording->paths[existing], other);
+        recorded = other_len == len && memcmp(other, normalized, len) == 0;
+    }
+
+    if (!recorded) {
+        assert(recording->num_paths < recording->capacity);
+        if (!hashed) {
+            hash_map_put(recording->recorded, path_hash, recording->num_paths);
+        }
+
+        u64 size = strlen(path) + 1;
+        assert(size <= (u64)(recording->arena.end - recording->arena.cursor) && "Recorded paths are longer than VFS_RECORDING_PATH_SIZE on average");
+        char* copy = (char*)arena_push(&recording->arena, size);
+        memcpy(copy, path, size);
+
+        recording->paths[recording->num_paths++] = copy;
+    }
+
+    semaphore_signal(recording->lock, 1);
+}
+
+bool vfs_read(Arena* arena, char* path, ReadFileResult* result) {
+    for (u32 i = vfs_num_paks; i--; ) {
+        if (pak_read(vfs_paks[i], arena, path, result)) {
+            return true;
+        }
+    }
+
+    if (vfs_recording) {
+        record_vfs_read(vfs_recording, path);
+    }
+
+    return false;
+}
+
+void vfs_begin_recording(u32 capacity) {
+    assert(!vfs_recording);
+
+    // The hash map holds at most four keys and values per path, past its minimum size; the rest covers that and
+    // rounding.
+    u64 arena_size = (u64)capacity * (sizeof(char*) + 8 * sizeof(u64) + VFS_RECORDING_PATH_SIZE) + 4096;
+    Arena arena = arena_init(page_alloc(arena_size), arena_size);
+
+    VFSRecording* recording = arena_push_struct_zero(&arena, VFSRecording);
+    recording->lock = semaphore_create(1);
+    recording->capacity = capacity;
+    recording->paths = arena_push_array(&arena, char*, capacity);
+    recording->recorded = hash_map_new(&arena, capacity);
+    recording->arena = arena;
+
+    vfs_recording = recording;
+}
+
+u32 vfs_end_recording(Arena* arena, char*** paths) {
+    VFSRecording* recording = vfs_recording;
+    assert(recording);
+
+    vfs_recording = 0;
+    semaphore_destroy(recording->lock);
+
+    u32 num_paths = recording->num_paths;
+    *paths = arena_push_array(arena, char*, num_paths);
+
+    for (u32 i = 0; i < num_paths; ++i) {
+        u64 size = strlen(recording->paths[i]) + 1;
+        (*paths)[i] = (char*)arena_push(arena, size);
+        memcpy((*paths)[i], recording->paths[i], size);
+    }
+
+    page_free(recording->arena.base);
+
+    return num_paths;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "common.h"
+
+// Pak archives pack many files into one, so reading them costs one open for the whole pak instead of an open,
+// read and close per file. Each file is cut into PAK_CHUNK_SIZE chunks compressed on their own with LZ4 (or
+// stored, where that doesn't make them smaller), so a file's chunks decompress in parallel. The table of contents
+// holds the files' paths and their 64-bit hashes, sorted by hash for binary search. A lookup compares the path as
+// well, so a path that only shares a hash with a packed file isn't found.
+//
+// Files are stored in the order they were packed. While files are read, a thread reads ahead of the last one into
+// the OS's file cache, so files packed in the order they're loaded are already in memory when they're asked for.
+//
+// Paths are normalized before they're hashed, the way Windows resolves them: either separator, any case, and
+// "." and ".." segments name the same file.
+
+#define PAK_CHUNK_SIZE (64 * 1024)
+#define PAK_MAX_PATH 1024
+
+// How many chunks past the last file read the read-ahead thread reads.
+#define PAK_READ_AHEAD_CHUNKS 256
+
+struct Pak;
+
+// Returns null if the file doesn't exist, isn't a pak or has a corrupt table of contents. Chunks are decompressed
+// by num_threads threads of the pak's own, along with the thread reading.
+Pak* pak_open(Arena* arena, char* path, u32 num_threads);
+void pak_close(Pak* pak);
+
+bool pak_contains(Pak* pak, char* path);
+
+// Writes path the way pak_build stores it, null-terminated: lowercase, '/' separators and no "." or ".." segments
+// that can be resolved. normalized needs PAK_MAX_PATH bytes. Returns its length.
+u32 pak_normalize_path(char* path, char* normalized);
+
+// Reads the whole file into arena, null-terminated like read_file. Returns false if the pak doesn't hold it.
+// Safe to call from several threads at once.
+bool pak_read(Pak* pak, Arena* arena, char* path, ReadFileResult* result);
+
+// Packs the loose files into a pak at pak_path, in the order given. A path given twice is packed once. Two paths
+// whose hashes collide stop the build with an error; renaming either file fixes it.
+void pak_build(char* pak_path, u32 num_files, char** paths);
+
+// The virtual file system under read_file: mounted paks are searched, most recently mounted first, before loose
+// files. Mount and unmount while nothing is being read.
+void vfs_mount(Pak* pak);
+void vfs_unmount(Pak* pak);
+
+// Returns false if no mounted pak holds the file.
+bool vfs_read(Arena* arena, char* path, ReadFileResult* result);
+
+// Records the paths of the files read from now on that no mounted pak holds, in the order they're first read, to
+// build a pak from. The recording keeps them in memory of its own until it ends, then copies them into arena. End
+// recording while nothing is being read.
+void vfs_begin_recording(u32 capacity);
+u32 vfs_end_recording(Arena* arena, char*** paths);
@@ -0,0 +1,103 @@
+#include "work_queue.h"
+
+struct WorkQueue {
+    u32 num_threads;
+    Thread* threads;
+    Semaphore wake;
+    Semaphore done;
+    volatile u32 quit;
+
+    WorkProc* proc;
+    void* data;
+    u32 count;
+    u32 chunk_size;
+    u32 num_chunks;
+    volatile u32 next_chunk;
+};
+
+internal void run_work_chunks(WorkQueue* queue) {
+    while (true) {
+        u32 chunk = atomic_increment(&queue->next_chunk) - 1;
+        if (chunk >= queue->num_chunks) {
+            break;
+        }
+
+        u32 begin = chunk * queue->chunk_size;
+        u32 end = queue->count - begin < queue->chunk_size ? queue->count : begin + queue->chunk_size;
+
+        queue->proc(queue->data, begin, end);
+    }
+}
+
+internal void work_queue_thread_proc(void* data) {
+    WorkQueue* queue = (WorkQueue*)data;
+
+    while (true) {
+        semaphore_wait(queue->wake);
+
+        if (atomic_load(&queue->quit)) {
+            break;
+        }
+
+        run_work_chunks(queue);
+        semaphore_signal(queue->done, 1);
+    }
+}
+
+WorkQueue* work_queue_new(Arena* arena, u32 num_threads, u64 scratch_size) {
+    WorkQueue* queue = arena_push_struct_zero(arena, WorkQueue);
+
+    queue->num_threads = num_threads;
+    queue->threads = arena_push_array(arena, Thread, num_threads);
+    queue->wake = semaphore_create(0);
+    queue->done = semaphore_create(0);
+
+    for (u32 i = 0; i < num_threads; ++i) {
+        queue->threads[i] = thread_start(arena, work_queue_thread_proc, queue, scratch_size);
+    }
+
+    return queue;
+}
+
+void work_queue_destroy(WorkQueue* queue) {
+    atomic_store(&queue->quit, 1);
+    semaphore_signal(queue->wake, queue->num_threads);
+
+    for (u32 i = 0; i < queue->num_threads; ++i) {
+        thread_join(queue->threads[i]);
+    }
+
+    semaphore_destroy(queue->wake);
+    semaphore_destroy(queue->done);
+}
+
+void work_queue_parallel_for(WorkQueue* queue, WorkProc* proc, void* data, u32 count, u32 chunk_size) {
+    assert(chunk_size > 0);
+
+    if (count == 0) {
+        return;
+    }
+
+    if (!queue || queue->num_threads == 0 || count <= chunk_size) {
+        proc(data, 0, count);
+        return;
+    }
+
+    queue->proc = proc;
+    queue->data = data;
+    queue->count = count;
+    queue->chunk_size = chunk_size;
+    queue->num_chunks = (count + chunk_size - 1) / chunk_size;
+    atomic_store(&queue->next_chunk, 0);
+
+    // Only as many workers as there are chunks beyond the caller's first are woken. Each signals once it runs
+    // out of chunks, so no worker is still reading this loop when the next one is set up.
+    u32 num_woken = queue->num_chunks - 1 < queue->num_threads ? queue->num_chunks - 1 : queue->num_threads;
+    semaphore_signal(queue->wake, num_woken);
+
+    run_work_chunks(queue);
+
+    for (u32 i = 0; i < num_woken; ++i) {
+        semaphore_wait(queue->done);
+    }
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include "common.h"
+
+// Persistent worker threads for data-parallel loops. A loop is cut into fixed-size chunks that the workers and
+// the calling thread claim in order, and the call returns once every chunk has run. Loops are issued from one
+// thread at a time.
+
+typedef void WorkProc(void* data, u32 begin, u32 end);
+
+struct WorkQueue;
+
+WorkQueue* work_queue_new(Arena* arena, u32 num_threads, u64 scratch_size);
+void work_queue_destroy(WorkQueue* queue);
+
+// Calls proc over [0, count) in chunks of chunk_size. Runs inline when the queue is null or there is only one chunk.
+void work_queue_parallel_for(WorkQueue* queue, WorkProc* proc, void* data, u32 count, u32 chunk_size);
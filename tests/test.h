@@ -0,0 +1,12 @@
+#pragma once
+
+#include "common.h"
+
+// Unlike assert, checks stay on in Release so the tests can run optimized. A failed check is reported and the test
+// carries on.
+#define TEST_CHECK(condition) test_check((condition), #condition, __FILE__, __LINE__)
+
+void test_check(bool passed, char* condition, char* file, int line);
+
+// Each test gets an arena that's cleared before the next one runs.
+typedef void TestProc(Arena* arena);
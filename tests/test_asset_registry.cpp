@@ -0,0 +1,141 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "test.h"
+#include "renderer/asset_registry.h"
+
+#define TEST_REGISTRY_MESHES 2
+
+// Two triangles, each with a mesh of its own and the default material, the first placed at x. The second is wound
+// the other way, so the loader doesn't deduplicate it into the first. The buffer is a file of its own.
+internal void write_test_registry_scene(f32 x) {
+    f32 vertices[] = {
+        0.0f, 0.0f, 0.0f,  1.0f, 0.0f, 0.0f,  0.0f, 0.0f, 1.0f, // Positions
+        0.0f, 1.0f, 0.0f,  0.0f, 1.0f, 0.0f,  0.0f, 1.0f, 0.0f, // Normals
+        0.0f, 0.0f,  1.0f, 0.0f,  0.0f, 1.0f, // UVs
+    };
+    u32 indices[] = { 0, 1, 2,  0, 2, 1 };
+
+    u8 buffer[sizeof(vertices) + sizeof(indices)];
+    memcpy(buffer, vertices, sizeof(vertices));
+    memcpy(buffer + sizeof(vertices), indices, sizeof(indices));
+    write_file("test_registry.bin", buffer, sizeof(buffer));
+
+    char json[4 * 1024];
+    int len = snprintf(json, sizeof(json),
+        "{\"asset\":{\"version\":\"2.0\"},\"buffers\":[{\"uri\":\"test_registry.bin\",\"byteLength\":%u}],"
+        "\"bufferViews\":[{\"buffer\":0,\"byteLength\":36},{\"buffer\":0,\"byteOffset\":36,\"byteLength\":36},"
+        "{\"buffer\":0,\"byteOffset\":72,\"byteLength\":24},{\"buffer\":0,\"byteOffset\":96,\"byteLength\":24}],"
+        "\"accessors\":[{\"bufferView\":0,\"componentType\":5126,\"count\":3,\"type\":\"VEC3\",\"min\":[0,0,0],\"max\":[1,0,1]},"
+        "{\"bufferView\":1,\"componentType\":5126,\"count\":3,\"type\":\"VEC3\"},"
+        "{\"bufferView\":2,\"componentType\":5126,\"count\":3,\"type\":\"VEC2\"},"
+        "{\"bufferView\":3,\"componentType\":5125,\"count\":3,\"type\":\"SCALAR\"},"
+        "{\"bufferView\":3,\"byteOffset\":12,\"componentType\":5125,\"count\":3,\"type\":\"SCALAR\"}],"
+        "\"meshes\":[{\"primitives\":[{\"attributes\":{\"POSITION\":0,\"NORMAL\":1,\"TEXCOORD_0\":2},\"indices\":3}]},"
+        "{\"primitives\":[{\"attributes\":{\"POSITION\":0,\"NORMAL\":1,\"TEXCOORD_0\":2},\"indices\":4}]}],"
+        "\"nodes\":[{\"mesh\":0,\"translation\":[%.1f,0,0]},{\"mesh\":1}],\"scenes\":[{\"nodes\":[0,1]}]}",
+        (u32)sizeof(buffer), x);
+
+    assert(len < (int)sizeof(json));
+    write_file("test_registry.gltf", json, len);
+}
+
+internal void remove_test_registry_scene() {
+    remove("test_registry.gltf");
+    remove("test_registry.bin");
+}
+
+internal SceneAsset load_test_registry_scene(Arena* arena, Renderer* renderer, AssetRegistry* registry, char* path) {
+    GLTFLoadOptions options = gltf_default_load_options();
+    options.build_meshlets = true;
+
+    RendererUploadContext* context = renderer_open_upload_context(arena, renderer);
+    SceneAsset scene = asset_registry_load_scene(registry, context, &options, path);
+    renderer_submit_upload_context(arena, renderer, context);
+
+    return scene;
+}
+
+// Acquiring a loaded scene again, under another spelling of its path, shares it without uploading anything. Once
+// its document changes, acquiring it loads it again and the old scene stays with its holders.
+void test_asset_registry_reacquire(Arena* arena) {
+    write_test_registry_scene(0.0f);
+
+    Renderer* renderer = renderer_init(arena, 0);
+    AssetRegistry* registry = asset_registry_new(arena, renderer, 16);
+
+    SceneAsset scene = load_test_registry_scene(arena, renderer, registry, "test_registry.gltf");
+    TEST_CHECK(asset_registry_scene_loaded(registry, scene));
+    TEST_CHECK(asset_registry_scene(registry, scene)->num_meshes == TEST_REGISTRY_MESHES);
+
+    RendererUploadStats uploads = renderer_upload_stats(renderer);
+
+    SceneAsset same = load_test_registry_scene(arena, renderer, registry, "./test_registry.gltf");
+    TEST_CHECK(same.handle == scene.handle);
+
+    GLTFLoadOptions options = gltf_default_load_options();
+    SceneAsset acquired = asset_registry_acquire_scene(registry, &options, "test_registry.gltf");
+    TEST_CHECK(acquired.handle == scene.handle);
+    TEST_CHECK(asset_registry_scene_loaded(registry, acquired));
+
+    RendererUploadStats uploads_after = renderer_upload_stats(renderer);
+    TEST_CHECK(uploads_after.bytes_copied == uploads.bytes_copied);
+    TEST_CHECK(uploads_after.bytes_in_place == uploads.bytes_in_place);
+    TEST_CHECK(asset_registry_num_scenes(registry) == 1);
+    TEST_CHECK(asset_registry_num_meshes(registry) == TEST_REGISTRY_MESHES);
+
+    write_test_registry_scene(2.0f);
+
+    SceneAsset changed = load_test_registry_scene(arena, renderer, registry, "test_registry.gltf");
+    TEST_CHECK(changed.handle != scene.handle);
+    TEST_CHECK(asset_registry_num_scenes(registry) == 2);
+    TEST_CHECK(asset_registry_scene(registry, scene)->num_meshes == TEST_REGISTRY_MESHES);
+
+    asset_registry_release_scene(registry, scene);
+    asset_registry_release_scene(registry, same);
+    asset_registry_release_scene(registry, acquired);
+    asset_registry_release_scene(registry, changed);
+    asset_registry_collect(registry);
+
+    TEST_CHECK(asset_registry_num_scenes(registry) == 0);
+    TEST_CHECK(asset_registry_num_meshes(registry) == 0);
+
+    renderer_release_backend(renderer);
+    remove_test_registry_scene();
+}
+
+// A collect frees the released scene and the meshes nothing else holds, and keeps a mesh with a reference of its
+// own until that's released too.
+void test_asset_registry_collect(Arena* arena) {
+    write_test_registry_scene(0.0f);
+
+    Renderer* renderer = renderer_init(arena, 0);
+    AssetRegistry* registry = asset_registry_new(arena, renderer, 16);
+
+    SceneAsset scene = load_test_registry_scene(arena, renderer, registry, "test_registry.gltf");
+    LoadGLTFResult* result = asset_registry_scene(registry, scene);
+    TEST_CHECK(result->num_meshes == TEST_REGISTRY_MESHES);
+
+    Mesh kept = result->meshes[0];
+    Mesh freed = result->meshes[1];
+    asset_registry_add_mesh_ref(registry, kept);
+
+    // Nothing is dropped until the collect.
+    asset_registry_release_scene(registry, scene);
+    TEST_CHECK(asset_registry_num_scenes(registry) == 1);
+    TEST_CHECK(renderer_mesh_alive(renderer, freed));
+
+    TEST_CHECK(asset_registry_collect(registry) == 2);
+    TEST_CHECK(asset_registry_num_scenes(registry) == 0);
+    TEST_CHECK(asset_registry_num_meshes(registry) == 1);
+    TEST_CHECK(renderer_mesh_alive(renderer, kept));
+    TEST_CHECK(!renderer_mesh_alive(renderer, freed));
+
+    asset_registry_release_mesh(registry, kept);
+    TEST_CHECK(asset_registry_collect(registry) == 1);
+    TEST_CHECK(asset_registry_num_meshes(registry) == 0);
+    TEST_CHECK(!renderer_mesh_alive(renderer, kept));
+
+    renderer_release_backend(renderer);
+    remove_test_registry_scene();
+}
@@ -0,0 +1,200 @@
+#include <float.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "test.h"
+#include "utility/base64.h"
+
+internal u32 next_random(u32* state) {
+    u32 x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+global_var char base64_alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+// Encodes with optional line wrapping and padding. Returns the encoded length; dst must hold 2x size + 4.
+internal u64 base64_encode(char* dst, u8* src, u64 size, u32 line_length, bool pad) {
+    char* out = dst;
+    u32 column = 0;
+
+    for (u64 i = 0; i < size; i += 3) {
+        u64 remaining = size - i;
+        u32 bits = (u32)src[i] << 16;
+        if (remaining > 1) {
+            bits |= (u32)src[i + 1] << 8;
+        }
+        if (remaining > 2) {
+            bits |= src[i + 2];
+        }
+
+        u32 count = remaining > 2 ? 4 : (u32)remaining + 1;
+
+        for (u32 k = 0; k < 4; ++k) {
+            if (k < count) {
+                *out++ = base64_alphabet[(bits >> (18 - k * 6)) & 63];
+            }
+            else if (pad) {
+                *out++ = '=';
+            }
+
+            if (line_length && ++column == line_length) {
+                *out++ = '\r';
+                *out++ = '\n';
+                column = 0;
+            }
+        }
+    }
+
+    return out - dst;
+}
+
+// The straightforward decoder, a character at a time through a table, to measure the SIMD one against. Skips
+// whitespace, stops at padding and doesn't check anything else.
+internal u64 base64_decode_reference(u8* dst, char* src, u64 len) {
+    i8 values[256];
+    memset(values, -1, sizeof(values));
+    for (u32 i = 0; i < 64; ++i) {
+        values[(u8)base64_alphabet[i]] = (i8)i;
+    }
+
+    u8* out = dst;
+    u32 bits = 0;
+    u32 count = 0;
+
+    for (u64 i = 0; i < len && src[i] != '='; ++i) {
+        i8 value = values[(u8)src[i]];
+        if (value < 0) {
+            continue;
+        }
+
+        bits = (bits << 6) | (u32)value;
+
+        if (++count == 4) {
+            out[0] = (u8)(bits >> 16);
+            out[1] = (u8)(bits >> 8);
+            out[2] = (u8)bits;
+            out += 3;
+            bits = 0;
+            count = 0;
+        }
+    }
+
+    if (count > 1) {
+        bits <<= (4 - count) * 6;
+        out[0] = (u8)(bits >> 16);
+        if (count == 3) {
+            out[1] = (u8)(bits >> 8);
+        }
+        out += count - 1;
+    }
+
+    return out - dst;
+}
+
+internal bool decodes_to(char* encoded, u64 encoded_len, u8* expected, u64 size, u8* decoded, u64 capacity) {
+    u64 decoded_size;
+    if (!base64_decode(decoded, capacity, encoded, encoded_len, &decoded_size)) {
+        return false;
+    }
+    return decoded_size == size && memcmp(decoded, expected, size) == 0;
+}
+
+void test_base64_round_trip(Arena* arena) {
+    u32 random = 0x9E3779B9;
+
+    u64 max_size = 4096;
+    u8* data = arena_push_array(arena, u8, max_size);
+    char* encoded = arena_push_array(arena, char, max_size * 2 + 4);
+    u8* decoded = arena_push_array(arena, u8, max_size + 16);
+
+    for (u32 trial = 0; trial < 2000; ++trial) {
+        u64 size = trial < 64 ? trial : next_random(&random) % max_size;
+        for (u64 i = 0; i < size; ++i) {
+            data[i] = (u8)next_random(&random);
+        }
+
+        u32 line_length = trial % 3 == 0 ? 76 : 0;
+        bool pad = trial % 2 == 0;
+        u64 len = base64_encode(encoded, data, size, line_length, pad);
+
+        // Exactly enough room, so the fast path's 16-byte stores have to stop short of the end.
+        TEST_CHECK(decodes_to(encoded, len, data, size, decoded, size));
+        TEST_CHECK(base64_decoded_size_bound(len) >= size);
+
+        if (size > 0) {
+            TEST_CHECK(!decodes_to(encoded, len, data, size, decoded, size - 1));
+        }
+
+        if (len > 8) {
+            // Spaces anywhere are skipped.
+            u64 at = next_random(&random) % len;
+            memmove(encoded + at + 1, encoded + at, len - at);
+            encoded[at] = ' ';
+            TEST_CHECK(decodes_to(encoded, len + 1, data, size, decoded, size));
+
+            // A character outside the alphabet isn't.
+            encoded[at] = '*';
+            TEST_CHECK(!decodes_to(encoded, len + 1, data, size, decoded, size));
+        }
+    }
+
+    // One character can't encode a whole byte, and padding can't be followed by more data.
+    TEST_CHECK(!decodes_to("QUJDR", 5, (u8*)"ABC", 3, decoded, 16));
+    TEST_CHECK(!decodes_to("QQ==QUJD", 8, (u8*)"A", 1, decoded, 16));
+    TEST_CHECK(decodes_to("QQ==", 4, (u8*)"A", 1, decoded, 16));
+    TEST_CHECK(decodes_to("QUI", 3, (u8*)"AB", 2, decoded, 16));
+}
+
+internal void bench_base64_case(char* name, char* encoded, u64 len, u8* decoded, u64 capacity) {
+    f32 best = FLT_MAX;
+    f32 best_reference = FLT_MAX;
+
+    for (u32 run = 0; run < 5; ++run) {
+        f32 start = engine_time();
+        u64 decoded_size;
+        bool valid = base64_decode(decoded, capacity, encoded, len, &decoded_size);
+        f32 seconds = engine_time() - start;
+
+        TEST_CHECK(valid);
+        best = seconds < best ? seconds : best;
+
+        start = engine_time();
+        u64 reference_size = base64_decode_reference(decoded, encoded, len);
+        seconds = engine_time() - start;
+
+        TEST_CHECK(reference_size == decoded_size);
+        best_reference = seconds < best_reference ? seconds : best_reference;
+    }
+
+    printf("  %s: %.2f GB/s of input, scalar %.2f GB/s (%.1fx)\n", name, (f64)len / best / 1e9, (f64)len / best_reference / 1e9, best_reference / best);
+}
+
+// The reference decodes last in every run, so the checks after each case hold it to the data too.
+void bench_base64_decode(Arena* arena) {
+    u64 size = 192 * 1024 * 1024;
+    u8* data = arena_push_array(arena, u8, size);
+
+    u32 random = 0x12345678;
+    for (u64 i = 0; i < size; i += 4) {
+        u32 value = next_random(&random);
+        memcpy(data + i, &value, 4);
+    }
+
+    char* encoded = (char*)page_alloc(size * 2 + 4);
+    u8* decoded = (u8*)page_alloc(size);
+
+    u64 len = base64_encode(encoded, data, size, 0, true);
+    bench_base64_case("unwrapped", encoded, len, decoded, size);
+    TEST_CHECK(memcmp(decoded, data, size) == 0);
+
+    len = base64_encode(encoded, data, size, 76, true);
+    bench_base64_case("76 columns, CRLF", encoded, len, decoded, size);
+    TEST_CHECK(memcmp(decoded, data, size) == 0);
+
+    page_free(decoded);
+    page_free(encoded);
+}
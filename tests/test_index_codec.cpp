@@ -0,0 +1,133 @@
+#include <float.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "test.h"
+#include "test_meshes.h"
+#include "renderer/index_codec.h"
+#include "renderer/mesh_optimizer.h"
+
+#define INDEX_SENTINEL 0xA5A5A5A5u
+
+internal u32 next_index_random(u32* state) {
+    u32 x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+// Decodes to both widths and checks neither writes past the last index.
+internal bool round_trips(Arena* arena, u32* indices, u32 index_count) {
+    Scratch scratch = get_scratch(&arena, 1);
+
+    IndexStream stream = encode_index_stream(scratch.arena, indices, index_count);
+    bool matches = stream.index_count == index_count && stream.size <= index_stream_bound(index_count);
+
+    u32* decoded = arena_push_array(scratch.arena, u32, index_count + 4);
+    for (u32 i = 0; i < index_count + 4; ++i) {
+        decoded[i] = INDEX_SENTINEL;
+    }
+
+    decode_index_stream(&stream, decoded);
+    matches &= memcmp(decoded, indices, index_count * sizeof(u32)) == 0;
+    matches &= decoded[index_count] == INDEX_SENTINEL;
+
+    u32 max_index = 0;
+    for (u32 i = 0; i < index_count; ++i) {
+        max_index = indices[i] > max_index ? indices[i] : max_index;
+    }
+
+    if (max_index <= UINT16_MAX) {
+        u16* decoded16 = arena_push_array(scratch.arena, u16, index_count + 8);
+        memset(decoded16, 0xA5, (index_count + 8) * sizeof(u16));
+
+        decode_index_stream_u16(&stream, decoded16);
+
+        for (u32 i = 0; i < index_count; ++i) {
+            matches &= decoded16[i] == indices[i];
+        }
+        matches &= decoded16[index_count] == 0xA5A5;
+    }
+
+    release_scratch(scratch);
+
+    return matches;
+}
+
+// Every length of a partial last group, deltas of every byte length in both directions, and a cache-optimized mesh,
+// the input streams are made for.
+void test_index_codec_round_trip(Arena* arena) {
+    u32 random = 0x2545F491;
+
+    u32* indices = arena_push_array(arena, u32, 4096);
+
+    for (u32 count = 0; count <= 9; ++count) {
+        for (u32 i = 0; i < count; ++i) {
+            indices[i] = next_index_random(&random) % 70000;
+        }
+        TEST_CHECK(round_trips(arena, indices, count));
+    }
+
+    for (u32 bits = 0; bits <= 32; bits += 4) {
+        for (u32 i = 0; i < 4096; ++i) {
+            u32 mask = bits == 32 ? UINT32_MAX : (1u << bits) - 1;
+            indices[i] = next_index_random(&random) & mask;
+        }
+        TEST_CHECK(round_trips(arena, indices, 4096));
+    }
+
+    // The largest delta each way.
+    u32 extremes[] = { 0, UINT32_MAX, 0, UINT32_MAX, UINT32_MAX, 0, 1, UINT32_MAX - 1 };
+    TEST_CHECK(round_trips(arena, extremes, ARRAY_LEN(extremes)));
+
+    Vertex* vertices;
+    u32 vertex_count;
+    u32* mesh_indices;
+    u32 index_count;
+    make_sphere(arena, 64, 0.0f, &vertices, &vertex_count, &mesh_indices, &index_count);
+    optimize_vertex_cache(mesh_indices, index_count, vertex_count, VERTEX_CACHE_SIZE);
+
+    TEST_CHECK(round_trips(arena, mesh_indices, index_count));
+
+    // Neighbouring indices in an optimized mesh are close, so most take a byte.
+    IndexStream stream = encode_index_stream(arena, mesh_indices, index_count);
+    TEST_CHECK(stream.size < index_count * 2);
+}
+
+// Decodes a cache-optimized mesh of a few million indices to both widths and reports the rate and the size.
+void bench_index_decode(Arena* arena) {
+    Vertex* vertices;
+    u32 vertex_count;
+    u32* indices;
+    u32 index_count;
+    make_sphere(arena, 1000, 0.0f, &vertices, &vertex_count, &indices, &index_count);
+    optimize_vertex_cache(indices, index_count, vertex_count, VERTEX_CACHE_SIZE);
+
+    IndexStream stream = encode_index_stream(arena, indices, index_count);
+    printf("  %u indices, %.2f bytes per index\n", index_count, (f64)stream.size / index_count);
+
+    u32* decoded = arena_push_array(arena, u32, index_count);
+    u16* decoded16 = arena_push_array(arena, u16, index_count);
+
+    f32 best = FLT_MAX;
+    f32 best16 = FLT_MAX;
+
+    for (u32 run = 0; run < 5; ++run) {
+        f32 start = engine_time();
+        decode_index_stream(&stream, decoded);
+        f32 seconds = engine_time() - start;
+        best = seconds < best ? seconds : best;
+
+        start = engine_time();
+        decode_index_stream_u16(&stream, decoded16);
+        seconds = engine_time() - start;
+        best16 = seconds < best16 ? seconds : best16;
+    }
+
+    TEST_CHECK(memcmp(decoded, indices, index_count * sizeof(u32)) == 0);
+
+    printf("  u32: %.0f M indices/s\n", index_count / best / 1e6);
+    printf("  u16: %.0f M indices/s\n", index_count / best16 / 1e6);
+}
@@ -0,0 +1,134 @@
+#include <float.h>
+#include <math.h>
+
+#include "test.h"
+#include "renderer/mesh_optimizer.h"
+#include "renderer/lod.h"
+#include "test_meshes.h"
+
+// The furthest any of the original vertices is from the simplified surface.
+internal f32 measure_deviation(Vertex* vertices, u32 vertex_count, u32* indices, u32 index_count) {
+    f32 deviation = 0.0f;
+
+    for (u32 i = 0; i < vertex_count; ++i) {
+        XMVECTOR p = XMLoadFloat3(&vertices[i].pos);
+        f32 nearest = FLT_MAX;
+
+        for (u32 j = 0; j < index_count; j += 3) {
+            XMVECTOR a = XMLoadFloat3(&vertices[indices[j + 0]].pos);
+            XMVECTOR b = XMLoadFloat3(&vertices[indices[j + 1]].pos);
+            XMVECTOR c = XMLoadFloat3(&vertices[indices[j + 2]].pos);
+            nearest = fminf(nearest, point_triangle_distance(p, a, b, c));
+        }
+
+        deviation = fmaxf(deviation, nearest);
+    }
+
+    return deviation;
+}
+
+// Slack for the float rounding in both the simplifier's bound and the measurement.
+internal bool within_bound(f32 deviation, f32 bound) {
+    return deviation <= bound * 1.001f + 1e-6f;
+}
+
+// Smooth curvature is where an area-weighted quadric error most underestimates how far the surface moves.
+global_var f32 sphere_bumps[] = { 0.0f, 0.08f };
+
+void test_simplify_error_bound(Arena* arena) {
+    Vertex* vertices;
+    u32 vertex_count;
+    u32* indices;
+    u32 index_count;
+    make_sphere(arena, 32, sphere_bumps[1], &vertices, &vertex_count, &indices, &index_count);
+
+    u32* dst = arena_push_array(arena, u32, index_count);
+
+    f32 max_errors[] = { 0.0f, 0.002f, 0.01f, 0.05f };
+
+    for (u32 i = 0; i < ARRAY_LEN(max_errors); ++i) {
+        f32 error;
+        u32 count = simplify_mesh(dst, indices, index_count, vertices, vertex_count, index_count / 4, max_errors[i], 0.0f, &error);
+
+        TEST_CHECK(count % 3 == 0 && count <= index_count);
+        TEST_CHECK(count == index_count || error > 0.0f);
+        TEST_CHECK(within_bound(measure_deviation(vertices, vertex_count, dst, count), error));
+    }
+}
+
+void test_lod_error_bound(Arena* arena) {
+    f32 attribute_weights[] = { 0.0f, 0.5f };
+
+    for (u32 s = 0; s < ARRAY_LEN(sphere_bumps); ++s)
+    for (u32 w = 0; w < ARRAY_LEN(attribute_weights); ++w) {
+        Vertex* vertices;
+        u32 vertex_count;
+        u32* indices;
+        u32 index_count;
+        make_sphere(arena, 32, sphere_bumps[s], &vertices, &vertex_count, &indices, &index_count);
+
+        u32* dst = arena_push_array(arena, u32, index_count * MAX_MESH_LODS);
+        MeshLOD lods[MAX_MESH_LODS];
+        u32 lod_count = build_mesh_lods(dst, lods, MAX_MESH_LODS, indices, index_count, vertices, vertex_count, attribute_weights[w]);
+
+        TEST_CHECK(lod_count > 2);
+        TEST_CHECK(lods[0].index_count == index_count && lods[0].error == 0.0f);
+
+        for (u32 i = 0; i < lod_count; ++i) {
+            MeshLOD* lod = &lods[i];
+
+            TEST_CHECK(lod->index_offset + lod->index_count <= index_count * MAX_MESH_LODS);
+
+            if (i > 0) {
+                TEST_CHECK(lod->index_count < lods[i - 1].index_count);
+                TEST_CHECK(lod->error >= lods[i - 1].error);
+            }
+
+            f32 deviation = measure_deviation(vertices, vertex_count, dst + lod->index_offset, lod->index_count);
+            TEST_CHECK(within_bound(deviation, lod->error));
+        }
+    }
+}
+
+void test_lod_selection_monotonic(Arena* arena) {
+    UNUSED(arena);
+
+    MeshLOD lods[] = {
+        { 0, 3000, 0.0f },
+        { 0, 1500, 0.001f },
+        { 0, 750, 0.004f },
+        { 0, 375, 0.02f },
+        { 0, 180, 0.1f },
+    };
+    u32 lod_count = ARRAY_LEN(lods);
+
+    f32 max_error_pixels = 1.0f;
+    f32 hysteresis_values[] = { 0.0f, LOD_HYSTERESIS };
+
+    for (u32 h = 0; h < ARRAY_LEN(hysteresis_values); ++h) {
+        f32 hysteresis = hysteresis_values[h];
+
+        // Moving away, the level only ever gets coarser, and never by more error than allowed.
+        u32 current_lod = 0;
+        for (f32 pixels_per_unit = 10000.0f; pixels_per_unit > 1.0f; pixels_per_unit *= 0.97f) {
+            u32 lod = select_mesh_lod(lods, lod_count, current_lod, pixels_per_unit, max_error_pixels, hysteresis);
+
+            TEST_CHECK(lod >= current_lod);
+            TEST_CHECK(lods[lod].error * pixels_per_unit <= max_error_pixels);
+
+            current_lod = lod;
+        }
+        TEST_CHECK(current_lod == lod_count - 1);
+
+        // And coming back, only ever finer.
+        for (f32 pixels_per_unit = 1.0f; pixels_per_unit < 10000.0f; pixels_per_unit *= 1.03f) {
+            u32 lod = select_mesh_lod(lods, lod_count, current_lod, pixels_per_unit, max_error_pixels, hysteresis);
+
+            TEST_CHECK(lod <= current_lod);
+            TEST_CHECK(lods[lod].error * pixels_per_unit <= max_error_pixels);
+
+            current_lod = lod;
+        }
+        TEST_CHECK(current_lod == 0);
+    }
+}
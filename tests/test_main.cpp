@@ -0,0 +1,130 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "test.h"
+
+// Every test and benchmark. Declared here rather than in headers of their own, since nothing else calls them.
+
+void test_simplify_error_bound(Arena* arena);
+void test_lod_error_bound(Arena* arena);
+void test_lod_selection_monotonic(Arena* arena);
+void test_vertex_cache_lowers_acmr(Arena* arena);
+void test_weld_vertices(Arena* arena);
+void test_meshlet_limits(Arena* arena);
+void test_meshlet_coverage(Arena* arena);
+void test_meshlet_culling_conservative(Arena* arena);
+void test_compact_vertex_error(Arena* arena);
+void test_index_codec_round_trip(Arena* arena);
+void bench_index_decode(Arena* arena);
+void test_base64_round_trip(Arena* arena);
+void bench_base64_decode(Arena* arena);
+void test_skinning_avx2_matches_sse(Arena* arena);
+void bench_skinning(Arena* arena);
+void test_residency_lru_eviction(Arena* arena);
+void test_residency_budget(Arena* arena);
+void test_world_streaming(Arena* arena);
+void test_world_shared_upload(Arena* arena);
+void test_texture_streaming_priority(Arena* arena);
+void test_texture_streaming_budget(Arena* arena);
+void test_pak_round_trip(Arena* arena);
+void test_pak_rejects_corrupt_toc(Arena* arena);
+void test_pak_compares_paths(Arena* arena);
+void bench_pak_read(Arena* arena);
+void bench_pak_read_cold(Arena* arena);
+void test_asset_registry_reacquire(Arena* arena);
+void test_asset_registry_collect(Arena* arena);
+
+struct TestCase {
+    char* name;
+    TestProc* proc;
+    bool benchmark; // Only run when asked for with --bench or by name
+};
+
+global_var TestCase tests[] = {
+    { "simplify_error_bound", test_simplify_error_bound, false },
+    { "lod_error_bound", test_lod_error_bound, false },
+    { "lod_selection_monotonic", test_lod_selection_monotonic, false },
+    { "vertex_cache_lowers_acmr", test_vertex_cache_lowers_acmr, false },
+    { "weld_vertices", test_weld_vertices, false },
+    { "meshlet_limits", test_meshlet_limits, false },
+    { "meshlet_coverage", test_meshlet_coverage, false },
+    { "meshlet_culling_conservative", test_meshlet_culling_conservative, false },
+    { "compact_vertex_error", test_compact_vertex_error, false },
+    { "index_codec_round_trip", test_index_codec_round_trip, false },
+    { "index_decode", bench_index_decode, true },
+    { "base64_round_trip", test_base64_round_trip, false },
+    { "base64_decode", bench_base64_decode, true },
+    { "skinning_avx2_matches_sse", test_skinning_avx2_matches_sse, false },
+    { "skinning", bench_skinning, true },
+    { "residency_lru_eviction", test_residency_lru_eviction, false },
+    { "residency_budget", test_residency_budget, false },
+    { "world_streaming", test_world_streaming, false },
+    { "world_shared_upload", test_world_shared_upload, false },
+    { "texture_streaming_priority", test_texture_streaming_priority, false },
+    { "texture_streaming_budget", test_texture_streaming_budget, false },
+    { "pak_round_trip", test_pak_round_trip, false },
+    { "pak_rejects_corrupt_toc", test_pak_rejects_corrupt_toc, false },
+    { "pak_compares_paths", test_pak_compares_paths, false },
+    { "pak_read", bench_pak_read, true },
+    { "pak_read_cold", bench_pak_read_cold, true },
+    { "asset_registry_reacquire", test_asset_registry_reacquire, false },
+    { "asset_registry_collect", test_asset_registry_collect, false },
+};
+
+global_var u32 num_failed_checks;
+
+void test_check(bool passed, char* condition, char* file, int line) {
+    if (!passed) {
+        printf("  %s(%d): check failed: %s\n", file, line, condition);
+        ++num_failed_checks;
+    }
+}
+
+// Runs every test, or only the ones named on the command line. --bench adds the benchmarks.
+int main(int argc, char** argv) {
+    platform_init();
+
+    u64 arena_size = 256 * 1024 * 1024;
+    Arena arena = arena_init(page_alloc(arena_size), arena_size);
+
+    bool run_benchmarks = false;
+    u32 num_names = 0;
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--bench") == 0) {
+            run_benchmarks = true;
+        }
+        else {
+            ++num_names;
+        }
+    }
+
+    u32 num_run = 0;
+    u32 num_failed = 0;
+
+    for (u32 i = 0; i < ARRAY_LEN(tests); ++i) {
+        TestCase* test = &tests[i];
+
+        bool selected = num_names == 0 && (!test->benchmark || run_benchmarks);
+        for (int j = 1; j < argc; ++j) {
+            selected |= strcmp(argv[j], test->name) == 0;
+        }
+
+        if (!selected) {
+            continue;
+        }
+
+        printf("%s\n", test->name);
+
+        u32 failed_before = num_failed_checks;
+        test->proc(&arena);
+        arena_clear(&arena);
+
+        ++num_run;
+        num_failed += num_failed_checks > failed_before;
+    }
+
+    printf("%u of %u passed.\n", num_run - num_failed, num_run);
+
+    return num_failed > 0;
+}
@@ -0,0 +1,181 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "test.h"
+#include "renderer/mesh_optimizer.h"
+
+#define GRID_SIZE 64
+#define WELD_GRID_SIZE 8
+#define WELD_EPSILON 0.001f
+
+// A flat n x n grid of quads, two triangles each, in row order. Rows are wider than the cache, so every row loads
+// the vertices it shares with the previous one again.
+internal void make_grid(Arena* arena, u32 n, Vertex** out_vertices, u32* out_vertex_count, u32** out_indices, u32* out_index_count) {
+    u32 vertex_count = (n + 1) * (n + 1);
+    Vertex* vertices = arena_push_array_zero(arena, Vertex, vertex_count);
+
+    for (u32 y = 0; y <= n; ++y) {
+        for (u32 x = 0; x <= n; ++x) {
+            Vertex* vertex = &vertices[y * (n + 1) + x];
+            vertex->pos = { (f32)x, 0.0f, (f32)y };
+            vertex->norm = { 0.0f, 1.0f, 0.0f };
+            vertex->uv = { (f32)x / n, (f32)y / n };
+        }
+    }
+
+    u32 index_count = n * n * 6;
+    u32* indices = arena_push_array(arena, u32, index_count);
+    u32 cursor = 0;
+
+    for (u32 y = 0; y < n; ++y) {
+        for (u32 x = 0; x < n; ++x) {
+            u32 a = y * (n + 1) + x;
+            u32 b = a + 1;
+            u32 c = a + n + 1;
+            u32 d = c + 1;
+
+            indices[cursor++] = a;
+            indices[cursor++] = c;
+            indices[cursor++] = b;
+            indices[cursor++] = b;
+            indices[cursor++] = c;
+            indices[cursor++] = d;
+        }
+    }
+
+    *out_vertices = vertices;
+    *out_vertex_count = vertex_count;
+    *out_indices = indices;
+    *out_index_count = index_count;
+}
+
+internal int compare_triangles(const void* a, const void* b) {
+    u32* ta = (u32*)a;
+    u32* tb = (u32*)b;
+
+    for (u32 i = 0; i < 3; ++i) {
+        if (ta[i] != tb[i]) {
+            return ta[i] < tb[i] ? -1 : 1;
+        }
+    }
+
+    return 0;
+}
+
+// Rotates each triangle to start at its smallest index, which keeps its winding, then sorts them, so two index
+// buffers drawing the same triangles in any order come out identical.
+internal u32* sorted_triangles(Arena* arena, u32* indices, u32 index_count) {
+    u32* triangles = arena_push_array(arena, u32, index_count);
+
+    for (u32 i = 0; i < index_count; i += 3) {
+        u32 first = 0;
+        for (u32 j = 1; j < 3; ++j) {
+            first = indices[i + j] < indices[i + first] ? j : first;
+        }
+
+        for (u32 j = 0; j < 3; ++j) {
+            triangles[i + j] = indices[i + (first + j) % 3];
+        }
+    }
+
+    qsort(triangles, index_count / 3, 3 * sizeof(u32), compare_triangles);
+
+    return triangles;
+}
+
+// Tipsify lowers ACMR on a grid, whose row order reloads every shared vertex, and draws the same triangles with
+// the same winding.
+void test_vertex_cache_lowers_acmr(Arena* arena) {
+    Vertex* vertices;
+    u32 vertex_count;
+    u32* indices;
+    u32 index_count;
+    make_grid(arena, GRID_SIZE, &vertices, &vertex_count, &indices, &index_count);
+
+    u32* before = sorted_triangles(arena, indices, index_count);
+    VertexCacheStats stats_before = analyze_vertex_cache(indices, index_count, vertex_count, VERTEX_CACHE_SIZE);
+
+    optimize_vertex_cache(indices, index_count, vertex_count, VERTEX_CACHE_SIZE);
+
+    VertexCacheStats stats_after = analyze_vertex_cache(indices, index_count, vertex_count, VERTEX_CACHE_SIZE);
+    u32* after = sorted_triangles(arena, indices, index_count);
+
+    TEST_CHECK(stats_after.triangle_count == stats_before.triangle_count);
+    TEST_CHECK(stats_after.vertex_count == vertex_count);
+    TEST_CHECK(stats_after.acmr < stats_before.acmr * 0.9f);
+    TEST_CHECK(memcmp(before, after, index_count * sizeof(u32)) == 0);
+}
+
+// The grid as an unindexed triangle soup, each corner its own vertex, nudged by less than half of epsilon. Corners
+// of quads right of the middle column get their U shifted by three epsilon there, an attribute seam welding must
+// keep.
+internal void make_grid_soup(Arena* arena, u32 n, Vertex** out_vertices, u32** out_indices, u32* out_index_count) {
+    Vertex* grid_vertices;
+    u32 grid_vertex_count;
+    u32* grid_indices;
+    u32 index_count;
+    make_grid(arena, n, &grid_vertices, &grid_vertex_count, &grid_indices, &index_count);
+
+    Vertex* vertices = arena_push_array(arena, Vertex, index_count);
+    u32* indices = arena_push_array(arena, u32, index_count);
+
+    for (u32 i = 0; i < index_count; ++i) {
+        u32 v = grid_indices[i];
+        f32 nudge = WELD_EPSILON * 0.4f * ((i % 5) / 2.0f - 1.0f);
+
+        vertices[i] = grid_vertices[v];
+        vertices[i].pos.x += nudge;
+        vertices[i].pos.y -= nudge;
+        vertices[i].uv.y += nudge;
+
+        u32 quad_x = (i / 6) % n;
+        if (quad_x >= n / 2 && v % (n + 1) == n / 2) {
+            vertices[i].uv.x += 3.0f * WELD_EPSILON;
+        }
+
+        indices[i] = i;
+    }
+
+    *out_vertices = vertices;
+    *out_indices = indices;
+    *out_index_count = index_count;
+}
+
+internal bool vertices_within(Vertex* a, Vertex* b, f32 epsilon) {
+    f32* fa = (f32*)a;
+    f32* fb = (f32*)b;
+
+    for (u32 i = 0; i < sizeof(Vertex) / sizeof(f32); ++i) {
+        if (fabsf(fa[i] - fb[i]) > epsilon) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Corners within epsilon of each other merge, every index still points at its corner, and the two sides of the
+// seam, a few epsilon apart, stay separate.
+void test_weld_vertices(Arena* arena) {
+    u32 n = WELD_GRID_SIZE;
+
+    Vertex* vertices;
+    u32* indices;
+    u32 index_count;
+    make_grid_soup(arena, n, &vertices, &indices, &index_count);
+
+    Vertex* original = arena_push_array(arena, Vertex, index_count);
+    memcpy(original, vertices, index_count * sizeof(Vertex));
+
+    u32 vertex_count = weld_vertices(vertices, indices, index_count, index_count, WELD_EPSILON);
+
+    TEST_CHECK(vertex_count == (n + 1) * (n + 1) + (n + 1));
+
+    bool same_corners = true;
+    for (u32 i = 0; i < index_count; ++i) {
+        same_corners &= indices[i] < vertex_count && vertices_within(&vertices[indices[i]], &original[i], WELD_EPSILON);
+    }
+
+    TEST_CHECK(same_corners);
+}
@@ -0,0 +1,48 @@
+#include <math.h>
+
+#include "test_meshes.h"
+
+void make_sphere(Arena* arena, u32 n, f32 bump, Vertex** out_vertices, u32* out_vertex_count, u32** out_indices, u32* out_index_count) {
+    u32 vertex_count = (n + 1) * (n + 1);
+    Vertex* vertices = arena_push_array(arena, Vertex, vertex_count);
+
+    for (u32 y = 0; y <= n; ++y) {
+        for (u32 x = 0; x <= n; ++x) {
+            f32 u = (f32)x / n;
+            f32 v = (f32)y / n;
+            f32 theta = u * 2.0f * PI32;
+            f32 phi = v * PI32;
+            f32 r = 1.0f + bump * sinf(theta * 7.0f + phi * 5.0f) * sinf(phi * 11.0f);
+
+            Vertex* vertex = &vertices[y * (n + 1) + x];
+            vertex->pos = { r * sinf(phi) * cosf(theta), r * cosf(phi), r * sinf(phi) * sinf(theta) };
+            vertex->norm = { sinf(phi) * cosf(theta), cosf(phi), sinf(phi) * sinf(theta) };
+            vertex->uv = { u, v };
+        }
+    }
+
+    u32 index_count = n * n * 6;
+    u32* indices = arena_push_array(arena, u32, index_count);
+    u32 cursor = 0;
+
+    for (u32 y = 0; y < n; ++y) {
+        for (u32 x = 0; x < n; ++x) {
+            u32 a = y * (n + 1) + x;
+            u32 b = a + 1;
+            u32 c = a + n + 1;
+            u32 d = c + 1;
+
+            indices[cursor++] = a;
+            indices[cursor++] = c;
+            indices[cursor++] = b;
+            indices[cursor++] = b;
+            indices[cursor++] = c;
+            indices[cursor++] = d;
+        }
+    }
+
+    *out_vertices = vertices;
+    *out_vertex_count = vertex_count;
+    *out_indices = indices;
+    *out_index_count = index_count;
+}
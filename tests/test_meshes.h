@@ -0,0 +1,11 @@
+#pragma once
+
+#include "test.h"
+#include "renderer/renderer.h"
+
+// Meshes shared by more than one test file.
+
+// A grid bent into a unit sphere, with bumps of the given height, so every level of simplification actually moves
+// the surface and meshlets see curvature. The seam where u wraps around is left open, like an attribute seam after
+// welding.
+void make_sphere(Arena* arena, u32 n, f32 bump, Vertex** out_vertices, u32* out_vertex_count, u32** out_indices, u32* out_index_count);
@@ -0,0 +1,248 @@
+#include <math.h>
+#include <string.h>
+
+#include "test.h"
+#include "test_meshes.h"
+#include "renderer/mesh_optimizer.h"
+#include "renderer/meshlet.h"
+
+#define NUM_CULL_CAMERAS 256
+
+struct MeshletLimits {
+    u32 max_vertices;
+    u32 max_triangles;
+};
+
+// The loader's limits, the smallest possible, and ones where either limit is the one that closes meshlets.
+global_var MeshletLimits meshlet_limits[] = {
+    { MESHLET_MAX_VERTICES, MESHLET_MAX_TRIANGLES },
+    { 3, 1 },
+    { 16, 124 },
+    { 254, 8 },
+};
+
+// A bumpy sphere in the order the loader hands build_meshlets, after Tipsify.
+internal void make_meshlet_sphere(Arena* arena, Vertex** vertices, u32* vertex_count, u32** indices, u32* index_count) {
+    make_sphere(arena, 32, 0.08f, vertices, vertex_count, indices, index_count);
+    optimize_vertex_cache(*indices, *index_count, *vertex_count, VERTEX_CACHE_SIZE);
+}
+
+// No meshlet goes over either limit, each lists a vertex once, and local indices stay inside the meshlet's vertices.
+void test_meshlet_limits(Arena* arena) {
+    Vertex* vertices;
+    u32 vertex_count;
+    u32* indices;
+    u32 index_count;
+    make_meshlet_sphere(arena, &vertices, &vertex_count, &indices, &index_count);
+
+    for (u32 l = 0; l < ARRAY_LEN(meshlet_limits); ++l) {
+        MeshletLimits limits = meshlet_limits[l];
+        MeshletBuildResult build = build_meshlets(arena, indices, index_count, vertex_count, limits.max_vertices, limits.max_triangles);
+
+        TEST_CHECK(build.meshlet_count > 0);
+
+        for (u32 m = 0; m < build.meshlet_count; ++m) {
+            MeshletRange* meshlet = &build.meshlets[m];
+
+            TEST_CHECK(meshlet->vertex_count >= 3 && meshlet->vertex_count <= limits.max_vertices);
+            TEST_CHECK(meshlet->triangle_count >= 1 && meshlet->triangle_count <= limits.max_triangles);
+
+            bool distinct = true;
+            for (u32 i = 0; i < meshlet->vertex_count; ++i)
+            for (u32 j = 0; j < i; ++j) {
+                distinct &= build.vertices[meshlet->vertex_offset + i] != build.vertices[meshlet->vertex_offset + j];
+            }
+
+            TEST_CHECK(distinct);
+
+            bool local = true;
+            for (u32 i = 0; i < meshlet->triangle_count * 3; ++i) {
+                local &= build.triangles[meshlet->triangle_offset * 3 + i] < meshlet->vertex_count;
+            }
+
+            TEST_CHECK(local);
+        }
+    }
+}
+
+// Meshlets are laid out back to back and hold every triangle once. Meshlets keep the index buffer's order, so
+// writing them back out gives the input again.
+void test_meshlet_coverage(Arena* arena) {
+    Vertex* vertices;
+    u32 vertex_count;
+    u32* indices;
+    u32 index_count;
+    make_meshlet_sphere(arena, &vertices, &vertex_count, &indices, &index_count);
+
+    u32* written = arena_push_array(arena, u32, index_count);
+
+    for (u32 l = 0; l < ARRAY_LEN(meshlet_limits); ++l) {
+        MeshletLimits limits = meshlet_limits[l];
+        MeshletBuildResult build = build_meshlets(arena, indices, index_count, vertex_count, limits.max_vertices, limits.max_triangles);
+
+        u32 vertex_offset = 0;
+        u32 triangle_offset = 0;
+
+        for (u32 m = 0; m < build.meshlet_count; ++m) {
+            TEST_CHECK(build.meshlets[m].vertex_offset == vertex_offset);
+            TEST_CHECK(build.meshlets[m].triangle_offset == triangle_offset);
+
+            vertex_offset += build.meshlets[m].vertex_count;
+            triangle_offset += build.meshlets[m].triangle_count;
+        }
+
+        TEST_CHECK(triangle_offset == index_count / 3);
+
+        memset(written, 0xFF, index_count * sizeof(u32));
+        write_meshlet_indices(&build, written);
+
+        TEST_CHECK(memcmp(written, indices, index_count * sizeof(u32)) == 0);
+    }
+}
+
+internal u32 next_meshlet_random(u32* state) {
+    u32 x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+internal f32 random_unit(u32* state) {
+    return (f32)(next_meshlet_random(state) & 0xFFFFFF) / (f32)0xFFFFFF;
+}
+
+internal XMVECTOR random_direction(u32* state) {
+    while (true) {
+        XMVECTOR v = XMVectorSet(random_unit(state) * 2.0f - 1.0f, random_unit(state) * 2.0f - 1.0f, random_unit(state) * 2.0f - 1.0f, 0.0f);
+        f32 length_sq = XMVectorGetX(XMVector3LengthSq(v));
+
+        if (length_sq > 0.01f && length_sq <= 1.0f) {
+            return XMVector3Normalize(v);
+        }
+    }
+}
+
+internal XMVECTOR plane_through(XMVECTOR normal, XMVECTOR point) {
+    return XMVectorSetW(normal, -XMVectorGetX(XMVector3Dot(normal, point)));
+}
+
+// A symmetric frustum with inward-facing planes. A zero half angle gives planes everything is inside of, to test
+// the cone on its own.
+internal void make_test_frustum(XMVECTOR position, XMVECTOR forward, f32 half_angle, XMVECTOR* frustum) {
+    if (half_angle == 0.0f) {
+        for (u32 i = 0; i < 6; ++i) {
+            frustum[i] = XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f);
+        }
+        return;
+    }
+
+    XMVECTOR up_hint = fabsf(XMVectorGetY(forward)) < 0.9f ? XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f) : XMVectorSet(1.0f, 0.0f, 0.0f, 0.0f);
+    XMVECTOR right = XMVector3Normalize(XMVector3Cross(up_hint, forward));
+    XMVECTOR up = XMVector3Cross(forward, right);
+
+    f32 s = sinf(half_angle);
+    f32 c = cosf(half_angle);
+
+    frustum[0] = plane_through(right * c + forward * s, position);
+    frustum[1] = plane_through(-right * c + forward * s, position);
+    frustum[2] = plane_through(up * c + forward * s, position);
+    frustum[3] = plane_through(-up * c + forward * s, position);
+    frustum[4] = plane_through(forward, position + forward * 0.1f);
+    frustum[5] = plane_through(-forward, position + forward * 100.0f);
+}
+
+internal bool inside_frustum(XMVECTOR* frustum, XMVECTOR p) {
+    for (u32 i = 0; i < 6; ++i) {
+        if (XMVectorGetX(XMPlaneDotCoord(frustum[i], p)) < 0.0f) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Whether a triangle clearly faces the camera and has a corner or its center in the frustum. Triangles seen close
+// to edge-on are left out, since float rounding decides which side of them the camera is on.
+internal bool triangle_visible(XMVECTOR* p, XMVECTOR* frustum, XMVECTOR camera_position) {
+    XMVECTOR normal = XMVector3Cross(p[1] - p[0], p[2] - p[0]);
+    if (XMVectorGetX(XMVector3LengthSq(normal)) == 0.0f) {
+        return false;
+    }
+
+    XMVECTOR view = XMVector3Normalize(p[0] - camera_position);
+    if (XMVectorGetX(XMVector3Dot(XMVector3Normalize(normal), view)) > -0.001f) {
+        return false;
+    }
+
+    XMVECTOR center = (p[0] + p[1] + p[2]) * (1.0f / 3.0f);
+    return inside_frustum(frustum, p[0]) || inside_frustum(frustum, p[1]) || inside_frustum(frustum, p[2]) || inside_frustum(frustum, center);
+}
+
+// From cameras all around a scaled, rotated and moved sphere, the sphere and cone tests never cull a meshlet with a
+// triangle that faces the camera inside the frustum. Every other camera sees everything, so the cone alone culls,
+// and the frustum culls more on top of it.
+void test_meshlet_culling_conservative(Arena* arena) {
+    Vertex* vertices;
+    u32 vertex_count;
+    u32* indices;
+    u32 index_count;
+    make_meshlet_sphere(arena, &vertices, &vertex_count, &indices, &index_count);
+
+    MeshletBuildResult build = build_meshlets(arena, indices, index_count, vertex_count, MESHLET_MAX_VERTICES, MESHLET_MAX_TRIANGLES);
+
+    Meshlet* meshlets = arena_push_array(arena, Meshlet, build.meshlet_count);
+    for (u32 m = 0; m < build.meshlet_count; ++m) {
+        meshlets[m].bounds = compute_meshlet_bounds(&build, &build.meshlets[m], vertices);
+        meshlets[m].index_offset = build.meshlets[m].triangle_offset * 3;
+        meshlets[m].index_count = build.meshlets[m].triangle_count * 3;
+    }
+
+    write_meshlet_indices(&build, indices);
+
+    XMVECTOR rotation = XMVector4Normalize(XMVectorSet(0.3f, -0.5f, 0.2f, 0.8f));
+    XMMATRIX transform = XMMatrixScaling(2.0f, 2.0f, 2.0f) * XMMatrixRotationQuaternion(rotation) * XMMatrixTranslation(5.0f, -1.0f, 3.0f);
+    XMVECTOR sphere_center = transform.r[3];
+
+    XMVECTOR* world = arena_push_array(arena, XMVECTOR, vertex_count);
+    for (u32 i = 0; i < vertex_count; ++i) {
+        world[i] = XMVector3Transform(XMLoadFloat3(&vertices[i].pos), transform);
+    }
+
+    u32* visible = arena_push_array(arena, u32, build.meshlet_count);
+    u32 random = 0x2545F491;
+    u32 num_missed = 0;
+    u32 num_culled[2] = {};
+
+    for (u32 camera = 0; camera < NUM_CULL_CAMERAS; ++camera) {
+        f32 distance = 2.5f + random_unit(&random) * 10.0f;
+        XMVECTOR camera_position = sphere_center + random_direction(&random) * distance;
+        XMVECTOR target = sphere_center + random_direction(&random) * (random_unit(&random) * 3.0f);
+        XMVECTOR forward = XMVector3Normalize(target - camera_position);
+
+        XMVECTOR frustum[6];
+        make_test_frustum(camera_position, forward, camera % 2 ? 0.2f + random_unit(&random) * 0.6f : 0.0f, frustum);
+
+        u32 visible_count = cull_meshlets(meshlets, build.meshlet_count, transform, frustum, camera_position, visible);
+        num_culled[camera % 2] += build.meshlet_count - visible_count;
+
+        u32 next_visible = 0;
+        for (u32 m = 0; m < build.meshlet_count; ++m) {
+            if (next_visible < visible_count && visible[next_visible] == m) {
+                ++next_visible;
+                continue;
+            }
+
+            for (u32 i = 0; i < meshlets[m].index_count; i += 3) {
+                u32* triangle = indices + meshlets[m].index_offset + i;
+                XMVECTOR p[3] = { world[triangle[0]], world[triangle[1]], world[triangle[2]] };
+
+                num_missed += triangle_visible(p, frustum, camera_position);
+            }
+        }
+    }
+
+    TEST_CHECK(num_missed == 0);
+    TEST_CHECK(num_culled[0] > 0);
+    TEST_CHECK(num_culled[1] > num_culled[0]);
+}
@@ -0,0 +1,334 @@
+#include <float.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "test.h"
+#include "utility/pak.h"
+
+#define TEST_PAK_PATH "test_pak.pak"
+#define NUM_BENCH_FILES 1024
+#define NUM_TOC_CORRUPTIONS 6
+
+// The layout pak.cpp writes, to corrupt it with.
+struct TestPakHeader {
+    u32 magic;
+    u32 version;
+    u32 num_files;
+    u32 num_chunks;
+    u64 toc_offset;
+    u64 paths_size;
+};
+
+struct TestPakFileEntry {
+    u64 path_hash;
+    u64 size;
+    u32 first_chunk;
+    u32 num_chunks;
+    u32 path_offset;
+    u32 path_len;
+};
+
+internal u32 next_pak_random(u32* state) {
+    u32 x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+// Compressible files are words from a short list, like text; the rest are noise LZ4 can't shrink, like
+// compressed textures.
+internal void fill_test_file(u8* data, u64 size, u32 seed, bool compressible) {
+    char* words[] = { "vertex ", "index ", "material ", "texture ", "mesh ", "node ", "scene ", "\n" };
+    u32 random = seed * 2654435761u + 1;
+
+    for (u64 i = 0; i < size;) {
+        if (compressible) {
+            char* word = words[next_pak_random(&random) % ARRAY_LEN(words)];
+            for (char* c = word; *c && i < size; ++c) {
+                data[i++] = (u8)*c;
+            }
+        }
+        else {
+            data[i++] = (u8)next_pak_random(&random);
+        }
+    }
+}
+
+internal void write_test_file(Arena* arena, char* path, u64 size, u32 seed, bool compressible) {
+    Scratch scratch = get_scratch(&arena, 1);
+
+    u8* data = arena_push_array(scratch.arena, u8, size);
+    fill_test_file(data, size, seed, compressible);
+    write_file(path, data, size);
+
+    release_scratch(scratch);
+}
+
+internal bool read_matches(Arena* arena, Pak* pak, char* path, u64 size, u32 seed, bool compressible) {
+    Scratch scratch = get_scratch(&arena, 1);
+
+    u8* expected = arena_push_array(scratch.arena, u8, size);
+    fill_test_file(expected, size, seed, compressible);
+
+    ReadFileResult result = {};
+    bool found = true;
+
+    if (pak) {
+        found = pak_read(pak, scratch.arena, path, &result);
+    }
+    else {
+        result = read_file(scratch.arena, path);
+    }
+
+    bool matches = found && result.size == size && memcmp(result.memory, expected, size) == 0 && result.memory[size] == '\0';
+
+    release_scratch(scratch);
+
+    return matches;
+}
+
+// Empty, single-chunk and multi-chunk files, both compressed and stored, read back from a pak the same as loose.
+void test_pak_round_trip(Arena* arena) {
+    struct TestFile {
+        char* path;
+        u64 size;
+        bool compressible;
+    };
+
+    TestFile files[] = {
+        { "test_pak_0.bin", 0, true },
+        { "test_pak_1.bin", 100, true },
+        { "test_pak_2.bin", PAK_CHUNK_SIZE, false },
+        { "test_pak_3.bin", 3 * PAK_CHUNK_SIZE + 17, true },
+        { "test_pak_4.bin", 2 * PAK_CHUNK_SIZE + 5, false },
+    };
+
+    char* paths[ARRAY_LEN(files) + 1];
+
+    for (u32 i = 0; i < ARRAY_LEN(files); ++i) {
+        write_test_file(arena, files[i].path, files[i].size, i, files[i].compressible);
+        paths[i] = files[i].path;
+    }
+
+    // A path given twice is packed once.
+    paths[ARRAY_LEN(files)] = "./TEST_PAK_1.BIN";
+    pak_build(TEST_PAK_PATH, ARRAY_LEN(paths), paths);
+
+    Pak* pak = pak_open(arena, TEST_PAK_PATH, 2);
+    TEST_CHECK(pak != 0);
+
+    for (u32 i = 0; i < ARRAY_LEN(files); ++i) {
+        TEST_CHECK(read_matches(arena, pak, files[i].path, files[i].size, i, files[i].compressible));
+    }
+
+    TEST_CHECK(pak_contains(pak, "data/../TEST_PAK_3.BIN"));
+    TEST_CHECK(!pak_contains(pak, "test_pak_5.bin"));
+
+    // Through read_file, the pak holds what the loose files do, under any spelling of their paths.
+    vfs_mount(pak);
+    TEST_CHECK(read_matches(arena, 0, ".\\Test_Pak_4.bin", files[4].size, 4, files[4].compressible));
+    vfs_unmount(pak);
+
+    pak_close(pak);
+
+    for (u32 i = 0; i < ARRAY_LEN(files); ++i) {
+        remove(files[i].path);
+    }
+    remove(TEST_PAK_PATH);
+}
+
+// Corruptions past the last leave the copy intact.
+internal bool pak_copy_opens(Arena* arena, ReadFileResult* pak_file, u32 corruption) {
+    Scratch scratch = get_scratch(&arena, 1);
+
+    u8* memory = arena_push_array(scratch.arena, u8, pak_file->size);
+    memcpy(memory, pak_file->memory, pak_file->size);
+
+    TestPakHeader* header = (TestPakHeader*)memory;
+    TestPakFileEntry* files = (TestPakFileEntry*)(memory + header->toc_offset);
+    u64* offsets = (u64*)(files + header->num_files);
+
+    switch (corruption) {
+        case 0: // A file's chunks run past the pak's
+            files[0].first_chunk = header->num_chunks - files[0].num_chunks + 1;
+            break;
+        case 1: // Offsets go backwards
+            offsets[2] = offsets[1] - 1;
+            break;
+        case 2: // The last chunk runs into the table of contents
+            offsets[header->num_chunks] = header->toc_offset + 1;
+            break;
+        case 3: // A chunk larger than any is written
+            offsets[1] = offsets[0] + PAK_CHUNK_SIZE + 1;
+            break;
+        case 4: // A file larger than its chunks hold
+            files[0].size += PAK_CHUNK_SIZE;
+            break;
+        case 5: // A path running past the end of the paths
+            files[1].path_offset = (u32)header->paths_size - files[1].path_len + 1;
+            break;
+    }
+
+    write_file("test_pak_corrupt.pak", memory, pak_file->size);
+
+    Pak* pak = pak_open(arena, "test_pak_corrupt.pak", 0);
+    if (pak) {
+        pak_close(pak);
+    }
+
+    release_scratch(scratch);
+    remove("test_pak_corrupt.pak");
+
+    return pak != 0;
+}
+
+// A table of contents that would have reads go outside the file, or decompress outside a file's memory, is
+// rejected when the pak is opened.
+void test_pak_rejects_corrupt_toc(Arena* arena) {
+    char* paths[] = { "test_pak_0.bin", "test_pak_1.bin" };
+    write_test_file(arena, paths[0], 3 * PAK_CHUNK_SIZE, 0, true);
+    write_test_file(arena, paths[1], 2 * PAK_CHUNK_SIZE, 1, false);
+
+    pak_build(TEST_PAK_PATH, ARRAY_LEN(paths), paths);
+    ReadFileResult pak_file = read_file(arena, TEST_PAK_PATH);
+
+    TEST_CHECK(pak_copy_opens(arena, &pak_file, NUM_TOC_CORRUPTIONS));
+
+    for (u32 corruption = 0; corruption < NUM_TOC_CORRUPTIONS; ++corruption) {
+        TEST_CHECK(!pak_copy_opens(arena, &pak_file, corruption));
+    }
+
+    for (u32 i = 0; i < ARRAY_LEN(paths); ++i) {
+        remove(paths[i]);
+    }
+    remove(TEST_PAK_PATH);
+}
+
+// A file is found by its path, not only its path's hash: with the stored path changed, the path that hashes to the
+// entry no longer finds it.
+void test_pak_compares_paths(Arena* arena) {
+    char* paths[] = { "test_pak_0.bin", "test_pak_1.bin" };
+    write_test_file(arena, paths[0], 100, 0, true);
+    write_test_file(arena, paths[1], 100, 1, true);
+
+    pak_build(TEST_PAK_PATH, ARRAY_LEN(paths), paths);
+    ReadFileResult pak_file = read_file(arena, TEST_PAK_PATH);
+
+    TestPakHeader* header = (TestPakHeader*)pak_file.memory;
+    TestPakFileEntry* files = (TestPakFileEntry*)(pak_file.memory + header->toc_offset);
+    char* path_table = (char*)(files + header->num_files) + (header->num_chunks + 1) * sizeof(u64);
+
+    path_table[files[0].path_offset] = 'x';
+    write_file("test_pak_renamed.pak", pak_file.memory, pak_file.size);
+
+    Pak* pak = pak_open(arena, "test_pak_renamed.pak", 0);
+    TEST_CHECK(pak != 0);
+
+    if (pak) {
+        TEST_CHECK(pak_contains(pak, paths[0]) != pak_contains(pak, paths[1]));
+        pak_close(pak);
+    }
+
+    for (u32 i = 0; i < ARRAY_LEN(paths); ++i) {
+        remove(paths[i]);
+    }
+    remove("test_pak_renamed.pak");
+    remove(TEST_PAK_PATH);
+}
+
+internal f32 time_reads(Arena* arena, u32 num_files, char** paths, u64* bytes_read) {
+    f32 start = engine_time();
+    *bytes_read = 0;
+
+    for (u32 i = 0; i < num_files; ++i) {
+        Scratch scratch = get_scratch(&arena, 1);
+        *bytes_read += read_file(scratch.arena, paths[i]).size;
+        release_scratch(scratch);
+    }
+
+    return engine_time() - start;
+}
+
+internal void drop_cached_files(u32 num_files, char** paths) {
+    for (u32 i = 0; i < num_files; ++i) {
+        file_drop_cached(paths[i]);
+    }
+    file_drop_cached(TEST_PAK_PATH);
+}
+
+// Reads the same files loose and from a pak, half text-like and half incompressible, 1 KB to 256 KB each. Warm, the
+// files are in the OS's file cache after the first run, so this measures opening and decompressing, not the disk.
+// Cold, every file is dropped from the cache before each pass, and the pak is opened as part of its pass.
+internal void bench_pak_reads(Arena* arena, bool cold) {
+    char** paths = arena_push_array(arena, char*, NUM_BENCH_FILES);
+    u64 loose_size = 0;
+    u32 random = 0x12345678;
+
+    for (u32 i = 0; i < NUM_BENCH_FILES; ++i) {
+        paths[i] = (char*)arena_push(arena, 32);
+        snprintf(paths[i], 32, "test_pak_bench_%u.bin", i);
+
+        u64 size = 1024 + next_pak_random(&random) % (255 * 1024);
+        write_test_file(arena, paths[i], size, i, i % 2 == 0);
+        loose_size += size;
+    }
+
+    pak_build(TEST_PAK_PATH, NUM_BENCH_FILES, paths);
+
+    f32 best_loose = FLT_MAX;
+    f32 best_pak = FLT_MAX;
+
+    for (u32 run = 0; run < 5; ++run) {
+        u64 bytes_read;
+
+        if (cold) {
+            drop_cached_files(NUM_BENCH_FILES, paths);
+        }
+
+        f32 seconds = time_reads(arena, NUM_BENCH_FILES, paths, &bytes_read);
+        TEST_CHECK(bytes_read == loose_size);
+        best_loose = seconds < best_loose ? seconds : best_loose;
+
+        if (cold) {
+            drop_cached_files(NUM_BENCH_FILES, paths);
+        }
+
+        f32 start = engine_time();
+
+        Pak* pak = pak_open(arena, TEST_PAK_PATH, processor_count() - 1);
+        TEST_CHECK(pak != 0);
+
+        vfs_mount(pak);
+        time_reads(arena, NUM_BENCH_FILES, paths, &bytes_read);
+        vfs_unmount(pak);
+
+        seconds = engine_time() - start;
+        pak_close(pak);
+
+        TEST_CHECK(bytes_read == loose_size);
+        best_pak = seconds < best_pak ? seconds : best_pak;
+    }
+
+    File pak_file = file_open(TEST_PAK_PATH);
+    u64 pak_size = file_size(pak_file);
+    file_close(pak_file);
+
+    printf("  %u files, %.1f MB packed to %.1f MB, %s\n", NUM_BENCH_FILES, loose_size / (1024.0f * 1024.0f), pak_size / (1024.0f * 1024.0f), cold ? "cold" : "warm");
+    printf("  loose: %.1f ms (%.0f MB/s)\n", best_loose * 1000.0f, loose_size / (1024.0f * 1024.0f) / best_loose);
+    printf("  pak: %.1f ms (%.0f MB/s)\n", best_pak * 1000.0f, loose_size / (1024.0f * 1024.0f) / best_pak);
+
+    for (u32 i = 0; i < NUM_BENCH_FILES; ++i) {
+        remove(paths[i]);
+    }
+    remove(TEST_PAK_PATH);
+}
+
+void bench_pak_read(Arena* arena) {
+    bench_pak_reads(arena, false);
+}
+
+void bench_pak_read_cold(Arena* arena) {
+    bench_pak_reads(arena, true);
+}
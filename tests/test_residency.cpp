@@ -0,0 +1,118 @@
+#include "test.h"
+#include "renderer/residency.h"
+
+#define NUM_TEST_MATERIALS 4
+#define NO_LIMIT ((u64)-1)
+
+// Small textures, each of which the null backend places in one 64 KB resource, so they're all the same size.
+internal void add_test_materials(ResidencyManager* manager, ResidentMaterial* materials) {
+    u32 texels[4 * 4] = {};
+
+    MaterialCreateInfo info = {};
+    info.texture_w = 4;
+    info.texture_h = 4;
+    info.texture_data = texels;
+
+    for (u32 i = 0; i < NUM_TEST_MATERIALS; ++i) {
+        texels[0] = i;
+        materials[i] = residency_add_material_cached(manager, &info);
+    }
+}
+
+internal bool material_ready(ResidencyManager* manager, Renderer* renderer, ResidentMaterial material) {
+    return residency_use_material(manager, material).handle != renderer_get_default_material(renderer).handle;
+}
+
+// Three of four materials fit in the budget. Using them in a different order than they were loaded in decides which
+// one the fourth evicts.
+void test_residency_lru_eviction(Arena* arena) {
+    Renderer* renderer = renderer_init(arena, 0);
+    ResidencyManager* manager = residency_new(arena, renderer, 16, 0);
+
+    ResidentMaterial materials[NUM_TEST_MATERIALS];
+    add_test_materials(manager, materials);
+
+    // Loaded in order 0, 1, 2 with no budget to stop them.
+    residency_set_budget(manager, NO_LIMIT);
+    for (u32 i = 0; i < 3; ++i) {
+        TEST_CHECK(!material_ready(manager, renderer, materials[i]));
+    }
+    residency_update(manager, NO_LIMIT);
+
+    u64 material_size = residency_stats(manager).bytes_resident / 3;
+    TEST_CHECK(residency_stats(manager).num_resident == 3);
+    residency_set_budget(manager, 3 * material_size);
+
+    // Used in order 2, 0, 1, leaving 2 least recently used.
+    TEST_CHECK(material_ready(manager, renderer, materials[2]));
+    residency_update(manager, NO_LIMIT);
+    TEST_CHECK(material_ready(manager, renderer, materials[0]));
+    TEST_CHECK(material_ready(manager, renderer, materials[1]));
+    residency_update(manager, NO_LIMIT);
+
+    // The fourth is used alone, so the least recently used of the rest makes room for it.
+    TEST_CHECK(!material_ready(manager, renderer, materials[3]));
+    residency_update(manager, NO_LIMIT);
+
+    ResidencyStats stats = residency_stats(manager);
+    TEST_CHECK(stats.evictions == 1);
+    TEST_CHECK(stats.bytes_resident == 3 * material_size);
+
+    TEST_CHECK(material_ready(manager, renderer, materials[3]));
+    TEST_CHECK(material_ready(manager, renderer, materials[0]));
+    TEST_CHECK(material_ready(manager, renderer, materials[1]));
+    TEST_CHECK(!material_ready(manager, renderer, materials[2]));
+
+    // 2 was used the frame it was missed, so it comes back over the budget. The next frame uses nothing, and 3 goes
+    // first, having been used first.
+    residency_update(manager, NO_LIMIT);
+    TEST_CHECK(residency_stats(manager).num_resident == NUM_TEST_MATERIALS);
+    residency_update(manager, NO_LIMIT);
+    TEST_CHECK(material_ready(manager, renderer, materials[2]));
+    TEST_CHECK(!material_ready(manager, renderer, materials[3]));
+
+    residency_destroy(manager);
+    renderer_release_backend(renderer);
+}
+
+// Eviction keeps resident bytes within the budget, except that what's used in a frame stays however much it is.
+void test_residency_budget(Arena* arena) {
+    Renderer* renderer = renderer_init(arena, 0);
+    ResidencyManager* manager = residency_new(arena, renderer, 16, NO_LIMIT);
+
+    ResidentMaterial materials[NUM_TEST_MATERIALS];
+    add_test_materials(manager, materials);
+
+    for (u32 i = 0; i < NUM_TEST_MATERIALS; ++i) {
+        material_ready(manager, renderer, materials[i]);
+    }
+    residency_update(manager, NO_LIMIT);
+
+    u64 material_size = residency_stats(manager).bytes_resident / NUM_TEST_MATERIALS;
+    residency_set_budget(manager, 2 * material_size);
+
+    // Every material used: nothing may go, so the budget is exceeded.
+    for (u32 i = 0; i < NUM_TEST_MATERIALS; ++i) {
+        TEST_CHECK(material_ready(manager, renderer, materials[i]));
+    }
+    residency_update(manager, NO_LIMIT);
+    TEST_CHECK(residency_stats(manager).num_resident == NUM_TEST_MATERIALS);
+
+    // One used: the rest are evicted down to the budget.
+    TEST_CHECK(material_ready(manager, renderer, materials[0]));
+    residency_update(manager, NO_LIMIT);
+
+    ResidencyStats stats = residency_stats(manager);
+    TEST_CHECK(stats.bytes_resident <= 2 * material_size);
+    TEST_CHECK(stats.evictions == 2);
+
+    // Evicted materials missed one at a time are loaded in place of ones not used since.
+    for (u32 frame = 0; frame < 4; ++frame) {
+        material_ready(manager, renderer, materials[frame % NUM_TEST_MATERIALS]);
+        residency_update(manager, 1);
+        TEST_CHECK(residency_stats(manager).bytes_resident <= 2 * material_size);
+    }
+
+    residency_destroy(manager);
+    renderer_release_backend(renderer);
+}
@@ -0,0 +1,129 @@
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+
+#include "test.h"
+#include "renderer/skinning.h"
+
+internal u32 next_random(u32* state) {
+    u32 x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+internal f32 random_range(u32* state, f32 min, f32 max) {
+    return min + (max - min) * (f32)(next_random(state) >> 8) / (f32)(1 << 24);
+}
+
+// Random vertices bound to a random palette of rotated, scaled and translated joints, each vertex with four
+// influences whose weights sum to one.
+internal SkinnedVertices make_skinned_vertices(Arena* arena, u32 vertex_count, u32 joint_count, XMMATRIX** out_palette) {
+    u32 random = 0xC0FFEE;
+
+    XMMATRIX* palette = arena_push_array(arena, XMMATRIX, joint_count);
+    for (u32 i = 0; i < joint_count; ++i) {
+        XMVECTOR rotation = XMQuaternionRotationRollPitchYaw(random_range(&random, -PI32, PI32), random_range(&random, -PI32, PI32), random_range(&random, -PI32, PI32));
+        f32 scale = random_range(&random, 0.5f, 2.0f);
+        palette[i] = XMMatrixScaling(scale, scale, scale) * XMMatrixRotationQuaternion(rotation) *
+            XMMatrixTranslation(random_range(&random, -10.0f, 10.0f), random_range(&random, -10.0f, 10.0f), random_range(&random, -10.0f, 10.0f));
+    }
+
+    SkinnedVertices vertices = {};
+    vertices.vertex_count = vertex_count;
+    vertices.joint_count = joint_count;
+    vertices.bind_vertices = arena_push_array(arena, Vertex, vertex_count);
+    vertices.influences = arena_push_array(arena, SkinInfluence, vertex_count);
+
+    for (u32 i = 0; i < vertex_count; ++i) {
+        Vertex* vertex = &vertices.bind_vertices[i];
+        vertex->pos = { random_range(&random, -5.0f, 5.0f), random_range(&random, -5.0f, 5.0f), random_range(&random, -5.0f, 5.0f) };
+        XMStoreFloat3(&vertex->norm, XMVector3Normalize(XMVectorSet(random_range(&random, -1.0f, 1.0f), random_range(&random, -1.0f, 1.0f), 0.5f, 0.0f)));
+        vertex->uv = { random_range(&random, 0.0f, 1.0f), random_range(&random, 0.0f, 1.0f) };
+
+        SkinInfluence* influence = &vertices.influences[i];
+        f32 total = 0.0f;
+        for (u32 j = 0; j < 4; ++j) {
+            influence->joints[j] = (u16)(next_random(&random) % joint_count);
+            // Every fourth vertex is rigid, bound to one joint like most of a real mesh.
+            influence->weights[j] = i % 4 == 0 && j > 0 ? 0.0f : random_range(&random, 0.0f, 1.0f);
+            total += influence->weights[j];
+        }
+        for (u32 j = 0; j < 4; ++j) {
+            influence->weights[j] /= total;
+        }
+    }
+
+    *out_palette = palette;
+    return vertices;
+}
+
+internal f32 max_difference(XMFLOAT3 a, XMFLOAT3 b) {
+    return fmaxf(fabsf(a.x - b.x), fmaxf(fabsf(a.y - b.y), fabsf(a.z - b.z)));
+}
+
+// The AVX2 path fuses its multiply-adds and orders them differently, so the two only agree to rounding.
+void test_skinning_avx2_matches_sse(Arena* arena) {
+    if (!skinning_has_avx2()) {
+        printf("  skipped: no AVX2 on this processor\n");
+        return;
+    }
+
+    XMMATRIX* palette;
+    SkinnedVertices vertices = make_skinned_vertices(arena, 10000, 64, &palette);
+
+    Vertex* sse = arena_push_array(arena, Vertex, vertices.vertex_count);
+    Vertex* avx2 = arena_push_array(arena, Vertex, vertices.vertex_count);
+    AABB sse_aabb;
+    AABB avx2_aabb;
+
+    skin_vertices_sse(sse, &sse_aabb, &vertices, palette);
+    skin_vertices_avx2(avx2, &avx2_aabb, &vertices, palette);
+
+    f32 max_pos_error = 0.0f;
+    f32 max_norm_error = 0.0f;
+    bool uvs_equal = true;
+
+    for (u32 i = 0; i < vertices.vertex_count; ++i) {
+        max_pos_error = fmaxf(max_pos_error, max_difference(sse[i].pos, avx2[i].pos));
+        max_norm_error = fmaxf(max_norm_error, max_difference(sse[i].norm, avx2[i].norm));
+        uvs_equal &= sse[i].uv.x == avx2[i].uv.x && sse[i].uv.y == avx2[i].uv.y;
+    }
+
+    // Positions reach about 50 units, where a float step is about 4e-6.
+    TEST_CHECK(max_pos_error < 1e-4f);
+    TEST_CHECK(max_norm_error < 1e-5f);
+    TEST_CHECK(uvs_equal);
+    TEST_CHECK(max_difference(sse_aabb.min, avx2_aabb.min) < 1e-4f);
+    TEST_CHECK(max_difference(sse_aabb.max, avx2_aabb.max) < 1e-4f);
+}
+
+void bench_skinning(Arena* arena) {
+    XMMATRIX* palette;
+    SkinnedVertices vertices = make_skinned_vertices(arena, 1000000, 64, &palette);
+
+    Vertex* dst = arena_push_array(arena, Vertex, vertices.vertex_count);
+    AABB aabb;
+
+    for (u32 path = 0; path < 2; ++path) {
+        if (path == 1 && !skinning_has_avx2()) {
+            break;
+        }
+
+        f32 best = FLT_MAX;
+        for (u32 run = 0; run < 5; ++run) {
+            f32 start = engine_time();
+            if (path == 0) {
+                skin_vertices_sse(dst, &aabb, &vertices, palette);
+            }
+            else {
+                skin_vertices_avx2(dst, &aabb, &vertices, palette);
+            }
+            best = fminf(best, engine_time() - start);
+        }
+
+        printf("  %s: %.1f M vertices/s\n", path == 0 ? "SSE" : "AVX2", (f64)vertices.vertex_count / best / 1e6);
+    }
+}
@@ -0,0 +1,156 @@
+#include <math.h>
+
+#include "test.h"
+#include "renderer/texture_streaming.h"
+#include "renderer/block_compression.h"
+
+#define TEST_TEXTURE_SIZE 256
+#define TEST_TEXTURE_MIPS 9
+#define TEST_TAIL_MIP 2 // The first level no larger than MIP_STREAMING_TAIL_SIZE
+#define NUM_BUDGET_TEXTURES 5
+
+internal StreamedTexture add_test_texture(Arena* arena, TextureStreamer* streamer) {
+    MaterialCreateInfo info = {};
+    info.texture_w = TEST_TEXTURE_SIZE;
+    info.texture_h = TEST_TEXTURE_SIZE;
+    info.mip_count = TEST_TEXTURE_MIPS;
+    info.texture_data = arena_push_zero(arena, texture_chain_size(TEXTURE_FORMAT_RGBA8, TEST_TEXTURE_SIZE, TEST_TEXTURE_SIZE, TEST_TEXTURE_MIPS));
+
+    return texture_streamer_add(streamer, &info);
+}
+
+// What a change to first_mip uploads: the chain from there down.
+internal u64 test_chain_size(u32 first_mip) {
+    u64 size = texture_chain_size(TEXTURE_FORMAT_RGBA8, TEST_TEXTURE_SIZE, TEST_TEXTURE_SIZE, TEST_TEXTURE_MIPS);
+    return size - texture_chain_size(TEXTURE_FORMAT_RGBA8, TEST_TEXTURE_SIZE, TEST_TEXTURE_SIZE, first_mip);
+}
+
+// Uses the texture on a unit cube placed along X so it spans the given pixels, seen from the origin with a
+// projection scale of 1. 400 pixels need level 0 of a 256 texture, 100 level 1 and 50 level 2.
+internal void use_at_pixels(TextureStreamer* streamer, StreamedTexture texture, f32 pixels) {
+    AABB aabb = {};
+    aabb.min = { -0.5f, -0.5f, -0.5f };
+    aabb.max = { 0.5f, 0.5f, 0.5f };
+
+    f32 diameter = sqrtf(3.0f);
+    f32 distance = diameter * 0.5f + diameter / pixels;
+
+    texture_streamer_use(streamer, texture, &aabb, XMMatrixTranslation(distance, 0.0f, 0.0f));
+}
+
+internal void begin_test_frame(TextureStreamer* streamer) {
+    texture_streamer_begin_frame(streamer, XMVectorZero(), 1.0f);
+}
+
+// Bigger changes go first, and loads before unloads, whatever order the textures were added in.
+void test_texture_streaming_priority(Arena* arena) {
+    Renderer* renderer = renderer_init(arena, 0);
+    TextureStreamer* streamer = texture_streamer_new(arena, renderer, 16, test_chain_size(0));
+
+    // B is added first, so it would win any tie.
+    StreamedTexture b = add_test_texture(arena, streamer);
+    StreamedTexture a = add_test_texture(arena, streamer);
+
+    begin_test_frame(streamer);
+    texture_streamer_update(streamer);
+    TEST_CHECK(texture_streamer_first_mip(streamer, a) == TEST_TAIL_MIP);
+    TEST_CHECK(texture_streamer_first_mip(streamer, b) == TEST_TAIL_MIP);
+
+    // A needs two more levels and B one. Only A's fits in the budget.
+    begin_test_frame(streamer);
+    use_at_pixels(streamer, a, 400.0f);
+    use_at_pixels(streamer, b, 100.0f);
+    texture_streamer_update(streamer);
+
+    TEST_CHECK(texture_streamer_first_mip(streamer, a) == 0);
+    TEST_CHECK(texture_streamer_first_mip(streamer, b) == TEST_TAIL_MIP);
+    TEST_CHECK(texture_streamer_stats(streamer).num_deferred == 1);
+
+    // B's load was deferred, not dropped.
+    begin_test_frame(streamer);
+    use_at_pixels(streamer, a, 400.0f);
+    use_at_pixels(streamer, b, 100.0f);
+    texture_streamer_update(streamer);
+
+    TEST_CHECK(texture_streamer_first_mip(streamer, b) == 1);
+    TEST_CHECK(texture_streamer_stats(streamer).num_deferred == 0);
+
+    // A drops back to its tail.
+    begin_test_frame(streamer);
+    use_at_pixels(streamer, a, 50.0f);
+    use_at_pixels(streamer, b, 100.0f);
+    texture_streamer_update(streamer);
+    TEST_CHECK(texture_streamer_first_mip(streamer, a) == TEST_TAIL_MIP);
+
+    // A's load and B's unload don't both fit, and the load goes first.
+    begin_test_frame(streamer);
+    use_at_pixels(streamer, a, 400.0f);
+    use_at_pixels(streamer, b, 50.0f);
+    texture_streamer_update(streamer);
+
+    TEST_CHECK(texture_streamer_first_mip(streamer, a) == 0);
+    TEST_CHECK(texture_streamer_first_mip(streamer, b) == 1);
+    TEST_CHECK(texture_streamer_stats(streamer).num_deferred == 1);
+
+    TextureStreamingStats stats = texture_streamer_stats(streamer);
+    TEST_CHECK(stats.num_loads == 5);
+    TEST_CHECK(stats.num_unloads == 1);
+    TEST_CHECK(stats.bytes_resident == test_chain_size(0) + test_chain_size(1));
+
+    texture_streamer_destroy(streamer);
+    renderer_release_backend(renderer);
+}
+
+// Tails are created however much they take. Other changes fit in the budget, except the first of an update, so a
+// chain bigger than the budget still streams in.
+void test_texture_streaming_budget(Arena* arena) {
+    Renderer* renderer = renderer_init(arena, 0);
+    TextureStreamer* streamer = texture_streamer_new(arena, renderer, 16, test_chain_size(1));
+
+    StreamedTexture textures[NUM_BUDGET_TEXTURES];
+    for (u32 i = 0; i < NUM_BUDGET_TEXTURES; ++i) {
+        textures[i] = add_test_texture(arena, streamer);
+    }
+
+    begin_test_frame(streamer);
+    texture_streamer_update(streamer);
+
+    TextureStreamingStats stats = texture_streamer_stats(streamer);
+    TEST_CHECK(stats.bytes_uploaded == NUM_BUDGET_TEXTURES * test_chain_size(TEST_TAIL_MIP));
+    TEST_CHECK(stats.bytes_uploaded > test_chain_size(1));
+    TEST_CHECK(stats.num_deferred == 0);
+
+    // Every texture needs level 1, and one of those fits in each update.
+    for (u32 frame = 0; frame < NUM_BUDGET_TEXTURES; ++frame) {
+        begin_test_frame(streamer);
+        for (u32 i = 0; i < NUM_BUDGET_TEXTURES; ++i) {
+            use_at_pixels(streamer, textures[i], 100.0f);
+        }
+        texture_streamer_update(streamer);
+
+        TEST_CHECK(texture_streamer_stats(streamer).num_deferred == NUM_BUDGET_TEXTURES - 1 - frame);
+    }
+
+    for (u32 i = 0; i < NUM_BUDGET_TEXTURES; ++i) {
+        TEST_CHECK(texture_streamer_first_mip(streamer, textures[i]) == 1);
+    }
+
+    // Level 0's chain is bigger than the budget but is the only change.
+    begin_test_frame(streamer);
+    use_at_pixels(streamer, textures[0], 400.0f);
+    for (u32 i = 1; i < NUM_BUDGET_TEXTURES; ++i) {
+        use_at_pixels(streamer, textures[i], 100.0f);
+    }
+    texture_streamer_update(streamer);
+
+    TEST_CHECK(test_chain_size(0) > test_chain_size(1));
+    TEST_CHECK(texture_streamer_first_mip(streamer, textures[0]) == 0);
+    TEST_CHECK(texture_streamer_stats(streamer).num_deferred == 0);
+
+    stats = texture_streamer_stats(streamer);
+    TEST_CHECK(stats.bytes_resident == test_chain_size(0) + (NUM_BUDGET_TEXTURES - 1) * test_chain_size(1));
+    TEST_CHECK(stats.bytes_fully_resident == NUM_BUDGET_TEXTURES * test_chain_size(0));
+
+    texture_streamer_destroy(streamer);
+    renderer_release_backend(renderer);
+}
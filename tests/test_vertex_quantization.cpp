@@ -0,0 +1,94 @@
+#include <math.h>
+
+#include "test.h"
+#include "renderer/vertex_quantization.h"
+
+#define NUM_QUANTIZED_VERTICES 1001 // Not a multiple of four, so the tail of the SIMD loops runs too
+
+internal u32 next_quantization_random(u32* state) {
+    u32 x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+internal f32 random_in(u32* state, f32 min, f32 max) {
+    return min + (max - min) * ((f32)(next_quantization_random(state) & 0xFFFFFF) / (f32)0xFFFFFF);
+}
+
+// Vertices inside the AABB, with its two corners first, unit normals, and UVs in [0, 1].
+internal Vertex* make_quantization_vertices(Arena* arena, AABB* aabb) {
+    Vertex* vertices = arena_push_array(arena, Vertex, NUM_QUANTIZED_VERTICES);
+    u32 random = 0x9E3779B9;
+
+    for (u32 i = 0; i < NUM_QUANTIZED_VERTICES; ++i) {
+        Vertex* vertex = &vertices[i];
+
+        if (i < 2) {
+            vertex->pos = i == 0 ? aabb->min : aabb->max;
+        }
+        else {
+            vertex->pos = { random_in(&random, aabb->min.x, aabb->max.x), random_in(&random, aabb->min.y, aabb->max.y), random_in(&random, aabb->min.z, aabb->max.z) };
+        }
+
+        XMVECTOR normal = XMVectorSet(random_in(&random, -1.0f, 1.0f), random_in(&random, -1.0f, 1.0f), random_in(&random, -1.0f, 1.0f), 0.0f);
+        XMStoreFloat3(&vertex->norm, XMVector3Normalize(normal + XMVectorSet(0.0f, 0.0f, 0.001f, 0.0f)));
+
+        vertex->uv = { random_in(&random, 0.0f, 1.0f), random_in(&random, 0.0f, 1.0f) };
+    }
+
+    return vertices;
+}
+
+// Positions come back within half a quantization step of where they were on every axis, and no further than
+// that along the diagonal. Half a step is the most round-to-nearest can move them, so the bound is also nearly met.
+void test_compact_vertex_error(Arena* arena) {
+    AABB aabb = {};
+    aabb.min = { -3.0f, 0.5f, 2.0f };
+    aabb.max = { 5.0f, 64.0f, 2.25f };
+
+    Vertex* vertices = make_quantization_vertices(arena, &aabb);
+
+    VertexDequantization dequantization = vertex_dequantization_from_aabb(&aabb);
+    XMFLOAT3 step = dequantization.position_scale;
+
+    TEST_CHECK(fabsf(step.x - 8.0f / 65535.0f) < 1e-9f);
+    TEST_CHECK(fabsf(step.y - 63.5f / 65535.0f) < 1e-9f);
+    TEST_CHECK(fabsf(step.z - 0.25f / 65535.0f) < 1e-9f);
+
+    CompactVertex* encoded = arena_push_array(arena, CompactVertex, NUM_QUANTIZED_VERTICES);
+    encode_compact_vertices(encoded, vertices, NUM_QUANTIZED_VERTICES, &dequantization);
+
+    Vertex* decoded = arena_push_array(arena, Vertex, NUM_QUANTIZED_VERTICES);
+    decode_compact_vertices(decoded, encoded, NUM_QUANTIZED_VERTICES, &dequantization);
+
+    // Float rounding in the offset and scale, relative to the largest coordinate.
+    f32 slack = 64.0f * 1e-6f;
+    XMFLOAT3 max_axis_error = {};
+
+    for (u32 i = 0; i < NUM_QUANTIZED_VERTICES; ++i) {
+        max_axis_error.x = fmaxf(max_axis_error.x, fabsf(decoded[i].pos.x - vertices[i].pos.x));
+        max_axis_error.y = fmaxf(max_axis_error.y, fabsf(decoded[i].pos.y - vertices[i].pos.y));
+        max_axis_error.z = fmaxf(max_axis_error.z, fabsf(decoded[i].pos.z - vertices[i].pos.z));
+    }
+
+    TEST_CHECK(max_axis_error.x <= step.x * 0.5f + slack && max_axis_error.x >= step.x * 0.4f);
+    TEST_CHECK(max_axis_error.y <= step.y * 0.5f + slack && max_axis_error.y >= step.y * 0.4f);
+    TEST_CHECK(max_axis_error.z <= step.z * 0.5f + slack && max_axis_error.z >= step.z * 0.4f);
+
+    // The corners land exactly on the first and last steps.
+    TEST_CHECK(encoded[0].pos[0] == 0 && encoded[0].pos[1] == 0 && encoded[0].pos[2] == 0);
+    TEST_CHECK(encoded[1].pos[0] == 65535 && encoded[1].pos[1] == 65535 && encoded[1].pos[2] == 65535);
+
+    CompactVertexError error = measure_compact_vertex_error(vertices, encoded, NUM_QUANTIZED_VERTICES, &dequantization);
+    f32 half_diagonal = 0.5f * sqrtf(step.x * step.x + step.y * step.y + step.z * step.z);
+
+    TEST_CHECK(error.max_position_error <= half_diagonal + slack);
+
+    // Octahedral 16-bit normals are good to a few thousandths of a degree, finer than a float acos near 1 resolves,
+    // and half-float UVs in [0, 1] to 2^-12.
+    TEST_CHECK(error.max_normal_error_degrees < 0.05f);
+    TEST_CHECK(error.max_uv_error <= 1.0f / 4096.0f);
+}
@@ -0,0 +1,190 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "test.h"
+#include "renderer/gltf_world.h"
+#include "renderer/texture_cache.h"
+
+#define TEST_WORLD_CELLS 4
+#define TEST_WORLD_CELL_SIZE 10.0f
+#define TEST_WORLD_IMAGE "test_world.png"
+
+// A row of triangles along X, one in the middle of each cell, each with a mesh of its own and all drawn with one
+// material. The buffer is a file of its own, which the world reads from as cells stream in.
+internal void write_test_world() {
+    f32 vertices[] = {
+        0.0f, 0.0f, 0.0f,  1.0f, 0.0f, 0.0f,  0.0f, 0.0f, 1.0f, // Positions
+        0.0f, 1.0f, 0.0f,  0.0f, 1.0f, 0.0f,  0.0f, 1.0f, 0.0f, // Normals
+        0.0f, 0.0f,  1.0f, 0.0f,  0.0f, 1.0f, // UVs
+    };
+    u32 indices[] = { 0, 1, 2 };
+
+    u8 buffer[sizeof(vertices) + sizeof(indices)];
+    memcpy(buffer, vertices, sizeof(vertices));
+    memcpy(buffer + sizeof(vertices), indices, sizeof(indices));
+    write_file("test_world.bin", buffer, sizeof(buffer));
+
+    char json[8 * 1024];
+    int len = 0;
+
+    len += snprintf(json + len, sizeof(json) - len,
+        "{\"asset\":{\"version\":\"2.0\"},\"buffers\":[{\"uri\":\"test_world.bin\",\"byteLength\":%u}],"
+        "\"bufferViews\":[{\"buffer\":0,\"byteLength\":36},{\"buffer\":0,\"byteOffset\":36,\"byteLength\":36},"
+        "{\"buffer\":0,\"byteOffset\":72,\"byteLength\":24},{\"buffer\":0,\"byteOffset\":96,\"byteLength\":12}],\"accessors\":[",
+        (u32)sizeof(buffer));
+
+    // Accessors of their own keep the meshes from being deduplicated into one.
+    for (u32 i = 0; i < TEST_WORLD_CELLS; ++i) {
+        len += snprintf(json + len, sizeof(json) - len,
+            "%s{\"bufferView\":0,\"componentType\":5126,\"count\":3,\"type\":\"VEC3\",\"min\":[0,0,0],\"max\":[1,0,1]},"
+            "{\"bufferView\":1,\"componentType\":5126,\"count\":3,\"type\":\"VEC3\"},"
+            "{\"bufferView\":2,\"componentType\":5126,\"count\":3,\"type\":\"VEC2\"},"
+            "{\"bufferView\":3,\"componentType\":5125,\"count\":3,\"type\":\"SCALAR\"}",
+            i > 0 ? "," : "");
+    }
+
+    len += snprintf(json + len, sizeof(json) - len, "],\"meshes\":[");
+
+    for (u32 i = 0; i < TEST_WORLD_CELLS; ++i) {
+        u32 a = i * 4;
+        len += snprintf(json + len, sizeof(json) - len,
+            "%s{\"primitives\":[{\"attributes\":{\"POSITION\":%u,\"NORMAL\":%u,\"TEXCOORD_0\":%u},\"indices\":%u,\"material\":0}]}",
+            i > 0 ? "," : "", a, a + 1, a + 2, a + 3);
+    }
+
+    len += snprintf(json + len, sizeof(json) - len, "],\"nodes\":[");
+
+    for (u32 i = 0; i < TEST_WORLD_CELLS; ++i) {
+        len += snprintf(json + len, sizeof(json) - len, "%s{\"mesh\":%u,\"translation\":[%.1f,0,4.5]}",
+            i > 0 ? "," : "", i, i * TEST_WORLD_CELL_SIZE + 4.5f);
+    }
+
+    len += snprintf(json + len, sizeof(json) - len,
+        "],\"scenes\":[{\"nodes\":[0,1,2,3]}],\"images\":[{\"uri\":\"" TEST_WORLD_IMAGE "\"}],\"textures\":[{\"source\":0}],"
+        "\"materials\":[{\"pbrMetallicRoughness\":{\"baseColorTexture\":{\"index\":0}}}]}");
+
+    assert(len < (int)sizeof(json));
+    write_file("test_world.gltf", json, len);
+}
+
+internal void remove_test_world() {
+    remove("test_world.gltf");
+    remove("test_world.bin");
+}
+
+// Stands in for another load holding the world's image, created in context, so the world takes it from the cache
+// instead of reading it.
+internal Material add_test_world_image(Renderer* renderer, TextureCache* cache, RendererUploadContext* context) {
+    u32 texels[4 * 4] = {};
+
+    MaterialCreateInfo info = {};
+    info.texture_w = 4;
+    info.texture_h = 4;
+    info.texture_data = texels;
+
+    Material material = renderer_new_material(renderer, context, &info);
+    TextureContentKey key = texture_content_key(texels, sizeof(texels));
+    texture_cache_insert(cache, TEST_WORLD_IMAGE, &key, material);
+
+    return material;
+}
+
+internal GLTFWorld* open_test_world(Arena* arena, Renderer* renderer, TextureCache* cache) {
+    GLTFLoadOptions options = gltf_default_load_options();
+
+    GLTFWorldOptions world_options = {};
+    world_options.cell_size = TEST_WORLD_CELL_SIZE;
+    world_options.load_radius = 5.0f;
+    world_options.unload_radius = 15.0f;
+
+    return gltf_open_world(arena, renderer, cache, &options, &world_options, "test_world.gltf");
+}
+
+// Cells stream in around the camera and out once it's past unload_radius, and what's resident is what the loaded
+// cells hold.
+void test_world_streaming(Arena* arena) {
+    write_test_world();
+
+    Renderer* renderer = renderer_init(arena, 0);
+    TextureCache* cache = texture_cache_new(arena, 16);
+
+    RendererUploadContext* context = renderer_open_upload_context(arena, renderer);
+    Material image = add_test_world_image(renderer, cache, context);
+    renderer_submit_upload_context(arena, renderer, context);
+
+    GLTFWorld* world = open_test_world(arena, renderer, cache);
+    TEST_CHECK(gltf_world_stats(world).num_cells == TEST_WORLD_CELLS);
+    TEST_CHECK(gltf_world_instances(world).num_instances == 0);
+
+    // Only the cell the camera is in is within load_radius.
+    gltf_update_world(world, XMVectorSet(5.0f, 0.0f, 5.0f, 0.0f), 1.0f);
+
+    GLTFWorldStats stats = gltf_world_stats(world);
+    TEST_CHECK(stats.num_loaded_cells == 1);
+    TEST_CHECK(gltf_world_instances(world).num_instances == 1);
+
+    u64 material_size = renderer_material_size(renderer, image);
+    u64 mesh_size = stats.bytes_resident - material_size;
+
+    // At the far end, the first cell is past unload_radius and the last streams in.
+    gltf_update_world(world, XMVectorSet(35.0f, 0.0f, 5.0f, 0.0f), 1.0f);
+
+    stats = gltf_world_stats(world);
+    TEST_CHECK(stats.num_loaded_cells == 1);
+    TEST_CHECK(stats.cell_loads == 2);
+    TEST_CHECK(stats.cell_unloads == 1);
+    TEST_CHECK(stats.bytes_resident == mesh_size + material_size);
+
+    // Back in the second cell, the last is exactly unload_radius away and stays.
+    gltf_update_world(world, XMVectorSet(15.0f, 0.0f, 5.0f, 0.0f), 1.0f);
+
+    stats = gltf_world_stats(world);
+    TEST_CHECK(stats.num_loaded_cells == 2);
+    TEST_CHECK(stats.cell_unloads == 1);
+    TEST_CHECK(stats.bytes_resident == 2 * mesh_size + material_size);
+    TEST_CHECK(gltf_world_instances(world).num_instances == 2);
+
+    // The material is shared by every cell, so the world's reference goes with the last of them.
+    gltf_close_world(world);
+    TEST_CHECK(renderer_material_alive(renderer, image));
+
+    texture_cache_release(cache, renderer, image);
+    TEST_CHECK(texture_cache_num_entries(cache) == 0);
+
+    renderer_release_backend(renderer);
+    remove_test_world();
+}
+
+// A cell drawing a material that's still on its way in someone else's upload isn't drawn until that finishes.
+void test_world_shared_upload(Arena* arena) {
+    write_test_world();
+
+    Renderer* renderer = renderer_init(arena, 0);
+    TextureCache* cache = texture_cache_new(arena, 16);
+
+    RendererUploadContext* context = renderer_open_upload_context(arena, renderer);
+    Material image = add_test_world_image(renderer, cache, context);
+
+    GLTFWorld* world = open_test_world(arena, renderer, cache);
+    XMVECTOR camera_position = XMVectorSet(5.0f, 0.0f, 5.0f, 0.0f);
+
+    gltf_update_world(world, camera_position, 1.0f);
+
+    GLTFWorldStats stats = gltf_world_stats(world);
+    TEST_CHECK(stats.num_loaded_cells == 0);
+    TEST_CHECK(stats.num_streaming_cells == 1);
+    TEST_CHECK(gltf_world_instances(world).num_instances == 0);
+
+    renderer_submit_upload_context(arena, renderer, context);
+    gltf_update_world(world, camera_position, 1.0f);
+
+    stats = gltf_world_stats(world);
+    TEST_CHECK(stats.num_loaded_cells == 1);
+    TEST_CHECK(stats.num_streaming_cells == 0);
+    TEST_CHECK(gltf_world_instances(world).num_instances == 1);
+
+    gltf_close_world(world);
+    texture_cache_release(cache, renderer, image);
+    renderer_release_backend(renderer);
+    remove_test_world();
+}